@@ -9,6 +9,37 @@ HEADERS += ./src/Model.h \
     ./src/Model.h \
     ./src/TabPane.h \
     ./src/Utils.h \
+    ./src/MeshSimplifier.h \
+    ./src/MeshOptimizer.h \
+    ./src/VertexCompressor.h \
+    ./src/MeshClusterizer.h \
+    ./src/Frustum.h \
+    ./src/GLStateCache.h \
+    ./src/Renderer.h \
+    ./src/OffscreenRenderer.h \
+    ./src/BatchRenderer.h \
+    ./src/Benchmark.h \
+    ./src/FrameProfiler.h \
+    ./src/ImportStatistics.h \
+    ./src/ModelStatisticsDialog.h \
+    ./src/MemoryTracker.h \
+    ./src/NativeImporter.h \
+    ./src/FloatParser.h \
+    ./src/ModelLoader.h \
+    ./src/ModelCache.h \
+    ./src/MeshBounds.h \
+    ./src/Bvh.h \
+    ./src/ModelPicker.h \
+    ./src/GpuPicker.h \
+    ./src/NormalGenerator.h \
+    ./src/TangentGenerator.h \
+    ./src/PointCloud.h \
+    ./src/PointRenderer.h \
+    ./src/PointCloudFile.h \
+    ./src/PointCloudStream.h \
+    ./src/EdgeExtractor.h \
+    ./src/MeshAnalyzer.h \
+    ./src/MeshReportDialog.h \
     ./GeneratedFiles/ui_mainwindow.h \
     ./ThirdParty/glm/glm/common.hpp \
     ./ThirdParty/glm/glm/exponential.hpp \
@@ -165,6 +196,37 @@ SOURCES += ./src/main.cpp \
     ./src/Model.cpp \
     ./src/ModelViewer.cpp \
     ./src/TabPane.cpp \
+    ./src/MeshSimplifier.cpp \
+    ./src/MeshOptimizer.cpp \
+    ./src/VertexCompressor.cpp \
+    ./src/MeshClusterizer.cpp \
+    ./src/Frustum.cpp \
+    ./src/GLStateCache.cpp \
+    ./src/Renderer.cpp \
+    ./src/OffscreenRenderer.cpp \
+    ./src/BatchRenderer.cpp \
+    ./src/Benchmark.cpp \
+    ./src/FrameProfiler.cpp \
+    ./src/ImportStatistics.cpp \
+    ./src/ModelStatisticsDialog.cpp \
+    ./src/MemoryTracker.cpp \
+    ./src/NativeImporter.cpp \
+    ./src/FloatParser.cpp \
+    ./src/ModelLoader.cpp \
+    ./src/ModelCache.cpp \
+    ./src/MeshBounds.cpp \
+    ./src/Bvh.cpp \
+    ./src/ModelPicker.cpp \
+    ./src/GpuPicker.cpp \
+    ./src/NormalGenerator.cpp \
+    ./src/TangentGenerator.cpp \
+    ./src/PointCloud.cpp \
+    ./src/PointRenderer.cpp \
+    ./src/PointCloudFile.cpp \
+    ./src/PointCloudStream.cpp \
+    ./src/EdgeExtractor.cpp \
+    ./src/MeshAnalyzer.cpp \
+    ./src/MeshReportDialog.cpp \
     ./src/Utils.cpp
 FORMS += ./mainwindow.ui
 RESOURCES += mainwindow.qrc
@@ -32,6 +32,7 @@ INCLUDEPATH += \
 
 win32: LIBS += -lopengl32 \
     -lglu32 \
+    -lpsapi \
     -lassimpd \
     -L"./lib/DevIL/lib" \
     -llibassimpd \
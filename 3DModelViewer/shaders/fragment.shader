@@ -3,44 +3,66 @@
 in vec2 uv;
 in vec3 fragPos;
 in vec3 normal;
+in vec4 tangent;
+flat in int plain;
+flat in int normalMapped;
+
+// Set once per frame, shared by every draw
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 flags; // x: lighting enabled, y: texturing enabled, z: number of clip planes
+    vec4 clipPlanes[6];
+};
 
-uniform vec4 modelColor;
-uniform vec3 lightColor;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform float lightingEnabled;
-uniform float texturingEnabled;
 uniform sampler2D texSampler;
+uniform sampler2D normalSampler;
 
 out vec4 color;
 
 void main() {
+    // The preview of a model that is still loading has no normals or uvs
+    if(plain != 0) {
+        color = vec4(0.3, 0.45, 0.7, 1.0);
+        return;
+    }
+
     // Ambient lighting
     float ambientStrength = 0.1f;
-    vec3 ambient = ambientStrength * lightColor;
+    vec3 ambient = ambientStrength * lightColor.rgb;
 
     // Diffuse lighting
     vec3 norm = normalize(normal);
+    if(normalMapped != 0) {
+        // Tangent space as MikkTSpace defines it: the interpolated vectors are used unnormalized
+        // and the bitangent is rebuilt from them
+        vec3 bitangent = tangent.w * cross(normal, tangent.xyz);
+        vec3 mapped = texture(normalSampler, uv).xyz * 2.0 - 1.0;
+        norm = normalize(mapped.x * tangent.xyz + mapped.y * bitangent + mapped.z * normal);
+    }
     // lightDir is the difference vector between lightPos and fragPos
-    vec3 lightDir = normalize(lightPos - fragPos);
+    vec3 lightDir = normalize(lightPos.xyz - fragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
+    vec3 diffuse = diff * lightColor.rgb;
 
     // Specular lighting
     float specularStrength = 0.5f;
-    vec3 viewDir = normalize(viewPos - fragPos);
+    vec3 viewDir = normalize(viewPos.xyz - fragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
 
     // Texture
-    if(texturingEnabled > 0.5)
+    if(flags.y > 0.5)
         color = vec4(texture(texSampler, uv).rgb, 1.0);
     else
         color = vec4(0.8, 0.8, 0.8, 1.0);
 
     // Calculate lighting for this fragment
-    if(lightingEnabled > 0.5) {
-        vec3 specular = specularStrength * spec * lightColor;
+    if(flags.x > 0.5) {
+        vec3 specular = specularStrength * spec * lightColor.rgb;
         color = vec4((ambient + diffuse + specular) * color.rgb, 1.0f);
     }
 }
\ No newline at end of file
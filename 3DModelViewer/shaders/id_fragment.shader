@@ -0,0 +1,11 @@
+#version 330 core
+
+// Index of the mesh plus one, so the cleared background reads as 0
+uniform uint meshId;
+
+out uvec2 id;
+
+void main() {
+    // Primitives are numbered from the start of the draw, which is the start of the mesh
+    id = uvec2(meshId, uint(gl_PrimitiveID));
+}
\ No newline at end of file
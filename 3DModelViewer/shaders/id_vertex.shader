@@ -0,0 +1,29 @@
+#version 330 core
+
+layout(location = 0) in vec3 vertexPos;
+
+// The draw's transform, with the pick region in front of the projection
+uniform mat4 mvp;
+// Object to world space, for the distances to the clip planes
+uniform mat4 model;
+
+// Only the clip planes are read; declared in full to match the layout of the other shaders
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 flags;
+    vec4 clipPlanes[6];
+};
+
+out float gl_ClipDistance[6];
+
+void main() {
+    gl_Position = mvp * vec4(vertexPos, 1.0f);
+    // Cut away parts can't be picked
+    vec4 worldPos = model * vec4(vertexPos, 1.0f);
+    for(int i = 0; i < 6; ++i)
+        gl_ClipDistance[i] = dot(clipPlanes[i], worldPos);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec4 pointColor;
+
+out vec4 color;
+
+void main() {
+    // Round points, so overlapping ones don't show as a grid of squares
+    vec2 offset = gl_PointCoord - vec2(0.5);
+    if(dot(offset, offset) > 0.25)
+        discard;
+    color = vec4(pointColor.rgb, 1.0);
+}
\ No newline at end of file
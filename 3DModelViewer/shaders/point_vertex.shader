@@ -0,0 +1,35 @@
+#version 330 core
+
+layout(location = 0) in vec3 vertexPos;
+// RGBA bytes, normalized
+layout(location = 1) in vec4 vertexColor;
+
+uniform mat4 mvp;
+// Object to world space, for the distances to the clip planes
+uniform mat4 model;
+// Spacing of the node's points in pixels at a distance of one unit; divided by the distance
+// to the camera, it makes the points of a node just cover the surface
+uniform float pointScale;
+
+// Only the clip planes are read; declared in full to match the layout of the other shaders
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 flags;
+    vec4 clipPlanes[6];
+};
+
+out float gl_ClipDistance[6];
+out vec4 pointColor;
+
+void main() {
+    gl_Position = mvp * vec4(vertexPos, 1.0f);
+    gl_PointSize = clamp(pointScale / max(gl_Position.w, 1e-6), 1.0, 32.0);
+    pointColor = vertexColor;
+    vec4 worldPos = model * vec4(vertexPos, 1.0f);
+    for(int i = 0; i < 6; ++i)
+        gl_ClipDistance[i] = dot(clipPlanes[i], worldPos);
+}
\ No newline at end of file
@@ -3,17 +3,56 @@
 layout(location = 0) in vec3 vertexPos;
 layout(location = 1) in vec2 vertexUV;
 layout(location = 2) in vec3 vertexNormal;
+// Only enabled for normal mapped meshes; w is the sign of the bitangent
+layout(location = 3) in vec4 vertexTangent;
 
-uniform mat4 mvp;
-uniform mat4 model;
+// Set once per frame, shared by every draw
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 flags; // x: lighting enabled, y: texturing enabled, z: number of clip planes
+    // World space section planes; the side where dot(plane, position) is negative is cut away.
+    // Only the first flags.z are enabled, the distances to the others are ignored.
+    vec4 clipPlanes[6];
+};
+
+// Set per draw from a range of the draw uniform buffer
+layout(std140) uniform DrawData {
+    mat4 model;
+    mat4 mvp;
+    vec4 drawFlags; // x: normals are octahedral-encoded into the first two components, y: plain colour, z: normal mapped
+};
+
+out float gl_ClipDistance[6];
 
 out vec2 uv;
 out vec3 fragPos;
 out vec3 normal;
+out vec4 tangent;
+flat out int plain;
+flat out int normalMapped;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if(n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
 
 void main() {
     gl_Position = mvp * vec4(vertexPos, 1.0f);
     uv = vertexUV;
     fragPos = vec3(model * vec4(vertexPos, 1.0f));
-    normal = vertexNormal;
+    for(int i = 0; i < 6; ++i)
+        gl_ClipDistance[i] = dot(clipPlanes[i], vec4(fragPos, 1.0));
+    plain = drawFlags.y > 0.5 ? 1 : 0;
+    normalMapped = drawFlags.z > 0.5 ? 1 : 0;
+    tangent = vertexTangent;
+    if(drawFlags.x > 0.5)
+        normal = octDecode(vertexNormal.xy);
+    else
+        normal = vertexNormal;
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "BatchRenderer.h"
+
+#include "QDir"
+#include "QDirIterator"
+#include "QFileInfo"
+#include "QThread"
+#include "QDebug"
+
+#include "Resources/assimp/include/assimp/Importer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace {
+
+// Runs one OffscreenRenderer until every model has been claimed
+class RenderWorker : public QThread {
+
+public:
+    RenderWorker(std::function<void(OffscreenRenderer&)> task) :
+      _task(task)
+    {
+        _renderer.moveToThread(this);
+    }
+
+protected:
+    void run() override {
+        _task(_renderer);
+        _renderer.releaseResources();
+    }
+
+private:
+    OffscreenRenderer _renderer;
+    std::function<void(OffscreenRenderer&)> _task;
+};
+
+}
+
+BatchRenderer::Options::Options() :
+  size(512, 512),
+  views(1, OffscreenRenderer::Iso),
+  outputDirectory("."),
+  numThreads(0)
+{}
+
+BatchRenderer::BatchRenderer(Options options) :
+  _options(options)
+{}
+
+int BatchRenderer::run(const QString& input) {
+    QString inputRoot;
+    QStringList models = findModels(input, inputRoot);
+    if(models.isEmpty()) {
+        qWarning() << "No models found in" << input;
+        return 1;
+    }
+
+    int numThreads = _options.numThreads > 0 ? _options.numThreads : QThread::idealThreadCount();
+    numThreads = std::max(1, std::min(numThreads, models.size()));
+
+    // Each worker claims the next model that has not been rendered yet
+    std::atomic<int> next(0);
+    std::atomic<int> failures(0);
+    auto task = [&](OffscreenRenderer& renderer) {
+        vector<QImage> images;
+        for(int i = next++; i < models.size(); i = next++) {
+            QString fileName = QDir(inputRoot).filePath(models[i]);
+            if(!renderer.render(fileName.toStdString(), _options.size, _options.views, images, _options.importOptions) || !writeImages(models[i], images)) {
+                qWarning() << "Failed to render" << fileName;
+                ++failures;
+                continue;
+            }
+            qDebug() << "Rendered" << fileName << "(" << i + 1 << "/" << models.size() << ")";
+        }
+    };
+
+    // Offscreen surfaces can only be created on the GUI thread, so the renderers are
+    // created here and their contexts handed over to the workers
+    vector<std::unique_ptr<RenderWorker> > workers;
+    for(int i = 0; i < numThreads; ++i)
+        workers.push_back(std::unique_ptr<RenderWorker>(new RenderWorker(task)));
+    for(auto& worker : workers)
+        worker->start();
+    for(auto& worker : workers)
+        worker->wait();
+
+    qDebug() << "Rendered" << models.size() - failures << "of" << models.size() << "models using" << numThreads << "threads";
+    return failures;
+}
+
+QStringList BatchRenderer::findModels(const QString& input, QString& inputRoot) {
+    QStringList models;
+    QFileInfo info(input);
+
+    if(!info.isDir()) {
+        inputRoot = info.absolutePath();
+        if(info.exists())
+            models.append(info.fileName());
+        return models;
+    }
+
+    inputRoot = info.absoluteFilePath();
+    QDir root(inputRoot);
+    Assimp::Importer importer;
+
+    QDirIterator it(inputRoot, QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext()) {
+        QString fileName = it.next();
+        string extension = "." + QFileInfo(fileName).suffix().toLower().toStdString();
+        if(importer.IsExtensionSupported(extension))
+            models.append(root.relativeFilePath(fileName));
+    }
+
+    // Keep the order stable so repeated runs process models in the same order
+    models.sort();
+    return models;
+}
+
+bool BatchRenderer::writeImages(const QString& relativePath, const vector<QImage>& images) {
+    // Mirror the input directory layout below the output directory
+    QFileInfo info(QDir(_options.outputDirectory).filePath(relativePath));
+    if(!QDir().mkpath(info.absolutePath()))
+        return false;
+
+    for(size_t i = 0; i < images.size() && i < _options.views.size(); ++i) {
+        QString name = QString("%1_%2.png")
+            .arg(info.completeBaseName())
+            .arg(OffscreenRenderer::viewName(_options.views[i]).c_str());
+        if(!images[i].save(info.dir().filePath(name)))
+            return false;
+    }
+    return true;
+}
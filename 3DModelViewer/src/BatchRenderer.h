@@ -0,0 +1,43 @@
+#pragma once
+
+#include "OffscreenRenderer.h"
+
+#include "QSize"
+#include "QString"
+#include "QStringList"
+
+#include <vector>
+
+using std::vector;
+
+// Renders thumbnails of many models headlessly. Models are spread over a pool of worker
+// threads, each with its own OffscreenRenderer and therefore its own GL context.
+class BatchRenderer {
+
+public:
+    struct Options {
+        Options();
+
+        QSize size;
+        vector<OffscreenRenderer::View> views;
+        QString outputDirectory;
+        int numThreads; // 0 uses one worker per hardware thread
+        Model::ImportOptions importOptions;
+    };
+
+    BatchRenderer(Options options);
+
+    // Renders input, which is either a model file or a directory that is searched recursively
+    // for files Assimp can import. Must be called from the GUI thread.
+    // Returns the number of models that could not be rendered.
+    int run(const QString& input);
+
+    // Returns the models in input (a file or a directory searched recursively for files Assimp
+    // can import) as paths relative to inputRoot
+    static QStringList findModels(const QString& input, QString& inputRoot);
+
+private:
+    Options _options;
+
+    bool writeImages(const QString& relativePath, const vector<QImage>& images);
+};
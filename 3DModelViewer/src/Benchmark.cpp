@@ -0,0 +1,551 @@
+#include "Benchmark.h"
+#include "BatchRenderer.h"
+#include "OffscreenRenderer.h"
+#include "FloatParser.h"
+#include "ModelPicker.h"
+#include "Utils.h"
+
+#include "QDir"
+#include "QElapsedTimer"
+#include "QFile"
+#include "QFileInfo"
+#include "QJsonArray"
+#include "QOpenGLContext"
+#include "QOpenGLFunctions"
+#include "QPoint"
+#include "QDebug"
+#include "QThread"
+#include "QtEndian"
+
+#include "gtc/constants.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+// std::from_chars for floating point needs C++17 and a recent standard library
+#if defined(__has_include)
+#if __has_include(<charconv>) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#include <charconv>
+#endif
+#endif
+
+namespace {
+
+// Blocks until the gpu has finished all submitted work, so timings include it
+void finishGpu() {
+    QOpenGLContext::currentContext()->functions()->glFinish();
+}
+
+// Frames rendered while waiting for an id pick before it is counted as missed
+const int MaxIdPickFrames = 100;
+
+// Each number parser runs this many times over a file; the fastest run is reported
+const int ParseRepetitions = 5;
+
+// Whether fileName stores its numbers as text
+bool isTextModel(const QString& fileName, const QByteArray& data) {
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    if(suffix == "obj")
+        return true;
+    if(suffix == "ply")
+        return data.left(data.indexOf("end_header")).contains("format ascii");
+    if(suffix == "stl") {
+        // Binary STL files can start with "solid" too, but their size is fixed by the triangle count
+        bool binarySize = data.size() >= 84 &&
+            size_t(data.size()) == 84 + 50 * size_t(qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data.constData()) + 80));
+        return data.startsWith("solid") && !binarySize;
+    }
+    return false;
+}
+
+// Runs parse over every number and returns the fastest of ParseRepetitions runs in milliseconds.
+// The values are summed so the conversions can't be optimized away.
+template<typename Parse>
+double timeParser(const vector<const char*>& numbers, const char* end, Parse parse, double& sum) {
+    double best = 0.0;
+    for(int i = 0; i < ParseRepetitions; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        sum = 0.0;
+        for(const char* number : numbers)
+            sum += parse(number, end);
+        double milliseconds = timer.nsecsElapsed() / 1e6;
+        best = i == 0 ? milliseconds : std::min(best, milliseconds);
+    }
+    return best;
+}
+
+double percentile(const vector<double>& sorted, double p) {
+    // Nearest-rank percentile
+    size_t rank = size_t(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+}
+
+Benchmark::Options::Options() :
+  size(1280, 720),
+  frames(360),
+  warmupFrames(10),
+  picks(0)
+{}
+
+Benchmark::Benchmark(Options options) :
+  _options(options)
+{}
+
+QJsonObject Benchmark::run(const QString& input) {
+    QString inputRoot;
+    QStringList models = BatchRenderer::findModels(input, inputRoot);
+
+    OffscreenRenderer renderer;
+    QJsonArray results;
+    int failures = 0;
+    double totalImport = 0.0;
+    double totalFirstPixel = 0.0;
+    double maxFirstPixel = 0.0;
+    int previewed = 0;
+
+    for(const QString& model : models) {
+        QJsonObject result = benchmarkModel(renderer, QDir(inputRoot).filePath(model));
+        result["file"] = model;
+        if(!result["loaded"].toBool())
+            ++failures;
+        totalImport += result["import"].toObject()["total"].toDouble();
+        double firstPixel = result["progressive"].toObject()["firstPixelMs"].toDouble(-1.0);
+        if(firstPixel >= 0.0) {
+            totalFirstPixel += firstPixel;
+            maxFirstPixel = std::max(maxFirstPixel, firstPixel);
+            ++previewed;
+        }
+        results.append(result);
+
+        qDebug() << "Benchmarked" << model;
+    }
+    renderer.releaseResources();
+
+    QJsonObject summary;
+    summary["models"] = models.size();
+    summary["failed"] = failures;
+    summary["totalImportMs"] = totalImport;
+    summary["meanFirstPixelMs"] = previewed > 0 ? totalFirstPixel / previewed : -1.0;
+    summary["maxFirstPixelMs"] = previewed > 0 ? maxFirstPixel : -1.0;
+    summary["peakRssBytes"] = double(Utils::getPeakResidentBytes());
+
+    QJsonObject report;
+    report["corpus"] = input;
+    report["width"] = _options.size.width();
+    report["height"] = _options.size.height();
+    report["frames"] = _options.frames;
+    report["importOptions"] = importOptionsToJson(_options.importOptions);
+    report["models"] = results;
+    report["summary"] = summary;
+    return report;
+}
+
+QJsonObject Benchmark::benchmarkModel(OffscreenRenderer& renderer, const QString& fileName) {
+    QJsonObject result;
+    result["loaded"] = false;
+
+    if(!renderer.makeCurrent(_options.size))
+        return result;
+
+    {
+        // The model has to be destroyed while the context is current
+        QElapsedTimer timer;
+        timer.start();
+
+        // Time until the viewer would first show something: the bounds, a frame of the point preview,
+        // and the first finished mesh. Meshes are finished on worker threads.
+        double boundsTime = -1.0;
+        double firstPixelTime = -1.0;
+        double firstMeshTime = -1.0;
+        std::mutex firstMeshMutex;
+        Model::LoadCallbacks callbacks;
+        MeshBounds::Box previewBounds;
+        MeshBounds::Sphere previewSphere;
+        callbacks.bounds = [&](const MeshBounds::Box& box, const MeshBounds::Sphere& sphere) {
+            previewBounds = box;
+            previewSphere = sphere;
+            boundsTime = timer.nsecsElapsed() / 1e6;
+        };
+        callbacks.preview = [&](const vector<glm::vec3>& points) {
+            Renderer* gl = renderer.renderer();
+            gl->setPreview(previewBounds.min, previewBounds.max, points);
+            renderer.setCamera(previewSphere, OffscreenRenderer::orbitMatrix(0.0f, 0.3f), _options.size);
+            gl->render();
+            finishGpu();
+            firstPixelTime = timer.nsecsElapsed() / 1e6;
+            gl->releasePreview();
+        };
+        callbacks.meshLoaded = [&](const Model::Mesh&, size_t) {
+            std::lock_guard<std::mutex> lock(firstMeshMutex);
+            if(firstMeshTime < 0.0)
+                firstMeshTime = timer.nsecsElapsed() / 1e6;
+        };
+
+        std::unique_ptr<Model> model = renderer.loadModel(fileName.toStdString(), _options.importOptions, callbacks);
+        double loadTime = timer.nsecsElapsed() / 1e6;
+
+        if(model) {
+            Renderer* gl = renderer.renderer();
+
+            timer.restart();
+            vector<Model::Mesh> meshes = model->getMeshes();
+            gl->setMeshes(meshes);
+            gl->setPointCloud(model->getPointCloud());
+            finishGpu();
+            double uploadTime = timer.nsecsElapsed() / 1e6;
+
+            const ImportStatistics& statistics = model->getImportStatistics();
+            QJsonObject stages;
+            for(const ImportStatistics::Stage& stage : statistics.getStages())
+                stages[stage.name.c_str()] = stage.milliseconds;
+            stages["upload"] = uploadTime;
+            stages["total"] = loadTime + uploadTime;
+            result["import"] = stages;
+
+            const ImportStatistics::WastedWork& wasted = statistics.wasted();
+            QJsonObject wastedWork;
+            wastedWork["duplicateTexturesSkipped"] = wasted.duplicateTexturesSkipped;
+            wastedWork["meshesReconverted"] = wasted.meshesReconverted;
+            wastedWork["texturesFailed"] = wasted.texturesFailed;
+            result["wastedWork"] = wastedWork;
+            result["bytesCopied"] = double(statistics.getBytesCopied());
+
+            QJsonObject progressive;
+            progressive["boundsMs"] = boundsTime;
+            progressive["firstPixelMs"] = firstPixelTime;
+            progressive["firstMeshMs"] = firstMeshTime;
+            result["progressive"] = progressive;
+
+            int numTriangles = 0;
+            for(const Model::Mesh& mesh : meshes)
+                numTriangles += mesh.numFaces;
+            result["meshes"] = int(meshes.size());
+            result["vertices"] = model->getNumVertices();
+            result["triangles"] = numTriangles;
+            result["points"] = double(model->getPointCloud() ? model->getPointCloud()->numPoints() : 0);
+
+            // Everything the model and the renderer hold once the model is on screen
+            MemoryTracker::Usage memory = model->getMemoryUsage();
+            memory += gl->getMemoryUsage();
+            result["memory"] = MemoryTracker::toJson(memory);
+
+            QJsonObject gpu;
+            gpu["bufferBytes"] = double(gl->getGpuBufferBytes());
+            gpu["textureBytes"] = double(memory.bytes[MemoryTracker::GLTextures]);
+            result["gpuBytes"] = gpu;
+
+            // Orbit once around the model at a slight elevation; warmup frames are not measured
+            vector<double> frameTimes;
+            int totalFrames = _options.warmupFrames + _options.frames;
+            for(int i = 0; i < totalFrames; ++i) {
+                float angle = 2.0f * glm::pi<float>() * i / std::max(totalFrames, 1);
+                renderer.setCamera(*model, OffscreenRenderer::orbitMatrix(angle, 0.3f), _options.size);
+
+                timer.restart();
+                gl->render();
+                finishGpu();
+                if(i >= _options.warmupFrames)
+                    frameTimes.push_back(timer.nsecsElapsed() / 1e6);
+            }
+            result["frameTimeMs"] = frameTimeStatistics(frameTimes);
+            result["glCallsPerFrame"] = int(gl->getGLCallsPerFrame());
+
+            if(_options.picks > 0)
+                result["picking"] = benchmarkPicking(renderer, *model);
+
+            gl->releaseMeshes();
+            result["loaded"] = true;
+        }
+    }
+
+    // Peak RSS only grows, so this is the high water mark up to and including this model
+    result["peakRssBytes"] = double(Utils::getPeakResidentBytes());
+
+    renderer.doneCurrent();
+    return result;
+}
+
+QJsonObject Benchmark::benchmarkPicking(OffscreenRenderer& renderer, Model& model) {
+    Renderer* gl = renderer.renderer();
+    renderer.setCamera(model, OffscreenRenderer::orbitMatrix(0.0f, 0.3f), _options.size);
+    gl->render();
+    finishGpu();
+
+    // A grid over the middle of the image, where the model is framed
+    int side = int(std::ceil(std::sqrt(double(_options.picks))));
+    vector<QPoint> pixels;
+    for(int i = 0; i < _options.picks; ++i) {
+        float u = 0.1f + 0.8f * (i % side + 0.5f) / side;
+        float v = 0.1f + 0.8f * (i / side + 0.5f) / side;
+        pixels.push_back(QPoint(int(u * _options.size.width()), int(v * _options.size.height())));
+    }
+
+    // Rays against the cpu hierarchies, which are built by the first pick
+    ModelPicker picker(model);
+    picker.start();
+    glm::mat4 modelMatrix = model.getModelMatrix();
+    QElapsedTimer timer;
+    auto pickRay = [&](const QPoint& pixel) {
+        glm::vec3 origin, direction;
+        gl->pickRay(pixel.x(), pixel.y(), origin, direction);
+        picker.pick(origin, direction, modelMatrix);
+        ModelPicker::Hit hit;
+        while(!picker.takeHit(hit))
+            QThread::yieldCurrentThread();
+        return hit;
+    };
+
+    timer.start();
+    pickRay(QPoint(_options.size.width() / 2, _options.size.height() / 2));
+    double firstPickTime = timer.nsecsElapsed() / 1e6;
+
+    vector<ModelPicker::Hit> rayHits;
+    vector<double> queryTimes, rayLatencies;
+    for(const QPoint& pixel : pixels) {
+        timer.restart();
+        rayHits.push_back(pickRay(pixel));
+        rayLatencies.push_back(timer.nsecsElapsed() / 1e6);
+        queryTimes.push_back(rayHits.back().microseconds / 1000.0);
+    }
+
+    QJsonObject ray;
+    ray["buildMs"] = picker.getBuildMilliseconds();
+    ray["firstPickMs"] = firstPickTime;
+    ray["queryMs"] = frameTimeStatistics(queryTimes);
+    ray["latencyMs"] = frameTimeStatistics(rayLatencies);
+    ray["memoryBytes"] = double(picker.getMemoryUsage().bytes[MemoryTracker::PickingData]);
+
+    // Ids drawn around each pixel; frames are rendered until its read back arrives, like the viewer does
+    vector<double> idLatencies, idFrames;
+    int missed = 0, sameMesh = 0, sameTriangle = 0;
+    for(size_t i = 0; i < pixels.size(); ++i) {
+        gl->requestIdPick(pixels[i].x(), pixels[i].y());
+        GpuPicker::Result hit;
+        bool answered = false;
+        for(int frames = 0; !answered && frames < MaxIdPickFrames; ++frames) {
+            gl->render();
+            answered = gl->takeIdPick(hit);
+        }
+        if(!answered) {
+            ++missed;
+            continue;
+        }
+        idLatencies.push_back(hit.milliseconds);
+        idFrames.push_back(hit.frames);
+
+        const ModelPicker::Hit& rayHit = rayHits[i];
+        if(hit.found == rayHit.found && (!hit.found || hit.mesh == rayHit.mesh)) {
+            ++sameMesh;
+            if(!hit.found || hit.triangle == rayHit.triangle)
+                ++sameTriangle;
+        }
+    }
+    finishGpu();
+
+    QJsonObject idBuffer;
+    idBuffer["latencyMs"] = frameTimeStatistics(idLatencies);
+    idBuffer["frames"] = frameTimeStatistics(idFrames);
+    idBuffer["missed"] = missed;
+
+    QJsonObject json;
+    json["pixels"] = int(pixels.size());
+    json["ray"] = ray;
+    json["idBuffer"] = idBuffer;
+    // Fractions of the pixels on which both pickers found the same mesh, and the same triangle
+    json["meshAgreement"] = double(sameMesh) / pixels.size();
+    json["triangleAgreement"] = double(sameTriangle) / pixels.size();
+    return json;
+}
+
+bool Benchmark::parseImportOptions(const QString& text, Model::ImportOptions& options) {
+    for(const QString& item : text.split(',', QString::SkipEmptyParts)) {
+        QStringList pair = item.split('=');
+        QString name = pair[0].trimmed();
+        bool enabled = pair.size() < 2 || pair[1].trimmed() != "0";
+
+        if(name == "lods")
+            options.generateLods = enabled;
+        else if(name == "optimize")
+            options.optimizeMeshes = enabled;
+        else if(name == "compress")
+            options.compressVertices = enabled;
+        else if(name == "clusters")
+            options.buildClusters = enabled;
+        else if(name == "native")
+            options.useNativeImporter = enabled;
+        else if(name == "cache")
+            options.useCache = enabled;
+        else if(name == "edges")
+            options.extractEdges = enabled;
+        else if(name == "edgeangle" && pair.size() == 2)
+            options.edgeFeatureAngle = pair[1].trimmed().toFloat();
+        else
+            return false;
+    }
+    return true;
+}
+
+QJsonObject Benchmark::importOptionsToJson(const Model::ImportOptions& options) {
+    QJsonObject json;
+    json["profile"] = Model::profileName(options.profile).c_str();
+    json["generateLods"] = options.generateLods;
+    json["maxLodLevels"] = options.maxLodLevels;
+    json["minLodTriangles"] = options.minLodTriangles;
+    json["optimizeMeshes"] = options.optimizeMeshes;
+    json["compressVertices"] = options.compressVertices;
+    json["buildClusters"] = options.buildClusters;
+    json["minClusterTriangles"] = options.minClusterTriangles;
+    json["useNativeImporter"] = options.useNativeImporter;
+    json["nativeObjMinBytes"] = double(options.nativeObjMinBytes);
+    json["useCache"] = options.useCache;
+    json["extractEdges"] = options.extractEdges;
+    json["edgeFeatureAngle"] = options.edgeFeatureAngle;
+    return json;
+}
+
+QJsonObject Benchmark::frameTimeStatistics(vector<double> frameTimes) {
+    QJsonObject json;
+    if(frameTimes.empty())
+        return json;
+
+    std::sort(frameTimes.begin(), frameTimes.end());
+    double sum = 0.0;
+    for(double time : frameTimes)
+        sum += time;
+
+    json["mean"] = sum / frameTimes.size();
+    json["p50"] = percentile(frameTimes, 50.0);
+    json["p95"] = percentile(frameTimes, 95.0);
+    json["p99"] = percentile(frameTimes, 99.0);
+    json["max"] = frameTimes.back();
+    return json;
+}
+
+QJsonObject Benchmark::benchmarkNumberParsing(const QString& input) {
+    QString inputRoot;
+    QStringList models = BatchRenderer::findModels(input, inputRoot);
+
+    QJsonArray results;
+    for(const QString& model : models) {
+        QFile file(QDir(inputRoot).filePath(model));
+        if(!file.open(QIODevice::ReadOnly))
+            continue;
+
+        // readAll terminates the data, which strtod relies on
+        QByteArray data = file.readAll();
+        if(!isTextModel(model, data))
+            continue;
+
+        results.append(benchmarkNumberParsing(model, data));
+        qDebug() << "Benchmarked number parsing of" << model;
+    }
+
+    QJsonObject report;
+    report["corpus"] = input;
+    report["simd"] = FloatParser::usesSimd();
+    report["models"] = results;
+    return report;
+}
+
+QJsonObject Benchmark::benchmarkNumberParsing(const QString& fileName, const QByteArray& text) {
+    const char* begin = text.constData();
+    const char* end = begin + text.size();
+
+    // Every whitespace separated token that is a number on its own; this skips keywords and
+    // OBJ face corners such as 1/2/3
+    vector<const char*> numbers;
+    size_t numberBytes = 0;
+    for(const char* p = begin; p < end; ) {
+        while(p < end && isspace(static_cast<unsigned char>(*p)))
+            ++p;
+        const char* token = p;
+        while(p < end && !isspace(static_cast<unsigned char>(*p)))
+            ++p;
+
+        const char* q = token;
+        float value;
+        if(token < p && FloatParser::parseExact(q, p, value) && q == p) {
+            numbers.push_back(token);
+            numberBytes += p - token;
+        }
+    }
+
+    // Results are compared bit for bit, so -0 and 0 differ
+    size_t fallbacks = FloatParser::getFallbackCount();
+    int mismatches = 0;
+    for(const char* number : numbers) {
+        const char* p = number;
+        const char* q = number;
+        float fast, exact;
+        FloatParser::parse(p, end, fast);
+        FloatParser::parseExact(q, end, exact);
+        if(p != q || memcmp(&fast, &exact, sizeof(float)) != 0)
+            ++mismatches;
+    }
+    fallbacks = FloatParser::getFallbackCount() - fallbacks;
+
+    QJsonObject parsers;
+    auto addParser = [&](const char* name, double milliseconds, double sum) {
+        QJsonObject parser;
+        parser["ms"] = milliseconds;
+        parser["nsPerNumber"] = numbers.empty() ? 0.0 : milliseconds * 1e6 / numbers.size();
+        parser["mbPerSecond"] = milliseconds > 0.0 ? numberBytes / (1024.0 * 1024.0) / (milliseconds / 1000.0) : 0.0;
+        parser["checksum"] = sum;
+        parsers[name] = parser;
+    };
+
+    double sum;
+    double milliseconds = timeParser(numbers, end, [](const char* p, const char* end) {
+        float value = 0.0f;
+        FloatParser::parse(p, end, value);
+        return value;
+    }, sum);
+    addParser("floatParser", milliseconds, sum);
+
+    milliseconds = timeParser(numbers, end, [](const char* p, const char* end) {
+        float value = 0.0f;
+        FloatParser::parseExact(p, end, value);
+        return value;
+    }, sum);
+    addParser("floatParserExact", milliseconds, sum);
+
+    // strtod and strtof read the decimal point of the current locale, so their checksums only
+    // match in locales that use '.'
+    milliseconds = timeParser(numbers, end, [](const char* p, const char*) {
+        return float(strtod(p, nullptr));
+    }, sum);
+    addParser("strtod", milliseconds, sum);
+
+    milliseconds = timeParser(numbers, end, [](const char* p, const char*) {
+        return strtof(p, nullptr);
+    }, sum);
+    addParser("strtof", milliseconds, sum);
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    milliseconds = timeParser(numbers, end, [](const char* p, const char* end) {
+        float value = 0.0f;
+        // Unlike the other parsers, from_chars rejects a leading '+'
+        std::from_chars(*p == '+' ? p + 1 : p, end, value);
+        return value;
+    }, sum);
+    addParser("fromChars", milliseconds, sum);
+#endif
+
+    QJsonObject result;
+    result["file"] = fileName;
+    result["bytes"] = double(text.size());
+    result["numbers"] = double(numbers.size());
+    result["numberBytes"] = double(numberBytes);
+    result["fallbacks"] = double(fallbacks);
+    result["mismatches"] = mismatches;
+    result["parsers"] = parsers;
+    return result;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Model.h"
+
+#include "QByteArray"
+#include "QJsonObject"
+#include "QSize"
+#include "QString"
+
+#include <vector>
+
+using std::vector;
+
+class OffscreenRenderer;
+
+// Headless performance suite. Loads every model of a corpus, timing each import stage,
+// then renders a scripted camera orbit around it and reports frame-time percentiles.
+// Results are returned as JSON so runs can be compared between versions and import options.
+class Benchmark {
+
+public:
+    struct Options {
+        Options();
+
+        QSize size;
+        int frames;       // Measured frames of the orbit
+        int warmupFrames; // Frames rendered before measuring starts
+        int picks;        // Pixels picked with both the ray and the id buffer picker, 0 to skip them
+        Model::ImportOptions importOptions;
+    };
+
+    Benchmark(Options options);
+
+    // Runs the suite over input (a model file or a directory). Must be called from the GUI thread.
+    QJsonObject run(const QString& input);
+
+    // Times the conversion of every number in the text models (OBJ, ASCII PLY and STL) of input,
+    // a file or a directory, with FloatParser and with the standard library, and counts the
+    // numbers on which FloatParser disagrees with the exact conversion.
+    static QJsonObject benchmarkNumberParsing(const QString& input);
+
+    // Parses a comma separated list of name=0|1 pairs (lods, optimize, compress, clusters, native,
+    // cache, edges) and edgeangle=degrees into options. Returns false on unknown names.
+    static bool parseImportOptions(const QString& text, Model::ImportOptions& options);
+
+private:
+    Options _options;
+
+    QJsonObject benchmarkModel(OffscreenRenderer& renderer, const QString& fileName);
+    // Picks a grid of pixels with rays against the cpu hierarchies and with the id buffer, and
+    // compares their latency and answers. The model's meshes must be uploaded to the renderer.
+    QJsonObject benchmarkPicking(OffscreenRenderer& renderer, Model& model);
+
+    static QJsonObject benchmarkNumberParsing(const QString& fileName, const QByteArray& text);
+
+    static QJsonObject importOptionsToJson(const Model::ImportOptions& options);
+    // Returns the mean, max and p50/p95/p99 of the frame times in milliseconds
+    static QJsonObject frameTimeStatistics(vector<double> frameTimes);
+};
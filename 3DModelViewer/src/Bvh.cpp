@@ -0,0 +1,262 @@
+#include "Bvh.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+namespace {
+
+const int NumBins = 16;
+// Ranges up to this many primitives are built as independent subtrees, in parallel
+const size_t SubtreePrimitives = 1 << 14;
+// Below this depth ranges are halved instead of split by area, which bounds the depth of the
+// tree to SahDepth + 32 and with it the traversal stack
+const int SahDepth = 32;
+const int MaxDepth = SahDepth + 32;
+
+struct Range {
+    uint32_t node;
+    uint32_t begin;
+    uint32_t end;
+    int depth;
+};
+
+struct BuildInput {
+    const vector<MeshBounds::Box>& boxes;
+    vector<glm::vec3> centroids;
+    vector<uint32_t>& order;
+    size_t maxLeafSize;
+};
+
+float halfArea(const glm::vec3& min, const glm::vec3& max) {
+    glm::vec3 extent = glm::max(max - min, glm::vec3(0.0f));
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+// Sets node to the bounds of the range. Makes it a leaf and returns false if the range is small
+// enough; otherwise reorders the range and returns true with the start of the right half in mid.
+bool split(const BuildInput& input, Bvh::Node& node, const Range& range, uint32_t& mid) {
+    MeshBounds::Box bounds, centroidBounds;
+    for(uint32_t i = range.begin; i < range.end; ++i) {
+        uint32_t primitive = input.order[i];
+        bounds.extend(input.boxes[primitive]);
+        centroidBounds.min = glm::min(centroidBounds.min, input.centroids[primitive]);
+        centroidBounds.max = glm::max(centroidBounds.max, input.centroids[primitive]);
+    }
+    node.min = bounds.min;
+    node.max = bounds.max;
+
+    uint32_t count = range.end - range.begin;
+    if(count <= input.maxLeafSize) {
+        node.first = range.begin;
+        node.count = count;
+        return false;
+    }
+    node.count = 0;
+
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    if(extent[axis] > 0.0f && range.depth < SahDepth) {
+        float scale = NumBins / extent[axis];
+        float offset = centroidBounds.min[axis];
+        auto binOf = [&](uint32_t primitive) {
+            return std::min(NumBins - 1, int((input.centroids[primitive][axis] - offset) * scale));
+        };
+
+        MeshBounds::Box binBounds[NumBins];
+        uint32_t binCounts[NumBins] = {};
+        for(uint32_t i = range.begin; i < range.end; ++i) {
+            int bin = binOf(input.order[i]);
+            binBounds[bin].extend(input.boxes[input.order[i]]);
+            ++binCounts[bin];
+        }
+
+        // Cost of splitting after each bin: primitives times area on both sides
+        float leftCost[NumBins - 1];
+        MeshBounds::Box side;
+        uint32_t sideCount = 0;
+        for(int bin = 0; bin < NumBins - 1; ++bin) {
+            side.extend(binBounds[bin]);
+            sideCount += binCounts[bin];
+            leftCost[bin] = sideCount * halfArea(side.min, side.max);
+        }
+
+        int bestBin = -1;
+        float bestCost = 0.0f;
+        side = MeshBounds::Box();
+        sideCount = 0;
+        for(int bin = NumBins - 1; bin > 0; --bin) {
+            side.extend(binBounds[bin]);
+            sideCount += binCounts[bin];
+            if(sideCount == 0 || sideCount == count)
+                continue;
+            float cost = leftCost[bin - 1] + sideCount * halfArea(side.min, side.max);
+            if(bestBin < 0 || cost < bestCost) {
+                bestBin = bin - 1;
+                bestCost = cost;
+            }
+        }
+
+        if(bestBin >= 0) {
+            uint32_t* first = input.order.data() + range.begin;
+            uint32_t* last = input.order.data() + range.end;
+            mid = uint32_t(std::partition(first, last, [&](uint32_t primitive) { return binOf(primitive) <= bestBin; }) - input.order.data());
+            return true;
+        }
+    }
+
+    // The centroids all coincide, or the tree is already deep: halve the range along the axis
+    mid = range.begin + count / 2;
+    std::nth_element(input.order.begin() + range.begin, input.order.begin() + mid, input.order.begin() + range.end,
+                     [&](uint32_t a, uint32_t b) { return input.centroids[a][axis] < input.centroids[b][axis]; });
+    return true;
+}
+
+// Builds the tree below nodes[root.node], appending the new nodes. If pending is given, ranges of
+// at most subtreeSize primitives are added to it instead of being built.
+void buildNodes(const BuildInput& input, vector<Bvh::Node>& nodes, const Range& root, size_t subtreeSize, vector<Range>* pending) {
+    vector<Range> stack(1, root);
+    while(!stack.empty()) {
+        Range range = stack.back();
+        stack.pop_back();
+
+        if(pending && range.end - range.begin <= subtreeSize) {
+            pending->push_back(range);
+            continue;
+        }
+
+        uint32_t mid;
+        if(!split(input, nodes[range.node], range, mid))
+            continue;
+
+        uint32_t left = uint32_t(nodes.size());
+        nodes[range.node].first = left;
+        nodes.resize(nodes.size() + 2);
+
+        Range leftRange = { left, range.begin, mid, range.depth + 1 };
+        Range rightRange = { left + 1, mid, range.end, range.depth + 1 };
+        stack.push_back(rightRange);
+        stack.push_back(leftRange);
+    }
+}
+
+// Where the ray enters the node's box, if it does before maxDistance
+bool enters(const Bvh::Node& node, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& distance) {
+    glm::vec3 t0 = (node.min - origin) * inverseDirection;
+    glm::vec3 t1 = (node.max - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    distance = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    return distance <= std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+}
+
+}
+
+Bvh::Bvh() {}
+
+void Bvh::build(const vector<MeshBounds::Box>& boxes, size_t maxLeafSize) {
+    clear();
+    if(boxes.empty())
+        return;
+
+    _order.resize(boxes.size());
+    BuildInput input = { boxes, vector<glm::vec3>(boxes.size()), _order, std::max<size_t>(1, maxLeafSize) };
+    for(uint32_t i = 0; i < boxes.size(); ++i) {
+        _order[i] = i;
+        input.centroids[i] = boxes[i].center();
+    }
+
+    // The top of the tree is split here, the subtrees below it on all threads
+    _nodes.resize(1);
+    Range root = { 0, 0, uint32_t(boxes.size()), 0 };
+    vector<Range> pending;
+    buildNodes(input, _nodes, root, SubtreePrimitives, &pending);
+
+    vector<vector<Node> > subtrees(pending.size());
+    Utils::parallelFor(pending.size(), [&](size_t i) {
+        Range subtreeRoot = pending[i];
+        subtreeRoot.node = 0;
+        subtrees[i].resize(1);
+        buildNodes(input, subtrees[i], subtreeRoot, 0, nullptr);
+    });
+
+    // Each subtree's root replaces its placeholder, the rest is appended with its child indices moved
+    for(size_t i = 0; i < pending.size(); ++i) {
+        uint32_t base = uint32_t(_nodes.size()) - 1;
+        for(size_t j = 0; j < subtrees[i].size(); ++j) {
+            Node node = subtrees[i][j];
+            if(node.count == 0)
+                node.first += base;
+            if(j == 0)
+                _nodes[pending[i].node] = node;
+            else
+                _nodes.push_back(node);
+        }
+    }
+}
+
+void Bvh::clear() {
+    _nodes.clear();
+    _order.clear();
+}
+
+bool Bvh::isEmpty() const {
+    return _nodes.empty();
+}
+
+void Bvh::traverse(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                   const std::function<float(uint32_t first, uint32_t count, float maxDistance)>& leaf) const {
+    float distance;
+    glm::vec3 inverseDirection = 1.0f / direction;
+    if(_nodes.empty() || !enters(_nodes[0], origin, inverseDirection, maxDistance, distance))
+        return;
+
+    // Farther children still to visit, with the distance the ray enters them at
+    uint32_t stack[MaxDepth];
+    float stackDistances[MaxDepth];
+    int size = 0;
+
+    uint32_t index = 0;
+    while(true) {
+        const Node& node = _nodes[index];
+        if(node.count > 0) {
+            maxDistance = leaf(node.first, node.count, maxDistance);
+        }
+        else {
+            float leftDistance, rightDistance;
+            bool left = enters(_nodes[node.first], origin, inverseDirection, maxDistance, leftDistance);
+            bool right = enters(_nodes[node.first + 1], origin, inverseDirection, maxDistance, rightDistance);
+            if(left && right) {
+                bool leftFirst = leftDistance <= rightDistance;
+                stack[size] = leftFirst ? node.first + 1 : node.first;
+                stackDistances[size] = leftFirst ? rightDistance : leftDistance;
+                ++size;
+                index = leftFirst ? node.first : node.first + 1;
+                continue;
+            }
+            if(left || right) {
+                index = left ? node.first : node.first + 1;
+                continue;
+            }
+        }
+
+        // Children entered beyond the closest hit found since they were pushed are skipped
+        while(size > 0 && stackDistances[size - 1] > maxDistance)
+            --size;
+        if(size == 0)
+            return;
+        index = stack[--size];
+    }
+}
+
+const vector<Bvh::Node>& Bvh::nodes() const {
+    return _nodes;
+}
+
+const vector<uint32_t>& Bvh::order() const {
+    return _order;
+}
+
+size_t Bvh::memoryBytes() const {
+    return _nodes.capacity() * sizeof(Node) + _order.capacity() * sizeof(uint32_t);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "glm.hpp"
+#include "MeshBounds.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+using std::vector;
+
+// Bounding volume hierarchy over a set of boxes, built with a binned surface area heuristic.
+// Leaves are ranges of order(), so the primitives can be stored in leaf order for coherent reads.
+// Large builds split the top of the tree on one thread and build its subtrees in parallel.
+class Bvh {
+
+public:
+    struct Node {
+        glm::vec3 min;
+        uint32_t first; // Inner nodes: index of the left child, the right one follows it. Leaves: first position in order()
+        glm::vec3 max;
+        uint32_t count; // Primitives in a leaf, 0 for inner nodes
+    };
+
+    Bvh();
+
+    // Replaces the hierarchy with one over boxes, with at most maxLeafSize primitives per leaf
+    void build(const vector<MeshBounds::Box>& boxes, size_t maxLeafSize);
+    void clear();
+    bool isEmpty() const;
+
+    // Calls leaf(first, count, maxDistance) for each leaf the ray origin + t * direction enters at
+    // some t in [0, maxDistance], the nearer child of each node first. leaf returns the distance of
+    // the closest hit so far, which prunes the rest of the traversal.
+    void traverse(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                  const std::function<float(uint32_t first, uint32_t count, float maxDistance)>& leaf) const;
+
+    const vector<Node>& nodes() const;
+    // Primitive indices, in the order the leaves refer to them
+    const vector<uint32_t>& order() const;
+    size_t memoryBytes() const;
+
+private:
+    vector<Node> _nodes;
+    vector<uint32_t> _order;
+};
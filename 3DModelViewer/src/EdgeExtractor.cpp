@@ -0,0 +1,211 @@
+#include "EdgeExtractor.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// Every pass is split into chunks of this many faces, vertices or edges
+const size_t ChunkSize = 1 << 16;
+// Key of the edges between two corners at the same position, which are skipped
+const uint64_t DegenerateEdge = ~uint64_t(0);
+
+size_t numChunks(size_t count) {
+    return (count + ChunkSize - 1) / ChunkSize;
+}
+
+// A vertex, ordered by the bits of its position so equal positions end up next to each other
+struct PositionKey {
+    uint32_t x;
+    uint32_t y;
+    uint32_t z;
+    uint32_t vertex;
+
+    bool operator<(const PositionKey& other) const {
+        if(x != other.x)
+            return x < other.x;
+        if(y != other.y)
+            return y < other.y;
+        if(z != other.z)
+            return z < other.z;
+        return vertex < other.vertex;
+    }
+};
+
+uint32_t positionBits(float value) {
+    // -0 and +0 are the same position
+    value += 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// An edge of a face, from corner to the next corner of its face. Ordered by the positions of its
+// ends, then by corner, so each edge's first corner comes first.
+struct EdgeKey {
+    uint64_t ends;
+    uint32_t corner;
+
+    bool operator<(const EdgeKey& other) const {
+        return ends != other.ends ? ends < other.ends : corner < other.corner;
+    }
+};
+
+// Marks corners whose edge isn't kept
+const uint32_t NoEdge = ~uint32_t(0);
+
+// The first corner of each kept edge, unordered. If firstCorners isn't null, it is filled with the
+// first corner of the kept edge of every corner, or NoEdge.
+vector<uint32_t> keepEdges(const vector<glm::vec3>& vertices, const vector<unsigned int>& positionIds,
+                           const unsigned int* indices, size_t count, float featureAngle,
+                           vector<uint32_t>* firstCorners, size_t maxThreads) {
+    const size_t numFaces = count / 3;
+    const size_t numCorners = numFaces * 3;
+
+    vector<EdgeKey> keys(numCorners);
+    Utils::parallelFor(numChunks(numCorners), [&](size_t chunk) {
+        const size_t end = std::min(numCorners, (chunk + 1) * ChunkSize);
+        for(size_t corner = chunk * ChunkSize; corner < end; ++corner) {
+            const size_t next = corner % 3 == 2 ? corner - 2 : corner + 1;
+            uint64_t a = positionIds[indices[corner]];
+            uint64_t b = positionIds[indices[next]];
+            keys[corner].ends = a == b ? DegenerateEdge : (std::min(a, b) << 32) | std::max(a, b);
+            keys[corner].corner = uint32_t(corner);
+        }
+    }, maxThreads);
+    Utils::parallelSort(keys, ChunkSize, maxThreads);
+
+    // Unit face normals, only needed to tell creases from smooth edges
+    const bool creasesOnly = featureAngle > 0.0f;
+    const float cosFeatureAngle = std::cos(glm::radians(featureAngle));
+    vector<glm::vec3> normals;
+    if(creasesOnly) {
+        normals.resize(numFaces);
+        Utils::parallelFor(numChunks(numFaces), [&](size_t chunk) {
+            const size_t end = std::min(numFaces, (chunk + 1) * ChunkSize);
+            for(size_t face = chunk * ChunkSize; face < end; ++face) {
+                const glm::vec3& a = vertices[indices[3 * face]];
+                glm::vec3 normal = glm::cross(vertices[indices[3 * face + 1]] - a, vertices[indices[3 * face + 2]] - a);
+                float length = glm::length(normal);
+                normals[face] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+            }
+        }, maxThreads);
+    }
+
+    if(firstCorners)
+        firstCorners->assign(numCorners, NoEdge);
+
+    // Each chunk handles the runs of equal ends starting in it, keeping the first corner of each
+    // edge it keeps
+    vector<vector<uint32_t>> kept(numChunks(numCorners));
+    Utils::parallelFor(kept.size(), [&](size_t chunk) {
+        size_t begin = chunk * ChunkSize;
+        const size_t end = std::min(numCorners, begin + ChunkSize);
+        while(begin < end && begin > 0 && keys[begin].ends == keys[begin - 1].ends)
+            ++begin;
+        for(size_t run = begin; run < end;) {
+            size_t runEnd = run + 1;
+            while(runEnd < numCorners && keys[runEnd].ends == keys[run].ends)
+                ++runEnd;
+            bool keep = keys[run].ends != DegenerateEdge;
+            if(keep && creasesOnly && runEnd - run == 2) {
+                const glm::vec3& a = normals[keys[run].corner / 3];
+                const glm::vec3& b = normals[keys[run + 1].corner / 3];
+                keep = glm::dot(a, b) < cosFeatureAngle;
+            }
+            if(keep) {
+                kept[chunk].push_back(keys[run].corner);
+                if(firstCorners) {
+                    for(size_t k = run; k < runEnd; ++k)
+                        (*firstCorners)[keys[k].corner] = keys[run].corner;
+                }
+            }
+            run = runEnd;
+        }
+    }, maxThreads);
+    vector<EdgeKey>().swap(keys);
+
+    vector<uint32_t> corners;
+    for(const vector<uint32_t>& chunk : kept)
+        corners.insert(corners.end(), chunk.begin(), chunk.end());
+    return corners;
+}
+
+}
+
+vector<unsigned int> EdgeExtractor::matchPositions(const vector<glm::vec3>& vertices, size_t maxThreads) {
+    const size_t count = vertices.size();
+    vector<PositionKey> keys(count);
+    Utils::parallelFor(numChunks(count), [&](size_t chunk) {
+        const size_t end = std::min(count, (chunk + 1) * ChunkSize);
+        for(size_t v = chunk * ChunkSize; v < end; ++v) {
+            keys[v].x = positionBits(vertices[v].x);
+            keys[v].y = positionBits(vertices[v].y);
+            keys[v].z = positionBits(vertices[v].z);
+            keys[v].vertex = uint32_t(v);
+        }
+    }, maxThreads);
+    Utils::parallelSort(keys, ChunkSize, maxThreads);
+
+    // The lowest vertex of each run of equal positions comes first
+    vector<unsigned int> ids(count);
+    unsigned int id = 0;
+    for(size_t i = 0; i < count; ++i) {
+        if(i == 0 || keys[i].x != keys[i - 1].x || keys[i].y != keys[i - 1].y || keys[i].z != keys[i - 1].z)
+            id = keys[i].vertex;
+        ids[keys[i].vertex] = id;
+    }
+    return ids;
+}
+
+void EdgeExtractor::extract(const vector<glm::vec3>& vertices, const vector<unsigned int>& positionIds,
+                            const unsigned int* indices, size_t count, float featureAngle,
+                            vector<unsigned int>& edges, size_t maxThreads) {
+    // Back in the order of the triangles
+    vector<uint32_t> corners = keepEdges(vertices, positionIds, indices, count, featureAngle, nullptr, maxThreads);
+    Utils::parallelSort(corners, ChunkSize, maxThreads);
+
+    const size_t first = edges.size();
+    edges.resize(first + 2 * corners.size());
+    Utils::parallelFor(numChunks(corners.size()), [&](size_t chunk) {
+        const size_t end = std::min(corners.size(), (chunk + 1) * ChunkSize);
+        for(size_t i = chunk * ChunkSize; i < end; ++i) {
+            const uint32_t corner = corners[i];
+            edges[first + 2 * i] = indices[corner];
+            edges[first + 2 * i + 1] = indices[corner % 3 == 2 ? corner - 2 : corner + 1];
+        }
+    }, maxThreads);
+}
+
+void EdgeExtractor::extractGroups(const vector<glm::vec3>& vertices, const vector<unsigned int>& positionIds,
+                                  const unsigned int* indices, const vector<size_t>& groupEnds, float featureAngle,
+                                  vector<unsigned int>& edges, vector<size_t>& groupEdgeEnds, size_t maxThreads) {
+    // Edges are kept or dropped looking at all the triangles, so a crease between two groups is
+    // still found, and then listed by every group using it
+    const size_t count = groupEnds.empty() ? 0 : 3 * groupEnds.back();
+    vector<uint32_t> firstCorners;
+    keepEdges(vertices, positionIds, indices, count, featureAngle, &firstCorners, maxThreads);
+
+    const size_t first = edges.size();
+    vector<uint32_t> groupCorners;
+    size_t begin = 0;
+    for(size_t end : groupEnds) {
+        groupCorners.clear();
+        for(size_t corner = 3 * begin; corner < 3 * end; ++corner) {
+            if(firstCorners[corner] != NoEdge)
+                groupCorners.push_back(firstCorners[corner]);
+        }
+        std::sort(groupCorners.begin(), groupCorners.end());
+        groupCorners.erase(std::unique(groupCorners.begin(), groupCorners.end()), groupCorners.end());
+
+        for(uint32_t corner : groupCorners) {
+            edges.push_back(indices[corner]);
+            edges.push_back(indices[corner % 3 == 2 ? corner - 2 : corner + 1]);
+        }
+        groupEdgeEnds.push_back(edges.size() - first);
+        begin = end;
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "glm.hpp"
+#include <vector>
+
+using std::vector;
+
+// The unique edges of a triangle list as GL_LINES indices, so a wireframe draws every edge once
+// instead of outlining each triangle, which draws every shared edge twice. Corners are matched by
+// position, so seams where vertices were split for normals or uvs don't double their edges. With
+// a feature angle only creases are kept: edges whose two faces meet at more than that angle, and
+// boundary and non-manifold edges, which are always kept. The passes run in parallel on up to
+// maxThreads threads (see Utils::parallelFor).
+class EdgeExtractor {
+
+public:
+    // The lowest index of a vertex with the same position, for every vertex. Computed once per
+    // mesh and shared by the extraction of each of its levels.
+    static vector<unsigned int> matchPositions(const vector<glm::vec3>& vertices, size_t maxThreads = 0);
+
+    // Appends to edges the two vertices of each unique edge of the count indices of triangles at
+    // indices. featureAngle is in degrees; 0 keeps every edge. Edges are ordered by the first
+    // triangle using them.
+    static void extract(const vector<glm::vec3>& vertices, const vector<unsigned int>& positionIds,
+                        const unsigned int* indices, size_t count, float featureAngle,
+                        vector<unsigned int>& edges, size_t maxThreads = 0);
+
+    // Like extract, for triangles split into consecutive groups that are culled separately, such as
+    // clusters. Group g ends before triangle groupEnds[g]. The edges of each group are appended in
+    // turn, so an edge shared by two groups is listed by both and stays drawn while either is.
+    // Appends to groupEdgeEnds where the edges of each group end, counted from the first one appended.
+    static void extractGroups(const vector<glm::vec3>& vertices, const vector<unsigned int>& positionIds,
+                              const unsigned int* indices, const vector<size_t>& groupEnds, float featureAngle,
+                              vector<unsigned int>& edges, vector<size_t>& groupEdgeEnds, size_t maxThreads = 0);
+
+private:
+    EdgeExtractor();
+    ~EdgeExtractor();
+};
@@ -0,0 +1,265 @@
+#include "FloatParser.h"
+
+#include "QtGlobal"
+
+#include <atomic>
+#include <clocale>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLOATPARSER_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Limits of the fast paths. Below them the mantissa and the power of ten are both exact, so a
+// single multiplication or division gives the correctly rounded result.
+const unsigned long long MaxFloatMantissa = 1ull << 24;
+const int MaxFloatExponent = 10;
+const unsigned long long MaxDoubleMantissa = 1ull << 53;
+const int MaxDoubleExponent = 22;
+// Significant digits that fit in the 64 bit mantissa
+const ptrdiff_t MaxDigits = 19;
+
+const float floatPowersOfTen[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+const double doublePowersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+std::atomic<size_t> fallbacks(0);
+
+// The parts of a number in the text
+struct Number {
+    const char* begin;
+    const char* end;
+    bool negative;
+    const char* integerBegin;
+    const char* integerEnd;
+    const char* fractionBegin;
+    const char* fractionEnd;
+    int exponent; // Explicit exponent after e or E
+};
+
+bool isDigit(char c) {
+    return unsigned(c - '0') < 10;
+}
+
+#ifdef FLOATPARSER_SSE2
+unsigned lowestSetBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// Returns the end of the run of digits starting at p
+const char* skipDigits(const char* p, const char* end) {
+#ifdef FLOATPARSER_SSE2
+    // c is a digit when c - '0' is below 10 unsigned; SSE2 only compares signed bytes, so both
+    // sides are shifted by 0x80 first
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i bias = _mm_set1_epi8(char(0x80));
+    const __m128i limit = _mm_set1_epi8(char(0x80 + 10));
+    while(end - p >= 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i digits = _mm_cmplt_epi8(_mm_xor_si128(_mm_sub_epi8(bytes, zero), bias), limit);
+        unsigned others = ~unsigned(_mm_movemask_epi8(digits)) & 0xFFFF;
+        if(others != 0)
+            return p + lowestSetBit(others);
+        p += 16;
+    }
+#endif
+    while(p < end && isDigit(*p))
+        ++p;
+    return p;
+}
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+// Converts the 8 digits at p in three multiplications, combining neighbouring digits, then
+// pairs, then quadruples within the 64 bit word
+unsigned long long eightDigits(const char* p) {
+    unsigned long long value;
+    memcpy(&value, p, sizeof(value));
+    value -= 0x3030303030303030ull;
+    value = (value * 10 + (value >> 8)) & 0x00FF00FF00FF00FFull;
+    value = (value * 100 + (value >> 16)) & 0x0000FFFF0000FFFFull;
+    return (value * 10000 + (value >> 32)) & 0xFFFFFFFFull;
+}
+#endif
+
+// Appends the digits [p, end) to mantissa; the result must fit in 64 bits
+unsigned long long appendDigits(unsigned long long mantissa, const char* p, const char* end) {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    for(; end - p >= 8; p += 8)
+        mantissa = mantissa * 100000000 + eightDigits(p);
+#endif
+    for(; p < end; ++p)
+        mantissa = mantissa * 10 + (*p - '0');
+    return mantissa;
+}
+
+const char* skipZeros(const char* p, const char* end) {
+    while(p < end && *p == '0')
+        ++p;
+    return p;
+}
+
+// Finds the parts of the number at p. Returns false if there is none.
+bool scan(const char* p, const char* end, Number& number) {
+    number.begin = p;
+    number.negative = false;
+    if(p < end && (*p == '-' || *p == '+')) {
+        number.negative = *p == '-';
+        ++p;
+    }
+
+    number.integerBegin = p;
+    number.integerEnd = p = skipDigits(p, end);
+    number.fractionBegin = number.fractionEnd = p;
+    if(p < end && *p == '.') {
+        number.fractionBegin = ++p;
+        number.fractionEnd = p = skipDigits(p, end);
+    }
+    if(number.integerBegin == number.integerEnd && number.fractionBegin == number.fractionEnd)
+        return false;
+
+    // An e without digits after it is not part of the number
+    number.exponent = 0;
+    if(p < end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        bool negativeExponent = false;
+        if(e < end && (*e == '-' || *e == '+')) {
+            negativeExponent = *e == '-';
+            ++e;
+        }
+        if(e < end && isDigit(*e)) {
+            int exponent = 0;
+            for(; e < end && isDigit(*e); ++e) {
+                if(exponent < 100000)
+                    exponent = exponent * 10 + (*e - '0');
+            }
+            number.exponent = negativeExponent ? -exponent : exponent;
+            p = e;
+        }
+    }
+
+    number.end = p;
+    return true;
+}
+
+// Converts number with Clinger's fast path. Returns false for the cases it can't convert exactly.
+bool convertFast(const Number& number, float& value) {
+    // Leading zeros don't count towards the significant digits
+    const char* integer = skipZeros(number.integerBegin, number.integerEnd);
+    const char* fraction = integer == number.integerEnd ? skipZeros(number.fractionBegin, number.fractionEnd) : number.fractionBegin;
+    if((number.integerEnd - integer) + (number.fractionEnd - fraction) > MaxDigits)
+        return false;
+
+    unsigned long long mantissa = appendDigits(appendDigits(0, integer, number.integerEnd), fraction, number.fractionEnd);
+    int exponent = number.exponent - int(number.fractionEnd - number.fractionBegin);
+
+    float result;
+    if(mantissa == 0) {
+        result = 0.0f;
+    }
+    else if(mantissa <= MaxFloatMantissa && exponent >= -MaxFloatExponent && exponent <= MaxFloatExponent) {
+        result = float(mantissa);
+        result = exponent >= 0 ? result * floatPowersOfTen[exponent] : result / floatPowersOfTen[-exponent];
+    }
+    else if(mantissa <= MaxDoubleMantissa && exponent >= -MaxDoubleExponent && exponent <= MaxDoubleExponent) {
+        double exact = double(mantissa);
+        exact = exponent >= 0 ? exact * doublePowersOfTen[exponent] : exact / doublePowersOfTen[-exponent];
+
+        // Rounding the correctly rounded double to float again is only wrong when the double
+        // lands exactly halfway between two floats (the low 29 of its 52 mantissa bits are 100...0)
+        unsigned long long bits;
+        memcpy(&bits, &exact, sizeof(bits));
+        if((bits & 0x1FFFFFFFull) == 0x10000000ull)
+            return false;
+        result = float(exact);
+    }
+    else {
+        return false;
+    }
+
+    value = number.negative ? -result : result;
+    return true;
+}
+
+}
+
+FloatParser::FloatParser() {}
+
+FloatParser::~FloatParser() {}
+
+bool FloatParser::parse(const char*& p, const char* end, float& value) {
+    Number number;
+    if(!scan(p, end, number))
+        return false;
+
+    if(!convertFast(number, value)) {
+        value = convertExact(number.begin, number.end);
+        fallbacks.fetch_add(1, std::memory_order_relaxed);
+    }
+    p = number.end;
+    return true;
+}
+
+bool FloatParser::parseExact(const char*& p, const char* end, float& value) {
+    Number number;
+    if(!scan(p, end, number))
+        return false;
+
+    value = convertExact(number.begin, number.end);
+    p = number.end;
+    return true;
+}
+
+size_t FloatParser::getFallbackCount() {
+    return fallbacks.load(std::memory_order_relaxed);
+}
+
+bool FloatParser::usesSimd() {
+#ifdef FLOATPARSER_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+float FloatParser::convertExact(const char* begin, const char* end) {
+    // strtof needs a terminated string and reads the decimal point of the current C locale,
+    // which Qt sets from the environment; the copy gets that decimal point instead of '.'
+    char buffer[64];
+    std::string longNumber;
+    char* text = buffer;
+    size_t length = end - begin;
+    if(length >= sizeof(buffer)) {
+        longNumber.assign(begin, end);
+        text = &longNumber[0];
+    }
+    else {
+        memcpy(buffer, begin, length);
+        buffer[length] = '\0';
+    }
+
+    char* point = static_cast<char*>(memchr(text, '.', length));
+    if(point)
+        *point = *localeconv()->decimal_point;
+    return strtof(text, nullptr);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+// Converts decimal text such as -1.25e-3 to float, as used by the text model formats.
+// Digit runs are found 16 bytes at a time with SSE2 and converted 8 digits at a time; numbers
+// of up to 19 significant digits with a small exponent are then converted exactly with a single
+// floating point operation (Clinger's fast path). Everything else goes through an exact
+// conversion in the C locale, so the result is always the correctly rounded float, whatever
+// locale the application runs in.
+class FloatParser {
+
+public:
+    // Parses a number at p and moves p past it. Returns false, leaving p where it was,
+    // if there is no number at p. Leading whitespace is not skipped.
+    static bool parse(const char*& p, const char* end, float& value);
+
+    // Same as parse, but always takes the exact slow path. Used as the reference when testing
+    // and benchmarking parse.
+    static bool parseExact(const char*& p, const char* end, float& value);
+
+    // Number of times parse had to fall back to the slow path since the program started
+    static size_t getFallbackCount();
+    // Whether digit runs are scanned with SSE2 in this build
+    static bool usesSimd();
+
+private:
+    FloatParser();
+    ~FloatParser();
+
+    // Converts [begin, end), which has already been validated, with strtof in the C locale
+    static float convertExact(const char* begin, const char* end);
+};
@@ -0,0 +1,310 @@
+#include "FrameProfiler.h"
+
+#include "QFile"
+#include "QJsonArray"
+#include "QJsonDocument"
+#include "QJsonObject"
+#include "QPainter"
+#include "QStringList"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+const char* counterNames[FrameProfiler::NumCounters] = {
+    "Draw calls",
+    "Triangles",
+    "Lines",
+    "Points",
+    "Texture binds",
+    "Buffer bytes"
+};
+
+// Total time and number of occurrences of each named stage
+typedef vector<std::pair<const char*, std::pair<double, int> > > StageTotals;
+
+}
+
+FrameProfiler::CpuScope::CpuScope(FrameProfiler& profiler, const char* name) :
+  _profiler(profiler),
+  _name(name),
+  _start(profiler._enabled ? profiler.now() : 0)
+{}
+
+FrameProfiler::CpuScope::~CpuScope() {
+    if(_profiler._enabled)
+        _profiler.recordCpu(_name, _start);
+}
+
+FrameProfiler::GpuScope::GpuScope(FrameProfiler& profiler, const char* name) :
+  _profiler(profiler),
+  _active(profiler.beginGpuPass(name))
+{}
+
+FrameProfiler::GpuScope::~GpuScope() {
+    if(_active)
+        _profiler.endGpuPass();
+}
+
+FrameProfiler::FrameProfiler() :
+  _gl(nullptr),
+  _enabled(false),
+  _inFrame(false),
+  _frameNumber(0),
+  _gpuPassActive(false)
+{
+    _clock.start();
+}
+
+void FrameProfiler::initialize(QOpenGLFunctions_3_3_Core* gl) {
+    _gl = gl;
+}
+
+void FrameProfiler::release() {
+    if(!_gl)
+        return;
+
+    for(size_t slot = 0; slot < QueryLatency; ++slot) {
+        for(const PendingQuery& pending : _pendingQueries[slot])
+            _freeQueries.push_back(pending.query);
+        _pendingQueries[slot].clear();
+    }
+    if(!_freeQueries.empty())
+        _gl->glDeleteQueries(GLsizei(_freeQueries.size()), _freeQueries.data());
+    _freeQueries.clear();
+    _gl = nullptr;
+}
+
+void FrameProfiler::setEnabled(bool enabled) {
+    _enabled = enabled;
+    if(!enabled)
+        _inFrame = false;
+}
+
+bool FrameProfiler::isEnabled() const {
+    return _enabled;
+}
+
+qint64 FrameProfiler::now() const {
+    return _clock.nsecsElapsed() / 1000;
+}
+
+void FrameProfiler::beginFrame() {
+    if(!_enabled)
+        return;
+
+    _current.number = _frameNumber;
+    _current.start = now();
+    _current.duration = 0;
+    _current.cpu.clear();
+    _current.gpu.clear();
+    std::fill(_current.counters, _current.counters + NumCounters, 0.0);
+    _inFrame = true;
+
+    // This slot was last used QueryLatency frames ago, long enough for the gpu to have caught up
+    resolveQueries(_frameNumber % QueryLatency);
+}
+
+void FrameProfiler::endFrame() {
+    if(!_enabled || !_inFrame)
+        return;
+
+    _current.duration = now() - _current.start;
+    _history.push_back(_current);
+    if(_history.size() > HistorySize)
+        _history.pop_front();
+
+    ++_frameNumber;
+    _inFrame = false;
+}
+
+void FrameProfiler::count(Counter counter, double amount) {
+    if(_enabled && _inFrame)
+        _current.counters[counter] += amount;
+}
+
+void FrameProfiler::recordCpu(const char* name, qint64 start) {
+    if(!_inFrame)
+        return;
+
+    Event event;
+    event.name = name;
+    event.start = start;
+    event.duration = now() - start;
+    _current.cpu.push_back(event);
+}
+
+bool FrameProfiler::beginGpuPass(const char* name) {
+    if(!_enabled || !_inFrame || !_gl || _gpuPassActive)
+        return false;
+
+    PendingQuery pending;
+    pending.frame = _frameNumber;
+    pending.name = name;
+    pending.cpuStart = now();
+    if(_freeQueries.empty()) {
+        pending.query = 0;
+        _gl->glGenQueries(1, &pending.query);
+    }
+    else {
+        pending.query = _freeQueries.back();
+        _freeQueries.pop_back();
+    }
+
+    _gl->glBeginQuery(GL_TIME_ELAPSED, pending.query);
+    _pendingQueries[_frameNumber % QueryLatency].push_back(pending);
+    _gpuPassActive = true;
+    return true;
+}
+
+void FrameProfiler::endGpuPass() {
+    _gl->glEndQuery(GL_TIME_ELAPSED);
+    _gpuPassActive = false;
+}
+
+void FrameProfiler::resolveQueries(size_t slot) {
+    if(!_gl)
+        return;
+
+    for(const PendingQuery& pending : _pendingQueries[slot]) {
+        GLint available = 0;
+        _gl->glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if(available) {
+            GLuint64 elapsed = 0;
+            _gl->glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &elapsed);
+
+            // The gpu clock isn't synchronized with ours, so passes are placed at the time they were submitted
+            for(auto it = _history.rbegin(); it != _history.rend(); ++it) {
+                if(it->number == pending.frame) {
+                    Event event;
+                    event.name = pending.name;
+                    event.start = pending.cpuStart;
+                    event.duration = qint64(elapsed / 1000);
+                    it->gpu.push_back(event);
+                    break;
+                }
+            }
+        }
+        _freeQueries.push_back(pending.query);
+    }
+    _pendingQueries[slot].clear();
+}
+
+void FrameProfiler::drawOverlay(QPainter& painter, const QRect& rect) const {
+    if(_history.empty())
+        return;
+
+    size_t numFrames = std::min(size_t(OverlayFrames), _history.size());
+    double frameTime = 0.0;
+    double counters[NumCounters] = {};
+
+    // Average each stage over the frames it appears in, keeping the order stages were first seen
+    StageTotals cpu, gpu;
+    auto accumulate = [](StageTotals& totals, const vector<Event>& events) {
+        for(const Event& event : events) {
+            auto it = std::find_if(totals.begin(), totals.end(), [&](const StageTotals::value_type& total) {
+                return qstrcmp(total.first, event.name) == 0;
+            });
+            if(it == totals.end())
+                totals.push_back(std::make_pair(event.name, std::make_pair(double(event.duration), 1)));
+            else {
+                it->second.first += event.duration;
+                ++it->second.second;
+            }
+        }
+    };
+
+    for(size_t i = _history.size() - numFrames; i < _history.size(); ++i) {
+        const Frame& frame = _history[i];
+        frameTime += frame.duration;
+        accumulate(cpu, frame.cpu);
+        accumulate(gpu, frame.gpu);
+        for(int c = 0; c < NumCounters; ++c)
+            counters[c] += frame.counters[c];
+    }
+
+    QStringList lines;
+    lines << QString("Frame (CPU)  %1 ms").arg(frameTime / numFrames / 1000.0, 0, 'f', 2);
+    for(const auto& stage : cpu)
+        lines << QString("  %1  %2 ms").arg(stage.first).arg(stage.second.first / stage.second.second / 1000.0, 0, 'f', 3);
+    for(const auto& pass : gpu)
+        lines << QString("GPU %1  %2 ms").arg(pass.first).arg(pass.second.first / pass.second.second / 1000.0, 0, 'f', 3);
+    for(int c = 0; c < NumCounters; ++c)
+        lines << QString("%1  %2").arg(counterNames[c]).arg(counters[c] / numFrames, 0, 'f', 0);
+
+    QFontMetrics metrics = painter.fontMetrics();
+    int width = 0;
+    for(const QString& line : lines)
+        width = std::max(width, metrics.width(line));
+    QRect background(rect.left() + 8, rect.top() + 8, width + 16, lines.size() * metrics.height() + 12);
+
+    painter.save();
+    painter.fillRect(background, QColor(0, 0, 0, 160));
+    painter.setPen(Qt::white);
+    int y = background.top() + 6 + metrics.ascent();
+    for(const QString& line : lines) {
+        painter.drawText(background.left() + 8, y, line);
+        y += metrics.height();
+    }
+    painter.restore();
+}
+
+bool FrameProfiler::writeTrace(const QString& fileName) const {
+    QJsonArray events;
+
+    auto metadata = [&](int tid, const char* name) {
+        QJsonObject event;
+        event["name"] = "thread_name";
+        event["ph"] = "M";
+        event["pid"] = 1;
+        event["tid"] = tid;
+        QJsonObject args;
+        args["name"] = name;
+        event["args"] = args;
+        events.append(event);
+    };
+    auto complete = [&](int tid, const char* name, qint64 start, qint64 duration) {
+        QJsonObject event;
+        event["name"] = name;
+        event["ph"] = "X";
+        event["pid"] = 1;
+        event["tid"] = tid;
+        event["ts"] = double(start);
+        event["dur"] = double(duration);
+        events.append(event);
+    };
+
+    metadata(1, "CPU");
+    metadata(2, "GPU");
+
+    for(const Frame& frame : _history) {
+        complete(1, "Frame", frame.start, frame.duration);
+        for(const Event& event : frame.cpu)
+            complete(1, event.name, event.start, event.duration);
+        for(const Event& event : frame.gpu)
+            complete(2, event.name, event.start, event.duration);
+
+        QJsonObject counter;
+        counter["name"] = "Counters";
+        counter["ph"] = "C";
+        counter["pid"] = 1;
+        counter["ts"] = double(frame.start);
+        QJsonObject args;
+        for(int c = 0; c < NumCounters; ++c)
+            args[counterNames[c]] = frame.counters[c];
+        counter["args"] = args;
+        events.append(counter);
+    }
+
+    QJsonObject trace;
+    trace["traceEvents"] = events;
+    trace["displayTimeUnit"] = "ms";
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    QByteArray json = QJsonDocument(trace).toJson(QJsonDocument::Compact);
+    return file.write(json) == json.size();
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "QOpenGLFunctions_3_3_Core"
+#include "QElapsedTimer"
+#include "QString"
+
+#include <deque>
+#include <vector>
+
+using std::vector;
+
+class QPainter;
+class QRect;
+
+// Collects per-frame CPU stage times, GPU pass times and work counters while enabled.
+// GPU times come from GL_TIME_ELAPSED queries that are read back a few frames later, so
+// measuring never waits for the gpu. The history can be shown as an overlay or written
+// as a Chrome trace (chrome://tracing, Perfetto).
+class FrameProfiler {
+
+public:
+    enum Counter {
+        DrawCalls,
+        Triangles,
+        Lines,
+        Points,
+        TextureBinds,
+        BufferBytes, // Bytes uploaded to buffers
+        NumCounters
+    };
+
+    // Times a CPU stage of the current frame from construction to destruction
+    class CpuScope {
+    public:
+        CpuScope(FrameProfiler& profiler, const char* name);
+        ~CpuScope();
+
+    private:
+        FrameProfiler& _profiler;
+        const char* _name;
+        qint64 _start;
+    };
+
+    // Times a GPU pass of the current frame from construction to destruction. Passes can't be nested.
+    class GpuScope {
+    public:
+        GpuScope(FrameProfiler& profiler, const char* name);
+        ~GpuScope();
+
+    private:
+        FrameProfiler& _profiler;
+        bool _active;
+    };
+
+    FrameProfiler();
+
+    // Called with the context current; release() deletes the query objects
+    void initialize(QOpenGLFunctions_3_3_Core* gl);
+    void release();
+
+    // Nothing is recorded while disabled, and the scopes cost next to nothing
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    void beginFrame();
+    void endFrame();
+    void count(Counter counter, double amount);
+
+    // Draws averages over the last frames in the top left corner of rect
+    void drawOverlay(QPainter& painter, const QRect& rect) const;
+    // Writes the recorded frames as Chrome trace-event JSON
+    bool writeTrace(const QString& fileName) const;
+
+private:
+    // Frames a GPU query is given before its result is read
+    static const size_t QueryLatency = 4;
+    // Frames kept for the trace
+    static const size_t HistorySize = 600;
+    // Frames averaged for the overlay
+    static const size_t OverlayFrames = 60;
+
+    struct Event {
+        const char* name;
+        qint64 start;    // Microseconds since the profiler was created
+        qint64 duration; // Microseconds
+    };
+
+    struct Frame {
+        quint64 number;
+        qint64 start;
+        qint64 duration;
+        vector<Event> cpu;
+        vector<Event> gpu;
+        double counters[NumCounters];
+    };
+
+    struct PendingQuery {
+        quint64 frame;
+        const char* name;
+        qint64 cpuStart;
+        GLuint query;
+    };
+
+    QOpenGLFunctions_3_3_Core* _gl;
+    bool _enabled;
+    bool _inFrame;
+    QElapsedTimer _clock;
+    quint64 _frameNumber;
+    Frame _current;
+    std::deque<Frame> _history;
+
+    // Queries issued in each of the last QueryLatency frames, and query objects ready for reuse
+    vector<PendingQuery> _pendingQueries[QueryLatency];
+    vector<GLuint> _freeQueries;
+    bool _gpuPassActive;
+
+    qint64 now() const;
+    void recordCpu(const char* name, qint64 start);
+    bool beginGpuPass(const char* name);
+    void endGpuPass();
+    // Reads back the queries of slot that have finished; the others are dropped rather than waited for
+    void resolveQueries(size_t slot);
+};
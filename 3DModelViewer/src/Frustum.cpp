@@ -0,0 +1,24 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& mvp) {
+    // Gribb/Hartmann: each plane is the last row of the matrix plus or minus one of the others
+    for(int i = 0; i < 3; ++i) {
+        for(int side = 0; side < 2; ++side) {
+            float sign = side == 0 ? 1.0f : -1.0f;
+            glm::vec4 plane;
+            for(int column = 0; column < 4; ++column)
+                plane[column] = mvp[column][3] + sign * mvp[column][i];
+
+            float length = glm::length(glm::vec3(plane));
+            _planes[i * 2 + side] = length > 0.0f ? plane / length : plane;
+        }
+    }
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+    for(const glm::vec4& plane : _planes) {
+        if(glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
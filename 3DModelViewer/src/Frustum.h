@@ -0,0 +1,16 @@
+#pragma once
+
+#include "glm.hpp"
+
+// View frustum planes in the space of the matrix they were extracted from
+class Frustum {
+
+public:
+    // Extracts the six planes from a (model) view projection matrix
+    Frustum(const glm::mat4& mvp);
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const;
+
+private:
+    glm::vec4 _planes[6];
+};
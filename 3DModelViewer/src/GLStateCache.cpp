@@ -0,0 +1,342 @@
+#include "GLStateCache.h"
+
+namespace {
+
+const GLuint Unknown = ~0u;
+
+}
+
+GLStateCache::GLStateCache() :
+  _gl(nullptr),
+  _calls(0),
+  _skipped(0),
+  _callsLastFrame(0),
+  _skippedLastFrame(0),
+  _drawCalls(0),
+  _textureBinds(0),
+  _bufferBytes(0)
+{
+    invalidate();
+}
+
+void GLStateCache::setFunctions(QOpenGLFunctions_3_3_Core* gl) {
+    _gl = gl;
+    invalidate();
+}
+
+void GLStateCache::invalidate() {
+    _program = Unknown;
+    _vertexArray = Unknown;
+    _polygonMode = Unknown;
+    _activeTexture = Unknown;
+    _viewport[0] = _viewport[1] = _viewport[2] = _viewport[3] = -1;
+    _blendSource = Unknown;
+    _blendDestination = Unknown;
+    _colorMask = -1;
+    _depthMask = -1;
+    _stencilFunc[0] = _stencilFunc[1] = _stencilFunc[2] = Unknown;
+    _stencilOp[0] = _stencilOp[1] = _stencilOp[2] = Unknown;
+    _buffers.clear();
+    _bufferRanges.clear();
+    _textures.clear();
+    _capabilities.clear();
+    _uniforms.clear();
+}
+
+void GLStateCache::beginFrame() {
+    _viewport[0] = _viewport[1] = _viewport[2] = _viewport[3] = -1;
+    _callsLastFrame = _calls;
+    _skippedLastFrame = _skipped;
+    _calls = 0;
+    _skipped = 0;
+    _drawCalls = 0;
+    _textureBinds = 0;
+    _bufferBytes = 0;
+}
+
+unsigned int GLStateCache::callsLastFrame() const {
+    return _callsLastFrame;
+}
+
+unsigned int GLStateCache::callsSkippedLastFrame() const {
+    return _skippedLastFrame;
+}
+
+unsigned int GLStateCache::drawCalls() const {
+    return _drawCalls;
+}
+
+unsigned int GLStateCache::textureBinds() const {
+    return _textureBinds;
+}
+
+size_t GLStateCache::bufferBytes() const {
+    return _bufferBytes;
+}
+
+void GLStateCache::useProgram(GLuint program) {
+    if(_program == program) {
+        ++_skipped;
+        return;
+    }
+    _gl->glUseProgram(program);
+    _program = program;
+    ++_calls;
+}
+
+void GLStateCache::bindVertexArray(GLuint vertexArray) {
+    if(_vertexArray == vertexArray) {
+        ++_skipped;
+        return;
+    }
+    _gl->glBindVertexArray(vertexArray);
+    _vertexArray = vertexArray;
+    // The element array binding belongs to the vertex array object
+    _buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+    ++_calls;
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer) {
+    auto it = _buffers.find(target);
+    if(it != _buffers.end() && it->second == buffer) {
+        ++_skipped;
+        return;
+    }
+    _gl->glBindBuffer(target, buffer);
+    _buffers[target] = buffer;
+    ++_calls;
+}
+
+void GLStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    std::pair<GLuint, std::pair<GLintptr, GLsizeiptr> > range(buffer, std::make_pair(offset, size));
+    std::pair<GLenum, GLuint> key(target, index);
+    auto it = _bufferRanges.find(key);
+    if(it != _bufferRanges.end() && it->second == range) {
+        ++_skipped;
+        return;
+    }
+    _gl->glBindBufferRange(target, index, buffer, offset, size);
+    _bufferRanges[key] = range;
+    // Binding a range also binds the buffer to the generic binding point
+    _buffers[target] = buffer;
+    ++_calls;
+}
+
+void GLStateCache::bindTexture(GLenum target, GLuint texture) {
+    // Bindings are kept per unit, so switching units to bind a second texture doesn't lose the first
+    std::pair<GLenum, GLenum> key(_activeTexture, target);
+    auto it = _textures.find(key);
+    if(it != _textures.end() && it->second == texture) {
+        ++_skipped;
+        return;
+    }
+    _gl->glBindTexture(target, texture);
+    _textures[key] = texture;
+    ++_textureBinds;
+    ++_calls;
+}
+
+void GLStateCache::setEnabled(GLenum capability, bool enabled) {
+    auto it = _capabilities.find(capability);
+    if(it != _capabilities.end() && it->second == enabled) {
+        ++_skipped;
+        return;
+    }
+    if(enabled)
+        _gl->glEnable(capability);
+    else
+        _gl->glDisable(capability);
+    _capabilities[capability] = enabled;
+    ++_calls;
+}
+
+void GLStateCache::polygonMode(GLenum mode) {
+    if(_polygonMode == mode) {
+        ++_skipped;
+        return;
+    }
+    _gl->glPolygonMode(GL_FRONT_AND_BACK, mode);
+    _polygonMode = mode;
+    ++_calls;
+}
+
+void GLStateCache::activeTexture(GLenum unit) {
+    if(_activeTexture == unit) {
+        ++_skipped;
+        return;
+    }
+    _gl->glActiveTexture(unit);
+    _activeTexture = unit;
+    ++_calls;
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    if(_viewport[0] == x && _viewport[1] == y && _viewport[2] == width && _viewport[3] == height) {
+        ++_skipped;
+        return;
+    }
+    _gl->glViewport(x, y, width, height);
+    _viewport[0] = x;
+    _viewport[1] = y;
+    _viewport[2] = width;
+    _viewport[3] = height;
+    ++_calls;
+}
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination) {
+    if(_blendSource == source && _blendDestination == destination) {
+        ++_skipped;
+        return;
+    }
+    _gl->glBlendFunc(source, destination);
+    _blendSource = source;
+    _blendDestination = destination;
+    ++_calls;
+}
+
+void GLStateCache::uniform1i(GLint location, GLint value) {
+    // Uniform values are stored per program
+    std::pair<GLuint, GLint> key(_program, location);
+    auto it = _uniforms.find(key);
+    if(it != _uniforms.end() && it->second == value) {
+        ++_skipped;
+        return;
+    }
+    _gl->glUniform1i(location, value);
+    _uniforms[key] = value;
+    ++_calls;
+}
+
+void GLStateCache::colorMask(bool enabled) {
+    if(_colorMask == GLint(enabled)) {
+        ++_skipped;
+        return;
+    }
+    const GLboolean value = enabled ? GL_TRUE : GL_FALSE;
+    _gl->glColorMask(value, value, value, value);
+    _colorMask = GLint(enabled);
+    ++_calls;
+}
+
+void GLStateCache::depthMask(bool enabled) {
+    if(_depthMask == GLint(enabled)) {
+        ++_skipped;
+        return;
+    }
+    _gl->glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    _depthMask = GLint(enabled);
+    ++_calls;
+}
+
+void GLStateCache::stencilFunc(GLenum func, GLint reference, GLuint mask) {
+    if(_stencilFunc[0] == func && _stencilFunc[1] == GLuint(reference) && _stencilFunc[2] == mask) {
+        ++_skipped;
+        return;
+    }
+    _gl->glStencilFunc(func, reference, mask);
+    _stencilFunc[0] = func;
+    _stencilFunc[1] = GLuint(reference);
+    _stencilFunc[2] = mask;
+    ++_calls;
+}
+
+void GLStateCache::stencilOp(GLenum stencilFail, GLenum depthFail, GLenum pass) {
+    if(_stencilOp[0] == stencilFail && _stencilOp[1] == depthFail && _stencilOp[2] == pass) {
+        ++_skipped;
+        return;
+    }
+    _gl->glStencilOp(stencilFail, depthFail, pass);
+    _stencilOp[0] = stencilFail;
+    _stencilOp[1] = depthFail;
+    _stencilOp[2] = pass;
+    ++_calls;
+}
+
+void GLStateCache::clear(GLbitfield mask) {
+    _gl->glClear(mask);
+    ++_calls;
+}
+
+void GLStateCache::bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    _gl->glBufferData(target, size, data, usage);
+    if(data)
+        _bufferBytes += size;
+    ++_calls;
+}
+
+void GLStateCache::bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    _gl->glBufferSubData(target, offset, size, data);
+    _bufferBytes += size;
+    ++_calls;
+}
+
+void GLStateCache::drawArrays(GLenum mode, GLint first, GLsizei count) {
+    _gl->glDrawArrays(mode, first, count);
+    ++_drawCalls;
+    ++_calls;
+}
+
+void GLStateCache::drawElements(GLenum mode, GLsizei count, GLenum type, const void* offset) {
+    _gl->glDrawElements(mode, count, type, offset);
+    ++_drawCalls;
+    ++_calls;
+}
+
+void GLStateCache::multiDrawElements(GLenum mode, const GLsizei* counts, GLenum type, const void* const* offsets, GLsizei drawCount) {
+    _gl->glMultiDrawElements(mode, counts, type, offsets, drawCount);
+    ++_drawCalls;
+    ++_calls;
+}
+
+void GLStateCache::uniformMatrix4(GLint location, const GLfloat* value) {
+    _gl->glUniformMatrix4fv(location, 1, GL_FALSE, value);
+    ++_calls;
+}
+
+void GLStateCache::uniform1ui(GLint location, GLuint value) {
+    _gl->glUniform1ui(location, value);
+    ++_calls;
+}
+
+void GLStateCache::uniform1f(GLint location, GLfloat value) {
+    _gl->glUniform1f(location, value);
+    ++_calls;
+}
+
+void GLStateCache::vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* offset) {
+    _gl->glEnableVertexAttribArray(index);
+    _gl->glVertexAttribPointer(index, size, type, normalized, stride, offset);
+    _calls += 2;
+}
+
+void GLStateCache::deleteBuffers(GLsizei count, const GLuint* buffers) {
+    _gl->glDeleteBuffers(count, buffers);
+    ++_calls;
+    for(GLsizei i = 0; i < count; ++i) {
+        if(buffers[i] == 0)
+            continue;
+        for(auto it = _buffers.begin(); it != _buffers.end(); ++it) {
+            if(it->second == buffers[i])
+                it->second = 0;
+        }
+        // Indexed bindings are unbound too; forgetting them makes the next bind reach the driver
+        for(auto it = _bufferRanges.begin(); it != _bufferRanges.end();) {
+            if(it->second.first == buffers[i])
+                it = _bufferRanges.erase(it);
+            else
+                ++it;
+        }
+    }
+}
+
+void GLStateCache::deleteVertexArrays(GLsizei count, const GLuint* vertexArrays) {
+    _gl->glDeleteVertexArrays(count, vertexArrays);
+    ++_calls;
+    for(GLsizei i = 0; i < count; ++i) {
+        if(vertexArrays[i] != 0 && vertexArrays[i] == _vertexArray) {
+            _vertexArray = 0;
+            // The element array binding of vertex array 0 isn't known
+            _buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "QOpenGLFunctions_3_3_Core"
+#include <map>
+#include <utility>
+
+// Shadow copy of the OpenGL state touched while rendering a frame.
+// Calls that would not change the state are skipped, and every call that does reach
+// the driver is counted so the cost of a frame can be inspected.
+class GLStateCache {
+
+public:
+    GLStateCache();
+
+    void setFunctions(QOpenGLFunctions_3_3_Core* gl);
+
+    // Forget the shadowed state; call whenever other code may have changed it
+    void invalidate();
+    // Starts counting calls for a new frame. The shadowed state is kept, apart from the viewport,
+    // which the widget sets before every frame.
+    void beginFrame();
+    unsigned int callsLastFrame() const;
+    unsigned int callsSkippedLastFrame() const;
+    // Work issued since beginFrame
+    unsigned int drawCalls() const;
+    unsigned int textureBinds() const;
+    size_t bufferBytes() const; // Bytes uploaded with bufferData/bufferSubData
+
+    // Cached state changes
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    void bindTexture(GLenum target, GLuint texture);
+    void setEnabled(GLenum capability, bool enabled);
+    void polygonMode(GLenum mode);
+    void activeTexture(GLenum unit);
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void blendFunc(GLenum source, GLenum destination);
+    void uniform1i(GLint location, GLint value);
+    void colorMask(bool enabled); // All four channels at once
+    void depthMask(bool enabled);
+    void stencilFunc(GLenum func, GLint reference, GLuint mask);
+    void stencilOp(GLenum stencilFail, GLenum depthFail, GLenum pass);
+
+    // Calls that always reach the driver, counted
+    void clear(GLbitfield mask);
+    void bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+    void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+    void drawArrays(GLenum mode, GLint first, GLsizei count);
+    void drawElements(GLenum mode, GLsizei count, GLenum type, const void* offset);
+    void multiDrawElements(GLenum mode, const GLsizei* counts, GLenum type, const void* const* offsets, GLsizei drawCount);
+    void uniformMatrix4(GLint location, const GLfloat* value);
+    void uniform1ui(GLint location, GLuint value);
+    void uniform1f(GLint location, GLfloat value);
+    // Enables the attribute of the bound vertex array and points it at the bound array buffer
+    void vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* offset);
+    // Deleting a bound object unbinds it, so these forget the bindings of the objects they delete
+    void deleteBuffers(GLsizei count, const GLuint* buffers);
+    void deleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+
+private:
+    QOpenGLFunctions_3_3_Core* _gl;
+
+    // 0 is a valid id for all of these, so unknown state is marked with ~0
+    GLuint _program;
+    GLuint _vertexArray;
+    GLenum _polygonMode;
+    GLenum _activeTexture;
+    GLint _viewport[4];
+    GLenum _blendSource;
+    GLenum _blendDestination;
+    GLint _colorMask; // 0 or 1, or -1 when unknown
+    GLint _depthMask;
+    GLuint _stencilFunc[3]; // Function, reference and mask
+    GLenum _stencilOp[3];
+    std::map<GLenum, GLuint> _buffers;
+    std::map<std::pair<GLenum, GLuint>, std::pair<GLuint, std::pair<GLintptr, GLsizeiptr> > > _bufferRanges;
+    std::map<std::pair<GLenum, GLenum>, GLuint> _textures; // By unit and target
+    std::map<GLenum, bool> _capabilities;
+    std::map<std::pair<GLuint, GLint>, GLint> _uniforms;
+
+    unsigned int _calls;
+    unsigned int _skipped;
+    unsigned int _callsLastFrame;
+    unsigned int _skippedLastFrame;
+    unsigned int _drawCalls;
+    unsigned int _textureBinds;
+    size_t _bufferBytes;
+};
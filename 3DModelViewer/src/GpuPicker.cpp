@@ -0,0 +1,265 @@
+#include "GpuPicker.h"
+
+#include "QDebug"
+
+#include "gtc/matrix_transform.hpp"
+
+namespace {
+
+const int RegionPixels = GpuPicker::RegionSize * GpuPicker::RegionSize;
+// Each read back holds the ids as two uints per pixel, followed by the depths
+const size_t IdBytes = RegionPixels * 2 * sizeof(uint32_t);
+const size_t ReadbackBytes = IdBytes + RegionPixels * sizeof(float);
+
+}
+
+GpuPicker::Result::Result() :
+  found(false),
+  mesh(0),
+  triangle(0),
+  position(0.0f),
+  normal(0.0f),
+  milliseconds(0.0),
+  frames(0)
+{}
+
+GpuPicker::GpuPicker() :
+  _gl(nullptr),
+  _framebuffer(0),
+  _idTexture(0),
+  _depthBuffer(0),
+  _previousDrawFramebuffer(0),
+  _previousReadFramebuffer(0),
+  _passReadback(-1),
+  _frame(0),
+  _sequence(0),
+  _hasRequest(false),
+  _requestX(0),
+  _requestY(0),
+  _requestTime(0),
+  _requestFrame(0),
+  _hasResult(false),
+  _resultSequence(0)
+{
+    for(Readback& readback : _readbacks) {
+        readback.buffer = 0;
+        readback.fence = nullptr;
+        readback.sequence = 0;
+    }
+    _clock.start();
+}
+
+void GpuPicker::initialize(QOpenGLFunctions_3_3_Core* gl) {
+    _gl = gl;
+
+    // Mesh and triangle ids in an integer target, with a depth buffer so the nearest surface wins
+    _gl->glGenTextures(1, &_idTexture);
+    _gl->glBindTexture(GL_TEXTURE_2D, _idTexture);
+    _gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, RegionSize, RegionSize, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+    _gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    _gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    _gl->glBindTexture(GL_TEXTURE_2D, 0);
+
+    _gl->glGenRenderbuffers(1, &_depthBuffer);
+    _gl->glBindRenderbuffer(GL_RENDERBUFFER, _depthBuffer);
+    _gl->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, RegionSize, RegionSize);
+    _gl->glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLint previous = 0;
+    _gl->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    _gl->glGenFramebuffers(1, &_framebuffer);
+    _gl->glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    _gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _idTexture, 0);
+    _gl->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthBuffer);
+    if(_gl->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        qWarning() << "The id buffer for picking is incomplete";
+    _gl->glBindFramebuffer(GL_FRAMEBUFFER, previous);
+
+    for(Readback& readback : _readbacks) {
+        _gl->glGenBuffers(1, &readback.buffer);
+        _gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        _gl->glBufferData(GL_PIXEL_PACK_BUFFER, ReadbackBytes, nullptr, GL_STREAM_READ);
+    }
+    _gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void GpuPicker::release() {
+    if(!_gl)
+        return;
+
+    for(Readback& readback : _readbacks) {
+        if(readback.fence)
+            _gl->glDeleteSync(readback.fence);
+        _gl->glDeleteBuffers(1, &readback.buffer);
+        readback.buffer = 0;
+        readback.fence = nullptr;
+    }
+    _gl->glDeleteFramebuffers(1, &_framebuffer);
+    _gl->glDeleteRenderbuffers(1, &_depthBuffer);
+    _gl->glDeleteTextures(1, &_idTexture);
+    _framebuffer = _depthBuffer = _idTexture = 0;
+    _gl = nullptr;
+}
+
+void GpuPicker::request(int x, int y) {
+    _requestX = x;
+    _requestY = y;
+    // The latency of a replaced request continues in the new one
+    if(!_hasRequest) {
+        _requestTime = _clock.nsecsElapsed();
+        _requestFrame = _frame;
+    }
+    _hasRequest = true;
+}
+
+bool GpuPicker::isPassDue() const {
+    return _gl && _hasRequest && freeReadback() >= 0;
+}
+
+glm::mat4 GpuPicker::beginPass(int width, int height, const glm::mat4& viewProjection) {
+    _passReadback = freeReadback();
+    Readback& readback = _readbacks[_passReadback];
+    readback.sequence = ++_sequence;
+    readback.requestTime = _requestTime;
+    readback.requestFrame = _requestFrame;
+    _hasRequest = false;
+
+    // Window coordinates count from the bottom; the region is centered on the middle of the pixel
+    glm::mat4 region = glm::pickMatrix(
+        glm::vec2(_requestX + 0.5f, height - 1 - _requestY + 0.5f),
+        glm::vec2(float(RegionSize)),
+        glm::ivec4(0, 0, width, height)
+    );
+    readback.inverseRegionViewProjection = glm::inverse(region * viewProjection);
+
+    _gl->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &_previousDrawFramebuffer);
+    _gl->glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &_previousReadFramebuffer);
+    _gl->glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+
+    // 0 is the background; drawn ids start at 1
+    const GLuint background[4] = { 0, 0, 0, 0 };
+    const GLfloat farDepth = 1.0f;
+    _gl->glClearBufferuiv(GL_COLOR, 0, background);
+    _gl->glClearBufferfv(GL_DEPTH, 0, &farDepth);
+    return region;
+}
+
+void GpuPicker::endPass() {
+    Readback& readback = _readbacks[_passReadback];
+
+    // Both reads land in the pixel buffer, so they return without waiting for the pass to finish
+    _gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    _gl->glReadPixels(0, 0, RegionSize, RegionSize, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+    _gl->glReadPixels(0, 0, RegionSize, RegionSize, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)IdBytes);
+    _gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = _gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    _gl->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _previousDrawFramebuffer);
+    _gl->glBindFramebuffer(GL_READ_FRAMEBUFFER, _previousReadFramebuffer);
+    _passReadback = -1;
+}
+
+void GpuPicker::poll() {
+    if(!_gl)
+        return;
+    ++_frame;
+
+    for(Readback& readback : _readbacks) {
+        if(!readback.fence)
+            continue;
+
+        // A zero timeout only asks whether the copy is done; the flush makes sure it gets started
+        GLenum status = _gl->glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            continue;
+        _gl->glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+
+        // Read backs finishing out of order don't replace a newer answer
+        if(readback.sequence < _resultSequence)
+            continue;
+
+        _gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        const void* data = _gl->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, ReadbackBytes, GL_MAP_READ_BIT);
+        if(data) {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            _result = decode(readback, reinterpret_cast<const uint32_t*>(bytes), reinterpret_cast<const float*>(bytes + IdBytes));
+            _result.milliseconds = (_clock.nsecsElapsed() - readback.requestTime) / 1e6;
+            _result.frames = int(_frame - readback.requestFrame);
+            _resultSequence = readback.sequence;
+            _hasResult = true;
+            _gl->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        _gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+bool GpuPicker::takeResult(Result& result) {
+    if(!_hasResult)
+        return false;
+    result = _result;
+    _hasResult = false;
+    return true;
+}
+
+size_t GpuPicker::gpuBytes() const {
+    if(!_gl)
+        return 0;
+    // The id target and its depth buffer, whose 24 bit depths are stored in 32 bits, and the read backs
+    return ReadbackBytes + NumReadbacks * ReadbackBytes;
+}
+
+int GpuPicker::freeReadback() const {
+    for(int i = 0; i < NumReadbacks; ++i) {
+        if(!_readbacks[i].fence && i != _passReadback)
+            return i;
+    }
+    return -1;
+}
+
+GpuPicker::Result GpuPicker::decode(const Readback& readback, const uint32_t* ids, const float* depths) const {
+    // Rows are read from the bottom up; the requested pixel is in the middle either way
+    const int center = RegionSize / 2;
+    auto meshAt = [&](int x, int y) { return ids[2 * (y * RegionSize + x)]; };
+    auto positionAt = [&](int x, int y, float depth) {
+        glm::vec4 ndc(
+            (x + 0.5f) / RegionSize * 2.0f - 1.0f,
+            (y + 0.5f) / RegionSize * 2.0f - 1.0f,
+            depth * 2.0f - 1.0f,
+            1.0f
+        );
+        glm::vec4 world = readback.inverseRegionViewProjection * ndc;
+        return glm::vec3(world) / world.w;
+    };
+
+    Result result;
+    uint32_t mesh = meshAt(center, center);
+    if(mesh == 0)
+        return result;
+
+    result.found = true;
+    result.mesh = mesh - 1;
+    result.triangle = ids[2 * (center * RegionSize + center) + 1];
+    result.position = positionAt(center, center, depths[center * RegionSize + center]);
+
+    // Tangents across the surface from the neighbouring pixels of the same mesh, on whichever side has one
+    glm::vec3 tangents[2];
+    bool haveTangents = true;
+    for(int axis = 0; axis < 2; ++axis) {
+        int dx = axis == 0 ? 1 : 0, dy = axis == 1 ? 1 : 0;
+        if(meshAt(center + dx, center + dy) == mesh)
+            tangents[axis] = positionAt(center + dx, center + dy, depths[(center + dy) * RegionSize + center + dx]) - result.position;
+        else if(meshAt(center - dx, center - dy) == mesh)
+            tangents[axis] = result.position - positionAt(center - dx, center - dy, depths[(center - dy) * RegionSize + center - dx]);
+        else
+            haveTangents = false;
+    }
+
+    // The direction of the ray through the pixel, from its point on the near plane
+    glm::vec3 direction = result.position - positionAt(center, center, 0.0f);
+    glm::vec3 normal = haveTangents ? glm::cross(tangents[0], tangents[1]) : glm::vec3(0.0f);
+    if(glm::dot(normal, normal) <= 0.0f)
+        normal = -direction;
+    result.normal = glm::normalize(glm::dot(normal, direction) > 0.0f ? -normal : normal);
+    return result;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "QOpenGLFunctions_3_3_Core"
+#include "QElapsedTimer"
+
+#include "glm.hpp"
+
+#include <cstdint>
+
+// Picks by drawing mesh and triangle ids into a small integer target, as an alternative to the
+// CPU hierarchies of ModelPicker that needs no preprocessing. Nothing is drawn until a pick is
+// requested; the pass then covers only the RegionSize square around the cursor, which a pick
+// matrix stretches over the whole target, so it costs a handful of fragments and anything outside
+// the square can be culled. The ids and depths are read back into a pixel buffer and collected
+// once their fence has passed, a frame or two later, so picking never stalls the pipeline.
+// Owned by the renderer; every method but request and takeResult expects its context to be current.
+class GpuPicker {
+
+public:
+    // Width and height in pixels of the region drawn around the requested pixel
+    static const int RegionSize = 9;
+
+    struct Result {
+        Result();
+
+        bool found;
+        uint32_t mesh;       // Index of the mesh in the order it was drawn
+        uint32_t triangle;   // Index of the triangle in the draw, which is the mesh's full resolution level
+        glm::vec3 position;  // World space
+        glm::vec3 normal;    // World space, from the depths around the pixel, facing the camera
+        double milliseconds; // From the request to the result
+        int frames;          // Frames rendered from the request to the result
+    };
+
+    GpuPicker();
+
+    // Creates the id target and the pixel buffers; release() deletes them
+    void initialize(QOpenGLFunctions_3_3_Core* gl);
+    void release();
+
+    // Queues a pick of pixel (x, y), counted from the top left corner of the viewport.
+    // Replaces a request that hasn't been drawn yet.
+    void request(int x, int y);
+    // Whether the next frame should draw the id pass
+    bool isPassDue() const;
+    // Binds and clears the id target for the pending request. Returns the matrix that goes in front
+    // of the projection to draw the region of a width x height viewport; viewProjection is used
+    // to bring the result back to world space.
+    glm::mat4 beginPass(int width, int height, const glm::mat4& viewProjection);
+    // Starts reading the region back and rebinds the framebuffer that was bound before beginPass
+    void endPass();
+    // Collects the read backs that have finished, without waiting for the others. Called once per frame.
+    void poll();
+    // The answer to the latest request, if it has arrived since the last call
+    bool takeResult(Result& result);
+
+    size_t gpuBytes() const;
+
+private:
+    // Read backs that can be in flight at once
+    static const int NumReadbacks = 3;
+
+    struct Readback {
+        GLuint buffer;
+        GLsync fence; // Null while the buffer is free
+        quint64 sequence;
+        glm::mat4 inverseRegionViewProjection;
+        qint64 requestTime;
+        quint64 requestFrame;
+    };
+
+    QOpenGLFunctions_3_3_Core* _gl;
+    GLuint _framebuffer;
+    GLuint _idTexture;
+    GLuint _depthBuffer;
+    GLint _previousDrawFramebuffer;
+    GLint _previousReadFramebuffer;
+    Readback _readbacks[NumReadbacks];
+    int _passReadback; // Readback written by the pass in progress, or -1
+
+    QElapsedTimer _clock;
+    quint64 _frame;
+    quint64 _sequence;
+
+    bool _hasRequest;
+    int _requestX;
+    int _requestY;
+    qint64 _requestTime;
+    quint64 _requestFrame;
+
+    bool _hasResult;
+    quint64 _resultSequence;
+    Result _result;
+
+    int freeReadback() const;
+    // Finds the id and position of the center pixel in the mapped ids and depths of a read back
+    Result decode(const Readback& readback, const uint32_t* ids, const float* depths) const;
+};
@@ -0,0 +1,170 @@
+#include "ImportStatistics.h"
+#include "Utils.h"
+
+#include "QDateTime"
+#include "QDir"
+#include "QFile"
+#include "QFileInfo"
+#include "QStandardPaths"
+#include "QStringList"
+#include "QTextStream"
+
+#include <algorithm>
+#include <mutex>
+
+namespace {
+
+// Imports on different threads append to the same log
+std::mutex logMutex;
+
+QString megabytes(size_t bytes) {
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 2) + " MB";
+}
+
+}
+
+ImportStatistics::WastedWork::WastedWork() :
+  duplicateTexturesSkipped(0),
+  meshesReconverted(0),
+  texturesFailed(0)
+{}
+
+ImportStatistics::ImportStatistics() :
+  _firstPixelMilliseconds(-1.0),
+  _bytesCopied(0)
+{}
+
+void ImportStatistics::clear() {
+    _fileName.clear();
+    _profile.clear();
+    _error.clear();
+    _stages.clear();
+    _firstPixelMilliseconds = -1.0;
+    _bytesCopied = 0;
+    _wasted = WastedWork();
+}
+
+void ImportStatistics::setFileName(const string& fileName) {
+    _fileName = fileName;
+}
+
+const string& ImportStatistics::getFileName() const {
+    return _fileName;
+}
+
+void ImportStatistics::setProfile(const string& profile) {
+    _profile = profile;
+}
+
+const string& ImportStatistics::getProfile() const {
+    return _profile;
+}
+
+void ImportStatistics::setError(const string& error) {
+    _error = error;
+}
+
+const string& ImportStatistics::getError() const {
+    return _error;
+}
+
+void ImportStatistics::addStage(const string& name, double milliseconds, size_t bytes, size_t count) {
+    auto it = std::find_if(_stages.begin(), _stages.end(), [&](const Stage& stage) {
+        return stage.name == name;
+    });
+
+    if(it == _stages.end()) {
+        Stage stage;
+        stage.name = name;
+        stage.milliseconds = 0.0;
+        stage.bytes = 0;
+        stage.count = 0;
+        _stages.push_back(stage);
+        it = _stages.end() - 1;
+    }
+
+    it->milliseconds += milliseconds;
+    it->bytes += bytes;
+    it->count += count;
+    it->peakResidentBytes = Utils::getPeakResidentBytes();
+}
+
+const vector<ImportStatistics::Stage>& ImportStatistics::getStages() const {
+    return _stages;
+}
+
+double ImportStatistics::getTotalMilliseconds() const {
+    double total = 0.0;
+    for(const Stage& stage : _stages)
+        total += stage.milliseconds;
+    return total;
+}
+
+void ImportStatistics::setFirstPixelMilliseconds(double milliseconds) {
+    _firstPixelMilliseconds = milliseconds;
+}
+
+double ImportStatistics::getFirstPixelMilliseconds() const {
+    return _firstPixelMilliseconds;
+}
+
+void ImportStatistics::addBytesCopied(size_t bytes) {
+    _bytesCopied += bytes;
+}
+
+size_t ImportStatistics::getBytesCopied() const {
+    return _bytesCopied;
+}
+
+ImportStatistics::WastedWork& ImportStatistics::wasted() {
+    return _wasted;
+}
+
+const ImportStatistics::WastedWork& ImportStatistics::wasted() const {
+    return _wasted;
+}
+
+QString ImportStatistics::toText() const {
+    QStringList lines;
+    lines << QString("%1  %2  [%3]  %4 ms%5")
+        .arg(QDateTime::currentDateTime().toString(Qt::ISODate))
+        .arg(_fileName.c_str())
+        .arg(_profile.c_str())
+        .arg(getTotalMilliseconds(), 0, 'f', 2)
+        .arg(_error.empty() ? QString() : QString("  FAILED: %1").arg(_error.c_str()));
+
+    for(const Stage& stage : _stages) {
+        QString line = QString("  %1 %2 ms").arg(stage.name.c_str(), -28).arg(stage.milliseconds, 10, 'f', 2);
+        if(stage.bytes > 0)
+            line += QString("  %1").arg(megabytes(stage.bytes), 12);
+        if(stage.count > 0)
+            line += QString("  x%1").arg(stage.count);
+        line += QString("  peak RSS %1").arg(megabytes(stage.peakResidentBytes));
+        lines << line;
+    }
+
+    lines << QString("  Geometry copied: %1").arg(megabytes(_bytesCopied));
+    lines << QString("  Wasted: %1 duplicate textures skipped, %2 meshes re-converted, %3 textures failed")
+        .arg(_wasted.duplicateTexturesSkipped)
+        .arg(_wasted.meshesReconverted)
+        .arg(_wasted.texturesFailed);
+    return lines.join('\n') + '\n';
+}
+
+bool ImportStatistics::appendToLog() const {
+    QString fileName = logFileName();
+    QDir().mkpath(QFileInfo(fileName).path());
+
+    std::lock_guard<std::mutex> lock(logMutex);
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+        return false;
+
+    QTextStream stream(&file);
+    stream << toText();
+    return stream.status() == QTextStream::Ok;
+}
+
+QString ImportStatistics::logFileName() {
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)).filePath("import.log");
+}
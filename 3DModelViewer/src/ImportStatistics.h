@@ -0,0 +1,76 @@
+#pragma once
+
+#include "QString"
+
+#include <vector>
+#include <string>
+
+using std::vector;
+using std::string;
+
+// Measurements of one model import, stage by stage, used to find out why a file is slow to open
+class ImportStatistics {
+
+public:
+    struct Stage {
+        string name;
+        double milliseconds;
+        size_t bytes;             // Data read or produced by the stage, 0 where it doesn't apply
+        size_t count;             // Items handled (files, vertices, meshes, textures), 0 where it doesn't apply
+        size_t peakResidentBytes; // Process memory high-water mark when the stage finished
+    };
+
+    // Work that was done but did not contribute to the result
+    struct WastedWork {
+        WastedWork();
+
+        int duplicateTexturesSkipped; // Texture references that resolved to an already loaded texture
+        int meshesReconverted;        // Meshes referenced by several nodes and converted again for each
+        int texturesFailed;           // Textures that were read but could not be decoded
+    };
+
+    ImportStatistics();
+
+    void clear();
+    void setFileName(const string& fileName);
+    const string& getFileName() const;
+    // Name of the import profile the file was loaded with
+    void setProfile(const string& profile);
+    const string& getProfile() const;
+    // Set when the import failed; the stages up to the failure are still recorded
+    void setError(const string& error);
+    const string& getError() const;
+
+    // Records a stage; a stage with the same name accumulates instead of being added twice
+    void addStage(const string& name, double milliseconds, size_t bytes = 0, size_t count = 0);
+    const vector<Stage>& getStages() const;
+    double getTotalMilliseconds() const;
+
+    // Time from the start of the load until the first frame showing any part of the model was
+    // drawn, measured by the viewer; negative when not measured
+    void setFirstPixelMilliseconds(double milliseconds);
+    double getFirstPixelMilliseconds() const;
+
+    // Bytes of geometry copied on the way from the file into gpu buffers, counting each time the
+    // same data is copied again (e.g. into mesh arrays, then into the driver)
+    void addBytesCopied(size_t bytes);
+    size_t getBytesCopied() const;
+
+    WastedWork& wasted();
+    const WastedWork& wasted() const;
+
+    // Human readable report, one line per stage
+    QString toText() const;
+    // Appends the report to the import log; safe to call from several threads
+    bool appendToLog() const;
+    static QString logFileName();
+
+private:
+    string _fileName;
+    string _profile;
+    string _error;
+    vector<Stage> _stages;
+    double _firstPixelMilliseconds;
+    size_t _bytesCopied;
+    WastedWork _wasted;
+};
@@ -0,0 +1,107 @@
+#include "MemoryTracker.h"
+
+#include <atomic>
+
+namespace {
+
+const char* categoryNames[MemoryTracker::NumCategories] = {
+    "vertexArrays",
+    "indexArrays",
+    "textureData",
+    "pickingData",
+    "glBuffers",
+    "glTextures"
+};
+
+// Accounts live on the GUI thread as well as on batch rendering workers
+std::atomic<size_t> globalBytes[MemoryTracker::NumCategories];
+
+QString megabytes(size_t bytes) {
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 1) + " MB";
+}
+
+}
+
+MemoryTracker::Usage::Usage() {
+    for(int c = 0; c < NumCategories; ++c)
+        bytes[c] = 0;
+}
+
+size_t MemoryTracker::Usage::systemBytes() const {
+    size_t total = 0;
+    for(int c = 0; c < NumCategories; ++c) {
+        if(!isGpuMemory(Category(c)))
+            total += bytes[c];
+    }
+    return total;
+}
+
+size_t MemoryTracker::Usage::gpuBytes() const {
+    return totalBytes() - systemBytes();
+}
+
+size_t MemoryTracker::Usage::totalBytes() const {
+    size_t total = 0;
+    for(int c = 0; c < NumCategories; ++c)
+        total += bytes[c];
+    return total;
+}
+
+MemoryTracker::Usage& MemoryTracker::Usage::operator+=(const Usage& other) {
+    for(int c = 0; c < NumCategories; ++c)
+        bytes[c] += other.bytes[c];
+    return *this;
+}
+
+MemoryTracker::Account::Account() {}
+
+MemoryTracker::Account::~Account() {
+    clear();
+}
+
+void MemoryTracker::Account::set(Category category, size_t bytes) {
+    // Unsigned wrap-around makes adding the difference correct in both directions
+    globalBytes[category] += bytes - _usage.bytes[category];
+    _usage.bytes[category] = bytes;
+}
+
+void MemoryTracker::Account::add(Category category, size_t bytes) {
+    set(category, _usage.bytes[category] + bytes);
+}
+
+void MemoryTracker::Account::clear() {
+    for(int c = 0; c < NumCategories; ++c)
+        set(Category(c), 0);
+}
+
+const MemoryTracker::Usage& MemoryTracker::Account::usage() const {
+    return _usage;
+}
+
+MemoryTracker::Usage MemoryTracker::globalUsage() {
+    Usage usage;
+    for(int c = 0; c < NumCategories; ++c)
+        usage.bytes[c] = globalBytes[c];
+    return usage;
+}
+
+const char* MemoryTracker::categoryName(Category category) {
+    return categoryNames[category];
+}
+
+bool MemoryTracker::isGpuMemory(Category category) {
+    return category == GLBuffers || category == GLTextures;
+}
+
+QJsonObject MemoryTracker::toJson(const Usage& usage) {
+    QJsonObject json;
+    for(int c = 0; c < NumCategories; ++c)
+        json[categoryNames[c]] = double(usage.bytes[c]);
+    json["systemBytes"] = double(usage.systemBytes());
+    json["gpuBytes"] = double(usage.gpuBytes());
+    return json;
+}
+
+QString MemoryTracker::toText(const Usage& usage) {
+    return QString("%1 RAM, %2 GPU").arg(megabytes(usage.systemBytes())).arg(megabytes(usage.gpuBytes()));
+}
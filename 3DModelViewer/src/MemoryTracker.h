@@ -0,0 +1,66 @@
+#pragma once
+
+#include "QJsonObject"
+#include "QString"
+
+#include <cstddef>
+
+// Accounts for the bytes held in system and GPU memory, by what they are used for. Each owner
+// (a model, a renderer) registers its memory through an Account; the accounts of a tab add up
+// to what that tab costs, and all accounts together to the global totals.
+class MemoryTracker {
+
+public:
+    enum Category {
+        VertexArrays,  // Mesh positions, normals, uvs and compact vertices in system memory
+        IndexArrays,   // Mesh indices of every level of detail in system memory
+        TextureData,   // Decoded pixels still held by DevIL (Texture::data)
+        PickingData,   // Ray picking hierarchies and their copies of the triangles
+        GLBuffers,     // Vertex, index and uniform buffers
+        GLTextures,
+        NumCategories
+    };
+
+    struct Usage {
+        Usage();
+
+        size_t bytes[NumCategories];
+
+        size_t systemBytes() const;
+        size_t gpuBytes() const;
+        size_t totalBytes() const;
+        Usage& operator+=(const Usage& other);
+    };
+
+    // Memory registered by one owner. Changes are mirrored into the global totals, and whatever is
+    // still registered when the account is destroyed is removed from them.
+    class Account {
+    public:
+        Account();
+        ~Account();
+
+        void set(Category category, size_t bytes);
+        void add(Category category, size_t bytes);
+        void clear();
+        const Usage& usage() const;
+
+    private:
+        Account(const Account&);
+        Account& operator=(const Account&);
+
+        Usage _usage;
+    };
+
+    // Sum of every live account; safe to call from any thread
+    static Usage globalUsage();
+
+    static const char* categoryName(Category category);
+    static bool isGpuMemory(Category category);
+    static QJsonObject toJson(const Usage& usage);
+    // Short summary such as "120.5 MB RAM, 64.0 MB GPU"
+    static QString toText(const Usage& usage);
+
+private:
+    MemoryTracker();
+    ~MemoryTracker();
+};
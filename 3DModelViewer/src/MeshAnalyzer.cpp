@@ -0,0 +1,563 @@
+#include "MeshAnalyzer.h"
+#include "ModelCache.h"
+#include "Utils.h"
+
+#include "QDebug"
+#include "QElapsedTimer"
+#include "QJsonArray"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+// Meshes with fewer triangles are analyzed on one thread, next to other small meshes
+const size_t ParallelTriangles = 1 << 16;
+// The per-vertex and per-triangle passes are split into chunks of this many
+const size_t ChunkSize = 1 << 16;
+
+uint64_t mix(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+// The partition of a hash; its high bits, since the maps pick their buckets from the low ones
+size_t partitionOf(uint64_t hash, size_t numPartitions) {
+    return size_t((hash >> 32) % numPartitions);
+}
+
+// Calls task(begin, end) for consecutive chunks of [0, count), on every thread if parallel is set
+void forChunks(size_t count, bool parallel, const std::function<void(size_t, size_t, size_t)>& task) {
+    const size_t numChunks = (count + ChunkSize - 1) / ChunkSize;
+    auto chunkTask = [&](size_t chunk) {
+        task(chunk, chunk * ChunkSize, std::min(count, (chunk + 1) * ChunkSize));
+    };
+    if(parallel) {
+        Utils::parallelFor(numChunks, chunkTask);
+    }
+    else {
+        for(size_t chunk = 0; chunk < numChunks; ++chunk)
+            chunkTask(chunk);
+    }
+}
+
+// The bits of a position, so -0 and +0 are the only different floats that match
+struct PositionKey {
+    uint32_t x;
+    uint32_t y;
+    uint32_t z;
+
+    bool operator==(const PositionKey& other) const {
+        return x == other.x && y == other.y && z == other.z;
+    }
+};
+
+PositionKey positionKey(const glm::vec3& position) {
+    PositionKey key;
+    glm::vec3 value = position + glm::vec3(0.0f);
+    memcpy(&key.x, &value.x, sizeof(uint32_t));
+    memcpy(&key.y, &value.y, sizeof(uint32_t));
+    memcpy(&key.z, &value.z, sizeof(uint32_t));
+    return key;
+}
+
+uint64_t positionHash(const PositionKey& key) {
+    return mix((uint64_t(key.x) << 32 | key.y) ^ mix(key.z));
+}
+
+// The position ids of a triangle's corners in ascending order
+struct TriangleKey {
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+
+    // Two corners at the same position
+    bool isCollapsed() const {
+        return a == b || b == c;
+    }
+
+    bool operator==(const TriangleKey& other) const {
+        return a == other.a && b == other.b && c == other.c;
+    }
+};
+
+uint64_t triangleHash(const TriangleKey& key) {
+    return mix((uint64_t(key.a) << 32 | key.b) ^ mix(key.c));
+}
+
+// An edge between two position ids, the lower one in the high bits
+uint64_t edgeKey(uint32_t a, uint32_t b) {
+    return uint64_t(a) << 32 | b;
+}
+
+size_t tableCapacity(size_t entries) {
+    size_t capacity = 16;
+    while(capacity < 2 * entries)
+        capacity *= 2;
+    return capacity;
+}
+
+// Open addressing hash set of vertex or triangle indices, compared by the keys they index, so
+// every entry is a single integer. hash(index) gives the hash of an index's key. Sized for an
+// estimate of the number of entries and doubled whenever it gets over half full.
+template<typename Hash>
+class IndexTable {
+
+public:
+    IndexTable(size_t entries, Hash hash) :
+      _slots(tableCapacity(entries), uint32_t(Empty)),
+      _size(0),
+      _hash(hash)
+    {}
+
+    // The first index inserted with a key equal to that of index, which is inserted if there is none
+    template<typename Equal>
+    uint32_t insert(uint32_t index, Equal equal) {
+        const size_t mask = _slots.size() - 1;
+        for(size_t slot = size_t(_hash(index)) & mask;; slot = (slot + 1) & mask) {
+            if(_slots[slot] == Empty) {
+                _slots[slot] = index;
+                if(++_size * 2 > _slots.size())
+                    grow();
+                return index;
+            }
+            if(equal(_slots[slot]))
+                return _slots[slot];
+        }
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    static const uint32_t Empty = ~uint32_t(0);
+
+    vector<uint32_t> _slots;
+    size_t _size;
+    Hash _hash;
+
+    void grow() {
+        vector<uint32_t> slots(2 * _slots.size(), uint32_t(Empty));
+        const size_t mask = slots.size() - 1;
+        for(uint32_t index : _slots) {
+            if(index == Empty)
+                continue;
+            size_t slot = size_t(_hash(index)) & mask;
+            while(slots[slot] != Empty)
+                slot = (slot + 1) & mask;
+            slots[slot] = index;
+        }
+        _slots.swap(slots);
+    }
+};
+
+template<typename Hash>
+IndexTable<Hash> makeIndexTable(size_t entries, Hash hash) {
+    return IndexTable<Hash>(entries, hash);
+}
+
+// Open addressing hash map from edges to the number of triangles using them. Sized for an
+// estimate of the number of edges and doubled whenever it gets over half full.
+class EdgeTable {
+
+public:
+    EdgeTable(size_t entries) :
+      _edges(tableCapacity(entries), uint64_t(Empty)),
+      _triangles(_edges.size(), 0),
+      _size(0)
+    {}
+
+    void add(uint64_t edge) {
+        const size_t slot = find(_edges, edge);
+        if(_edges[slot] == Empty) {
+            if((_size + 1) * 2 > _edges.size()) {
+                grow();
+                add(edge);
+                return;
+            }
+            _edges[slot] = edge;
+            ++_size;
+        }
+        ++_triangles[slot];
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    // Calls visit(edge, triangles) for every edge
+    template<typename Visit>
+    void forEach(Visit visit) const {
+        for(size_t slot = 0; slot < _edges.size(); ++slot) {
+            if(_edges[slot] != Empty)
+                visit(_edges[slot], _triangles[slot]);
+        }
+    }
+
+private:
+    // Not a valid edge, whose ends are always different
+    static const uint64_t Empty = ~uint64_t(0);
+
+    vector<uint64_t> _edges;
+    vector<uint32_t> _triangles;
+    size_t _size;
+
+    // The slot holding edge, or the empty slot it would go in
+    static size_t find(const vector<uint64_t>& edges, uint64_t edge) {
+        const size_t mask = edges.size() - 1;
+        size_t slot = size_t(mix(edge)) & mask;
+        while(edges[slot] != edge && edges[slot] != Empty)
+            slot = (slot + 1) & mask;
+        return slot;
+    }
+
+    void grow() {
+        vector<uint64_t> edges(2 * _edges.size(), uint64_t(Empty));
+        vector<uint32_t> triangles(edges.size(), 0);
+        for(size_t slot = 0; slot < _edges.size(); ++slot) {
+            if(_edges[slot] == Empty)
+                continue;
+            const size_t newSlot = find(edges, _edges[slot]);
+            edges[newSlot] = _edges[slot];
+            triangles[newSlot] = _triangles[slot];
+        }
+        _edges.swap(edges);
+        _triangles.swap(triangles);
+    }
+};
+
+// What each chunk of triangles adds up
+struct TriangleSums {
+    TriangleSums() : area(0.0), volume(0.0), degenerate(0) {}
+
+    double area;
+    double volume;
+    size_t degenerate;
+};
+
+// What each partition of the hash maps counts
+struct PartitionCounts {
+    PartitionCounts() : uniqueVertices(0), duplicateTriangles(0), edges(0), nonManifoldEdges(0) {}
+
+    size_t uniqueVertices;
+    size_t duplicateTriangles;
+    size_t edges;
+    size_t nonManifoldEdges;
+    vector<uint64_t> boundaryEdges;
+};
+
+// Boundary edges meeting at a position belong to the same loop, so the loops are the connected
+// components of the boundary edges
+size_t countLoops(const vector<uint64_t>& boundaryEdges) {
+    std::unordered_map<uint32_t, uint32_t> parents;
+    auto find = [&](uint32_t id) {
+        uint32_t root = parents.emplace(id, id).first->second;
+        while(parents[root] != root)
+            root = parents[root];
+        parents[id] = root;
+        return root;
+    };
+
+    size_t merges = 0;
+    for(uint64_t edge : boundaryEdges) {
+        uint32_t a = find(uint32_t(edge >> 32));
+        uint32_t b = find(uint32_t(edge));
+        if(a != b) {
+            parents[a] = b;
+            ++merges;
+        }
+    }
+    return parents.size() - merges;
+}
+
+void addTo(MeshAnalyzer::MeshReport& total, const MeshAnalyzer::MeshReport& mesh) {
+    total.triangles += mesh.triangles;
+    total.vertices += mesh.vertices;
+    total.uniqueVertices += mesh.uniqueVertices;
+    total.degenerateTriangles += mesh.degenerateTriangles;
+    total.duplicateTriangles += mesh.duplicateTriangles;
+    total.edges += mesh.edges;
+    total.boundaryEdges += mesh.boundaryEdges;
+    total.boundaryLoops += mesh.boundaryLoops;
+    total.nonManifoldEdges += mesh.nonManifoldEdges;
+    total.surfaceArea += mesh.surfaceArea;
+    total.volume += mesh.volume;
+}
+
+QJsonObject meshToJson(const MeshAnalyzer::MeshReport& mesh) {
+    QJsonObject json;
+    json["name"] = QString::fromStdString(mesh.name);
+    json["analyzed"] = mesh.analyzed;
+    json["triangles"] = double(mesh.triangles);
+    json["vertices"] = double(mesh.vertices);
+    if(!mesh.analyzed)
+        return json;
+
+    json["uniqueVertices"] = double(mesh.uniqueVertices);
+    json["degenerateTriangles"] = double(mesh.degenerateTriangles);
+    json["duplicateTriangles"] = double(mesh.duplicateTriangles);
+    json["edges"] = double(mesh.edges);
+    json["boundaryEdges"] = double(mesh.boundaryEdges);
+    json["boundaryLoops"] = double(mesh.boundaryLoops);
+    json["nonManifoldEdges"] = double(mesh.nonManifoldEdges);
+    json["closed"] = mesh.isClosed();
+    json["surfaceArea"] = mesh.surfaceArea;
+    json["volume"] = mesh.volume;
+    return json;
+}
+
+}
+
+MeshAnalyzer::MeshReport::MeshReport() :
+  analyzed(false),
+  triangles(0),
+  vertices(0),
+  uniqueVertices(0),
+  degenerateTriangles(0),
+  duplicateTriangles(0),
+  edges(0),
+  boundaryEdges(0),
+  boundaryLoops(0),
+  nonManifoldEdges(0),
+  surfaceArea(0.0),
+  volume(0.0)
+{}
+
+bool MeshAnalyzer::MeshReport::isClosed() const {
+    return boundaryEdges == 0 && nonManifoldEdges == 0;
+}
+
+MeshAnalyzer::Report::Report() :
+  milliseconds(0.0),
+  cancelled(false)
+{
+    total.analyzed = true;
+}
+
+MeshAnalyzer::Report MeshAnalyzer::analyze(const Model& model, const std::atomic<bool>* cancelled) {
+    QElapsedTimer timer;
+    timer.start();
+
+    const vector<Model::Mesh>& meshes = model.getMeshes();
+
+    // Meshes loaded from the cache only have their geometry on the gpu, so it is read from the cache again
+    ModelCache cache;
+    bool cacheOpen = false;
+    if(std::any_of(meshes.begin(), meshes.end(), [](const Model::Mesh& mesh) { return mesh.uploaded; })) {
+        vector<Model::Mesh> cachedMeshes;
+        vector<string> textures;
+        vector<int> meshTextures, meshNormalTextures;
+        string error;
+        cacheOpen = cache.open(model.getFileName(), model.getImportOptions(), cachedMeshes, textures, meshTextures, meshNormalTextures, error)
+                 && cachedMeshes.size() == meshes.size();
+        if(!cacheOpen)
+            qWarning() << "Meshes of" << model.getFileName().c_str() << "that were read from the cache can't be analyzed:" << error.c_str();
+    }
+
+    Report report;
+    report.meshes.resize(meshes.size());
+
+    // Small meshes are analyzed one per thread, large ones one after another over every thread
+    vector<size_t> small;
+    vector<size_t> large;
+    for(size_t i = 0; i < meshes.size(); ++i) {
+        const Model::Mesh& mesh = meshes[i];
+        MeshReport& meshReport = report.meshes[i];
+        meshReport.name = mesh.name;
+        meshReport.triangles = size_t(mesh.numFaces);
+        meshReport.vertices = size_t(mesh.numVertices);
+        if(mesh.lods.empty() || (mesh.uploaded && !cacheOpen))
+            continue;
+        if(size_t(mesh.lods[0].indexCount / 3) < ParallelTriangles)
+            small.push_back(i);
+        else
+            large.push_back(i);
+    }
+
+    auto analyzeMesh = [&](size_t index) {
+        if(cancelled && *cancelled)
+            return;
+
+        const Model::Mesh& mesh = meshes[index];
+        const Model::Lod& lod = mesh.lods[0];
+        const vector<glm::vec3>* positions = &mesh.vertices;
+        const unsigned int* indices = mesh.indices.data();
+        vector<glm::vec3> cachedPositions;
+        if(mesh.uploaded) {
+            const ModelCache::Geometry& geometry = cache.geometry(index);
+            if(size_t(lod.indexOffset + lod.indexCount) * sizeof(unsigned int) > geometry.indices.bytes)
+                return;
+            cache.readPositions(index, cachedPositions);
+            positions = &cachedPositions;
+            indices = reinterpret_cast<const unsigned int*>(geometry.indices.data);
+        }
+
+        MeshReport meshReport = analyze(*positions, indices + lod.indexOffset, size_t(lod.indexCount));
+        meshReport.name = mesh.name;
+        report.meshes[index] = meshReport;
+    };
+    Utils::parallelFor(small.size(), [&](size_t i) {
+        analyzeMesh(small[i]);
+    });
+    for(size_t index : large)
+        analyzeMesh(index);
+    cache.close();
+
+    report.cancelled = cancelled && *cancelled;
+    for(const MeshReport& mesh : report.meshes) {
+        if(mesh.analyzed)
+            addTo(report.total, mesh);
+    }
+    report.milliseconds = timer.nsecsElapsed() / 1e6;
+    return report;
+}
+
+MeshAnalyzer::MeshReport MeshAnalyzer::analyze(const vector<glm::vec3>& vertices, const unsigned int* indices, size_t count) {
+    MeshReport report;
+    report.analyzed = true;
+    report.vertices = vertices.size();
+    const size_t numVertices = vertices.size();
+    const size_t numTriangles = count / 3;
+    report.triangles = numTriangles;
+
+    const bool parallel = numTriangles >= ParallelTriangles;
+    const size_t numPartitions = parallel ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    vector<PartitionCounts> partitions(numPartitions);
+
+    // Each position gets the id of its lowest vertex. Every partition scans all vertices, keeping
+    // those whose hash falls in it, so each table is only touched by one thread.
+    vector<PositionKey> positions(numVertices);
+    vector<uint64_t> positionHashes(numVertices);
+    forChunks(numVertices, parallel, [&](size_t, size_t begin, size_t end) {
+        for(size_t v = begin; v < end; ++v) {
+            positions[v] = positionKey(vertices[v]);
+            positionHashes[v] = positionHash(positions[v]);
+        }
+    });
+    vector<uint32_t> ids(numVertices);
+    Utils::parallelFor(numPartitions, [&](size_t p) {
+        auto lowest = makeIndexTable(numVertices / numPartitions + 1, [&](uint32_t v) {
+            return positionHashes[v];
+        });
+        for(size_t v = 0; v < numVertices; ++v) {
+            if(numPartitions > 1 && partitionOf(positionHashes[v], numPartitions) != p)
+                continue;
+            const PositionKey& key = positions[v];
+            ids[v] = lowest.insert(uint32_t(v), [&](uint32_t other) {
+                return positions[other] == key;
+            });
+        }
+        partitions[p].uniqueVertices = lowest.size();
+    });
+    vector<PositionKey>().swap(positions);
+    vector<uint64_t>().swap(positionHashes);
+
+    // Area, volume and degeneracy of every triangle, and its corners in position order
+    vector<TriangleKey> triangles(numTriangles);
+    vector<TriangleSums> sums((numTriangles + ChunkSize - 1) / ChunkSize);
+    forChunks(numTriangles, parallel, [&](size_t chunk, size_t begin, size_t end) {
+        TriangleSums& chunkSums = sums[chunk];
+        for(size_t t = begin; t < end; ++t) {
+            TriangleKey& key = triangles[t];
+            if(indices[3 * t] >= numVertices || indices[3 * t + 1] >= numVertices || indices[3 * t + 2] >= numVertices) {
+                key.a = key.b = key.c = 0;
+                ++chunkSums.degenerate;
+                continue;
+            }
+
+            const glm::dvec3 a(vertices[indices[3 * t]]);
+            const glm::dvec3 b(vertices[indices[3 * t + 1]]);
+            const glm::dvec3 c(vertices[indices[3 * t + 2]]);
+            const glm::dvec3 normal = glm::cross(b - a, c - a);
+            const double area = 0.5 * glm::length(normal);
+            chunkSums.area += area;
+            // The tetrahedra from the origin to each triangle add up to the enclosed volume
+            chunkSums.volume += glm::dot(a, glm::cross(b, c)) / 6.0;
+
+            uint32_t corners[] = { ids[indices[3 * t]], ids[indices[3 * t + 1]], ids[indices[3 * t + 2]] };
+            std::sort(corners, corners + 3);
+            key.a = corners[0];
+            key.b = corners[1];
+            key.c = corners[2];
+            if(area == 0.0 || key.isCollapsed())
+                ++chunkSums.degenerate;
+        }
+    });
+    for(const TriangleSums& chunkSums : sums) {
+        report.surfaceArea += chunkSums.area;
+        report.volume += chunkSums.volume;
+        report.degenerateTriangles += chunkSums.degenerate;
+    }
+
+    // Duplicate triangles and the number of triangles on every edge, partitioned like the positions.
+    // Closed meshes have about one and a half edges per triangle, but open meshes and unwelded
+    // triangle soups have up to three, and partitions aren't evenly filled, so the tables grow.
+    Utils::parallelFor(numPartitions, [&](size_t p) {
+        PartitionCounts& counts = partitions[p];
+        auto seen = makeIndexTable(numTriangles / numPartitions + 1, [&](uint32_t t) {
+            return triangleHash(triangles[t]);
+        });
+        EdgeTable edgeTriangles(3 * numTriangles / (2 * numPartitions) + 1);
+
+        for(size_t t = 0; t < numTriangles; ++t) {
+            const TriangleKey& key = triangles[t];
+            if(key.isCollapsed())
+                continue;
+            const uint64_t hash = triangleHash(key);
+            if(numPartitions == 1 || partitionOf(hash, numPartitions) == p) {
+                uint32_t first = seen.insert(uint32_t(t), [&](uint32_t other) {
+                    return triangles[other] == key;
+                });
+                if(first != t)
+                    ++counts.duplicateTriangles;
+            }
+            const uint64_t edges[] = { edgeKey(key.a, key.b), edgeKey(key.b, key.c), edgeKey(key.a, key.c) };
+            for(uint64_t edge : edges) {
+                if(numPartitions == 1 || partitionOf(mix(edge), numPartitions) == p)
+                    edgeTriangles.add(edge);
+            }
+        }
+
+        counts.edges = edgeTriangles.size();
+        edgeTriangles.forEach([&](uint64_t edge, uint32_t triangles) {
+            if(triangles == 1)
+                counts.boundaryEdges.push_back(edge);
+            else if(triangles > 2)
+                ++counts.nonManifoldEdges;
+        });
+    });
+
+    vector<uint64_t> boundaryEdges;
+    for(const PartitionCounts& counts : partitions) {
+        report.uniqueVertices += counts.uniqueVertices;
+        report.duplicateTriangles += counts.duplicateTriangles;
+        report.edges += counts.edges;
+        report.nonManifoldEdges += counts.nonManifoldEdges;
+        boundaryEdges.insert(boundaryEdges.end(), counts.boundaryEdges.begin(), counts.boundaryEdges.end());
+    }
+    report.boundaryEdges = boundaryEdges.size();
+    report.boundaryLoops = countLoops(boundaryEdges);
+    return report;
+}
+
+QJsonObject MeshAnalyzer::toJson(const Report& report) {
+    QJsonArray meshes;
+    for(const MeshReport& mesh : report.meshes)
+        meshes.append(meshToJson(mesh));
+
+    QJsonObject json;
+    json["milliseconds"] = report.milliseconds;
+    json["cancelled"] = report.cancelled;
+    json["meshes"] = meshes;
+    json["total"] = meshToJson(report.total);
+    return json;
+}
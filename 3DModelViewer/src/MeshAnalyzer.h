@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Model.h"
+
+#include "QJsonObject"
+
+#include <atomic>
+#include <vector>
+#include <string>
+
+using std::vector;
+using std::string;
+
+// Counts and validates the geometry of loaded meshes: unique positions, degenerate and duplicate
+// triangles, boundary and non-manifold edges, surface area and volume. Corners are matched by
+// position, so seams where vertices were split for normals or uvs don't open the surface. Large
+// meshes are split over the hardware threads by partitioning the hashes of their positions,
+// triangles and edges, each partition filling its own hash tables; small meshes run one per thread.
+class MeshAnalyzer {
+
+public:
+    // Findings for the full resolution level of one mesh
+    struct MeshReport {
+        MeshReport();
+
+        string name;
+        bool analyzed; // False when the mesh's geometry couldn't be read, or the analysis was cancelled
+        size_t triangles;
+        size_t vertices;
+        size_t uniqueVertices;      // Distinct positions
+        // Zero area, or indices past the vertices. Those with two corners at one position or invalid
+        // indices are left out of the checks below.
+        size_t degenerateTriangles;
+        size_t duplicateTriangles;  // Same three positions as another triangle, in any order; counted once per extra copy
+        size_t edges;               // Unique edges between positions
+        size_t boundaryEdges;       // Edges of a single triangle
+        size_t boundaryLoops;       // Connected runs of boundary edges, i.e. holes and open borders
+        size_t nonManifoldEdges;    // Edges shared by more than two triangles
+        double surfaceArea;
+        // Signed volume enclosed by the triangles; only meaningful when the mesh is closed and its
+        // triangles are consistently wound, and negative when they are wound inwards
+        double volume;
+
+        // No boundary or non-manifold edges
+        bool isClosed() const;
+    };
+
+    struct Report {
+        Report();
+
+        vector<MeshReport> meshes;
+        // Sums over the analyzed meshes; name is empty and analyzed is set
+        MeshReport total;
+        double milliseconds;
+        bool cancelled;
+    };
+
+    // Analyzes the full resolution level of every mesh of model. Only reads the model, so it can
+    // run on any thread while the model is drawn. Meshes read from the cache are read from it again.
+    // Stops before the next mesh, leaving the report's cancelled set, once cancelled is set.
+    static Report analyze(const Model& model, const std::atomic<bool>* cancelled = nullptr);
+    // Analyzes the count indices of triangles at indices
+    static MeshReport analyze(const vector<glm::vec3>& vertices, const unsigned int* indices, size_t count);
+
+    static QJsonObject toJson(const Report& report);
+
+private:
+    MeshAnalyzer();
+    ~MeshAnalyzer();
+};
@@ -0,0 +1,177 @@
+#include "MeshBounds.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHBOUNDS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Arrays are split into chunks of this many vertices, so one large mesh still uses every thread
+const size_t ChunkVertices = 1 << 18;
+
+#ifdef MESHBOUNDS_SSE2
+float lane(__m128 v, int i) {
+    float values[4];
+    _mm_storeu_ps(values, v);
+    return values[i];
+}
+#endif
+
+}
+
+MeshBounds::Box::Box() :
+  min(FLT_MAX),
+  max(-FLT_MAX)
+{}
+
+bool MeshBounds::Box::isEmpty() const {
+    return min.x > max.x;
+}
+
+glm::vec3 MeshBounds::Box::center() const {
+    return isEmpty() ? glm::vec3(0.0f) : 0.5f * (min + max);
+}
+
+void MeshBounds::Box::extend(const Box& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+MeshBounds::Sphere::Sphere() :
+  center(0.0f),
+  radius(0.0f)
+{}
+
+MeshBounds::MeshBounds() {}
+
+MeshBounds::~MeshBounds() {}
+
+MeshBounds::Box MeshBounds::box(const glm::vec3* positions, size_t count) {
+    Box result;
+    size_t i = 0;
+
+#ifdef MESHBOUNDS_SSE2
+    // Four packed vertices are three registers: (x0 y0 z0 x1) (y1 z1 x2 y2) (z2 x3 y3 z3). Taking
+    // the minimum and maximum of each register separately keeps every lane on the same axis,
+    // so the axes only need to be gathered from the lanes once at the end.
+    if(count >= 4) {
+        const float* p = &positions[0].x;
+        __m128 min0 = _mm_loadu_ps(p), min1 = _mm_loadu_ps(p + 4), min2 = _mm_loadu_ps(p + 8);
+        __m128 max0 = min0, max1 = min1, max2 = min2;
+        for(i = 4; i + 4 <= count; i += 4) {
+            const float* q = p + 3 * i;
+            __m128 v0 = _mm_loadu_ps(q), v1 = _mm_loadu_ps(q + 4), v2 = _mm_loadu_ps(q + 8);
+            min0 = _mm_min_ps(min0, v0);
+            min1 = _mm_min_ps(min1, v1);
+            min2 = _mm_min_ps(min2, v2);
+            max0 = _mm_max_ps(max0, v0);
+            max1 = _mm_max_ps(max1, v1);
+            max2 = _mm_max_ps(max2, v2);
+        }
+
+        result.min = glm::vec3(
+            std::min(std::min(lane(min0, 0), lane(min0, 3)), std::min(lane(min1, 2), lane(min2, 1))),
+            std::min(std::min(lane(min0, 1), lane(min1, 0)), std::min(lane(min1, 3), lane(min2, 2))),
+            std::min(std::min(lane(min0, 2), lane(min1, 1)), std::min(lane(min2, 0), lane(min2, 3)))
+        );
+        result.max = glm::vec3(
+            std::max(std::max(lane(max0, 0), lane(max0, 3)), std::max(lane(max1, 2), lane(max2, 1))),
+            std::max(std::max(lane(max0, 1), lane(max1, 0)), std::max(lane(max1, 3), lane(max2, 2))),
+            std::max(std::max(lane(max0, 2), lane(max1, 1)), std::max(lane(max2, 0), lane(max2, 3)))
+        );
+    }
+#endif
+
+    for(; i < count; ++i) {
+        result.min = glm::min(result.min, positions[i]);
+        result.max = glm::max(result.max, positions[i]);
+    }
+    return result;
+}
+
+float MeshBounds::radius(const glm::vec3* positions, size_t count, const glm::vec3& center) {
+    float maxDistance2 = 0.0f;
+    size_t i = 0;
+
+#ifdef MESHBOUNDS_SSE2
+    // Transpose four packed vertices into one register per axis to get four squared distances at once
+    const float* p = &positions[0].x;
+    __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    __m128 maxDistances = _mm_setzero_ps();
+    for(; i + 4 <= count; i += 4) {
+        const float* q = p + 3 * i;
+        __m128 v0 = _mm_loadu_ps(q), v1 = _mm_loadu_ps(q + 4), v2 = _mm_loadu_ps(q + 8);
+
+        __m128 x = _mm_shuffle_ps(v0, _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+        __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(0, 0, 1, 1)),
+                                  _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 1, 2, 2)), v2, _MM_SHUFFLE(3, 0, 2, 0));
+
+        __m128 dx = _mm_sub_ps(x, cx), dy = _mm_sub_ps(y, cy), dz = _mm_sub_ps(z, cz);
+        __m128 distances = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        maxDistances = _mm_max_ps(maxDistances, distances);
+    }
+    maxDistance2 = std::max(std::max(lane(maxDistances, 0), lane(maxDistances, 1)),
+                            std::max(lane(maxDistances, 2), lane(maxDistances, 3)));
+#endif
+
+    for(; i < count; ++i) {
+        glm::vec3 d = positions[i] - center;
+        maxDistance2 = std::max(maxDistance2, glm::dot(d, d));
+    }
+    return std::sqrt(maxDistance2);
+}
+
+void MeshBounds::compute(const vector<const vector<glm::vec3>*>& arrays, vector<Box>& boxes, vector<Sphere>& spheres) {
+    struct Chunk {
+        size_t array;
+        size_t begin;
+        size_t end;
+    };
+    vector<Chunk> chunks;
+    for(size_t i = 0; i < arrays.size(); ++i) {
+        size_t size = arrays[i]->size();
+        for(size_t begin = 0; begin < size; begin += ChunkVertices) {
+            Chunk chunk = { i, begin, std::min(size, begin + ChunkVertices) };
+            chunks.push_back(chunk);
+        }
+    }
+
+    // First the boxes, reduced from their chunks
+    vector<Box> chunkBoxes(chunks.size());
+    Utils::parallelFor(chunks.size(), [&](size_t i) {
+        const Chunk& chunk = chunks[i];
+        chunkBoxes[i] = box(arrays[chunk.array]->data() + chunk.begin, chunk.end - chunk.begin);
+    });
+
+    boxes.assign(arrays.size(), Box());
+    for(size_t i = 0; i < chunks.size(); ++i)
+        boxes[chunks[i].array].extend(chunkBoxes[i]);
+
+    // Then the spheres around the box centers, which need the finished boxes
+    vector<float> chunkRadii(chunks.size());
+    Utils::parallelFor(chunks.size(), [&](size_t i) {
+        const Chunk& chunk = chunks[i];
+        chunkRadii[i] = radius(arrays[chunk.array]->data() + chunk.begin, chunk.end - chunk.begin, boxes[chunk.array].center());
+    });
+
+    spheres.assign(arrays.size(), Sphere());
+    for(size_t i = 0; i < arrays.size(); ++i)
+        spheres[i].center = boxes[i].center();
+    for(size_t i = 0; i < chunks.size(); ++i)
+        spheres[chunks[i].array].radius = std::max(spheres[chunks[i].array].radius, chunkRadii[i]);
+}
+
+bool MeshBounds::usesSimd() {
+#ifdef MESHBOUNDS_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
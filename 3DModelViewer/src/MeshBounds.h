@@ -0,0 +1,47 @@
+#pragma once
+
+#include "glm.hpp"
+#include <vector>
+
+using std::vector;
+
+// Exact axis aligned bounding boxes and bounding spheres of vertex positions. Positions are read
+// four at a time with SSE where available, and large arrays are split into chunks that are
+// processed in parallel and then reduced.
+class MeshBounds {
+
+public:
+    struct Box {
+        // An empty box, which any point or box extends
+        Box();
+
+        glm::vec3 min;
+        glm::vec3 max;
+
+        bool isEmpty() const;
+        glm::vec3 center() const;
+        void extend(const Box& other);
+    };
+
+    // Encloses every position; centered on the box, with the distance to the farthest position as radius
+    struct Sphere {
+        Sphere();
+
+        glm::vec3 center;
+        float radius;
+    };
+
+    static Box box(const glm::vec3* positions, size_t count);
+    // Largest distance between center and any of positions
+    static float radius(const glm::vec3* positions, size_t count, const glm::vec3& center);
+
+    // Box and sphere of every array in arrays, spread across the available hardware threads
+    static void compute(const vector<const vector<glm::vec3>*>& arrays, vector<Box>& boxes, vector<Sphere>& spheres);
+
+    // Whether box and radius use SSE in this build
+    static bool usesSimd();
+
+private:
+    MeshBounds();
+    ~MeshBounds();
+};
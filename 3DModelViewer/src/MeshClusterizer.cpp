@@ -0,0 +1,101 @@
+#include "MeshClusterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+MeshClusterizer::MeshClusterizer() {}
+
+MeshClusterizer::~MeshClusterizer() {}
+
+vector<MeshClusterizer::Cluster> MeshClusterizer::build(const vector<unsigned int>& indices,
+                                                        int indexOffset,
+                                                        int indexCount,
+                                                        const vector<glm::vec3>& positions) {
+    vector<Cluster> clusters;
+    std::unordered_set<unsigned int> clusterVertices;
+    int clusterStart = indexOffset;
+
+    for(int i = indexOffset; i < indexOffset + indexCount; i += 3) {
+        // Count how many new vertices this triangle would add to the current cluster
+        unsigned int newVertices = 0;
+        for(int k = 0; k < 3; ++k) {
+            if(clusterVertices.count(indices[i + k]) == 0)
+                ++newVertices;
+        }
+
+        int clusterTriangles = (i - clusterStart) / 3;
+        if(clusterVertices.size() + newVertices > MaxVertices || clusterTriangles + 1 > int(MaxTriangles)) {
+            clusters.push_back(computeBounds(indices, clusterStart, i - clusterStart, positions));
+            clusterVertices.clear();
+            clusterStart = i;
+        }
+
+        for(int k = 0; k < 3; ++k)
+            clusterVertices.insert(indices[i + k]);
+    }
+
+    if(clusterStart < indexOffset + indexCount)
+        clusters.push_back(computeBounds(indices, clusterStart, indexOffset + indexCount - clusterStart, positions));
+
+    return clusters;
+}
+
+MeshClusterizer::Cluster MeshClusterizer::computeBounds(const vector<unsigned int>& indices,
+                                                        int indexOffset,
+                                                        int indexCount,
+                                                        const vector<glm::vec3>& positions) {
+    Cluster cluster;
+    cluster.indexOffset = indexOffset;
+    cluster.indexCount = indexCount;
+    cluster.edgeOffset = cluster.edgeCount = 0;
+
+    // Sphere around the center of the bounding box
+    glm::vec3 minPos = positions[indices[indexOffset]];
+    glm::vec3 maxPos = minPos;
+    for(int i = indexOffset; i < indexOffset + indexCount; ++i) {
+        minPos = glm::min(minPos, positions[indices[i]]);
+        maxPos = glm::max(maxPos, positions[indices[i]]);
+    }
+    cluster.center = 0.5f * (minPos + maxPos);
+    cluster.radius = 0.0f;
+    for(int i = indexOffset; i < indexOffset + indexCount; ++i)
+        cluster.radius = std::max(cluster.radius, glm::distance(cluster.center, positions[indices[i]]));
+
+    // Cone axis is the average triangle normal; its spread is the largest deviation from it
+    vector<glm::vec3> normals;
+    glm::vec3 axis(0.0f);
+    for(int i = indexOffset; i < indexOffset + indexCount; i += 3) {
+        const glm::vec3& a = positions[indices[i]];
+        const glm::vec3& b = positions[indices[i + 1]];
+        const glm::vec3& c = positions[indices[i + 2]];
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if(length <= 0.0f)
+            continue;
+        normals.push_back(normal / length);
+        axis += normals.back();
+    }
+
+    cluster.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    cluster.coneCutoff = 1.0f;
+    float axisLength = glm::length(axis);
+    if(normals.empty() || axisLength <= 0.0f)
+        return cluster;
+    cluster.coneAxis = axis / axisLength;
+
+    float minDot = 1.0f;
+    for(const glm::vec3& normal : normals)
+        minDot = std::min(minDot, glm::dot(normal, cluster.coneAxis));
+
+    // A cone wider than a hemisphere always has a triangle facing the camera
+    if(minDot > 0.0f)
+        cluster.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+
+    return cluster;
+}
+
+bool MeshClusterizer::isBackfacing(const Cluster& cluster, const glm::vec3& cameraPosition) {
+    glm::vec3 toCluster = cluster.center - cameraPosition;
+    return glm::dot(toCluster, cluster.coneAxis) >= cluster.coneCutoff * glm::length(toCluster) + cluster.radius;
+}
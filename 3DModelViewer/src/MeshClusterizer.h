@@ -0,0 +1,53 @@
+#pragma once
+
+#include "glm.hpp"
+#include <vector>
+
+using std::vector;
+
+// Splits a triangle list into small clusters (meshlets) that can be culled individually,
+// so parts of a large mesh that are off screen or facing away are not drawn.
+class MeshClusterizer {
+
+public:
+    static const unsigned int MaxVertices = 64;
+    static const unsigned int MaxTriangles = 124;
+
+    struct Cluster {
+        int indexOffset; // Range of the mesh's index buffer covered by this cluster
+        int indexCount;
+        // Range of the edges of the cluster's triangles, including those it shares with other
+        // clusters, when the mesh's edges were extracted
+        int edgeOffset;
+        int edgeCount;
+
+        // Bounding sphere
+        glm::vec3 center;
+        float radius;
+
+        // Normal cone: every triangle normal lies within the cone around coneAxis.
+        // coneCutoff is 1 when the normals are too spread out for backface culling.
+        glm::vec3 coneAxis;
+        float coneCutoff;
+    };
+
+    // Builds clusters over indices[indexOffset, indexOffset + indexCount) without reordering them.
+    // Triangles are taken in order, so the range should already be optimized for locality.
+    static vector<Cluster> build(const vector<unsigned int>& indices,
+                                 int indexOffset,
+                                 int indexCount,
+                                 const vector<glm::vec3>& positions);
+
+    // True if every triangle of the cluster faces away from a camera at cameraPosition
+    // (both in the same object space)
+    static bool isBackfacing(const Cluster& cluster, const glm::vec3& cameraPosition);
+
+private:
+    MeshClusterizer();
+    ~MeshClusterizer();
+
+    static Cluster computeBounds(const vector<unsigned int>& indices,
+                                 int indexOffset,
+                                 int indexCount,
+                                 const vector<glm::vec3>& positions);
+};
@@ -0,0 +1,222 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+
+namespace {
+
+struct Cluster {
+    size_t firstTriangle;
+    size_t numTriangles;
+    float sortKey;
+};
+
+}
+
+MeshOptimizer::MeshOptimizer() {}
+
+MeshOptimizer::~MeshOptimizer() {}
+
+void MeshOptimizer::optimizeVertexCache(vector<unsigned int>& indices, size_t numVertices) {
+    const size_t numTriangles = indices.size() / 3;
+    if(numTriangles == 0)
+        return;
+
+    // Vertex to triangle adjacency, stored as one flat list with per-vertex offsets
+    vector<unsigned int> liveTriangles(numVertices, 0);
+    for(unsigned int index : indices)
+        ++liveTriangles[index];
+
+    vector<unsigned int> offsets(numVertices + 1, 0);
+    for(size_t v = 0; v < numVertices; ++v)
+        offsets[v + 1] = offsets[v] + liveTriangles[v];
+
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t t = 0; t < numTriangles; ++t) {
+        for(int k = 0; k < 3; ++k)
+            adjacency[fill[indices[t * 3 + k]]++] = unsigned(t);
+    }
+
+    vector<unsigned int> cacheTime(numVertices, 0);
+    vector<bool> emitted(numTriangles, false);
+    vector<unsigned int> deadEnd;
+    vector<unsigned int> candidates;
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    unsigned int time = CacheSize + 1;
+    size_t cursor = 0;
+    long fanningVertex = indices[0];
+
+    while(fanningVertex >= 0) {
+        candidates.clear();
+
+        // Emit every remaining triangle around the fanning vertex
+        for(unsigned int i = offsets[fanningVertex]; i < offsets[fanningVertex + 1]; ++i) {
+            unsigned int t = adjacency[i];
+            if(emitted[t])
+                continue;
+            emitted[t] = true;
+
+            for(int k = 0; k < 3; ++k) {
+                unsigned int v = indices[t * 3 + k];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --liveTriangles[v];
+
+                // Only a cache miss moves the vertex to the front of the FIFO
+                if(time - cacheTime[v] > CacheSize)
+                    cacheTime[v] = time++;
+            }
+        }
+
+        // Prefer the candidate that will still be in the cache after emitting its fan,
+        // and among those, the one that entered the cache earliest
+        long best = -1;
+        int bestPriority = -1;
+        for(unsigned int v : candidates) {
+            if(liveTriangles[v] == 0)
+                continue;
+            int priority = 0;
+            if(time - cacheTime[v] + 2 * liveTriangles[v] <= CacheSize)
+                priority = int(time - cacheTime[v]);
+            if(priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+
+        // Dead end: fall back to recently used vertices, then to the first unfinished vertex
+        while(best < 0 && !deadEnd.empty()) {
+            unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if(liveTriangles[v] > 0)
+                best = v;
+        }
+        while(best < 0 && cursor < numVertices) {
+            if(liveTriangles[cursor] > 0)
+                best = long(cursor);
+            ++cursor;
+        }
+
+        fanningVertex = best;
+    }
+
+    indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(vector<unsigned int>& indices, const vector<glm::vec3>& positions) {
+    const size_t numTriangles = indices.size() / 3;
+    if(numTriangles == 0)
+        return;
+
+    // Split the triangles wherever every corner misses the cache; reordering the clusters
+    // at those points costs nothing in vertex cache efficiency
+    vector<Cluster> clusters;
+    vector<unsigned int> cacheTime(positions.size(), 0);
+    unsigned int time = CacheSize + 1;
+    for(size_t t = 0; t < numTriangles; ++t) {
+        int misses = 0;
+        for(int k = 0; k < 3; ++k) {
+            unsigned int v = indices[t * 3 + k];
+            if(time - cacheTime[v] > CacheSize) {
+                cacheTime[v] = time++;
+                ++misses;
+            }
+        }
+        if(misses == 3 || clusters.empty()) {
+            Cluster cluster;
+            cluster.firstTriangle = t;
+            cluster.numTriangles = 0;
+            cluster.sortKey = 0.0f;
+            clusters.push_back(cluster);
+        }
+        ++clusters.back().numTriangles;
+    }
+
+    // Area weighted centroid of the whole mesh
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for(size_t t = 0; t < numTriangles; ++t) {
+        const glm::vec3& a = positions[indices[t * 3]];
+        const glm::vec3& b = positions[indices[t * 3 + 1]];
+        const glm::vec3& c = positions[indices[t * 3 + 2]];
+        float area = glm::length(glm::cross(b - a, c - a));
+        meshCentroid += area * (a + b + c) / 3.0f;
+        meshArea += area;
+    }
+    if(meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Clusters far out along their own normal are likely to occlude the rest of the mesh
+    for(Cluster& cluster : clusters) {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for(size_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.numTriangles; ++t) {
+            const glm::vec3& a = positions[indices[t * 3]];
+            const glm::vec3& b = positions[indices[t * 3 + 1]];
+            const glm::vec3& c = positions[indices[t * 3 + 2]];
+            glm::vec3 triangleNormal = glm::cross(b - a, c - a);
+            float triangleArea = glm::length(triangleNormal);
+            centroid += triangleArea * (a + b + c) / 3.0f;
+            normal += triangleNormal;
+            area += triangleArea;
+        }
+        float normalLength = glm::length(normal);
+        if(area > 0.0f && normalLength > 0.0f)
+            cluster.sortKey = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for(const Cluster& cluster : clusters) {
+        result.insert(result.end(),
+                      indices.begin() + cluster.firstTriangle * 3,
+                      indices.begin() + (cluster.firstTriangle + cluster.numTriangles) * 3);
+    }
+    indices.swap(result);
+}
+
+vector<unsigned int> MeshOptimizer::optimizeVertexFetch(vector<unsigned int>& indices, size_t numVertices) {
+    const unsigned int unassigned = ~0u;
+    vector<unsigned int> remap(numVertices, unassigned);
+    unsigned int next = 0;
+
+    for(unsigned int& index : indices) {
+        if(remap[index] == unassigned)
+            remap[index] = next++;
+        index = remap[index];
+    }
+
+    // Vertices no triangle refers to keep their relative order at the end
+    for(unsigned int& target : remap) {
+        if(target == unassigned)
+            target = next++;
+    }
+
+    return remap;
+}
+
+float MeshOptimizer::calculateACMR(const vector<unsigned int>& indices, size_t numVertices) {
+    const size_t numTriangles = indices.size() / 3;
+    if(numTriangles == 0)
+        return 0.0f;
+
+    vector<unsigned int> cacheTime(numVertices, 0);
+    unsigned int time = CacheSize + 1;
+    size_t misses = 0;
+    for(unsigned int v : indices) {
+        if(time - cacheTime[v] > CacheSize) {
+            cacheTime[v] = time++;
+            ++misses;
+        }
+    }
+
+    return float(misses) / float(numTriangles);
+}
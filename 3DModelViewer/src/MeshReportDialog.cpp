@@ -0,0 +1,113 @@
+#include "MeshReportDialog.h"
+#include "Utils.h"
+
+#include "QDialogButtonBox"
+#include "QHeaderView"
+#include "QLabel"
+#include "QTableWidget"
+#include "QTimer"
+#include "QVBoxLayout"
+
+namespace {
+
+QTableWidgetItem* numberItem(const QString& text) {
+    QTableWidgetItem* item = new QTableWidgetItem(text);
+    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    return item;
+}
+
+QTableWidgetItem* countItem(size_t count) {
+    return numberItem(QString::number(qulonglong(count)));
+}
+
+void fillRow(QTableWidget* table, int row, const QString& name, const MeshAnalyzer::MeshReport& mesh) {
+    table->setItem(row, 0, new QTableWidgetItem(name));
+    table->setItem(row, 1, countItem(mesh.triangles));
+    table->setItem(row, 2, countItem(mesh.vertices));
+    if(!mesh.analyzed) {
+        table->setItem(row, 3, new QTableWidgetItem(QObject::tr("Not analyzed")));
+        return;
+    }
+
+    table->setItem(row, 3, countItem(mesh.uniqueVertices));
+    table->setItem(row, 4, countItem(mesh.degenerateTriangles));
+    table->setItem(row, 5, countItem(mesh.duplicateTriangles));
+    table->setItem(row, 6, countItem(mesh.edges));
+    table->setItem(row, 7, countItem(mesh.boundaryEdges));
+    table->setItem(row, 8, countItem(mesh.boundaryLoops));
+    table->setItem(row, 9, countItem(mesh.nonManifoldEdges));
+    table->setItem(row, 10, new QTableWidgetItem(mesh.isClosed() ? QObject::tr("Yes") : QObject::tr("No")));
+    table->setItem(row, 11, numberItem(QString::number(mesh.surfaceArea, 'g', 6)));
+    // The volume of an open mesh depends on where the origin is, so it means nothing
+    table->setItem(row, 12, numberItem(mesh.isClosed() ? QString::number(mesh.volume, 'g', 6) : QString()));
+}
+
+}
+
+MeshReportDialog::MeshReportDialog(const Model& model, QWidget* parent) :
+  QDialog(parent),
+  _cancelled(false),
+  _finished(false)
+{
+    setWindowTitle(tr("Mesh report - %1").arg(Utils::getFileNameFromPath(model.getFileName()).c_str()));
+
+    _table = new QTableWidget(0, 13, this);
+    _table->setHorizontalHeaderLabels(QStringList() << tr("Mesh") << tr("Triangles") << tr("Vertices") << tr("Unique vertices")
+                                                    << tr("Degenerate") << tr("Duplicate") << tr("Edges") << tr("Boundary edges")
+                                                    << tr("Boundary loops") << tr("Non-manifold edges") << tr("Closed")
+                                                    << tr("Area") << tr("Volume"));
+    _table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    _table->verticalHeader()->hide();
+
+    _summary = new QLabel(tr("Analyzing %1 meshes...").arg(model.getMeshes().size()), this);
+    _summary->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttons, SIGNAL(rejected()), this, SLOT(reject()));
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addWidget(_table);
+    layout->addWidget(_summary);
+    layout->addWidget(buttons);
+    resize(960, 480);
+
+    // The worker only reads the model, which the dialog being modal keeps open
+    _worker = std::thread([this, &model]() {
+        _report = MeshAnalyzer::analyze(model, &_cancelled);
+        _finished = true;
+    });
+
+    // Checked from the event loop, so the viewer is never kept waiting
+    _timer = new QTimer(this);
+    connect(_timer, &QTimer::timeout, [this]() {
+        if(!_finished)
+            return;
+        _timer->stop();
+        showReport();
+    });
+    _timer->start(50);
+}
+
+MeshReportDialog::~MeshReportDialog() {
+    _cancelled = true;
+    _worker.join();
+}
+
+void MeshReportDialog::showReport() {
+    const vector<MeshAnalyzer::MeshReport>& meshes = _report.meshes;
+    _table->setRowCount(int(meshes.size()) + 1);
+    size_t notAnalyzed = 0;
+    for(int row = 0; row < int(meshes.size()); ++row) {
+        fillRow(_table, row, meshes[row].name.c_str(), meshes[row]);
+        if(!meshes[row].analyzed)
+            ++notAnalyzed;
+    }
+    fillRow(_table, int(meshes.size()), tr("Total"), _report.total);
+    _table->resizeColumnsToContents();
+    _table->horizontalHeader()->setStretchLastSection(true);
+
+    QString summary = tr("Analyzed in %1 ms").arg(_report.milliseconds, 0, 'f', 2);
+    if(notAnalyzed > 0)
+        summary += tr("\n%1 meshes could not be read back from the cache").arg(notAnalyzed);
+    _summary->setText(summary);
+}
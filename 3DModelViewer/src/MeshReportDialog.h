@@ -0,0 +1,35 @@
+#pragma once
+
+#include "QDialog"
+
+#include "MeshAnalyzer.h"
+
+#include <atomic>
+#include <thread>
+
+class QLabel;
+class QTableWidget;
+class QTimer;
+
+// Analyzes the meshes of a model on a worker thread (see MeshAnalyzer) and shows a row for each
+// once it has finished, while the viewer keeps drawing. Closing the dialog cancels the analysis
+// after the mesh being analyzed. The model must outlive the dialog.
+class MeshReportDialog : public QDialog {
+
+public:
+    MeshReportDialog(const Model& model, QWidget* parent = 0);
+    ~MeshReportDialog();
+
+private:
+    std::thread _worker;
+    std::atomic<bool> _cancelled;
+    std::atomic<bool> _finished;
+    MeshAnalyzer::Report _report; // Written by the worker until _finished is set
+
+    QTableWidget* _table;
+    QLabel* _summary;
+    QTimer* _timer;
+
+    // Fills the table once the worker has finished
+    void showReport();
+};
@@ -0,0 +1,253 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+
+namespace {
+
+// Symmetric 4x4 matrix representing the sum of squared distances to a set of planes
+struct Quadric {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+    Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0) {}
+
+    void addPlane(double a, double b, double c, double d) {
+        a2 += a * a; ab += a * b; ac += a * c; ad += a * d;
+        b2 += b * b; bc += b * c; bd += b * d;
+        c2 += c * c; cd += c * d;
+        d2 += d * d;
+    }
+
+    void add(const Quadric& q) {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+    }
+
+    // Sum of squared distances from p to every plane in this quadric
+    double evaluate(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double result = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                      + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                      + c2 * z * z + 2 * cd * z
+                      + d2;
+        return std::max(result, 0.0);
+    }
+};
+
+struct Collapse {
+    float cost;
+    unsigned int from;
+    unsigned int to;
+
+    // Reversed so that std::priority_queue pops the cheapest collapse first
+    bool operator<(const Collapse& other) const { return cost > other.cost; }
+};
+
+uint64_t edgeKey(unsigned int a, unsigned int b) {
+    if(a > b)
+        std::swap(a, b);
+    return (uint64_t(a) << 32) | b;
+}
+
+}
+
+MeshSimplifier::MeshSimplifier() {}
+
+MeshSimplifier::~MeshSimplifier() {}
+
+vector<unsigned int> MeshSimplifier::simplify(const vector<glm::vec3>& positions,
+                                              const vector<unsigned int>& indices,
+                                              size_t targetIndexCount,
+                                              float* resultError) {
+    const size_t numVertices = positions.size();
+    const size_t numTriangles = indices.size() / 3;
+
+    vector<unsigned int> triangles(indices.begin(), indices.begin() + numTriangles * 3);
+    vector<bool> triangleRemoved(numTriangles, false);
+    size_t liveTriangles = numTriangles;
+
+    // Accumulate the plane of every triangle into the quadrics of its corners
+    vector<Quadric> quadrics(numVertices);
+    vector<vector<unsigned int> > vertexTriangles(numVertices);
+    for(size_t t = 0; t < numTriangles; ++t) {
+        const unsigned int* tri = &triangles[t * 3];
+        glm::vec3 normal = glm::cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]]);
+        float length = glm::length(normal);
+        if(length > 0.0f) {
+            normal /= length;
+            double d = -glm::dot(normal, positions[tri[0]]);
+            for(int k = 0; k < 3; ++k)
+                quadrics[tri[k]].addPlane(normal.x, normal.y, normal.z, d);
+        }
+        for(int k = 0; k < 3; ++k)
+            vertexTriangles[tri[k]].push_back(unsigned(t));
+    }
+
+    // Edges used by exactly one triangle lie on an open border or an attribute seam
+    // (seam vertices are split by the importer). Lock their vertices in place.
+    std::unordered_map<uint64_t, int> edgeUse;
+    edgeUse.reserve(numTriangles * 3);
+    for(size_t t = 0; t < numTriangles; ++t) {
+        for(int k = 0; k < 3; ++k)
+            ++edgeUse[edgeKey(triangles[t * 3 + k], triangles[t * 3 + (k + 1) % 3])];
+    }
+    vector<bool> locked(numVertices, false);
+    for(auto& edge : edgeUse) {
+        if(edge.second != 2) {
+            locked[unsigned(edge.first >> 32)] = true;
+            locked[unsigned(edge.first & 0xffffffff)] = true;
+        }
+    }
+
+    // Vertices that have been collapsed point at the vertex they were merged into
+    vector<unsigned int> remap(numVertices);
+    for(size_t i = 0; i < numVertices; ++i)
+        remap[i] = unsigned(i);
+    auto find = [&remap](unsigned int v) {
+        unsigned int root = v;
+        while(remap[root] != root)
+            root = remap[root];
+        while(remap[v] != root) {
+            unsigned int next = remap[v];
+            remap[v] = root;
+            v = next;
+        }
+        return root;
+    };
+
+    auto collapseCost = [&](unsigned int from, unsigned int to) {
+        Quadric q = quadrics[from];
+        q.add(quadrics[to]);
+        return float(q.evaluate(positions[to]));
+    };
+
+    // Queue the cheapest direction of every edge that has an unlocked endpoint
+    std::priority_queue<Collapse> queue;
+    for(auto& edge : edgeUse) {
+        if(edge.second != 2)
+            continue;
+        unsigned int a = unsigned(edge.first >> 32);
+        unsigned int b = unsigned(edge.first & 0xffffffff);
+        if(locked[a] && locked[b])
+            continue;
+
+        Collapse collapse;
+        if(locked[a] || (!locked[b] && collapseCost(b, a) < collapseCost(a, b))) {
+            collapse.from = b;
+            collapse.to = a;
+        }
+        else {
+            collapse.from = a;
+            collapse.to = b;
+        }
+        collapse.cost = collapseCost(collapse.from, collapse.to);
+        queue.push(collapse);
+    }
+    edgeUse.clear();
+
+    double maxCost = 0.0;
+    const size_t targetTriangles = targetIndexCount / 3;
+
+    while(liveTriangles > targetTriangles && !queue.empty()) {
+        Collapse collapse = queue.top();
+        queue.pop();
+
+        unsigned int from = find(collapse.from);
+        unsigned int to = find(collapse.to);
+        if(from == to)
+            continue;
+        if(locked[from]) {
+            if(locked[to])
+                continue;
+            std::swap(from, to);
+        }
+
+        // Neighbouring collapses may have made this edge more expensive; requeue it if so
+        float cost = collapseCost(from, to);
+        if(from != collapse.from || to != collapse.to || cost > collapse.cost) {
+            collapse.from = from;
+            collapse.to = to;
+            collapse.cost = cost;
+            queue.push(collapse);
+            continue;
+        }
+
+        // Reject collapses that would flip a surviving triangle around
+        bool flips = false;
+        bool sharesTriangle = false;
+        for(unsigned int t : vertexTriangles[from]) {
+            if(triangleRemoved[t])
+                continue;
+            unsigned int* tri = &triangles[t * 3];
+            if(find(tri[0]) == to || find(tri[1]) == to || find(tri[2]) == to) {
+                sharesTriangle = true;
+                continue;
+            }
+
+            glm::vec3 corners[3];
+            for(int k = 0; k < 3; ++k)
+                corners[k] = positions[find(tri[k])];
+            glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+            for(int k = 0; k < 3; ++k) {
+                if(find(tri[k]) == from)
+                    corners[k] = positions[to];
+            }
+            glm::vec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+            if(glm::dot(before, after) <= 0.0f) {
+                flips = true;
+                break;
+            }
+        }
+        if(flips || !sharesTriangle)
+            continue;
+
+        // Perform the collapse: triangles on the edge disappear, the rest move onto 'to'
+        for(unsigned int t : vertexTriangles[from]) {
+            if(triangleRemoved[t])
+                continue;
+            unsigned int* tri = &triangles[t * 3];
+            for(int k = 0; k < 3; ++k)
+                tri[k] = find(tri[k]);
+            if(tri[0] == to || tri[1] == to || tri[2] == to) {
+                triangleRemoved[t] = true;
+                --liveTriangles;
+                continue;
+            }
+            for(int k = 0; k < 3; ++k) {
+                if(tri[k] == from)
+                    tri[k] = to;
+            }
+            vertexTriangles[to].push_back(t);
+        }
+        vector<unsigned int>().swap(vertexTriangles[from]);
+
+        quadrics[to].add(quadrics[from]);
+        remap[from] = to;
+        maxCost = std::max(maxCost, double(cost));
+    }
+
+    vector<unsigned int> result;
+    result.reserve(liveTriangles * 3);
+    for(size_t t = 0; t < numTriangles; ++t) {
+        if(triangleRemoved[t])
+            continue;
+        unsigned int a = find(triangles[t * 3]);
+        unsigned int b = find(triangles[t * 3 + 1]);
+        unsigned int c = find(triangles[t * 3 + 2]);
+        if(a == b || b == c || a == c)
+            continue;
+        result.push_back(a);
+        result.push_back(b);
+        result.push_back(c);
+    }
+
+    if(resultError)
+        *resultError = float(std::sqrt(maxCost));
+
+    return result;
+}
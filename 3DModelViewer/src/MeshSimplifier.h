@@ -0,0 +1,28 @@
+#pragma once
+
+#include "glm.hpp"
+#include <vector>
+
+using std::vector;
+
+// Quadric error metric simplification of indexed triangle meshes.
+// Edges are collapsed onto one of their existing endpoints, so every simplified
+// index list still refers to the original vertex array and all levels of detail
+// can share the same vertex buffers.
+class MeshSimplifier {
+
+public:
+    // Returns a simplified copy of indices with at most targetIndexCount indices
+    // (or as close as the mesh allows). Vertices on open borders and attribute
+    // seams are never moved, which keeps silhouettes and UV seams intact.
+    // If resultError is non-null it receives the largest object-space deviation
+    // introduced by the collapses.
+    static vector<unsigned int> simplify(const vector<glm::vec3>& positions,
+                                         const vector<unsigned int>& indices,
+                                         size_t targetIndexCount,
+                                         float* resultError = nullptr);
+
+private:
+    MeshSimplifier();
+    ~MeshSimplifier();
+};
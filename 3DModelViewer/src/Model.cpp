@@ -1,7 +1,25 @@
 #include "Model.h"
+#include "ModelCache.h"
+#include "EdgeExtractor.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "NativeImporter.h"
+#include "NormalGenerator.h"
+#include "PointCloud.h"
+#include "PointCloudFile.h"
+#include "PointCloudStream.h"
+#include "TangentGenerator.h"
 #include "Utils.h"
 #include "QErrorMessage"
+#include "QDebug"
+#include "QThread"
+#include "QElapsedTimer"
+#include "QCoreApplication"
 #include "fstream"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
 
 // GLM
 #include "gtc/matrix_transform.hpp"
@@ -9,32 +27,260 @@
 #include "Resources/assimp/include/assimp/Importer.hpp"
 #include "Resources/assimp/include/assimp/scene.h"
 #include "Resources/assimp/include/assimp/postprocess.h"
+#include "Resources/assimp/include/assimp/IOSystem.hpp"
+#include "Resources/assimp/include/assimp/IOStream.hpp"
 // DevIL
 #include "IL/il.h"
 #include "IL/ilut.h"
 
+namespace {
+
+// Cached geometry is copied into gpu buffers through mapped ranges of at most this size
+const size_t UploadChunkBytes = 4 << 20;
+
+// DevIL keeps its bound image and error state in globals, so models loaded on
+// different threads must take turns using it
+std::mutex devilMutex;
+
+// Plain file io that records the time Assimp spends reading, separating it from parsing
+class TimedIOSystem : public Assimp::IOSystem {
+
+public:
+    TimedIOSystem() :
+      readMilliseconds(0.0),
+      bytesRead(0),
+      filesOpened(0)
+    {}
+
+    bool Exists(const char* fileName) const {
+        FILE* file = std::fopen(fileName, "rb");
+        if(!file)
+            return false;
+        std::fclose(file);
+        return true;
+    }
+
+    char getOsSeparator() const {
+#ifdef _WIN32
+        return '\\';
+#else
+        return '/';
+#endif
+    }
+
+    Assimp::IOStream* Open(const char* fileName, const char* mode) {
+        FILE* file = std::fopen(fileName, mode);
+        if(!file)
+            return nullptr;
+        ++filesOpened;
+        return new Stream(*this, file);
+    }
+
+    void Close(Assimp::IOStream* stream) {
+        delete stream;
+    }
+
+    double readMilliseconds;
+    size_t bytesRead;
+    size_t filesOpened;
+
+private:
+    class Stream : public Assimp::IOStream {
+
+    public:
+        Stream(TimedIOSystem& system, FILE* file) :
+          _system(system),
+          _file(file)
+        {}
+
+        ~Stream() {
+            std::fclose(_file);
+        }
+
+        size_t Read(void* buffer, size_t size, size_t count) {
+            QElapsedTimer timer;
+            timer.start();
+            size_t read = std::fread(buffer, size, count, _file);
+            _system.readMilliseconds += timer.nsecsElapsed() / 1e6;
+            _system.bytesRead += read * size;
+            return read;
+        }
+
+        size_t Write(const void* buffer, size_t size, size_t count) {
+            return std::fwrite(buffer, size, count, _file);
+        }
+
+        aiReturn Seek(size_t offset, aiOrigin origin) {
+            int whence = origin == aiOrigin_SET ? SEEK_SET : origin == aiOrigin_CUR ? SEEK_CUR : SEEK_END;
+            return std::fseek(_file, long(offset), whence) == 0 ? aiReturn_SUCCESS : aiReturn_FAILURE;
+        }
+
+        size_t Tell() const {
+            return size_t(std::ftell(_file));
+        }
+
+        size_t FileSize() const {
+            long position = std::ftell(_file);
+            std::fseek(_file, 0, SEEK_END);
+            long size = std::ftell(_file);
+            std::fseek(_file, position, SEEK_SET);
+            return size_t(size);
+        }
+
+        void Flush() {
+            std::fflush(_file);
+        }
+
+    private:
+        TimedIOSystem& _system;
+        FILE* _file;
+    };
+};
+
+// The post-processing steps a profile can use, in the order Assimp runs them when they are
+// passed to ReadFile together
+struct PostProcessStep {
+    unsigned int flag;
+    const char* name;
+};
+const PostProcessStep postProcessSteps[] = {
+    { aiProcess_FindInstances, "Post-process: FindInstances" },
+    { aiProcess_OptimizeGraph, "Post-process: OptimizeGraph" },
+    { aiProcess_OptimizeMeshes, "Post-process: OptimizeMeshes" },
+    { aiProcess_Triangulate, "Post-process: Triangulate" },
+    { aiProcess_SortByPType, "Post-process: SortByPType" },
+    { aiProcess_JoinIdenticalVertices, "Post-process: JoinIdenticalVertices" },
+    { aiProcess_ImproveCacheLocality, "Post-process: ImproveCacheLocality" }
+};
+
+// Post-processing steps of each profile. Missing normals aren't generated by Assimp but by the
+// normals stage, the same way as for the native importer.
+unsigned int profileSteps(Model::ImportProfile profile) {
+    switch(profile) {
+    case Model::FastPreview:
+        return aiProcess_Triangulate | aiProcess_SortByPType;
+    case Model::HighQuality:
+        return aiProcess_FindInstances | aiProcess_OptimizeGraph | aiProcess_OptimizeMeshes
+             | aiProcess_Triangulate | aiProcess_SortByPType
+             | aiProcess_JoinIdenticalVertices | aiProcess_ImproveCacheLocality;
+    default:
+        return aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_JoinIdenticalVertices;
+    }
+}
+
+// Bytes of the vertex attributes and indices the renderer uploads for the meshes
+size_t geometryBytes(const vector<Model::Mesh>& meshes) {
+    size_t bytes = 0;
+    for(const Model::Mesh& mesh : meshes) {
+        if(!mesh.compactVertices.empty())
+            bytes += mesh.compactVertices.size() * sizeof(VertexCompressor::CompactVertex);
+        else
+            bytes += mesh.vertices.size() * sizeof(glm::vec3) + mesh.normals.size() * sizeof(glm::vec3) + mesh.uvs.size() * sizeof(glm::vec2);
+        bytes += mesh.tangents.size() * sizeof(uint32_t) + mesh.indices.size() * sizeof(unsigned int);
+    }
+    return bytes;
+}
+
+size_t countVertices(const aiScene* scene) {
+    size_t count = 0;
+    for(unsigned int i = 0; i < scene->mNumMeshes; ++i)
+        count += scene->mMeshes[i]->mNumVertices;
+    return count;
+}
+
+}
+
 Model::Model() :
   _modelMatrixOutOfDate(true),
   _initialized(false),
   _numVertices(0),
+  _uploadedBytes(0),
   _modelMatrix(glm::mat4()),
   _translationMatrix(glm::mat4()),
   _scaleMatrix(glm::mat4()),
   _rotationMatrix(glm::mat4())
 {
     // Initialize IL so we can import images
+    std::lock_guard<std::mutex> lock(devilMutex);
     ilInit(); 
     checkILError();
     initializeOpenGLFunctions();
 }
 
-Model::Model(string fileName) : Model() {
+Model::ImportOptions::ImportOptions() :
+  profile(Standard),
+  generateLods(true),
+  maxLodLevels(5),
+  minLodTriangles(4096),
+  optimizeMeshes(true),
+  compressVertices(false),
+  buildClusters(true),
+  minClusterTriangles(1024),
+  useNativeImporter(true),
+  nativeObjMinBytes(64 * 1024 * 1024),
+  useCache(true),
+  generateNormals(true),
+  normalCreaseAngle(60.0f),
+  generateTangents(true),
+  extractEdges(true),
+  edgeFeatureAngle(0.0f)
+{}
+
+Model::ImportOptions Model::ImportOptions::fromProfile(ImportProfile profile) {
+    ImportOptions options;
+    options.profile = profile;
+
+    if(profile == FastPreview) {
+        options.generateLods = false;
+        options.optimizeMeshes = false;
+        options.buildClusters = false;
+        options.normalCreaseAngle = 0.0f;
+        options.extractEdges = false;
+        // Geometry only, but much quicker than Assimp for every OBJ file
+        options.nativeObjMinBytes = 0;
+    }
+    else if(profile == HighQuality) {
+        // The native importer would skip Assimp's post-processing
+        options.useNativeImporter = false;
+    }
+    return options;
+}
+
+string Model::profileName(ImportProfile profile) {
+    switch(profile) {
+    case FastPreview: return "fast-preview";
+    case HighQuality: return "high-quality";
+    default:          return "standard";
+    }
+}
+
+bool Model::parseProfile(const string& name, ImportProfile& profile) {
+    for(ImportProfile candidate : { FastPreview, Standard, HighQuality }) {
+        if(name == profileName(candidate)) {
+            profile = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+Model::Model(string fileName, ImportOptions options, LoadCallbacks callbacks) : Model() {
     _fileName = fileName;
+    _importOptions = options;
+    _loadCallbacks = callbacks;
 
     loadFile(fileName);
 }
 
 Model::~Model() {
+    for(Mesh& mesh : _meshes) {
+        if(!mesh.uploaded)
+            continue;
+        GLuint buffers[] = { mesh.vertexBuffer, mesh.uvBuffer, mesh.normalBuffer, mesh.tangentBuffer, mesh.indexBuffer, mesh.compactBuffer };
+        glDeleteBuffers(6, buffers);
+    }
+
+    std::lock_guard<std::mutex> lock(devilMutex);
     for(Texture tex : _textures) {
         glDeleteTextures(1, &tex.texId);
         ilDeleteImages(1, &tex.ilTexId);
@@ -42,109 +288,614 @@ Model::~Model() {
 }
 
 bool Model::loadFile(string fileName) {
-    // Create the Assimp importer to import the file data
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(fileName,
-        //aiProcess_CalcTangentSpace |
-        aiProcess_Triangulate |
-        aiProcess_JoinIdenticalVertices |
-        aiProcess_SortByPType);
+    _importStatistics.clear();
+    _importStatistics.setFileName(fileName);
+    _importStatistics.setProfile(profileName(_importOptions.profile));
+
+    // Preprocessed point clouds only have their node table read here, the points follow as they are drawn
+    if(PointCloudFile::isPointCloudFile(fileName))
+        return openPointStream(fileName);
+
+    // A model opened before with the same options is read back from its cache, already processed
+    ModelCache cache;
+    bool cached = _importOptions.useCache && loadCache(fileName, cache);
+
+    // Large scans in simple formats are read without building an Assimp scene first.
+    // Anything the native importer can't read still goes through Assimp.
+    bool loaded = cached;
+    if(!loaded && _importOptions.useNativeImporter && NativeImporter::canImport(fileName, _importOptions.nativeObjMinBytes)) {
+        size_t first = _meshes.size();
+        string error;
+        loaded = NativeImporter::import(fileName, _meshes, _importStatistics, error);
+        if(loaded) {
+            for(size_t i = first; i < _meshes.size(); ++i) {
+                _meshes[i].matIndex = -1; // Materials aren't read
+                initMesh(_meshes[i]);
+            }
+        }
+        else {
+            qDebug() << "Native importer could not read" << fileName.c_str() << "(" << error.c_str() << "), using Assimp";
+        }
+    }
 
-    if(!scene)
+    if(!loaded && !importScene(fileName)) {
+        _importStatistics.appendToLog();
         return false; // file could not be read
+    }
 
-    // Recursively load each node in this model, starting with the root node
-    loadNode(scene->mRootNode, scene);
-
-    // Load the materials for this model
-    if(scene->HasMaterials()) {
-        loadTextures(scene);
+    // Imported geometry is copied once into the meshes, and once more by the renderer's upload
+    if(!cached)
+        _importStatistics.addBytesCopied(geometryBytes(_meshes));
+
+    // Textures and cached buffers were created on this thread's context; other contexts sharing
+    // them may only use them once they are complete
+    if(_loadCallbacks.meshLoaded && (!_textures.empty() || cached))
+        glFinish();
+
+    // Mesh processing doesn't move vertices, so the bounds can be published before it runs
+    QElapsedTimer timer;
+    timer.start();
+    computeBounds();
+    _importStatistics.addStage("Bounds", timer.nsecsElapsed() / 1e6, 0, _meshes.size());
+
+    if(_loadCallbacks.bounds)
+        _loadCallbacks.bounds(_bounds, _boundingSphere);
+    if(_loadCallbacks.preview) {
+        timer.restart();
+        vector<glm::vec3> points = cached ? cache.samplePoints(PreviewPoints) : samplePoints(PreviewPoints);
+        _importStatistics.addStage("Preview sample", timer.nsecsElapsed() / 1e6, points.size() * sizeof(glm::vec3), points.size());
+        _loadCallbacks.preview(points);
     }
 
-    // Find BBox of the model as a whole
-    Mesh model; // represents complete model mesh
-    model.vertices = _vertices;
-    findBoundingBox(model);
+    if(cached) {
+        cache.close();
+        if(_loadCallbacks.meshLoaded) {
+            for(size_t i = 0; i < _meshes.size(); ++i)
+                _loadCallbacks.meshLoaded(_meshes[i], i);
+        }
+    }
+    else {
+        buildPointCloud();
+        if(_importOptions.generateNormals)
+            generateNormals();
+        if(_importOptions.generateTangents)
+            generateTangents();
+
+        timer.restart();
+        processMeshes();
+        _importStatistics.addStage("Mesh processing", timer.nsecsElapsed() / 1e6, 0, _meshes.size());
+        _importStatistics.addBytesCopied(geometryBytes(_meshes));
+
+        // The cache holds meshes only; point clouds are rebuilt from the file
+        if(_importOptions.useCache && !_pointCloud) {
+            timer.restart();
+            string error;
+            if(!ModelCache::write(fileName, _importOptions, _meshes, _textures, error))
+                qWarning() << "Could not write the cache of" << fileName.c_str() << ":" << error.c_str();
+            _importStatistics.addStage("Cache write", timer.nsecsElapsed() / 1e6, geometryBytes(_meshes), 1);
+        }
+    }
 
     // Center the model
-    translate( 
-        -(model.minX + model.maxX) / 2.0, 
-        -(model.minY + model.maxY) / 2.0, 
-        -(model.minZ + model.maxZ) / 2.0
-    );
+    translate(-_boundingSphere.center.x, -_boundingSphere.center.y, -_boundingSphere.center.z);
+    _initialized = true;
 
-    // We will set the bounding sphere diameter to be the distance between two corners of the bounding box
-    // This is a rough estimate, but it works well for the purpose of fitting the model to the viewport
-    _boundingSphereRadius = 0.5 * distanceBetweenTwoPoints(
-        glm::vec3(model.minX, model.minY, model.minZ),
-        glm::vec3(model.maxX, model.maxY, model.maxZ)
-    );
+    updateMemoryUsage();
+    _importStatistics.appendToLog();
+    return true;
+}
+
+bool Model::openPointStream(const string& fileName) {
+    QElapsedTimer timer;
+    timer.start();
+    _pointStream.reset(new PointCloudStream());
+    string error;
+    if(!_pointStream->open(fileName, PointCloudStream::DefaultMemoryBytes, error)) {
+        qWarning() << "Could not open" << fileName.c_str() << ":" << error.c_str();
+        _pointStream.reset();
+        _importStatistics.setError(error);
+        _importStatistics.appendToLog();
+        return false;
+    }
+    const vector<PointCloud::Node>& nodes = _pointStream->nodes();
+    _importStatistics.addStage("Octree open", timer.nsecsElapsed() / 1e6, nodes.size() * sizeof(PointCloud::Node), nodes.size());
+
+    computeBounds();
+    if(_loadCallbacks.bounds)
+        _loadCallbacks.bounds(_bounds, _boundingSphere);
+
+    translate(-_boundingSphere.center.x, -_boundingSphere.center.y, -_boundingSphere.center.z);
     _initialized = true;
 
+    updateMemoryUsage();
+    _importStatistics.appendToLog();
+    return true;
+}
+
+bool Model::importScene(const string& fileName) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // Create the Assimp importer to import the file data. It owns the io system and deletes it.
+    Assimp::Importer importer;
+    TimedIOSystem* io = new TimedIOSystem();
+    importer.SetIOHandler(io);
+    const aiScene* scene = importer.ReadFile(fileName, 0);
+
+    double readTime = timer.nsecsElapsed() / 1e6;
+    _importStatistics.addStage("File read", io->readMilliseconds, io->bytesRead, io->filesOpened);
+    _importStatistics.addStage("Assimp parse", readTime - io->readMilliseconds, 0, scene ? scene->mNumMeshes : 0);
+
+    // Post-processing steps are applied one at a time so each can be timed
+    unsigned int steps = profileSteps(_importOptions.profile);
+    for(const PostProcessStep& step : postProcessSteps) {
+        if(!scene)
+            break;
+        if(!(steps & step.flag))
+            continue;
+        timer.restart();
+        scene = importer.ApplyPostProcessing(step.flag);
+        _importStatistics.addStage(step.name, timer.nsecsElapsed() / 1e6, 0, scene ? countVertices(scene) : 0);
+    }
+
+    if(!scene) {
+        _importStatistics.setError(importer.GetErrorString());
+        return false;
+    }
+
+    // Recursively load each node in this model, starting with the root node
+    timer.restart();
+    vector<bool> converted(scene->mNumMeshes, false);
+    loadNode(scene->mRootNode, scene, converted);
+    size_t meshBytes = 0;
+    for(const Mesh& mesh : _meshes) {
+        meshBytes += mesh.vertices.size() * sizeof(glm::vec3) + mesh.normals.size() * sizeof(glm::vec3)
+                   + mesh.uvs.size() * sizeof(glm::vec2) + mesh.indices.size() * sizeof(unsigned int);
+    }
+    _importStatistics.addStage("Mesh conversion", timer.nsecsElapsed() / 1e6, meshBytes, _meshes.size());
+
+    // Load the materials for this model. Decode and upload are recorded as separate stages by loadTexture.
+    if(scene->HasMaterials()) {
+        loadTextures(scene);
+    }
+    return true;
+}
+
+bool Model::loadCache(const string& fileName, ModelCache& cache) {
+    QElapsedTimer timer;
+    timer.start();
+
+    size_t first = _meshes.size();
+    vector<string> textureFiles;
+    vector<int> meshTextures, meshNormalTextures;
+    string error;
+    if(!cache.open(fileName, _importOptions, _meshes, textureFiles, meshTextures, meshNormalTextures, error)) {
+        qDebug() << "Not using the cache of" << fileName.c_str() << ":" << error.c_str();
+        return false;
+    }
+    _importStatistics.addStage("Cache map", timer.nsecsElapsed() / 1e6, cache.size(), 1);
+
+    // Copy the geometry straight from the mapping into gpu buffers. Each buffer is only bound
+    // to the copy target, which leaves the vertex array and element bindings of the context alone.
+    timer.restart();
+    size_t bytesBefore = _uploadedBytes;
+    for(size_t i = first; i < _meshes.size(); ++i) {
+        Mesh& mesh = _meshes[i];
+        const ModelCache::Geometry& geometry = cache.geometry(i - first);
+        if(geometry.compactVertices.bytes > 0) {
+            mesh.compactBuffer = uploadBuffer(geometry.compactVertices.data, geometry.compactVertices.bytes);
+        }
+        else {
+            mesh.vertexBuffer = uploadBuffer(geometry.vertices.data, geometry.vertices.bytes);
+            // Meshes without uvs or normals get no buffer for them
+            if(geometry.normals.bytes > 0)
+                mesh.normalBuffer = uploadBuffer(geometry.normals.data, geometry.normals.bytes);
+            if(geometry.uvs.bytes > 0)
+                mesh.uvBuffer = uploadBuffer(geometry.uvs.data, geometry.uvs.bytes);
+        }
+        if(geometry.tangents.bytes > 0)
+            mesh.tangentBuffer = uploadBuffer(geometry.tangents.data, geometry.tangents.bytes);
+        mesh.indexBuffer = uploadBuffer(geometry.indices.data, geometry.indices.bytes);
+        mesh.uploaded = true;
+        _numVertices += mesh.numVertices;
+    }
+    size_t uploaded = _uploadedBytes - bytesBefore;
+    _importStatistics.addStage("Cache upload", timer.nsecsElapsed() / 1e6, uploaded, _meshes.size() - first);
+    _importStatistics.addBytesCopied(uploaded);
+
+    // Textures aren't cached; they are decoded again from their files
+    vector<GLuint> textureIds;
+    for(const string& textureFile : textureFiles) {
+        Texture texture;
+        texture.fileName = textureFile;
+        texture.opacity = 1.0f;
+        try {
+            loadTexture(texture.fileName, texture);
+        }
+        catch(std::runtime_error) {
+            ++_importStatistics.wasted().texturesFailed;
+            qWarning() << "Error:" << textureFile.c_str() << "could not be loaded";
+            textureIds.push_back(0);
+            continue;
+        }
+        textureIds.push_back(texture.texId);
+        _textures.push_back(texture);
+    }
+    for(size_t i = first; i < _meshes.size(); ++i) {
+        if(meshTextures[i - first] >= 0)
+            _meshes[i].diffuseTexture.texId = textureIds[meshTextures[i - first]];
+        if(meshNormalTextures[i - first] >= 0)
+            _meshes[i].normalTexture.texId = textureIds[meshNormalTextures[i - first]];
+    }
     return true;
 }
 
-void Model::loadNode(aiNode* node, const aiScene* scene) {
+GLuint Model::uploadBuffer(const char* data, size_t bytes) {
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+
+    // The buffer is new, so nothing can be using it and the ranges can be mapped without synchronizing
+    for(size_t offset = 0; offset < bytes; offset += UploadChunkBytes) {
+        size_t length = std::min(UploadChunkBytes, bytes - offset);
+        void* target = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, length,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if(target) {
+            memcpy(target, data + offset, length);
+            // The contents of a mapping can be lost, e.g. on a display mode change; write them again then
+            if(glUnmapBuffer(GL_COPY_WRITE_BUFFER))
+                continue;
+        }
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, length, data + offset);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    _uploadedBytes += bytes;
+    return buffer;
+}
+
+void Model::loadNode(aiNode* node, const aiScene* scene, vector<bool>& converted) {
     // Load all the meshes in this node
     for(int i = 0; i < node->mNumMeshes; ++i) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        // Instanced meshes are converted again for every node that references them
+        unsigned int index = node->mMeshes[i];
+        if(converted[index])
+            ++_importStatistics.wasted().meshesReconverted;
+        converted[index] = true;
+
+        aiMesh* mesh = scene->mMeshes[index];
         loadMesh(mesh);
     }
 
     // Recursively load each child node 
     for(int i = 0; i < node->mNumChildren; ++i)
-        loadNode(node->mChildren[i], scene);
+        loadNode(node->mChildren[i], scene, converted);
 }
 
 void Model::loadMesh(aiMesh* mesh) {
-    vector<glm::vec3> vertices;
-    vector<glm::vec3> normals;
-    vector<glm::vec2> uvs;
-
     Mesh m;
     m.matIndex = mesh->mMaterialIndex;
-    m.numFaces = mesh->mNumFaces;
 
-    for(int i = 0; i < mesh->mNumFaces; ++i) {
-        aiFace face = mesh->mFaces[i];
-
-        for(int j = 0; j < face.mNumIndices; ++j) {
-            int index = face.mIndices[j];
-
-            // Vertices
-            if(mesh->HasPositions()) {
-                glm::vec3 vertex(
-                    mesh->mVertices[index].x, 
-                    mesh->mVertices[index].y, 
-                    mesh->mVertices[index].z
-                );
-                _vertices.push_back(vertex);
-                m.vertices.push_back(vertex);
-            }
+    m.vertices.reserve(mesh->mNumVertices);
+    for(int i = 0; i < mesh->mNumVertices; ++i) {
+        // Vertices
+        if(mesh->HasPositions()) {
+            glm::vec3 vertex(
+                mesh->mVertices[i].x,
+                mesh->mVertices[i].y,
+                mesh->mVertices[i].z
+            );
+            m.vertices.push_back(vertex);
+        }
 
-            // Normals
-            if(mesh->HasNormals()) {
-                glm::vec3 normal(
-                    mesh->mNormals[index].x,
-                    mesh->mNormals[index].y,
-                    mesh->mNormals[index].z
-                );
-                m.normals.push_back(normal);
-            }
+        // Normals
+        if(mesh->HasNormals()) {
+            glm::vec3 normal(
+                mesh->mNormals[i].x,
+                mesh->mNormals[i].y,
+                mesh->mNormals[i].z
+            );
+            m.normals.push_back(normal);
+        }
 
-            // UVs
-            if(mesh->HasTextureCoords(0) && mesh->mTextureCoords[0]) {
-                aiVector3D texCoord = mesh->mTextureCoords[0][index];
-                glm::vec2 uv(texCoord.x, texCoord.y);
-                m.uvs.push_back(uv);
-            }
+        // UVs
+        if(mesh->HasTextureCoords(0) && mesh->mTextureCoords[0]) {
+            aiVector3D texCoord = mesh->mTextureCoords[0][i];
+            glm::vec2 uv(texCoord.x, texCoord.y);
+            m.uvs.push_back(uv);
         }
     }
 
-    _numVertices += mesh->mNumVertices; // add to total number of vertices
-    findBoundingBox(m); 
+    // Indices - only triangles are drawn, points and lines are sorted into their own meshes
+    m.indices.reserve(mesh->mNumFaces * 3);
+    for(int i = 0; i < mesh->mNumFaces; ++i) {
+        const aiFace& face = mesh->mFaces[i];
+        if(face.mNumIndices != 3)
+            continue;
+
+        for(int j = 0; j < 3; ++j)
+            m.indices.push_back(face.mIndices[j]);
+    }
+    initMesh(m);
     // Add this mesh to our vector of meshes
-    _meshes.push_back(m);
+    _meshes.push_back(std::move(m));
+}
+
+void Model::initMesh(Mesh& m) {
+    m.numVertices = m.vertices.size();
+    m.uvBuffer = m.normalBuffer = m.tangentBuffer = m.compactBuffer = 0;
+    m.vertexArray = 0;
+    m.diffuseTexture.texId = 0;
+    m.normalTexture.texId = 0;
+
+    m.numFaces = m.indices.size() / 3;
+    m.acmrBefore = m.acmrAfter = MeshOptimizer::calculateACMR(m.indices, m.vertices.size());
+
+    Lod fullResolution;
+    fullResolution.indexOffset = 0;
+    fullResolution.indexCount = m.indices.size();
+    fullResolution.error = 0.0f;
+    fullResolution.edgeOffset = fullResolution.edgeCount = 0;
+    m.lods.push_back(fullResolution);
+
+    _numVertices += m.numVertices; // add to total number of vertices
+}
+
+void Model::buildPointCloud() {
+    auto isPoints = [](const Mesh& mesh) { return mesh.indices.empty() && !mesh.vertices.empty(); };
+    size_t numPoints = 0;
+    bool hasColors = false;
+    for(const Mesh& mesh : _meshes) {
+        if(isPoints(mesh)) {
+            numPoints += mesh.vertices.size();
+            hasColors = hasColors || !mesh.colors.empty();
+        }
+    }
+    if(numPoints == 0)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // All the scans of the file go into one cloud; a single scan is moved rather than copied
+    vector<glm::vec3> positions;
+    vector<uint32_t> colors;
+    for(Mesh& mesh : _meshes) {
+        if(!isPoints(mesh))
+            continue;
+        if(hasColors) {
+            if(mesh.colors.size() != mesh.vertices.size())
+                colors.resize(colors.size() + mesh.vertices.size(), uint32_t(PointCloud::DefaultColor));
+            else if(colors.empty())
+                colors.swap(mesh.colors);
+            else
+                colors.insert(colors.end(), mesh.colors.begin(), mesh.colors.end());
+        }
+        if(positions.empty())
+            positions.swap(mesh.vertices);
+        else
+            positions.insert(positions.end(), mesh.vertices.begin(), mesh.vertices.end());
+    }
+    _meshes.erase(std::remove_if(_meshes.begin(), _meshes.end(), isPoints), _meshes.end());
+
+    _pointCloud.reset(new PointCloud());
+    _pointCloud->build(positions, colors);
+    _importStatistics.addStage("Point octree", timer.nsecsElapsed() / 1e6, _pointCloud->memoryBytes(), _pointCloud->nodes().size());
+}
+
+void Model::generateNormals() {
+    QElapsedTimer timer;
+    timer.start();
+
+    size_t numMeshes = 0, bytes = 0;
+    for(Mesh& mesh : _meshes) {
+        if(!mesh.normals.empty() || mesh.indices.empty())
+            continue;
+
+        // The generator is parallel within the mesh, so the meshes themselves go one at a time.
+        // Split vertices are appended and the indices keep their count, so the first lod stays valid.
+        size_t added = NormalGenerator::generate(mesh.vertices, mesh.uvs, mesh.indices, _importOptions.normalCreaseAngle, mesh.normals);
+        mesh.numVertices = int(mesh.vertices.size());
+        mesh.acmrBefore = mesh.acmrAfter = MeshOptimizer::calculateACMR(mesh.indices, mesh.vertices.size());
+        _numVertices += int(added);
+
+        ++numMeshes;
+        bytes += mesh.normals.size() * sizeof(glm::vec3) + added * (sizeof(glm::vec3) + (mesh.uvs.empty() ? 0 : sizeof(glm::vec2)));
+    }
+    if(numMeshes > 0)
+        _importStatistics.addStage("Normals", timer.nsecsElapsed() / 1e6, bytes, numMeshes);
+}
+
+void Model::generateTangents() {
+    // Tangents are only paid for by meshes that can use them
+    vector<size_t> mapped;
+    for(size_t i = 0; i < _meshes.size(); ++i) {
+        const Mesh& mesh = _meshes[i];
+        if(mesh.normalTexture.texId != 0 && !mesh.uvs.empty() && !mesh.normals.empty() && mesh.tangents.empty())
+            mapped.push_back(i);
+    }
+    if(mapped.empty())
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    vector<size_t> added(mapped.size(), 0);
+    Utils::parallelFor(mapped.size(), [&](size_t i) {
+        Mesh& mesh = _meshes[mapped[i]];
+        added[i] = TangentGenerator::generate(mesh.vertices, mesh.normals, mesh.uvs, mesh.indices, mesh.tangents);
+        mesh.numVertices = int(mesh.vertices.size());
+        mesh.acmrBefore = mesh.acmrAfter = MeshOptimizer::calculateACMR(mesh.indices, mesh.vertices.size());
+    });
+
+    size_t bytes = 0;
+    for(size_t i = 0; i < mapped.size(); ++i) {
+        const Mesh& mesh = _meshes[mapped[i]];
+        _numVertices += int(added[i]);
+        bytes += mesh.tangents.size() * sizeof(uint32_t) + added[i] * (2 * sizeof(glm::vec3) + sizeof(glm::vec2));
+    }
+    _importStatistics.addStage("Tangents", timer.nsecsElapsed() / 1e6, bytes, mapped.size());
+}
+
+void Model::processMeshes() {
+    // Meshes are independent of each other, so process them in parallel. Edge extraction is parallel
+    // itself, so it only starts threads of its own for a single mesh rather than from every thread here.
+    const size_t edgeThreads = _meshes.size() == 1 ? 0 : 1;
+    Utils::parallelFor(_meshes.size(), [this, edgeThreads](size_t i) {
+        if(_importOptions.generateLods)
+            generateLods(_meshes[i]);
+        if(_importOptions.optimizeMeshes)
+            optimizeMesh(_meshes[i]);
+        if(_importOptions.compressVertices)
+            compressVertices(_meshes[i]);
+        if(_importOptions.buildClusters)
+            buildClusters(_meshes[i]);
+        if(_importOptions.extractEdges)
+            extractEdges(_meshes[i], edgeThreads);
+        if(_loadCallbacks.meshLoaded)
+            _loadCallbacks.meshLoaded(_meshes[i], i);
+    });
+
+    if(_importOptions.optimizeMeshes) {
+        // Report the improvement over the whole model, weighted by triangle count
+        double before = 0.0, after = 0.0;
+        int numFaces = 0;
+        for(const Mesh& mesh : _meshes) {
+            before += mesh.acmrBefore * mesh.numFaces;
+            after += mesh.acmrAfter * mesh.numFaces;
+            numFaces += mesh.numFaces;
+        }
+        if(numFaces > 0)
+            qDebug() << "Vertex cache ACMR:" << before / numFaces << "->" << after / numFaces;
+    }
+
+    if(_importOptions.compressVertices) {
+        // Report the worst quantization error of any mesh so precision can be checked
+        VertexCompressor::Error worst;
+        for(const Mesh& mesh : _meshes) {
+            worst.maxPosition = std::max(worst.maxPosition, mesh.compressionError.maxPosition);
+            worst.maxPositionRelative = std::max(worst.maxPositionRelative, mesh.compressionError.maxPositionRelative);
+            worst.maxNormalDegrees = std::max(worst.maxNormalDegrees, mesh.compressionError.maxNormalDegrees);
+            worst.maxUv = std::max(worst.maxUv, mesh.compressionError.maxUv);
+        }
+        qDebug() << "Compact vertices:" << sizeof(VertexCompressor::CompactVertex) << "bytes per vertex,"
+                 << "max position error" << worst.maxPosition << "(" << worst.maxPositionRelative << "of bounding box diagonal ),"
+                 << "max normal error" << worst.maxNormalDegrees << "degrees,"
+                 << "max uv error" << worst.maxUv;
+    }
+}
+
+void Model::generateLods(Mesh& mesh) {
+    if(mesh.numFaces < _importOptions.minLodTriangles)
+        return;
+
+    // Each level targets a quarter of the triangles of the previous one, and is
+    // simplified from that previous level rather than from the full mesh
+    vector<unsigned int> previous(mesh.indices.begin(), mesh.indices.begin() + mesh.lods[0].indexCount);
+    float error = 0.0f;
+
+    while(int(mesh.lods.size()) < _importOptions.maxLodLevels) {
+        float levelError = 0.0f;
+        vector<unsigned int> simplified = MeshSimplifier::simplify(mesh.vertices, previous, previous.size() / 4, &levelError);
+
+        // Stop once the simplifier can no longer make meaningful progress
+        if(simplified.empty() || simplified.size() > previous.size() * 3 / 4)
+            break;
+
+        error += levelError;
+
+        Lod lod;
+        lod.indexOffset = mesh.indices.size();
+        lod.indexCount = simplified.size();
+        lod.error = error;
+        lod.edgeOffset = lod.edgeCount = 0;
+        mesh.lods.push_back(lod);
+        mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+
+        if(simplified.size() / 3 < 64)
+            break;
+        previous.swap(simplified);
+    }
+}
+
+void Model::optimizeMesh(Mesh& mesh) {
+    // Triangle order is optimized separately for each level of detail
+    for(Lod& lod : mesh.lods) {
+        vector<unsigned int> indices(
+            mesh.indices.begin() + lod.indexOffset,
+            mesh.indices.begin() + lod.indexOffset + lod.indexCount
+        );
+        MeshOptimizer::optimizeVertexCache(indices, mesh.vertices.size());
+        MeshOptimizer::optimizeOverdraw(indices, mesh.vertices);
+        std::copy(indices.begin(), indices.end(), mesh.indices.begin() + lod.indexOffset);
+
+        if(&lod == &mesh.lods[0])
+            mesh.acmrAfter = MeshOptimizer::calculateACMR(indices, mesh.vertices.size());
+    }
+
+    // Vertex order follows the full resolution mesh, which comes first in the index buffer
+    vector<unsigned int> remap = MeshOptimizer::optimizeVertexFetch(mesh.indices, mesh.vertices.size());
+    MeshOptimizer::remapVertices(mesh.vertices, remap);
+    MeshOptimizer::remapVertices(mesh.normals, remap);
+    MeshOptimizer::remapVertices(mesh.uvs, remap);
+    MeshOptimizer::remapVertices(mesh.tangents, remap);
+}
+
+void Model::compressVertices(Mesh& mesh) {
+    mesh.compactVertices = VertexCompressor::compress(
+        mesh.vertices,
+        mesh.normals,
+        mesh.uvs,
+        mesh.positionDecode,
+        &mesh.compressionError
+    );
+}
+
+void Model::buildClusters(Mesh& mesh) {
+    if(mesh.numFaces < _importOptions.minClusterTriangles)
+        return;
+
+    // Only the full resolution level is clustered; coarser levels are cheap enough to draw whole
+    mesh.clusters = MeshClusterizer::build(mesh.indices, mesh.lods[0].indexOffset, mesh.lods[0].indexCount, mesh.vertices);
+}
+
+void Model::extractEdges(Mesh& mesh, size_t maxThreads) {
+    vector<unsigned int> positionIds = EdgeExtractor::matchPositions(mesh.vertices, maxThreads);
+
+    // Appended after every triangle list, so the levels keep their offsets
+    vector<unsigned int> edges;
+    for(size_t i = 0; i < mesh.lods.size(); ++i) {
+        Lod& lod = mesh.lods[i];
+        lod.edgeOffset = int(mesh.indices.size() + edges.size());
+        if(i == 0 && !mesh.clusters.empty())
+            extractClusterEdges(mesh, positionIds, edges, maxThreads);
+        else
+            EdgeExtractor::extract(mesh.vertices, positionIds, mesh.indices.data() + lod.indexOffset, lod.indexCount,
+                                   _importOptions.edgeFeatureAngle, edges, maxThreads);
+        lod.edgeCount = int(mesh.indices.size() + edges.size()) - lod.edgeOffset;
+    }
+
+    mesh.indices.insert(mesh.indices.end(), edges.begin(), edges.end());
+}
+
+void Model::extractClusterEdges(Mesh& mesh, const vector<unsigned int>& positionIds, vector<unsigned int>& edges,
+                                size_t maxThreads) {
+    // Each cluster's triangles are contiguous, and the clusters cover the level in order
+    const Lod& lod = mesh.lods[0];
+    vector<size_t> clusterEnds;
+    for(const MeshClusterizer::Cluster& cluster : mesh.clusters)
+        clusterEnds.push_back(size_t(cluster.indexOffset - lod.indexOffset + cluster.indexCount) / 3);
+
+    // The level is only drawn through its clusters, so its range is theirs put together
+    const int first = int(mesh.indices.size() + edges.size());
+    vector<size_t> edgeEnds;
+    EdgeExtractor::extractGroups(mesh.vertices, positionIds, mesh.indices.data() + lod.indexOffset, clusterEnds,
+                                 _importOptions.edgeFeatureAngle, edges, edgeEnds, maxThreads);
+    for(size_t i = 0; i < mesh.clusters.size(); ++i) {
+        mesh.clusters[i].edgeOffset = first + int(i == 0 ? 0 : edgeEnds[i - 1]);
+        mesh.clusters[i].edgeCount = int(edgeEnds[i] - (i == 0 ? 0 : edgeEnds[i - 1]));
+    }
 }
 
 // TODO refactor this method
@@ -157,6 +908,10 @@ void Model::loadTextures(const aiScene* scene) {
 
             const aiMaterial* material = scene->mMaterials[mesh.matIndex];
             unsigned int numTex = material->GetTextureCount((aiTextureType)j);
+            // Normal maps get their own slot. OBJ materials usually give theirs as a bump map,
+            // which Assimp reads as a height map.
+            bool normalMap = j == aiTextureType_NORMALS || j == aiTextureType_HEIGHT;
+            Texture& target = normalMap ? mesh.normalTexture : mesh.diffuseTexture;
 
             // Check for textures and load them if found
             for(int k = 0; k < numTex; ++k) {
@@ -173,10 +928,11 @@ void Model::loadTextures(const aiScene* scene) {
                     for(Texture t : _textures) {
                         if(t.fileName == texPath.data) {
                             skip = true;
-                            mesh.diffuseTexture.texId = t.texId;
+                            target.texId = t.texId;
                         }
                     }
                     if(skip) {
+                        ++_importStatistics.wasted().duplicateTexturesSkipped;
                         continue;
                     }
 
@@ -187,13 +943,20 @@ void Model::loadTextures(const aiScene* scene) {
                         loadTexture(curTex.fileName, curTex);
                     }
                     catch(std::runtime_error) {
-                        QErrorMessage errorBox;
+                        ++_importStatistics.wasted().texturesFailed;
                         string msg = "Error: ";
                         msg.append(curTex.fileName).append(" could not be loaded");
-                        errorBox.showMessage(msg.c_str());
+                        // Dialogs can only be shown from the GUI thread; headless loads just log
+                        if(QThread::currentThread() == QCoreApplication::instance()->thread()) {
+                            QErrorMessage errorBox;
+                            errorBox.showMessage(msg.c_str());
+                        }
+                        else {
+                            qWarning() << msg.c_str();
+                        }
                         continue;
                     }
-                    mesh.diffuseTexture.texId = curTex.texId;
+                    target.texId = curTex.texId;
                     _textures.push_back(curTex);
                     break;
                 }
@@ -207,6 +970,8 @@ void Model::loadTexture(string fileName, Texture& texture) {
     //string fileNameWithPath = getPathFromFileName(_fileName).append(getFileNameFromPath(fileName));
     string fileNameWithPath = Utils::getPathFromFileName(_fileName).append(Utils::getFileNameFromPath(fileName));
 
+    std::lock_guard<std::mutex> lock(devilMutex);
+
     // Create the DevIL texture id
     ilGenImages(1, &texture.ilTexId);
     checkILError();
@@ -214,16 +979,21 @@ void Model::loadTexture(string fileName, Texture& texture) {
     checkILError();
 
     // Load the image
+    QElapsedTimer timer;
+    timer.start();
     bool success = ilLoadImage(fileNameWithPath.c_str());
     if(!success) {
         throw std::runtime_error("Could not read file");
     }
+    texture.dataBytes = ilGetInteger(IL_IMAGE_SIZE_OF_DATA);
+    _importStatistics.addStage("Texture decode", timer.nsecsElapsed() / 1e6, texture.dataBytes, 1);
 
     // Switch the renderer
     ilutRenderer(ILUT_OPENGL);
     checkILError();
 
     // This will generate an OpenGL texture and send the data to the gpu for us
+    timer.restart();
     texture.texId = ilutGLBindTexImage();
     checkILError();
 
@@ -238,42 +1008,104 @@ void Model::loadTexture(string fileName, Texture& texture) {
     texture.data = (char*)ilGetData();
     texture.width = ilGetInteger(IL_IMAGE_WIDTH);
     texture.height = ilGetInteger(IL_IMAGE_HEIGHT);
+
+    // Textures are uploaded as 8 bit RGBA
+    _importStatistics.addStage("Texture upload", timer.nsecsElapsed() / 1e6, size_t(texture.width) * texture.height * 4, 1);
+}
+
+vector<glm::vec3> Model::samplePoints(size_t maxPoints) const {
+    size_t numVertices = 0;
+    for(const Mesh& mesh : _meshes)
+        numVertices += mesh.vertices.size();
+    size_t step = std::max<size_t>(1, (numVertices + maxPoints - 1) / maxPoints);
+
+    // The sample continues across mesh boundaries, so small meshes still get their share
+    vector<glm::vec3> points;
+    points.reserve(std::min(numVertices, maxPoints));
+    size_t next = 0;
+    for(const Mesh& mesh : _meshes) {
+        for(; next < mesh.vertices.size(); next += step)
+            points.push_back(mesh.vertices[next]);
+        next -= mesh.vertices.size();
+    }
+    return points;
 }
 
-double Model::distanceBetweenTwoPoints(glm::vec3 p1, glm::vec3 p2) {
-    return hypot(hypot(p1.x - p2.x, p1.y - p2.y), p1.z - p2.z);
+MemoryTracker::Usage Model::meshMemory(const vector<Mesh>& meshes) {
+    MemoryTracker::Usage usage;
+    for(const Mesh& mesh : meshes) {
+        usage.bytes[MemoryTracker::VertexArrays] += mesh.vertices.capacity() * sizeof(glm::vec3)
+                                                  + mesh.normals.capacity() * sizeof(glm::vec3)
+                                                  + mesh.uvs.capacity() * sizeof(glm::vec2)
+                                                  + mesh.tangents.capacity() * sizeof(uint32_t)
+                                                  + mesh.colors.capacity() * sizeof(uint32_t)
+                                                  + mesh.compactVertices.capacity() * sizeof(VertexCompressor::CompactVertex);
+        usage.bytes[MemoryTracker::IndexArrays] += mesh.indices.capacity() * sizeof(unsigned int);
+    }
+    return usage;
 }
 
-// TODO find a better way to find bbox
-void Model::findBoundingBox(Mesh& mesh) {
-    // Find the max/min x, y, and z values for this mesh
-    for(auto vertex : mesh.vertices) {
-        if(vertex.x > mesh.maxX)
-            mesh.maxX = vertex.x;
-        else if(vertex.x < mesh.minX)
-            mesh.minX = vertex.x;
+void Model::updateMemoryUsage() {
+    MemoryTracker::Usage meshes = meshMemory(_meshes);
 
-        if(vertex.y > mesh.maxY)
-            mesh.maxY = vertex.y;
-        else if(vertex.y < mesh.minY)
-            mesh.minY = vertex.y;
+    // DevIL keeps every decoded image until the model is destroyed; the GL copy is 8 bit RGBA
+    size_t textureBytes = 0, glTextureBytes = 0;
+    for(const Texture& texture : _textures) {
+        textureBytes += texture.dataBytes;
+        glTextureBytes += size_t(texture.width) * texture.height * 4;
+    }
+
+    // The point cloud's octree is counted with the vertices; a streamed cloud's points are counted by the stream
+    size_t pointBytes = _pointCloud ? _pointCloud->memoryBytes() : 0;
+    if(_pointStream)
+        pointBytes += _pointStream->nodes().capacity() * sizeof(PointCloud::Node);
+
+    _memory.set(MemoryTracker::VertexArrays, meshes.bytes[MemoryTracker::VertexArrays] + pointBytes);
+    _memory.set(MemoryTracker::IndexArrays, meshes.bytes[MemoryTracker::IndexArrays]);
+    _memory.set(MemoryTracker::TextureData, textureBytes);
+    _memory.set(MemoryTracker::GLTextures, glTextureBytes);
+    _memory.set(MemoryTracker::GLBuffers, _uploadedBytes);
+}
 
-        if(vertex.z > mesh.maxZ)
-            mesh.maxZ = vertex.z;
-        else if(vertex.z < mesh.minZ)
-            mesh.minZ = vertex.z;
+void Model::computeBounds() {
+    // Cached meshes come with their bounds
+    vector<Mesh*> meshes;
+    vector<const vector<glm::vec3>*> positions;
+    for(Mesh& mesh : _meshes) {
+        if(!mesh.uploaded) {
+            meshes.push_back(&mesh);
+            positions.push_back(&mesh.vertices);
+        }
+    }
+
+    vector<MeshBounds::Box> boxes;
+    vector<MeshBounds::Sphere> spheres;
+    MeshBounds::compute(positions, boxes, spheres);
+    for(size_t i = 0; i < meshes.size(); ++i) {
+        meshes[i]->bounds = boxes[i];
+        meshes[i]->boundingSphere = spheres[i];
     }
 
-    // Now, given these max/min values, find the vertices that compose the bounding box
-    // These vertices are simply composed of every permutation of the max/min values for this mesh
-    mesh.boundingBox.push_back(glm::vec3(mesh.minX, mesh.minY, mesh.minZ));
-    mesh.boundingBox.push_back(glm::vec3(mesh.minX, mesh.maxY, mesh.minZ));
-    mesh.boundingBox.push_back(glm::vec3(mesh.minX, mesh.minY, mesh.maxZ));
-    mesh.boundingBox.push_back(glm::vec3(mesh.minX, mesh.maxY, mesh.maxZ));
-    mesh.boundingBox.push_back(glm::vec3(mesh.maxX, mesh.minY, mesh.minZ));
-    mesh.boundingBox.push_back(glm::vec3(mesh.maxX, mesh.maxY, mesh.minZ));
-    mesh.boundingBox.push_back(glm::vec3(mesh.maxX, mesh.minY, mesh.maxZ));
-    mesh.boundingBox.push_back(glm::vec3(mesh.maxX, mesh.maxY, mesh.maxZ));
+    _bounds = MeshBounds::Box();
+    for(const Mesh& mesh : _meshes)
+        _bounds.extend(mesh.bounds);
+    if(_pointStream)
+        _bounds.extend(_pointStream->bounds());
+
+    // The model's sphere is centered on its box, and must contain the sphere of every mesh.
+    // Half the box diagonal always does, so the radius never exceeds that.
+    _boundingSphere.center = _bounds.center();
+    _boundingSphere.radius = 0.0f;
+    for(const Mesh& mesh : _meshes) {
+        if(!mesh.bounds.isEmpty())
+            _boundingSphere.radius = std::max(_boundingSphere.radius, glm::distance(_boundingSphere.center, mesh.boundingSphere.center) + mesh.boundingSphere.radius);
+    }
+    if(_pointStream && !_pointStream->bounds().isEmpty()) {
+        const MeshBounds::Box& box = _pointStream->bounds();
+        _boundingSphere.radius = std::max(_boundingSphere.radius, glm::distance(_boundingSphere.center, box.center()) + 0.5f * glm::distance(box.min, box.max));
+    }
+    if(!_bounds.isEmpty())
+        _boundingSphere.radius = std::min(_boundingSphere.radius, 0.5f * glm::distance(_bounds.min, _bounds.max));
 }
 
 void Model::fitToScreen(double zPos, double fovDegrees) {
@@ -283,22 +1115,52 @@ void Model::fitToScreen(double zPos, double fovDegrees) {
     // This is the maximum radius we can have for this FOV
     double rMax = zPos * sin(glm::radians(fovDegrees));
     // How much we need to scale by to fit the model in the screen
-    double scaleFactor = rMax / _boundingSphereRadius;
+    double scaleFactor = _boundingSphere.radius > 0.0f ? rMax / _boundingSphere.radius : 1.0;
     scale(scaleFactor);
 }
 
-vector<glm::vec3> Model::getVertices() {
-    return _vertices;
+glm::mat4 Model::fitMatrix(const MeshBounds::Sphere& bounds, double zPos, double fovDegrees) {
+    // Same centering as loadFile, and the same scale as fitToScreen
+    double scaleFactor = bounds.radius > 0.0f ? zPos * sin(glm::radians(fovDegrees)) / bounds.radius : 1.0;
+    return glm::scale(glm::mat4(), glm::vec3(float(scaleFactor))) * glm::translate(glm::mat4(), -bounds.center);
 }
 
 vector<Model::Texture> Model::getTextures() {
     return _textures;
 }
 
-vector<Model::Mesh> Model::getMeshes() {
+const vector<Model::Mesh>& Model::getMeshes() const {
     return _meshes;
 }
 
+const PointCloud* Model::getPointCloud() const {
+    return _pointCloud.get();
+}
+
+PointCloudStream* Model::getPointStream() const {
+    return _pointStream.get();
+}
+
+const string& Model::getFileName() const {
+    return _fileName;
+}
+
+Model::ImportOptions Model::getImportOptions() const {
+    return _importOptions;
+}
+
+const ImportStatistics& Model::getImportStatistics() const {
+    return _importStatistics;
+}
+
+ImportStatistics& Model::getImportStatistics() {
+    return _importStatistics;
+}
+
+const MemoryTracker::Usage& Model::getMemoryUsage() const {
+    return _memory.usage();
+}
+
 int Model::getNumVertices() {
     return _numVertices;
 }
@@ -1,8 +1,15 @@
 #pragma once
 
 #include "glm.hpp"
+#include "VertexCompressor.h"
+#include "MeshClusterizer.h"
+#include "MeshBounds.h"
+#include "ImportStatistics.h"
+#include "MemoryTracker.h"
 #include "QOpenGLFunctions_3_3_Core"
 #include "IL/ilu.h"
+#include <functional>
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -13,6 +20,9 @@ struct aiScene;
 struct aiNode;
 struct aiMesh;
 struct aiMaterial;
+class ModelCache;
+class PointCloud;
+class PointCloudStream;
 
 #define NUM_AI_TEXTURE_TYPES 0xC
 
@@ -30,33 +40,128 @@ public:
         int width;
         int height;
         char* data;
+        size_t dataBytes; // Size of the decoded image held by DevIL
         float opacity;
         GLuint texId;
         ILuint ilTexId;
     };
 
+    // One level of detail; a range of Mesh::indices drawn instead of the full mesh
+    struct Lod {
+        int indexOffset;
+        int indexCount;
+        float error; // Object-space deviation from the full resolution mesh
+        // Line list of the level's unique edges in Mesh::indices, drawn by the wireframe view. A
+        // clustered level's range is made of its clusters' ranges, which repeat the edges they share.
+        // edgeCount is 0 when edges weren't extracted.
+        int edgeOffset;
+        int edgeCount;
+    };
+
     struct Mesh {
         string name;
         vector<glm::vec3> vertices;
         vector<glm::vec3> normals;
         vector<glm::vec2> uvs;
+        // Packed tangents (see VertexCompressor::packTangent), only filled for meshes with a normal map
+        vector<uint32_t> tangents;
+        // RGBA colour of each vertex, 8 bits per component with red in the lowest byte. Only read
+        // for meshes without faces, which go into the model's point cloud.
+        vector<uint32_t> colors;
+        // Triangle list indices for every level of detail, stored back to back, followed by their edges
+        vector<unsigned int> indices;
+        // lods[0] is always the full resolution mesh
+        vector<Lod> lods;
 
         GLuint vertexBuffer;
         GLuint uvBuffer;
         GLuint normalBuffer;
+        GLuint tangentBuffer; // Kept separate from the other attributes, for float and compact vertices alike
+        GLuint indexBuffer;
+        // Records the attribute layout and index buffer, so a draw needs a single bind
+        GLuint vertexArray;
+
+        // Packed copy of the vertex attributes, only filled when ImportOptions::compressVertices is set.
+        // When present it replaces the three float buffers above on the gpu.
+        vector<VertexCompressor::CompactVertex> compactVertices;
+        glm::mat4 positionDecode; // Maps compact positions back to object space
+        VertexCompressor::Error compressionError;
+        GLuint compactBuffer;
+
+        // Small groups of full resolution triangles that are culled individually
+        vector<MeshClusterizer::Cluster> clusters;
 
         int matIndex;
         int numFaces;
         int numVertices;
-        int minX = 0, maxX = 0, minY = 0, maxY = 0, minZ = 0, maxZ = 0;
-        vector<glm::vec3> boundingBox;
+        // Average cache miss ratio of the full resolution mesh before and after optimization
+        float acmrBefore;
+        float acmrAfter;
+        // Object-space bounds of the vertices
+        MeshBounds::Box bounds;
+        MeshBounds::Sphere boundingSphere;
 
         Texture diffuseTexture;
         Texture specularTexture;
+        Texture normalTexture; // Tangent space normal map; texId is 0 without one
+
+        // Set when the model filled the gpu buffers itself, straight from its cache. The attribute
+        // and index arrays above are then empty, and the buffers belong to the model.
+        bool uploaded = false;
+    };
+
+    // Named sets of import options, from the quickest to load to the best looking
+    enum ImportProfile {
+        FastPreview, // Flat normals where missing, no vertex welding, LODs, optimization or clusters
+        Standard,    // Smooth normals where missing, welded vertices, LODs, optimization and clusters
+        HighQuality  // Standard, with Assimp also merging instances, flattening the scene graph,
+                     // merging meshes and improving cache locality
     };
 
+    // Optional processing performed on the meshes after they have been read
+    struct ImportOptions {
+        ImportOptions();
+        // The options of profile; the default constructed options are those of Standard
+        static ImportOptions fromProfile(ImportProfile profile);
+
+        ImportProfile profile; // Selects the Assimp post-processing steps
+
+        bool generateLods;     // Build simplified levels of detail for large meshes
+        int maxLodLevels;      // Number of levels including the full resolution mesh
+        int minLodTriangles;   // Meshes smaller than this are left as they are
+        bool optimizeMeshes;   // Reorder triangles and vertices for vertex cache, overdraw and fetch efficiency
+        bool compressVertices; // Store vertices in the 16 byte quantized format (see VertexCompressor)
+        bool buildClusters;    // Split large meshes into clusters for finer grained culling
+        int minClusterTriangles;
+        bool useNativeImporter;   // Read OBJ, PLY, binary STL and point files without Assimp (geometry only, see NativeImporter)
+        size_t nativeObjMinBytes; // Smaller OBJ files go through Assimp so their materials are loaded
+        bool useCache;            // Load from and save to the binary cache of processed meshes (see ModelCache)
+        bool generateNormals;     // Compute normals for meshes read without them (see NormalGenerator)
+        float normalCreaseAngle;  // Degrees between faces above which they don't share normals; 0 for flat normals
+        bool generateTangents;    // Compute tangents for meshes with a normal map (see TangentGenerator)
+        bool extractEdges;        // Extract the unique edges of every level for the wireframe view (see EdgeExtractor)
+        float edgeFeatureAngle;   // Degrees between faces below which their shared edge is left out; 0 keeps every edge
+    };
+
+    // Names used for the profiles on the command line and in reports: fast-preview, standard, high-quality
+    static string profileName(ImportProfile profile);
+    static bool parseProfile(const string& name, ImportProfile& profile);
+
+    // Receive what loadFile has learned about the model before it returns, so a viewer can show
+    // something early. Called in this order; any of them may be left empty.
+    struct LoadCallbacks {
+        // Bounds of the whole model, known once the geometry has been read. Called from the loading thread.
+        std::function<void(const MeshBounds::Box& box, const MeshBounds::Sphere& sphere)> bounds;
+        // A sample of at most PreviewPoints vertex positions spread over all meshes. Called from the loading thread.
+        std::function<void(const vector<glm::vec3>& points)> preview;
+        // A mesh whose processing has finished, with its index in getMeshes(). Called from the
+        // processing threads, in no particular order.
+        std::function<void(const Mesh& mesh, size_t index)> meshLoaded;
+    };
+    static const size_t PreviewPoints = 1 << 16;
+
     Model();
-    Model(string fileName);
+    Model(string fileName, ImportOptions options = ImportOptions(), LoadCallbacks callbacks = LoadCallbacks());
     ~Model();
 
     bool loadFile(string fileName);
@@ -64,10 +169,22 @@ public:
     bool isModelMatrixOutOfDate();
     bool initialized();
 
-    vector<glm::vec3> getVertices();
     //vector<glm::vec2> getTextureUVs();
     vector<Texture> getTextures();
-    vector<Mesh> getMeshes();
+    const vector<Mesh>& getMeshes() const;
+    // The points of the meshes read without faces, or null if there were none
+    const PointCloud* getPointCloud() const;
+    // The cloud of a preprocessed point cloud file, read from disk as it is drawn; null for other files
+    PointCloudStream* getPointStream() const;
+    const string& getFileName() const;
+    ImportOptions getImportOptions() const;
+    // Timings, sizes and wasted work of each stage of the last loadFile
+    const ImportStatistics& getImportStatistics() const;
+    ImportStatistics& getImportStatistics();
+    // System and GPU memory held by the model's meshes and textures
+    const MemoryTracker::Usage& getMemoryUsage() const;
+    // System memory held by the vertex attributes and indices of meshes
+    static MemoryTracker::Usage meshMemory(const vector<Mesh>& meshes);
     int getNumVertices();
     glm::mat4 getModelMatrix();
 
@@ -79,10 +196,17 @@ public:
 
     // Call this to scale the model to fit within the screen upon load
     void fitToScreen(double zPos, double fovDegrees);
+    // The model matrix fitToScreen results in for a model with the bounding sphere bounds, used to
+    // show a model before it has finished loading
+    static glm::mat4 fitMatrix(const MeshBounds::Sphere& bounds, double zPos, double fovDegrees);
     void reset();
 
 private:
     string _fileName;
+    ImportOptions _importOptions;
+    LoadCallbacks _loadCallbacks;
+    ImportStatistics _importStatistics;
+    MemoryTracker::Account _memory;
     vector<string> _materials; // holds file names of relevent material files
     vector<Texture> _textures;
     glm::mat4 _modelMatrix;
@@ -90,26 +214,62 @@ private:
     glm::mat4 _rotationMatrix;
     glm::mat4 _translationMatrix;
 
-    vector<glm::vec3> _vertices;
     vector<glm::vec2> _uvs; // Texture UV coordinates
-    vector<glm::vec3> _boundingBox;
-    double _boundingSphereRadius;
+    MeshBounds::Box _bounds;
+    MeshBounds::Sphere _boundingSphere;
     vector<Mesh> _meshes;
+    std::unique_ptr<PointCloud> _pointCloud;
+    std::unique_ptr<PointCloudStream> _pointStream;
     int _numVertices;
     float _opacity;
+    size_t _uploadedBytes; // Size of the gpu buffers filled from the cache
 
     ILenum _ilError;
 
     bool _modelMatrixOutOfDate;
     bool _initialized;
 
-    void loadNode(aiNode* node, const aiScene* scene);
+    // converted marks the scene meshes already loaded, to count meshes shared between nodes
+    // Reads fileName with Assimp, including materials and textures
+    bool importScene(const string& fileName);
+    // Reads the meshes of fileName from its cache, if there is an up to date one, and uploads their geometry
+    bool loadCache(const string& fileName, ModelCache& cache);
+    // Creates a buffer holding bytes of data, filled through mapped ranges so the data is copied only once
+    GLuint uploadBuffer(const char* data, size_t bytes);
+    void loadNode(aiNode* node, const aiScene* scene, vector<bool>& converted);
     void loadMesh(aiMesh* mesh);
+    // Sets up the counters, buffer ids and full resolution level of a mesh whose geometry has been read
+    void initMesh(Mesh& m);
     void loadTextures(const aiScene* scene);
     void loadTexture(string fileName, Texture& texture);
+    // Every n-th vertex of the meshes, with n chosen so that at most maxPoints are returned
+    vector<glm::vec3> samplePoints(size_t maxPoints) const;
+    // Moves the meshes without faces out of _meshes, into an octree of their points
+    void buildPointCloud();
+    // Opens a preprocessed point cloud file in place of loading meshes
+    bool openPointStream(const string& fileName);
+    // Normals of the meshes read without them; each mesh is processed in parallel chunks
+    void generateNormals();
+    // Tangents of the meshes with a normal map, one mesh per thread
+    void generateTangents();
+    // Runs the optional per-mesh import stages (LOD generation, optimization) in parallel
+    void processMeshes();
+    void generateLods(Mesh& mesh);
+    void optimizeMesh(Mesh& mesh);
+    void compressVertices(Mesh& mesh);
+    void buildClusters(Mesh& mesh);
+    // Appends the edges of every level to the indices, those of the full resolution level grouped by
+    // cluster, on up to maxThreads threads (see Utils::parallelFor)
+    void extractEdges(Mesh& mesh, size_t maxThreads);
+    // Appends the edges of each cluster of the full resolution level to edges, and sets their ranges
+    void extractClusterEdges(Mesh& mesh, const vector<unsigned int>& positionIds, vector<unsigned int>& edges,
+                             size_t maxThreads);
+
+    // Registers the size of the meshes, vertices and textures with the memory tracker
+    void updateMemoryUsage();
 
-    void findBoundingBox(Mesh& mesh);
-    double distanceBetweenTwoPoints(glm::vec3 p1, glm::vec3 p2);
+    // Bounds of the meshes that don't have them yet, and of the whole model
+    void computeBounds();
 
     void checkILError();
 };
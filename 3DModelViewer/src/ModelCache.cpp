@@ -0,0 +1,532 @@
+#include "ModelCache.h"
+
+#include "QCryptographicHash"
+#include "QDateTime"
+#include "QDir"
+#include "QFileInfo"
+#include "QSaveFile"
+#include "QStandardPaths"
+
+#include "gtc/type_ptr.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char Magic[8] = { 'M', 'V', 'C', 'A', 'C', 'H', 'E', '\0' };
+// Increase whenever the layout below or the meaning of a cached mesh field changes
+const quint32 Version = 6;
+// Caches are written in native byte order; one written on a machine of the other order is ignored
+const quint32 ByteOrderMark = 0x01020304;
+// Every array starts at a multiple of this, so it can be used in place from the mapping
+const size_t Alignment = 16;
+
+// The import options that change the processed meshes
+struct OptionsKey {
+    qint32 profile;
+    qint32 generateLods;
+    qint32 maxLodLevels;
+    qint32 minLodTriangles;
+    qint32 optimizeMeshes;
+    qint32 compressVertices;
+    qint32 buildClusters;
+    qint32 minClusterTriangles;
+    qint32 useNativeImporter;
+    qint32 generateNormals;
+    float normalCreaseAngle;
+    qint32 generateTangents;
+    qint32 extractEdges;
+    float edgeFeatureAngle;
+    qint64 nativeObjMinBytes;
+};
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    qint64 sourceSize;
+    qint64 sourceModified; // Milliseconds since the epoch
+    OptionsKey options;
+    quint32 numTextures;
+    quint32 numMeshes;
+};
+
+// Followed by the name, then the arrays in the order of the counts
+struct MeshHeader {
+    quint32 nameLength;
+    qint32 matIndex;
+    qint32 textureIndex;
+    qint32 normalTextureIndex;
+    qint32 numFaces;
+    qint32 numVertices;
+    quint32 numLods;
+    quint32 numClusters;
+    quint32 numPositions;
+    quint32 numNormals;
+    quint32 numUvs;
+    quint32 numTangents;
+    quint32 numCompactVertices;
+    quint32 numIndices;
+    float acmrBefore;
+    float acmrAfter;
+    float boundsMin[3];
+    float boundsMax[3];
+    float sphereCenter[3];
+    float sphereRadius;
+    float positionDecode[16];
+    VertexCompressor::Error compressionError;
+};
+
+OptionsKey optionsKey(const Model::ImportOptions& options) {
+    // Zeroed first so the padding compares equal too
+    OptionsKey key;
+    memset(&key, 0, sizeof(key));
+    key.profile = options.profile;
+    key.generateLods = options.generateLods;
+    key.maxLodLevels = options.maxLodLevels;
+    key.minLodTriangles = options.minLodTriangles;
+    key.optimizeMeshes = options.optimizeMeshes;
+    key.compressVertices = options.compressVertices;
+    key.buildClusters = options.buildClusters;
+    key.minClusterTriangles = options.minClusterTriangles;
+    key.useNativeImporter = options.useNativeImporter;
+    key.generateNormals = options.generateNormals;
+    key.normalCreaseAngle = options.normalCreaseAngle;
+    key.generateTangents = options.generateTangents;
+    key.extractEdges = options.extractEdges;
+    key.edgeFeatureAngle = options.edgeFeatureAngle;
+    key.nativeObjMinBytes = qint64(options.nativeObjMinBytes);
+    return key;
+}
+
+qint64 modifiedTime(const QFileInfo& info) {
+    return info.lastModified().toMSecsSinceEpoch();
+}
+
+size_t padding(size_t offset) {
+    return (Alignment - offset % Alignment) % Alignment;
+}
+
+// Whether [offset, offset + count) lies within the first size values
+bool isRange(int offset, int count, size_t size) {
+    return offset >= 0 && count >= 0 && size_t(offset) + size_t(count) <= size;
+}
+
+// Whether everything drawn from a mesh read back from a cache stays within its arrays, which are
+// uploaded as they are: the attribute arrays match the vertex count, every index is a vertex, and
+// every level and cluster lies within the indices. A cache that is damaged, or stale in a way the
+// header doesn't show, would otherwise make the gpu read past its buffers.
+bool isConsistent(const MeshHeader& header, const Model::Mesh& mesh) {
+    const bool compact = header.numCompactVertices > 0;
+    const size_t numVertices = compact ? header.numCompactVertices : header.numPositions;
+    if(compact ? header.numPositions > 0 || header.numNormals > 0 || header.numUvs > 0
+               : (header.numNormals > 0 && header.numNormals != numVertices) || (header.numUvs > 0 && header.numUvs != numVertices))
+        return false;
+    if((header.numTangents > 0 && header.numTangents != numVertices) || header.numVertices < 0 || size_t(header.numVertices) != numVertices)
+        return false;
+
+    if(mesh.lods.empty())
+        return false;
+    for(const Model::Lod& lod : mesh.lods) {
+        if(!isRange(lod.indexOffset, lod.indexCount, header.numIndices) || !isRange(lod.edgeOffset, lod.edgeCount, header.numIndices))
+            return false;
+    }
+    for(const MeshClusterizer::Cluster& cluster : mesh.clusters) {
+        if(!isRange(cluster.indexOffset, cluster.indexCount, header.numIndices) || !isRange(cluster.edgeOffset, cluster.edgeCount, header.numIndices))
+            return false;
+    }
+    return true;
+}
+
+// Whether every one of count indices is below numVertices
+bool indicesInRange(const unsigned int* indices, size_t count, size_t numVertices) {
+    unsigned int largest = 0;
+    for(size_t i = 0; i < count; ++i)
+        largest = std::max(largest, indices[i]);
+    return count == 0 || largest < numVertices;
+}
+
+class Writer {
+
+public:
+    Writer(QIODevice& device) :
+      _device(device),
+      _offset(0),
+      _ok(true)
+    {}
+
+    void write(const void* data, size_t bytes) {
+        if(!_ok || bytes == 0)
+            return;
+        _ok = _device.write(static_cast<const char*>(data), qint64(bytes)) == qint64(bytes);
+        _offset += bytes;
+    }
+
+    void align() {
+        static const char zeros[Alignment] = {};
+        write(zeros, padding(_offset));
+    }
+
+    template<class T>
+    void writeArray(const vector<T>& values) {
+        align();
+        write(values.data(), values.size() * sizeof(T));
+    }
+
+    bool ok() const {
+        return _ok;
+    }
+
+private:
+    QIODevice& _device;
+    size_t _offset;
+    bool _ok;
+};
+
+class Reader {
+
+public:
+    Reader(const char* data, size_t size) :
+      _begin(data),
+      _position(data),
+      _end(data + size)
+    {}
+
+    // Returns count values at the current position and moves past them, or null if the file is too short
+    template<class T>
+    const T* take(size_t count) {
+        if(count > size_t(_end - _position) / sizeof(T))
+            return nullptr;
+        const T* values = reinterpret_cast<const T*>(_position);
+        _position += count * sizeof(T);
+        return values;
+    }
+
+    bool align() {
+        size_t pad = padding(size_t(_position - _begin));
+        if(pad > size_t(_end - _position))
+            return false;
+        _position += pad;
+        return true;
+    }
+
+    template<class T>
+    bool takeArray(size_t count, ModelCache::Range& range) {
+        if(!align())
+            return false;
+        range.data = reinterpret_cast<const char*>(take<T>(count));
+        range.bytes = count * sizeof(T);
+        return range.data != nullptr;
+    }
+
+    template<class T>
+    bool takeArray(size_t count, vector<T>& values) {
+        ModelCache::Range range;
+        if(!takeArray<T>(count, range))
+            return false;
+        const T* first = reinterpret_cast<const T*>(range.data);
+        values.assign(first, first + count);
+        return true;
+    }
+
+private:
+    const char* _begin;
+    const char* _position;
+    const char* _end;
+};
+
+}
+
+ModelCache::ModelCache() :
+  _data(nullptr),
+  _size(0)
+{}
+
+ModelCache::~ModelCache() {
+    close();
+}
+
+QString ModelCache::cacheFileName(const string& fileName) {
+    // Named after the absolute path of the model, so models with the same name don't collide
+    QString path = QFileInfo(QString::fromStdString(fileName)).absoluteFilePath();
+    QByteArray hash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex();
+    QDir directory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    return directory.filePath(QString("models/%1.mvcache").arg(QString(hash)));
+}
+
+bool ModelCache::write(const string& fileName, const Model::ImportOptions& options, const vector<Model::Mesh>& meshes,
+                       const vector<Model::Texture>& textures, string& error) {
+    QFileInfo source(QString::fromStdString(fileName));
+    QString path = cacheFileName(fileName);
+    if(!QDir().mkpath(QFileInfo(path).absolutePath())) {
+        error = "Could not create the cache directory";
+        return false;
+    }
+
+    // Written to a temporary file that replaces the cache once complete, so a cache is never half written
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly)) {
+        error = file.errorString().toStdString();
+        return false;
+    }
+    Writer writer(file);
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.byteOrder = ByteOrderMark;
+    header.sourceSize = source.size();
+    header.sourceModified = modifiedTime(source);
+    header.options = optionsKey(options);
+    header.numTextures = quint32(textures.size());
+    header.numMeshes = quint32(meshes.size());
+    writer.write(&header, sizeof(header));
+
+    for(const Model::Texture& texture : textures) {
+        quint32 length = quint32(texture.fileName.size());
+        writer.align();
+        writer.write(&length, sizeof(length));
+        writer.write(texture.fileName.data(), length);
+    }
+
+    for(const Model::Mesh& mesh : meshes) {
+        MeshHeader meshHeader = MeshHeader();
+        meshHeader.nameLength = quint32(mesh.name.size());
+        meshHeader.matIndex = mesh.matIndex;
+        meshHeader.textureIndex = meshHeader.normalTextureIndex = -1;
+        for(size_t i = 0; i < textures.size(); ++i) {
+            if(mesh.diffuseTexture.texId != 0 && textures[i].texId == mesh.diffuseTexture.texId)
+                meshHeader.textureIndex = int(i);
+            if(mesh.normalTexture.texId != 0 && textures[i].texId == mesh.normalTexture.texId)
+                meshHeader.normalTextureIndex = int(i);
+        }
+        meshHeader.numFaces = mesh.numFaces;
+        meshHeader.numVertices = mesh.numVertices;
+        meshHeader.numLods = quint32(mesh.lods.size());
+        meshHeader.numClusters = quint32(mesh.clusters.size());
+        meshHeader.numIndices = quint32(mesh.indices.size());
+        meshHeader.acmrBefore = mesh.acmrBefore;
+        meshHeader.acmrAfter = mesh.acmrAfter;
+
+        // Only what the renderer uploads is stored: the compact vertices replace the float arrays
+        bool compact = !mesh.compactVertices.empty();
+        meshHeader.numPositions = compact ? 0 : quint32(mesh.vertices.size());
+        meshHeader.numNormals = compact ? 0 : quint32(mesh.normals.size());
+        meshHeader.numUvs = compact ? 0 : quint32(mesh.uvs.size());
+        meshHeader.numTangents = quint32(mesh.tangents.size());
+        meshHeader.numCompactVertices = quint32(mesh.compactVertices.size());
+
+        for(int axis = 0; axis < 3; ++axis) {
+            meshHeader.boundsMin[axis] = mesh.bounds.min[axis];
+            meshHeader.boundsMax[axis] = mesh.bounds.max[axis];
+            meshHeader.sphereCenter[axis] = mesh.boundingSphere.center[axis];
+        }
+        meshHeader.sphereRadius = mesh.boundingSphere.radius;
+        memcpy(meshHeader.positionDecode, &mesh.positionDecode[0][0], sizeof(meshHeader.positionDecode));
+        meshHeader.compressionError = mesh.compressionError;
+
+        writer.align();
+        writer.write(&meshHeader, sizeof(meshHeader));
+        writer.write(mesh.name.data(), mesh.name.size());
+        writer.writeArray(mesh.lods);
+        writer.writeArray(mesh.clusters);
+        if(!compact) {
+            writer.writeArray(mesh.vertices);
+            writer.writeArray(mesh.normals);
+            writer.writeArray(mesh.uvs);
+        }
+        writer.writeArray(mesh.tangents);
+        writer.writeArray(mesh.compactVertices);
+        writer.writeArray(mesh.indices);
+    }
+
+    if(!writer.ok() || !file.commit()) {
+        error = file.errorString().toStdString();
+        return false;
+    }
+    return true;
+}
+
+bool ModelCache::open(const string& fileName, const Model::ImportOptions& options, vector<Model::Mesh>& meshes,
+                      vector<string>& textures, vector<int>& meshTextures, vector<int>& meshNormalTextures, string& error) {
+    close();
+
+    QFileInfo source(QString::fromStdString(fileName));
+    _file.setFileName(cacheFileName(fileName));
+    if(!source.isFile() || !_file.exists()) {
+        error = "No cache";
+        return false;
+    }
+    if(!_file.open(QIODevice::ReadOnly)) {
+        error = _file.errorString().toStdString();
+        return false;
+    }
+    _size = size_t(_file.size());
+    _data = _size > 0 ? reinterpret_cast<const char*>(_file.map(0, _file.size())) : nullptr;
+    if(!_data) {
+        error = "Could not map the cache";
+        close();
+        return false;
+    }
+
+    Reader reader(_data, _size);
+    const FileHeader* header = reader.take<FileHeader>(1);
+    OptionsKey key = optionsKey(options);
+    if(!header || memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version || header->byteOrder != ByteOrderMark)
+        error = "Written by another version";
+    else if(header->sourceSize != source.size() || header->sourceModified != modifiedTime(source))
+        error = "Out of date";
+    else if(memcmp(&header->options, &key, sizeof(key)) != 0)
+        error = "Written with other import options";
+    if(!error.empty()) {
+        close();
+        return false;
+    }
+
+    // Everything is read into these first, so nothing is returned from a damaged cache
+    vector<string> cachedTextures;
+    vector<int> cachedMeshTextures, cachedMeshNormalTextures;
+    vector<Model::Mesh> cachedMeshes;
+    bool ok = true;
+
+    for(quint32 i = 0; ok && i < header->numTextures; ++i) {
+        const quint32* length = reader.align() ? reader.take<quint32>(1) : nullptr;
+        const char* name = length ? reader.take<char>(*length) : nullptr;
+        if(name)
+            cachedTextures.push_back(string(name, *length));
+        ok = name != nullptr;
+    }
+
+    for(quint32 i = 0; ok && i < header->numMeshes; ++i) {
+        const MeshHeader* meshHeader = reader.align() ? reader.take<MeshHeader>(1) : nullptr;
+        const char* name = meshHeader ? reader.take<char>(meshHeader->nameLength) : nullptr;
+        if(!name) {
+            ok = false;
+            break;
+        }
+
+        Model::Mesh mesh;
+        Geometry geometry;
+        ok = reader.takeArray(meshHeader->numLods, mesh.lods)
+          && reader.takeArray(meshHeader->numClusters, mesh.clusters)
+          && reader.takeArray<glm::vec3>(meshHeader->numPositions, geometry.vertices)
+          && reader.takeArray<glm::vec3>(meshHeader->numNormals, geometry.normals)
+          && reader.takeArray<glm::vec2>(meshHeader->numUvs, geometry.uvs)
+          && reader.takeArray<uint32_t>(meshHeader->numTangents, geometry.tangents)
+          && reader.takeArray<VertexCompressor::CompactVertex>(meshHeader->numCompactVertices, geometry.compactVertices)
+          && reader.takeArray<unsigned int>(meshHeader->numIndices, geometry.indices);
+        if(!ok)
+            break;
+        if(!isConsistent(*meshHeader, mesh) ||
+           !indicesInRange(reinterpret_cast<const unsigned int*>(geometry.indices.data), meshHeader->numIndices, size_t(meshHeader->numVertices))) {
+            error = "Inconsistent mesh " + string(name, meshHeader->nameLength);
+            ok = false;
+            break;
+        }
+
+        mesh.name = string(name, meshHeader->nameLength);
+        mesh.matIndex = meshHeader->matIndex;
+        mesh.numFaces = meshHeader->numFaces;
+        mesh.numVertices = meshHeader->numVertices;
+        mesh.acmrBefore = meshHeader->acmrBefore;
+        mesh.acmrAfter = meshHeader->acmrAfter;
+        mesh.bounds.min = glm::make_vec3(meshHeader->boundsMin);
+        mesh.bounds.max = glm::make_vec3(meshHeader->boundsMax);
+        mesh.boundingSphere.center = glm::make_vec3(meshHeader->sphereCenter);
+        mesh.boundingSphere.radius = meshHeader->sphereRadius;
+        memcpy(&mesh.positionDecode[0][0], meshHeader->positionDecode, sizeof(meshHeader->positionDecode));
+        mesh.compressionError = meshHeader->compressionError;
+        mesh.vertexBuffer = mesh.uvBuffer = mesh.normalBuffer = mesh.tangentBuffer = mesh.indexBuffer = mesh.compactBuffer = 0;
+        mesh.vertexArray = 0;
+        mesh.diffuseTexture.texId = mesh.normalTexture.texId = 0;
+
+        geometry.positionDecode = mesh.positionDecode;
+        _geometry.push_back(geometry);
+        cachedMeshes.push_back(std::move(mesh));
+
+        int texture = meshHeader->textureIndex;
+        cachedMeshTextures.push_back(texture >= 0 && texture < int(cachedTextures.size()) ? texture : -1);
+        int normalTexture = meshHeader->normalTextureIndex;
+        cachedMeshNormalTextures.push_back(normalTexture >= 0 && normalTexture < int(cachedTextures.size()) ? normalTexture : -1);
+    }
+
+    if(!ok) {
+        if(error.empty())
+            error = "Truncated";
+        close();
+        return false;
+    }
+
+    textures.insert(textures.end(), cachedTextures.begin(), cachedTextures.end());
+    meshTextures.insert(meshTextures.end(), cachedMeshTextures.begin(), cachedMeshTextures.end());
+    meshNormalTextures.insert(meshNormalTextures.end(), cachedMeshNormalTextures.begin(), cachedMeshNormalTextures.end());
+    for(Model::Mesh& mesh : cachedMeshes)
+        meshes.push_back(std::move(mesh));
+    return true;
+}
+
+void ModelCache::close() {
+    if(_data)
+        _file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(_data)));
+    _file.close();
+    _data = nullptr;
+    _size = 0;
+    _geometry.clear();
+}
+
+size_t ModelCache::size() const {
+    return _size;
+}
+
+const ModelCache::Geometry& ModelCache::geometry(size_t mesh) const {
+    return _geometry[mesh];
+}
+
+void ModelCache::readPositions(size_t mesh, vector<glm::vec3>& positions) const {
+    const Geometry& geometry = _geometry[mesh];
+    if(geometry.compactVertices.bytes > 0) {
+        size_t count = geometry.compactVertices.bytes / sizeof(VertexCompressor::CompactVertex);
+        const VertexCompressor::CompactVertex* vertices = reinterpret_cast<const VertexCompressor::CompactVertex*>(geometry.compactVertices.data);
+        positions.resize(count);
+        for(size_t i = 0; i < count; ++i) {
+            glm::vec3 normalized = glm::vec3(vertices[i].position[0], vertices[i].position[1], vertices[i].position[2]) / 65535.0f;
+            positions[i] = glm::vec3(geometry.positionDecode * glm::vec4(normalized, 1.0f));
+        }
+    }
+    else {
+        const glm::vec3* vertices = reinterpret_cast<const glm::vec3*>(geometry.vertices.data);
+        positions.assign(vertices, vertices + geometry.vertices.bytes / sizeof(glm::vec3));
+    }
+}
+
+vector<glm::vec3> ModelCache::samplePoints(size_t maxPoints) const {
+    size_t numVertices = 0;
+    for(const Geometry& geometry : _geometry)
+        numVertices += geometry.vertices.bytes / sizeof(glm::vec3) + geometry.compactVertices.bytes / sizeof(VertexCompressor::CompactVertex);
+    size_t step = std::max<size_t>(1, (numVertices + maxPoints - 1) / maxPoints);
+
+    // Only the sampled vertices are touched, so the rest of the mapping is not read in
+    vector<glm::vec3> points;
+    points.reserve(std::min(numVertices, maxPoints));
+    size_t next = 0;
+    for(const Geometry& geometry : _geometry) {
+        const glm::vec3* positions = reinterpret_cast<const glm::vec3*>(geometry.vertices.data);
+        const VertexCompressor::CompactVertex* compact = reinterpret_cast<const VertexCompressor::CompactVertex*>(geometry.compactVertices.data);
+        bool isCompact = geometry.compactVertices.bytes > 0;
+        size_t count = isCompact ? geometry.compactVertices.bytes / sizeof(VertexCompressor::CompactVertex) : geometry.vertices.bytes / sizeof(glm::vec3);
+
+        for(; next < count; next += step) {
+            if(isCompact) {
+                glm::vec3 normalized = glm::vec3(compact[next].position[0], compact[next].position[1], compact[next].position[2]) / 65535.0f;
+                points.push_back(glm::vec3(geometry.positionDecode * glm::vec4(normalized, 1.0f)));
+            }
+            else {
+                points.push_back(positions[next]);
+            }
+        }
+        next -= count;
+    }
+    return points;
+}
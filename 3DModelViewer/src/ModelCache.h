@@ -0,0 +1,75 @@
+#pragma once
+
+#include "QFile"
+#include "QString"
+
+#include "Model.h"
+
+#include <vector>
+#include <string>
+
+using std::vector;
+using std::string;
+
+// Binary snapshot of a model's processed meshes (levels of detail, optimized order, compact
+// vertices, clusters, bounds) and the textures they use, kept in the user's cache directory so
+// reopening a model skips importing and processing it again. A cache is only used while the
+// model file has the size and modification time it was written for, and with the same import
+// options. Reading maps the file; the geometry stays in the mapping, laid out exactly as it goes
+// into GL buffers, so it can be copied straight from the page cache into the driver.
+class ModelCache {
+
+public:
+    // A range of the mapped file; empty when the mesh has no such data
+    struct Range {
+        const char* data;
+        size_t bytes;
+    };
+
+    // What a mesh uploads to the gpu. Compact meshes only have compactVertices, tangents and indices.
+    struct Geometry {
+        Range vertices;
+        Range normals;
+        Range uvs;
+        Range tangents;
+        Range compactVertices;
+        Range indices;
+        glm::mat4 positionDecode;
+    };
+
+    ModelCache();
+    ~ModelCache();
+
+    // File the cache of fileName is kept in
+    static QString cacheFileName(const string& fileName);
+
+    // Writes the cache of fileName. textures are those the meshes' diffuse and normal textures were loaded from.
+    static bool write(const string& fileName, const Model::ImportOptions& options, const vector<Model::Mesh>& meshes,
+                      const vector<Model::Texture>& textures, string& error);
+
+    // Maps the cache of fileName if there is an up to date one for options. meshes receive everything
+    // but their geometry, which is available through geometry() until the cache is closed.
+    // textures receives the file name of each texture, and meshTextures and meshNormalTextures the
+    // index into it of each mesh's diffuse texture and normal map, or -1. Returns false and sets
+    // error if there is no usable cache, including one whose indices or ranges point past its arrays.
+    bool open(const string& fileName, const Model::ImportOptions& options, vector<Model::Mesh>& meshes,
+              vector<string>& textures, vector<int>& meshTextures, vector<int>& meshNormalTextures, string& error);
+    void close();
+
+    // Size of the mapped file
+    size_t size() const;
+    const Geometry& geometry(size_t mesh) const;
+    // Object space vertex positions of a mesh, decoded from its compact vertices if it has them
+    void readPositions(size_t mesh, vector<glm::vec3>& positions) const;
+    // Every n-th vertex position of the meshes, read from the mapping; see Model::samplePoints
+    vector<glm::vec3> samplePoints(size_t maxPoints) const;
+
+private:
+    ModelCache(const ModelCache&);
+    ModelCache& operator=(const ModelCache&);
+
+    QFile _file;
+    const char* _data;
+    size_t _size;
+    vector<Geometry> _geometry;
+};
@@ -0,0 +1,116 @@
+#include "ModelLoader.h"
+
+#include "QCoreApplication"
+#include "QDebug"
+
+#include <stdexcept>
+
+ModelLoader::Progress::Progress() :
+  hasBounds(false),
+  hasPreview(false)
+{}
+
+ModelLoader::ModelLoader(const string& fileName, Model::ImportOptions options, QObject* parent) :
+  QThread(parent),
+  _fileName(fileName),
+  _options(options),
+  _loaded(false),
+  _contextCreated(false)
+{
+    _surface.setFormat(QSurfaceFormat::defaultFormat());
+    _surface.create();
+
+    // Textures and buffers created by the model on this context are drawn by the viewers' contexts,
+    // so without the global share context (Qt::AA_ShareOpenGLContexts) the load fails
+    if(!QOpenGLContext::globalShareContext()) {
+        qWarning() << "No global share context to load" << fileName.c_str() << "with";
+    }
+    else {
+        _context.setFormat(QSurfaceFormat::defaultFormat());
+        _context.setShareContext(QOpenGLContext::globalShareContext());
+        _contextCreated = _context.create();
+        if(!_contextCreated)
+            qWarning() << "Could not create an OpenGL context for loading" << fileName.c_str();
+    }
+    _context.moveToThread(this);
+}
+
+ModelLoader::~ModelLoader() {
+    wait();
+
+    // A model that was never taken deletes its textures, which needs its context
+    if(_model && _contextCreated && _context.makeCurrent(&_surface)) {
+        _model.reset();
+        _context.doneCurrent();
+    }
+}
+
+ModelLoader::Progress ModelLoader::takeProgress() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Progress progress;
+    std::swap(progress, _progress);
+    return progress;
+}
+
+bool ModelLoader::isLoaded() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _loaded;
+}
+
+unique_ptr<Model> ModelLoader::takeModel() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return std::move(_model);
+}
+
+void ModelLoader::run() {
+    Model::LoadCallbacks callbacks;
+    callbacks.bounds = [this](const MeshBounds::Box& box, const MeshBounds::Sphere& sphere) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _progress.hasBounds = true;
+            _progress.bounds = box;
+            _progress.sphere = sphere;
+        }
+        emit progressed();
+    };
+    callbacks.preview = [this](const vector<glm::vec3>& points) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _progress.hasPreview = true;
+            _progress.preview = points;
+        }
+        emit progressed();
+    };
+    callbacks.meshLoaded = [this](const Model::Mesh& mesh, size_t index) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _progress.meshes.push_back(&mesh);
+            _progress.meshIndices.push_back(index);
+        }
+        emit progressed();
+    };
+
+    unique_ptr<Model> model;
+    if(_contextCreated && _context.makeCurrent(&_surface)) {
+        try {
+            model.reset(new Model(_fileName, _options, callbacks));
+        }
+        catch(std::runtime_error& error) {
+            qWarning() << _fileName.c_str() << ":" << error.what();
+        }
+
+        if(model && !model->initialized())
+            model.reset();
+        _context.doneCurrent();
+    }
+
+    // The context goes back to the GUI thread, which deletes it and any model left behind
+    _context.moveToThread(QCoreApplication::instance()->thread());
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _model = std::move(model);
+        _loaded = true;
+    }
+    emit loaded();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "QThread"
+#include "QOffscreenSurface"
+#include "QOpenGLContext"
+
+#include "Model.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
+
+using std::vector;
+using std::string;
+using std::unique_ptr;
+
+// Loads a model on a background thread, handing out what is known about it as soon as it is
+// known: its bounds once the geometry has been read, a sample of its vertices, then each mesh as
+// its processing finishes. The thread has its own GL context, shared with the viewers through
+// the global share context, for the textures and buffers the model creates; the loader must
+// outlive the model it loaded.
+class ModelLoader : public QThread {
+    Q_OBJECT
+
+public:
+    // What has arrived since the previous call to takeProgress
+    struct Progress {
+        Progress();
+
+        bool hasBounds;
+        MeshBounds::Box bounds;
+        MeshBounds::Sphere sphere;
+        bool hasPreview;
+        vector<glm::vec3> preview;
+        // Meshes of the model being loaded, which are announced once they won't change again. The
+        // model is kept by the loader until takeModel, so these point into it instead of copying its arrays.
+        vector<const Model::Mesh*> meshes;
+        vector<size_t> meshIndices; // Index of each of meshes in the finished model
+    };
+
+    // Must be constructed on the GUI thread, since that is the only thread offscreen surfaces can be created on
+    ModelLoader(const string& fileName, Model::ImportOptions options, QObject* parent = 0);
+    // Waits for the load to finish
+    ~ModelLoader();
+
+    Progress takeProgress();
+    // True once the load has ended, successfully or not
+    bool isLoaded();
+    // The model once isLoaded(), or null if it could not be read. Can be taken once.
+    unique_ptr<Model> takeModel();
+
+signals:
+    // Emitted from the loading threads whenever takeProgress has something new
+    void progressed();
+    // Emitted once the load has ended
+    void loaded();
+
+protected:
+    void run() override;
+
+private:
+    string _fileName;
+    Model::ImportOptions _options;
+    QOffscreenSurface _surface;
+    QOpenGLContext _context;
+    bool _contextCreated; // False without a global share context, which fails the load
+
+    // Guards everything below, which is written by the loading threads
+    std::mutex _mutex;
+    Progress _progress;
+    unique_ptr<Model> _model;
+    bool _loaded;
+};
@@ -0,0 +1,381 @@
+#include "ModelPicker.h"
+#include "ModelCache.h"
+#include "Utils.h"
+
+#include "QDebug"
+#include "QElapsedTimer"
+
+#include "gtc/matrix_inverse.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MODELPICKER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Triangles per task when preparing a mesh
+const size_t ChunkTriangles = 1 << 16;
+// Leaves hold what one SSE test covers
+const size_t LeafTriangles = 4;
+
+}
+
+ModelPicker::Hit::Hit() :
+  found(false),
+  mesh(0),
+  triangle(0),
+  position(0.0f),
+  normal(0.0f),
+  microseconds(0.0)
+{}
+
+ModelPicker::ModelPicker(const Model& model, QObject* parent) :
+  QThread(parent),
+  _model(model),
+  _hasQuery(false),
+  _hasHit(false),
+  _built(false),
+  _stopping(false),
+  _buildMilliseconds(0.0)
+{}
+
+ModelPicker::~ModelPicker() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    wait();
+}
+
+void ModelPicker::pick(const glm::vec3& origin, const glm::vec3& direction, const glm::mat4& modelMatrix) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _query.origin = origin;
+        _query.direction = direction;
+        _query.modelMatrix = modelMatrix;
+        _hasQuery = true;
+    }
+    _wake.notify_all();
+}
+
+bool ModelPicker::takeHit(Hit& hit) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(!_hasHit)
+        return false;
+    hit = _hit;
+    _hasHit = false;
+    return true;
+}
+
+bool ModelPicker::isBuilt() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _built;
+}
+
+double ModelPicker::getBuildMilliseconds() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _buildMilliseconds;
+}
+
+MemoryTracker::Usage ModelPicker::getMemoryUsage() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _memory.usage();
+}
+
+bool ModelPicker::isStopping() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stopping;
+}
+
+void ModelPicker::run() {
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this]() { return _hasQuery || _stopping; });
+            if(_stopping)
+                return;
+        }
+
+        // Nothing is built until the first query, so models that are never picked cost nothing
+        if(!isBuilt())
+            build();
+
+        Query query;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if(_stopping)
+                return;
+            query = _query;
+            _hasQuery = false;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        Hit hit = intersect(query);
+        hit.microseconds = timer.nsecsElapsed() / 1e3;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _hit = hit;
+            _hasHit = true;
+        }
+        emit picked();
+    }
+}
+
+void ModelPicker::build() {
+    QElapsedTimer timer;
+    timer.start();
+
+    const vector<Model::Mesh>& meshes = _model.getMeshes();
+
+    // Meshes loaded from the cache only have their geometry on the gpu, so it is read from the cache again
+    ModelCache cache;
+    bool cacheOpen = false;
+    if(std::any_of(meshes.begin(), meshes.end(), [](const Model::Mesh& mesh) { return mesh.uploaded; })) {
+        vector<Model::Mesh> cachedMeshes;
+        vector<string> textures;
+        vector<int> meshTextures, meshNormalTextures;
+        string error;
+        cacheOpen = cache.open(_model.getFileName(), _model.getImportOptions(), cachedMeshes, textures, meshTextures, meshNormalTextures, error)
+                 && cachedMeshes.size() == meshes.size();
+        if(!cacheOpen)
+            qWarning() << "Meshes of" << _model.getFileName().c_str() << "that were read from the cache can't be picked:" << error.c_str();
+    }
+
+    vector<MeshBounds::Box> meshBoxes;
+    for(size_t i = 0; i < meshes.size(); ++i) {
+        // Each mesh is built with every thread, so stopping is checked in between
+        if(isStopping())
+            return;
+
+        const Model::Mesh& mesh = meshes[i];
+        int indexOffset = mesh.lods.empty() ? 0 : mesh.lods[0].indexOffset;
+        int indexCount = mesh.lods.empty() ? int(mesh.indices.size()) : mesh.lods[0].indexCount;
+
+        const glm::vec3* positions = mesh.vertices.data();
+        size_t numPositions = mesh.vertices.size();
+        const unsigned int* indices = mesh.indices.data() + indexOffset;
+        vector<glm::vec3> cachedPositions;
+        if(mesh.uploaded) {
+            if(!cacheOpen)
+                continue;
+            const ModelCache::Geometry& geometry = cache.geometry(i);
+            cache.readPositions(i, cachedPositions);
+            positions = cachedPositions.data();
+            numPositions = cachedPositions.size();
+            indices = reinterpret_cast<const unsigned int*>(geometry.indices.data) + indexOffset;
+            if(size_t(indexOffset + indexCount) * sizeof(unsigned int) > geometry.indices.bytes)
+                continue;
+        }
+
+        MeshTriangles triangles;
+        buildMesh(positions, numPositions, indices, size_t(indexCount), triangles);
+        if(triangles.bvh.isEmpty())
+            continue;
+
+        MeshBounds::Box box;
+        box.min = triangles.bvh.nodes()[0].min;
+        box.max = triangles.bvh.nodes()[0].max;
+        meshBoxes.push_back(box);
+        _meshes.push_back(std::move(triangles));
+        _meshIndices.push_back(i);
+    }
+    cache.close();
+
+    // There is no instancing in the model, so the top level holds one leaf per mesh, in object space
+    _topLevel.build(meshBoxes, 1);
+
+    size_t bytes = _topLevel.memoryBytes() + _meshIndices.capacity() * sizeof(size_t);
+    for(const MeshTriangles& triangles : _meshes) {
+        bytes += triangles.bvh.memoryBytes() + triangles.triangle.capacity() * sizeof(uint32_t);
+        for(int axis = 0; axis < 3; ++axis)
+            bytes += (triangles.v0[axis].capacity() + triangles.edge1[axis].capacity() + triangles.edge2[axis].capacity()) * sizeof(float);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _built = true;
+    _buildMilliseconds = timer.nsecsElapsed() / 1e6;
+    _memory.set(MemoryTracker::PickingData, bytes);
+    qDebug() << "Built picking hierarchies of" << _meshes.size() << "meshes in" << _buildMilliseconds << "ms";
+}
+
+void ModelPicker::buildMesh(const glm::vec3* positions, size_t numPositions, const unsigned int* indices, size_t numIndices,
+                            MeshTriangles& triangles) {
+    size_t numTriangles = numIndices / 3;
+    size_t numChunks = (numTriangles + ChunkTriangles - 1) / ChunkTriangles;
+    auto isValid = [&](size_t triangle) {
+        return indices[3 * triangle] < numPositions && indices[3 * triangle + 1] < numPositions && indices[3 * triangle + 2] < numPositions;
+    };
+
+    // Triangles with indices out of range keep an empty box, and zero edges so they are never hit
+    vector<MeshBounds::Box> boxes(numTriangles);
+    Utils::parallelFor(numChunks, [&](size_t chunk) {
+        size_t end = std::min(numTriangles, (chunk + 1) * ChunkTriangles);
+        for(size_t t = chunk * ChunkTriangles; t < end; ++t) {
+            if(!isValid(t))
+                continue;
+            for(int k = 0; k < 3; ++k) {
+                boxes[t].min = glm::min(boxes[t].min, positions[indices[3 * t + k]]);
+                boxes[t].max = glm::max(boxes[t].max, positions[indices[3 * t + k]]);
+            }
+        }
+    });
+
+    triangles.bvh.build(boxes, LeafTriangles);
+    if(triangles.bvh.isEmpty())
+        return;
+
+    // Copied in leaf order, so a leaf's triangles are next to each other in every array
+    const vector<uint32_t>& order = triangles.bvh.order();
+    for(int axis = 0; axis < 3; ++axis) {
+        triangles.v0[axis].assign(numTriangles + 3, 0.0f);
+        triangles.edge1[axis].assign(numTriangles + 3, 0.0f);
+        triangles.edge2[axis].assign(numTriangles + 3, 0.0f);
+    }
+    triangles.triangle.assign(numTriangles + 3, 0);
+
+    Utils::parallelFor(numChunks, [&](size_t chunk) {
+        size_t end = std::min(numTriangles, (chunk + 1) * ChunkTriangles);
+        for(size_t i = chunk * ChunkTriangles; i < end; ++i) {
+            uint32_t t = order[i];
+            triangles.triangle[i] = t;
+            if(!isValid(t))
+                continue;
+            glm::vec3 v0 = positions[indices[3 * t]];
+            glm::vec3 edge1 = positions[indices[3 * t + 1]] - v0;
+            glm::vec3 edge2 = positions[indices[3 * t + 2]] - v0;
+            for(int axis = 0; axis < 3; ++axis) {
+                triangles.v0[axis][i] = v0[axis];
+                triangles.edge1[axis][i] = edge1[axis];
+                triangles.edge2[axis][i] = edge2[axis];
+            }
+        }
+    });
+}
+
+ModelPicker::Hit ModelPicker::intersect(const Query& query) const {
+    Hit hit;
+    if(_topLevel.isEmpty())
+        return hit;
+
+    // The hierarchies are in object space, so the ray is moved there instead
+    glm::mat4 inverse = glm::inverse(query.modelMatrix);
+    glm::vec3 origin = glm::vec3(inverse * glm::vec4(query.origin, 1.0f));
+    glm::vec3 direction = glm::vec3(inverse * glm::vec4(query.direction, 0.0f));
+
+    float closest = FLT_MAX;
+    size_t hitMesh = 0;
+    uint32_t hitIndex = 0;
+    const vector<uint32_t>& meshOrder = _topLevel.order();
+    _topLevel.traverse(origin, direction, closest, [&](uint32_t first, uint32_t count, float) {
+        for(uint32_t m = first; m < first + count; ++m) {
+            const MeshTriangles& triangles = _meshes[meshOrder[m]];
+            triangles.bvh.traverse(origin, direction, closest, [&](uint32_t leafFirst, uint32_t leafCount, float maxDistance) {
+                uint32_t index;
+                float distance = intersectLeaf(triangles, leafFirst, leafCount, origin, direction, maxDistance, index);
+                if(distance < closest) {
+                    closest = distance;
+                    hitMesh = meshOrder[m];
+                    hitIndex = index;
+                }
+                return closest;
+            });
+        }
+        return closest;
+    });
+
+    if(closest == FLT_MAX)
+        return hit;
+
+    const MeshTriangles& triangles = _meshes[hitMesh];
+    glm::vec3 edge1(triangles.edge1[0][hitIndex], triangles.edge1[1][hitIndex], triangles.edge1[2][hitIndex]);
+    glm::vec3 edge2(triangles.edge2[0][hitIndex], triangles.edge2[1][hitIndex], triangles.edge2[2][hitIndex]);
+    glm::vec3 normal = glm::normalize(glm::inverseTranspose(glm::mat3(query.modelMatrix)) * glm::cross(edge1, edge2));
+
+    hit.found = true;
+    hit.mesh = _meshIndices[hitMesh];
+    hit.meshName = _model.getMeshes()[hit.mesh].name;
+    hit.triangle = triangles.triangle[hitIndex];
+    hit.position = glm::vec3(query.modelMatrix * glm::vec4(origin + closest * direction, 1.0f));
+    hit.normal = glm::dot(normal, query.direction) > 0.0f ? -normal : normal;
+    return hit;
+}
+
+float ModelPicker::intersectLeaf(const MeshTriangles& triangles, uint32_t first, uint32_t count,
+                                 const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t& hitIndex) {
+#ifdef MODELPICKER_SSE2
+    // Moller-Trumbore for the four triangles of the leaf at once, with the lanes past count masked off
+    __m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+    __m128 e1x = _mm_loadu_ps(&triangles.edge1[0][first]);
+    __m128 e1y = _mm_loadu_ps(&triangles.edge1[1][first]);
+    __m128 e1z = _mm_loadu_ps(&triangles.edge1[2][first]);
+    __m128 e2x = _mm_loadu_ps(&triangles.edge2[0][first]);
+    __m128 e2y = _mm_loadu_ps(&triangles.edge2[1][first]);
+    __m128 e2z = _mm_loadu_ps(&triangles.edge2[2][first]);
+
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    __m128 sx = _mm_sub_ps(_mm_set1_ps(origin.x), _mm_loadu_ps(&triangles.v0[0][first]));
+    __m128 sy = _mm_sub_ps(_mm_set1_ps(origin.y), _mm_loadu_ps(&triangles.v0[1][first]));
+    __m128 sz = _mm_sub_ps(_mm_set1_ps(origin.z), _mm_loadu_ps(&triangles.v0[2][first]));
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDet);
+
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDet);
+    __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+    // Degenerate triangles have a zero determinant, which turns u, v and t into NaNs that fail every test
+    __m128 zero = _mm_setzero_ps();
+    __m128 mask = _mm_cmplt_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), _mm_set1_ps(float(count)));
+    mask = _mm_and_ps(mask, _mm_cmpneq_ps(det, zero));
+    mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmplt_ps(t, _mm_set1_ps(maxDistance))));
+
+    int lanes = _mm_movemask_ps(mask);
+    if(lanes == 0)
+        return maxDistance;
+
+    float distances[4];
+    _mm_storeu_ps(distances, t);
+    for(uint32_t lane = 0; lane < 4; ++lane) {
+        if((lanes & (1 << lane)) && distances[lane] < maxDistance) {
+            maxDistance = distances[lane];
+            hitIndex = first + lane;
+        }
+    }
+    return maxDistance;
+#else
+    for(uint32_t i = first; i < first + count; ++i) {
+        glm::vec3 edge1(triangles.edge1[0][i], triangles.edge1[1][i], triangles.edge1[2][i]);
+        glm::vec3 edge2(triangles.edge2[0][i], triangles.edge2[1][i], triangles.edge2[2][i]);
+        glm::vec3 p = glm::cross(direction, edge2);
+        float det = glm::dot(edge1, p);
+        if(det == 0.0f)
+            continue;
+        float inverseDet = 1.0f / det;
+        glm::vec3 s = origin - glm::vec3(triangles.v0[0][i], triangles.v0[1][i], triangles.v0[2][i]);
+        float u = glm::dot(s, p) * inverseDet;
+        glm::vec3 q = glm::cross(s, edge1);
+        float v = glm::dot(direction, q) * inverseDet;
+        float t = glm::dot(edge2, q) * inverseDet;
+        if(u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t < maxDistance) {
+            maxDistance = t;
+            hitIndex = i;
+        }
+    }
+    return maxDistance;
+#endif
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "QThread"
+
+#include "Bvh.h"
+#include "Model.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <string>
+
+using std::vector;
+using std::string;
+
+// Finds the mesh and triangle under a ray. Each mesh gets a BVH over its full resolution
+// triangles, whose leaves hold up to four triangles tested at once with SSE, and a BVH over the
+// mesh bounds sits on top of them. Everything runs on the picker's own thread: the hierarchies are
+// built on the first request, and each answer is announced with picked(). The model must outlive
+// the picker, and must not change while it is alive.
+class ModelPicker : public QThread {
+    Q_OBJECT
+
+public:
+    struct Hit {
+        Hit();
+
+        bool found;
+        size_t mesh;
+        string meshName;
+        uint32_t triangle;  // Index of the triangle in the mesh's full resolution level
+        glm::vec3 position; // World space
+        glm::vec3 normal;   // World space, facing the ray
+        double microseconds; // Time taken by the query, not counting the build
+    };
+
+    ModelPicker(const Model& model, QObject* parent = 0);
+    // Stops the thread, abandoning a build in progress after the mesh it is working on
+    ~ModelPicker();
+
+    // Queues a query for the world space ray origin + t * direction against the model drawn with
+    // modelMatrix. Only the latest query is kept if the thread is busy.
+    void pick(const glm::vec3& origin, const glm::vec3& direction, const glm::mat4& modelMatrix);
+    // The answer to the latest query, if it has arrived since the last call
+    bool takeHit(Hit& hit);
+
+    bool isBuilt();
+    double getBuildMilliseconds();
+    // Memory held by the hierarchies and their copies of the triangles
+    MemoryTracker::Usage getMemoryUsage();
+
+signals:
+    // Emitted from the picker's thread when takeHit has a new answer
+    void picked();
+
+protected:
+    void run() override;
+
+private:
+    struct Query {
+        glm::vec3 origin;
+        glm::vec3 direction;
+        glm::mat4 modelMatrix;
+    };
+
+    // The full resolution triangles of a mesh in BVH leaf order, as one vertex and two edges each.
+    // Every array is padded by three zeroed triangles so a leaf can always be loaded four at a time.
+    struct MeshTriangles {
+        Bvh bvh;
+        vector<float> v0[3];
+        vector<float> edge1[3];
+        vector<float> edge2[3];
+        vector<uint32_t> triangle;
+    };
+
+    const Model& _model;
+    vector<MeshTriangles> _meshes;
+    vector<size_t> _meshIndices; // Model mesh of each entry of _meshes
+    Bvh _topLevel;
+
+    // Guards everything below, shared with the GUI thread
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    bool _hasQuery;
+    Query _query;
+    bool _hasHit;
+    Hit _hit;
+    bool _built;
+    bool _stopping;
+    double _buildMilliseconds;
+    MemoryTracker::Account _memory;
+
+    void build();
+    bool isStopping();
+    static void buildMesh(const glm::vec3* positions, size_t numPositions, const unsigned int* indices, size_t numIndices,
+                          MeshTriangles& triangles);
+    Hit intersect(const Query& query) const;
+    // Closest hit with the leaf's triangles closer than maxDistance; returns its distance or maxDistance
+    static float intersectLeaf(const MeshTriangles& triangles, uint32_t first, uint32_t count,
+                               const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t& hitIndex);
+};
@@ -0,0 +1,95 @@
+#include "ModelStatisticsDialog.h"
+#include "ImportStatistics.h"
+#include "Utils.h"
+
+#include "QDialogButtonBox"
+#include "QHeaderView"
+#include "QLabel"
+#include "QTableWidget"
+#include "QVBoxLayout"
+
+namespace {
+
+QString megabytes(size_t bytes) {
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 2);
+}
+
+QTableWidgetItem* numberItem(const QString& text) {
+    QTableWidgetItem* item = new QTableWidgetItem(text);
+    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    return item;
+}
+
+}
+
+ModelStatisticsDialog::ModelStatisticsDialog(const ImportStatistics& statistics, const MemoryTracker::Usage& memory, QWidget* parent) :
+  QDialog(parent)
+{
+    setWindowTitle(tr("Model statistics - %1").arg(Utils::getFileNameFromPath(statistics.getFileName()).c_str()));
+
+    const vector<ImportStatistics::Stage>& stages = statistics.getStages();
+    QTableWidget* table = new QTableWidget(int(stages.size()), 5, this);
+    table->setHorizontalHeaderLabels(QStringList() << tr("Stage") << tr("Time (ms)") << tr("Size (MB)") << tr("Count") << tr("Peak RSS (MB)"));
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->verticalHeader()->hide();
+
+    for(int row = 0; row < int(stages.size()); ++row) {
+        const ImportStatistics::Stage& stage = stages[row];
+        table->setItem(row, 0, new QTableWidgetItem(stage.name.c_str()));
+        table->setItem(row, 1, numberItem(QString::number(stage.milliseconds, 'f', 2)));
+        table->setItem(row, 2, numberItem(stage.bytes > 0 ? megabytes(stage.bytes) : QString()));
+        table->setItem(row, 3, numberItem(stage.count > 0 ? QString::number(stage.count) : QString()));
+        table->setItem(row, 4, numberItem(megabytes(stage.peakResidentBytes)));
+    }
+    table->resizeColumnsToContents();
+    table->horizontalHeader()->setStretchLastSection(true);
+
+    const ImportStatistics::WastedWork& wasted = statistics.wasted();
+    QString summary = tr("Profile: %1\nTotal: %2 ms").arg(statistics.getProfile().c_str()).arg(statistics.getTotalMilliseconds(), 0, 'f', 2);
+    if(statistics.getFirstPixelMilliseconds() >= 0.0)
+        summary += tr("\nFirst pixel: %1 ms").arg(statistics.getFirstPixelMilliseconds(), 0, 'f', 2);
+    summary += tr("\nGeometry copied: %1 MB").arg(megabytes(statistics.getBytesCopied()));
+    if(!statistics.getError().empty())
+        summary += tr("\nImport failed: %1").arg(statistics.getError().c_str());
+    summary += tr("\nDuplicate textures skipped: %1\nMeshes re-converted: %2\nTextures failed: %3")
+        .arg(wasted.duplicateTexturesSkipped)
+        .arg(wasted.meshesReconverted)
+        .arg(wasted.texturesFailed);
+    summary += tr("\nLogged to %1").arg(ImportStatistics::logFileName());
+
+    QLabel* label = new QLabel(summary, this);
+    label->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+    // One row per category, then the system and gpu subtotals
+    MemoryTracker::Usage global = MemoryTracker::globalUsage();
+    QTableWidget* memoryTable = new QTableWidget(MemoryTracker::NumCategories + 2, 3, this);
+    memoryTable->setHorizontalHeaderLabels(QStringList() << tr("Memory") << tr("This tab (MB)") << tr("All tabs (MB)"));
+    memoryTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    memoryTable->verticalHeader()->hide();
+
+    for(int c = 0; c < MemoryTracker::NumCategories; ++c) {
+        MemoryTracker::Category category = MemoryTracker::Category(c);
+        QString name = QString("%1 (%2)").arg(MemoryTracker::categoryName(category)).arg(MemoryTracker::isGpuMemory(category) ? "GPU" : "RAM");
+        memoryTable->setItem(c, 0, new QTableWidgetItem(name));
+        memoryTable->setItem(c, 1, numberItem(megabytes(memory.bytes[c])));
+        memoryTable->setItem(c, 2, numberItem(megabytes(global.bytes[c])));
+    }
+    memoryTable->setItem(MemoryTracker::NumCategories, 0, new QTableWidgetItem(tr("Total RAM")));
+    memoryTable->setItem(MemoryTracker::NumCategories, 1, numberItem(megabytes(memory.systemBytes())));
+    memoryTable->setItem(MemoryTracker::NumCategories, 2, numberItem(megabytes(global.systemBytes())));
+    memoryTable->setItem(MemoryTracker::NumCategories + 1, 0, new QTableWidgetItem(tr("Total GPU")));
+    memoryTable->setItem(MemoryTracker::NumCategories + 1, 1, numberItem(megabytes(memory.gpuBytes())));
+    memoryTable->setItem(MemoryTracker::NumCategories + 1, 2, numberItem(megabytes(global.gpuBytes())));
+    memoryTable->resizeColumnsToContents();
+    memoryTable->horizontalHeader()->setStretchLastSection(true);
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttons, SIGNAL(rejected()), this, SLOT(reject()));
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addWidget(table);
+    layout->addWidget(label);
+    layout->addWidget(memoryTable);
+    layout->addWidget(buttons);
+    resize(640, 640);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "QDialog"
+
+#include "MemoryTracker.h"
+
+class ImportStatistics;
+
+// Shows how long each stage of a model's import took, the work that was wasted, and the memory
+// the model's tab holds next to the total over all tabs
+class ModelStatisticsDialog : public QDialog {
+
+public:
+    ModelStatisticsDialog(const ImportStatistics& statistics, const MemoryTracker::Usage& memory, QWidget* parent = 0);
+};
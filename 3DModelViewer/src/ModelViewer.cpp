@@ -4,8 +4,10 @@
 #include "gtc/type_ptr.hpp"
 #include "gtx/rotate_vector.hpp"
 
-#include <fstream>
 #include "QSurface"
+#include "QPainter"
+#include "QFileDialog"
+#include "QFileInfo"
 
 #include "Resources/assimp/include/assimp/Importer.hpp"
 #include "Resources/assimp/include/assimp/scene.h"
@@ -13,10 +15,8 @@
 
 ModelViewer::ModelViewer(QWidget* parent) :
   QOpenGLWidget(parent),
+  _pickingMode(RayPicking),
   _file(""),
-  _viewMode(ModelView),
-  _lightColor(glm::vec3(1.0, 1.0, 1.0)),
-  _lightPos(glm::vec3(0.0, 5.0, 0.0)),
   _camPosition(glm::vec3(0.0, 0.0, 3.0)),
   _camDirection(glm::vec3(0.0, 0.0, 0.0)),
   _camUp(glm::vec3(0.0, 1.0, 0.0)),
@@ -26,8 +26,9 @@ ModelViewer::ModelViewer(QWidget* parent) :
   _fov(45.0),
   _pendingMVPChange(false),
   _modelLoaded(false),
-  _lightingEnabled(true),
-  _texturingEnabled(true)
+  _previewShown(false),
+  _meshesShown(0),
+  _firstPixelMs(-1.0)
 {
     setFormat(QSurfaceFormat::defaultFormat());
     makeCurrent();
@@ -44,9 +45,14 @@ ModelViewer::ModelViewer(QWidget* parent) :
 }
 
 ModelViewer::~ModelViewer() {
-    glDeleteBuffers(1, &_vertexBuffer);
-    glDeleteVertexArrays(1, &_vertexArray);
-    glDeleteProgram(_programId);
+    // Wait for a load in progress before tearing anything down
+    if(_loader) {
+        disconnect(_loader.get(), 0, this, 0);
+        _loader->wait();
+    }
+
+    // The renderer releases its GL objects when it is destroyed, which needs the context
+    makeCurrent();
 }
 
 void ModelViewer::initializeGL() {
@@ -77,104 +83,49 @@ void ModelViewer::initializeGL() {
 
     qDebug() << "OpenGL Driver Version String:" << QLatin1String(reinterpret_cast<const char*>(glGetString(GL_VERSION)));
 
-    glEnable(GL_LINE_SMOOTH);
-    glEnable(GL_DEPTH_TEST);
-    glClearColor(1.0, 1.0, 1.0, 1.0);
-
-    // Load and compile our shaders
-    _programId = glCreateProgram();
-    loadShader("shaders/vertex.shader", GL_VERTEX_SHADER, _programId);
-    loadShader("shaders/fragment.shader", GL_FRAGMENT_SHADER, _programId);
-    glUseProgram(_programId);
-
-    // Get uniform handles
-    _uniformMVPHandle = glGetUniformLocation(_programId, "mvp");
-    _uniformTexSamplerHandle = glGetUniformLocation(_programId, "texSampler");
-    _uniformModelHandle = glGetUniformLocation(_programId, "model");
-    _uniformTexEnabledHandle = glGetUniformLocation(_programId, "texturingEnabled");
-    _uniformLightingHandle = glGetUniformLocation(_programId, "lightColor");
-    _uniformLightPosHandle = glGetUniformLocation(_programId, "lightPos");
-    _uniformLightingEnabledHandle = glGetUniformLocation(_programId, "lightingEnabled");
-    _uniformViewPosHandle = glGetUniformLocation(_programId, "viewPos");
-
-    // Set some uniforms here; the others will be set upon render
-    glUniform1f(_uniformTexEnabledHandle, 1.0f);
-    glUniform3f(_uniformLightingHandle, 1.0f, 1.0f, 1.0f);
-    glUniform3fv(_uniformLightPosHandle, 1, glm::value_ptr(_lightPos));
-    glUniform1f(_uniformLightingEnabledHandle, 1.0f);
-    glUniform4fv(_uniformModelHandle, 1, glm::value_ptr(_model));
+    // Compile the shaders and create the buffers used for drawing
+    _renderer.initialize();
+    _renderer.setViewport(width(), height());
 
-    glGenVertexArrays(1, &_vertexArray);
-    glBindVertexArray(_vertexArray);
-
-    glGenBuffers(1, &_vertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+    // A load may have started before the widget was first shown
+    updateLoading();
 }
 
 void ModelViewer::paintGL() {
 
-    if(!_modelLoaded)
+    if(!_modelLoaded && !_previewShown)
         return;
-    if(_mainModel->isModelMatrixOutOfDate())
-        recalculateMVP();
-
-    processCameraMovements();
-
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Smooth out the lines
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_LINE_SMOOTH);
-    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
-
-    // Set polygon mode based on current viewing mode
-    if(_viewMode == ViewMode::PointCloud)
-        glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
-    else if(_viewMode == ViewMode::WireFrame)
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    else if(_viewMode == ViewMode::ModelView)
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-    glUseProgram(_programId);
-    glBindVertexArray(_vertexArray);
-
-    // Set uniforms
-    glUniformMatrix4fv(_uniformMVPHandle, 1, GL_FALSE, glm::value_ptr(_mvp));
-    glUniform4fv(_uniformModelHandle, 1, glm::value_ptr(_model));
-    glUniform3fv(_uniformLightPosHandle, 1, glm::value_ptr(_lightPos));
-
-    for(Model::Mesh mesh : _meshes) {
-        glActiveTexture(GL_TEXTURE0 + mesh.diffuseTexture.texId);
-        glBindTexture(GL_TEXTURE_2D, mesh.diffuseTexture.texId);
-
-        // Set texture sampler
-        glUniform1i(_uniformTexSamplerHandle, mesh.diffuseTexture.texId);
-
-        // First attribute buffer - vertices
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-        // Second attribute buffer - texture coordinates
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.uvBuffer);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-        // Third attribute buffer - normals
-        glEnableVertexAttribArray(2);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.normalBuffer);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-        glDrawArrays(GL_TRIANGLES, 0, mesh.numFaces * 3);
+
+    FrameProfiler& profiler = _renderer.profiler();
+    profiler.beginFrame();
+
+    {
+        FrameProfiler::CpuScope scope(profiler, "Camera update");
+        if(_mainModel && _mainModel->isModelMatrixOutOfDate())
+            recalculateMVP();
+
+        processCameraMovements();
     }
 
-    // Clean up
-    glDisableVertexAttribArray(2);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glUseProgram(0);
+    _renderer.render();
+    profiler.endFrame();
+    updateIdPick();
+
+    if(_firstPixelMs < 0.0) {
+        _firstPixelMs = _loadTimer.nsecsElapsed() / 1e6;
+        qDebug() << "First pixel of" << _file.c_str() << "after" << _firstPixelMs << "ms";
+    }
+    if(_mainModel && _mainModel->getImportStatistics().getFirstPixelMilliseconds() < 0.0)
+        _mainModel->getImportStatistics().setFirstPixelMilliseconds(_firstPixelMs);
+
+    if(profiler.isEnabled()) {
+        {
+            QPainter painter(this);
+            profiler.drawOverlay(painter, rect());
+        }
+        // The painter changes whatever GL state it needs
+        _renderer.invalidateState();
+    }
 
     // Swap buffers
     makeCurrent();
@@ -187,7 +138,7 @@ void ModelViewer::resizeGL(int width, int height) {
     if(!isInitialized())
         return;
 
-    glViewport(0, 0, width, height);
+    _renderer.setViewport(width, height);
 
     _projection = glm::perspective(45.0, double(width) / double(height), 0.1, 10000.0);
 
@@ -198,62 +149,85 @@ void ModelViewer::updateGL() {
     repaint();
 }
 
-bool ModelViewer::loadFile(string fileName) {
+bool ModelViewer::loadFile(string fileName, Model::ImportOptions options) {
+
+    if(_loader || _mainModel)
+        return false;
+    if(!QFileInfo(QString::fromStdString(fileName)).isFile())
+        return false;
 
     _file = fileName;
 
-    if(!_mainModel.get())
-        _mainModel = unique_ptr<Model>(new Model(_file));
+    // Progress is delivered through queued signals, so it is uploaded on this thread with our context current
+    _loader.reset(new ModelLoader(_file, options));
+    connect(_loader.get(), SIGNAL(progressed()), this, SLOT(updateLoading()));
+    connect(_loader.get(), SIGNAL(loaded()), this, SLOT(updateLoading()));
 
-    _modelLoaded = true;
+    _loadTimer.start();
+    _loader->start();
+    return true;
+}
 
-    // Send the vertex data to the gpu
-    loadVertices();
+void ModelViewer::updateLoading() {
+    if(!_loader || _modelLoaded || !_renderer.initialized())
+        return;
 
-    // Scale the model to fit within screen dimensions
-    _mainModel->fitToScreen(_zPos, _fov);
+    makeCurrent();
 
-    return true;
-}
+    ModelLoader::Progress progress = _loader->takeProgress();
 
-void ModelViewer::loadVertices() {
-    if(!_modelLoaded)
-        return; // model has not yet been created
-
-    _meshes = _mainModel->getMeshes();
-
-    for(Model::Mesh& mesh : _meshes) {
-
-        // Send vertex data to gpu
-        glGenBuffers(1, &mesh.vertexBuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
-        glBufferData(
-            GL_ARRAY_BUFFER,
-            mesh.vertices.size() * sizeof(glm::vec3),
-            mesh.vertices.data(),
-            GL_STATIC_DRAW
-        );
-
-        // Send uv data to gpu
-        glGenBuffers(1, &mesh.uvBuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.uvBuffer);
-        glBufferData(
-            GL_ARRAY_BUFFER,
-            mesh.numFaces * 3 * sizeof(glm::vec2),
-            mesh.uvs.data(),
-            GL_STATIC_DRAW
-        );
-
-        // Send vertex normal data to gpu
-        glGenBuffers(1, &mesh.normalBuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.normalBuffer);
-        glBufferData(
-            GL_ARRAY_BUFFER,
-            mesh.numFaces * 3 * sizeof(glm::vec3),
-            mesh.normals.data(), 
-            GL_STATIC_DRAW
-        );
+    if(progress.hasBounds) {
+        // Frame the bounds exactly as fitToScreen will frame the finished model
+        _previewBounds = progress.bounds;
+        _previewMatrix = Model::fitMatrix(progress.sphere, _zPos, _fov);
+        _renderer.setPreview(_previewBounds.min, _previewBounds.max, vector<glm::vec3>());
+        _previewShown = true;
+    }
+    if(progress.hasPreview && _previewShown)
+        _renderer.setPreview(_previewBounds.min, _previewBounds.max, progress.preview);
+
+    for(size_t i = 0; i < progress.meshes.size(); ++i)
+        _renderer.addMesh(*progress.meshes[i], progress.meshIndices[i]);
+    _meshesShown += progress.meshes.size();
+
+    if(_loader->isLoaded()) {
+        _mainModel = _loader->takeModel();
+        _renderer.releasePreview();
+        _previewShown = false;
+
+        if(!_mainModel) {
+            qWarning() << "Could not load" << _file.c_str();
+            _renderer.releaseMeshes();
+            _loader.reset();
+            // Emitted last, since whoever handles it may close the viewer
+            emit loadFailed(QString::fromStdString(_file));
+            return;
+        }
+        else {
+            // Meshes that arrived before being finalized (or not at all) are uploaded again
+            if(_meshesShown != _mainModel->getMeshes().size())
+                _renderer.setMeshes(_mainModel->getMeshes());
+            if(_mainModel->getPointStream())
+                _renderer.setPointStream(_mainModel->getPointStream());
+            else
+                _renderer.setPointCloud(_mainModel->getPointCloud());
+
+            // Scale the model to fit within screen dimensions
+            _mainModel->fitToScreen(_zPos, _fov);
+            _modelLoaded = true;
+
+            // The picker's hierarchies are only built once something is picked
+            _picker.reset(new ModelPicker(*_mainModel));
+            connect(_picker.get(), SIGNAL(picked()), this, SLOT(updatePick()));
+            _picker->start();
+
+            if(_firstPixelMs >= 0.0)
+                _mainModel->getImportStatistics().setFirstPixelMilliseconds(_firstPixelMs);
+        }
     }
+
+    recalculateMVP();
+    update();
 }
 
 void ModelViewer::processCameraMovements() {
@@ -279,6 +253,15 @@ void ModelViewer::processCameraMovements() {
     if(isKeyPressed(Qt::Key_R)) {
         resetView();
     }
+
+    // Page up/down: move the newest section plane further into or out of the model. Only the
+    // frame uniforms change, however large the model.
+    if(isKeyPressed(Qt::Key_PageUp) != isKeyPressed(Qt::Key_PageDown) && !getClipPlanes().empty()) {
+        vector<glm::vec4> planes = getClipPlanes();
+        const float step = _previewBounds.isEmpty() ? 0.01f : 0.005f * glm::length(_previewBounds.max - _previewBounds.min);
+        planes.back().w += isKeyPressed(Qt::Key_PageUp) ? -step : step;
+        setClipPlanes(planes);
+    }
 }
 
 bool ModelViewer::isKeyPressed(int key) {
@@ -316,7 +299,8 @@ void ModelViewer::translate(double x, double y, double z) {
     glm::vec3 vec = glm::vec3(x, y, z);
     glm::vec3 translation = camToObj(vec);
 
-    _mainModel->translate(translation.x, translation.y, translation.z);
+    if(_mainModel)
+        _mainModel->translate(translation.x, translation.y, translation.z);
 }
 
 void ModelViewer::mouseMoveEvent(QMouseEvent* event) {
@@ -344,6 +328,79 @@ void ModelViewer::mouseMoveEvent(QMouseEvent* event) {
 void ModelViewer::mousePressEvent(QMouseEvent* event) {
     // Update the mouse's last position
     _lastPos = event->pos();
+    if(event->button() == Qt::LeftButton)
+        _pressPos = event->pos();
+}
+
+void ModelViewer::mouseReleaseEvent(QMouseEvent* event) {
+    // A click that didn't turn into a rotation selects what is under the cursor
+    if(event->button() == Qt::LeftButton && (event->pos() - _pressPos).manhattanLength() <= 2)
+        pickAt(event->x(), event->y());
+}
+
+void ModelViewer::setPickingMode(PickingMode mode) {
+    _pickingMode = mode;
+}
+
+ModelViewer::PickingMode ModelViewer::getPickingMode() const {
+    return _pickingMode;
+}
+
+void ModelViewer::pickAt(int x, int y) {
+    if(!_picker)
+        return;
+
+    if(_pickingMode == IdBufferPicking) {
+        // Drawn with the next frame, and answered by one of the frames after it
+        _renderer.requestIdPick(x, y);
+        update();
+        return;
+    }
+
+    glm::vec3 origin, direction;
+    _renderer.pickRay(x, y, origin, direction);
+    _picker->pick(origin, direction, _model);
+}
+
+const ModelPicker::Hit& ModelViewer::getPickedHit() const {
+    return _pickedHit;
+}
+
+void ModelViewer::updatePick() {
+    if(!_picker || !_picker->takeHit(_pickedHit))
+        return;
+
+    reportPick(tr("picked in %1 us").arg(_pickedHit.microseconds, 0, 'f', 1));
+}
+
+void ModelViewer::updateIdPick() {
+    GpuPicker::Result result;
+    if(!_mainModel || !_renderer.takeIdPick(result))
+        return;
+
+    _pickedHit = ModelPicker::Hit();
+    _pickedHit.found = result.found;
+    if(result.found) {
+        _pickedHit.mesh = result.mesh;
+        _pickedHit.meshName = _mainModel->getMeshes()[result.mesh].name;
+        _pickedHit.triangle = result.triangle;
+        _pickedHit.position = result.position;
+        _pickedHit.normal = result.normal;
+    }
+    _pickedHit.microseconds = result.milliseconds * 1000.0;
+    reportPick(tr("read back from the id buffer after %1 ms, %2 frames").arg(result.milliseconds, 0, 'f', 2).arg(result.frames));
+}
+
+void ModelViewer::reportPick(const QString& timing) {
+    QString description = tr("Nothing under the cursor");
+    if(_pickedHit.found) {
+        QString name = _pickedHit.meshName.empty() ? tr("mesh %1").arg(_pickedHit.mesh) : QString::fromStdString(_pickedHit.meshName);
+        description = tr("%1, triangle %2 at (%3, %4, %5), normal (%6, %7, %8)")
+            .arg(name).arg(_pickedHit.triangle)
+            .arg(_pickedHit.position.x, 0, 'f', 3).arg(_pickedHit.position.y, 0, 'f', 3).arg(_pickedHit.position.z, 0, 'f', 3)
+            .arg(_pickedHit.normal.x, 0, 'f', 2).arg(_pickedHit.normal.y, 0, 'f', 2).arg(_pickedHit.normal.z, 0, 'f', 2);
+    }
+    emit picked(description + " - " + timing);
 }
 
 void ModelViewer::wheelEvent(QWheelEvent* event) {
@@ -354,6 +411,46 @@ void ModelViewer::wheelEvent(QWheelEvent* event) {
 
 void ModelViewer::keyPressEvent(QKeyEvent* event) {
     _keysPressed.push_back(event->key());
+
+    // F3: toggle the profiler overlay, F4: save the recorded frames as a trace, F5: switch the picking mode,
+    // F6: add a section plane, F7: toggle the caps of the cut surfaces, F8: remove the section planes
+    if(event->key() == Qt::Key_F3 && !event->isAutoRepeat()) {
+        setProfilerOverlayEnabled(!_renderer.profiler().isEnabled());
+    }
+    else if(event->key() == Qt::Key_F4 && !event->isAutoRepeat()) {
+        QString fileName = QFileDialog::getSaveFileName(this, tr("Save frame trace"), "frame_trace.json", tr("Trace (*.json)"));
+        if(!fileName.isEmpty() && !writeFrameTrace(fileName))
+            qWarning() << "Could not write" << fileName;
+    }
+    else if(event->key() == Qt::Key_F5 && !event->isAutoRepeat()) {
+        setPickingMode(_pickingMode == RayPicking ? IdBufferPicking : RayPicking);
+        emit picked(_pickingMode == RayPicking ? tr("Picking with rays") : tr("Picking with the id buffer"));
+    }
+    else if(event->key() == Qt::Key_F6 && !event->isAutoRepeat()) {
+        addClipPlane();
+    }
+    else if(event->key() == Qt::Key_F7 && !event->isAutoRepeat()) {
+        setClipCapsEnabled(!isClipCapsEnabled());
+        emit picked(isClipCapsEnabled() ? tr("Section caps on") : tr("Section caps off"));
+    }
+    else if(event->key() == Qt::Key_F8 && !event->isAutoRepeat()) {
+        setClipPlanes(vector<glm::vec4>());
+        emit picked(tr("Section planes removed"));
+    }
+}
+
+void ModelViewer::addClipPlane() {
+    vector<glm::vec4> planes = getClipPlanes();
+    if(planes.size() >= size_t(Renderer::MaxClipPlanes)) {
+        emit picked(tr("No more than %1 section planes").arg(Renderer::MaxClipPlanes));
+        return;
+    }
+
+    // The normal points away from the camera, which is the side that is kept
+    glm::vec3 normal = glm::normalize(camToObj(glm::vec3(0.0f, 0.0f, -1.0f)));
+    planes.push_back(glm::vec4(normal, -glm::dot(normal, _previewBounds.center())));
+    setClipPlanes(planes);
+    emit picked(tr("Section plane %1 of %2").arg(planes.size()).arg(Renderer::MaxClipPlanes));
 }
 
 void ModelViewer::keyReleaseEvent(QKeyEvent* event) {
@@ -382,91 +479,86 @@ void ModelViewer::resetView() {
         _camDirection, 
         _camUp
     );
-    _mainModel->reset();
+    if(_mainModel)
+        _mainModel->reset();
     _model = glm::mat4(1.0);
     _xPos = _yPos = 0.0;
     _zPos = 3.0;
-    _lightPos = glm::vec3(0.0, 5.0, 0.0);
+    _renderer.setLight(glm::vec3(0.0, 5.0, 0.0), glm::vec3(1.0, 1.0, 1.0));
     recalculateMVP();
 }
 
-void ModelViewer::setViewMode(ViewMode mode) {
-    _viewMode = mode;
+void ModelViewer::setBackfaceCullingEnabled(bool enabled) {
+    _renderer.setBackfaceCullingEnabled(enabled);
 }
 
-ModelViewer::ViewMode ModelViewer::getViewMode() {
-    return _viewMode;
+void ModelViewer::setClipPlanes(const vector<glm::vec4>& planes) {
+    _renderer.setClipPlanes(planes);
 }
 
-void ModelViewer::recalculateMVP() {
-    if(!_modelLoaded)
-        return;
+const vector<glm::vec4>& ModelViewer::getClipPlanes() const {
+    return _renderer.getClipPlanes();
+}
 
-    _model = _mainModel->getModelMatrix(); // get model matrix from our model object
-    _mvp = _projection * _view * _model;
+void ModelViewer::setClipCapsEnabled(bool enabled) {
+    _renderer.setClipCapsEnabled(enabled);
+}
 
-    if(isInitialized()) {
-        glUseProgram(_programId);
-        glUniformMatrix4fv(_uniformMVPHandle, 1, GL_FALSE, glm::value_ptr(_mvp));
-        glUseProgram(0);
-    }
+bool ModelViewer::isClipCapsEnabled() const {
+    return _renderer.isClipCapsEnabled();
+}
 
-    _pendingMVPChange = false;
+void ModelViewer::setViewMode(ViewMode mode) {
+    _renderer.setViewMode(mode);
 }
 
-void ModelViewer::loadShader(string shaderSource, GLenum shaderType, GLuint &programId) {
-    GLuint shaderId = glCreateShader(shaderType);
+ModelViewer::ViewMode ModelViewer::getViewMode() {
+    return _renderer.getViewMode();
+}
 
-    GLint result = GL_FALSE; // compilation result
-    int infoLogLength;       // length of info log
+void ModelViewer::setProfilerOverlayEnabled(bool enabled) {
+    _renderer.profiler().setEnabled(enabled);
+}
 
-    std::ifstream shaderFile(shaderSource);
-    std::string shaderStr;
-    const char* shader;
+bool ModelViewer::writeFrameTrace(const QString& fileName) {
+    return _renderer.profiler().writeTrace(fileName);
+}
 
-    if(!shaderFile.is_open()) {
-        std::string error = "Error: could not read file ";
-        throw std::runtime_error(error.append(shaderSource).c_str());
-    }
+const Model* ModelViewer::getModel() const {
+    return _mainModel.get();
+}
 
-    // Read shader
-    std::string buffer;
-    while(std::getline(shaderFile, buffer)) {
-        shaderStr += buffer + "\n";
+MemoryTracker::Usage ModelViewer::getMemoryUsage() const {
+    MemoryTracker::Usage usage = _renderer.getMemoryUsage();
+    if(_mainModel) {
+        usage += _mainModel->getMemoryUsage();
+        if(_mainModel->getPointStream())
+            usage += _mainModel->getPointStream()->getMemoryUsage();
     }
+    if(_picker)
+        usage += _picker->getMemoryUsage();
+    return usage;
+}
 
-    shader = shaderStr.c_str();
-
-    // Compile shader
-    qDebug() << "Compiling shader";
-    glShaderSource(shaderId, // Shader handle
-                   1,        // Number of files
-                   &shader,  // Shader source code
-                   NULL);    // NULL terminated string
-    glCompileShader(shaderId);
-
-    // Check shader
-    glGetShaderiv(shaderId, GL_COMPILE_STATUS, &result);
-    glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &infoLogLength);
-    std::vector<char> errorMessage(infoLogLength);
-    glGetShaderInfoLog(shaderId, infoLogLength, NULL, &errorMessage[0]);
-    qDebug() << errorMessage.data();
+unsigned int ModelViewer::getGLCallsPerFrame() const {
+    return _renderer.getGLCallsPerFrame();
+}
 
-    // Link the program
-    qDebug() << "Linking program";
-    glAttachShader(programId, shaderId);
-    glLinkProgram(programId);
+unsigned int ModelViewer::getGLCallsSkippedPerFrame() const {
+    return _renderer.getGLCallsSkippedPerFrame();
+}
 
-    // Check the program
-    glGetProgramiv(programId, GL_LINK_STATUS, &result);
-    glGetProgramiv(programId, GL_INFO_LOG_LENGTH, &infoLogLength);
-    std::vector<char> programErrorMessage(std::max(infoLogLength, int(1)));
-    glGetProgramInfoLog(programId, infoLogLength, NULL, &programErrorMessage[0]);
-    qDebug() << programErrorMessage.data();
+void ModelViewer::recalculateMVP() {
+    if(_previewShown && !_modelLoaded)
+        _model = _previewMatrix; // the model is still loading, frame its bounds
+    else if(_modelLoaded)
+        _model = _mainModel->getModelMatrix(); // get model matrix from our model object
+    else
+        return;
 
-    glDeleteShader(shaderId);
+    _renderer.setMatrices(_projection, _view, _model);
 
-    shaderFile.close();
+    _pendingMVPChange = false;
 }
 
 void ModelViewer::onMessageLogged(QOpenGLDebugMessage message) {
@@ -476,23 +568,9 @@ void ModelViewer::onMessageLogged(QOpenGLDebugMessage message) {
 }
 
 void ModelViewer::setLightingEnabled(bool enabled) {
-    _lightingEnabled = enabled;
-
-    glUseProgram(_programId);
-    if(enabled)
-        glUniform1f(_uniformLightingEnabledHandle, 1.0f);
-    else
-        glUniform1f(_uniformLightingEnabledHandle, 0.0f);
-    glUseProgram(0);
+    _renderer.setLightingEnabled(enabled);
 }
 
 void ModelViewer::setTexturingEnabled(bool enabled) {
-    _texturingEnabled = enabled;
-
-    glUseProgram(_programId);
-    if(_texturingEnabled && isInitialized())
-        glUniform1f(_uniformTexEnabledHandle, 1.0);
-    else
-        glUniform1f(_uniformTexEnabledHandle, 0.0);
-    glUseProgram(0);
+    _renderer.setTexturingEnabled(enabled);
 }
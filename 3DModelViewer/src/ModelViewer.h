@@ -2,8 +2,12 @@
 
 #include "QtOpenGL"
 #include "QOpenGLFunctions_3_3_Core"
+#include "QElapsedTimer"
 
 #include "Model.h"
+#include "ModelLoader.h"
+#include "ModelPicker.h"
+#include "Renderer.h"
 
 #include "glm.hpp"
 
@@ -17,16 +21,20 @@ class ModelViewer : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
     Q_OBJECT
 
 public:
-    enum ViewMode {
-        PointCloud = GL_POINT,      // View model as point cloud
-        WireFrame = GL_LINE_STRIP,  // View model as wireframe/mesh
-        ModelView = GL_TRIANGLES    // Normal viewing mode
+    typedef Renderer::ViewMode ViewMode;
+
+    enum PickingMode {
+        RayPicking,     // Rays against triangle hierarchies on the cpu, built on the first pick
+        IdBufferPicking // Ids drawn around the cursor and read back from the gpu, with nothing to build
     };
 
     ModelViewer(QWidget* parent = 0);
     ~ModelViewer();
 
-    bool loadFile(string fileName);
+    // Starts loading fileName in the background. Its bounds, a point preview and then its meshes
+    // are drawn as they arrive. Returns false if a model is already loaded or the file does not exist;
+    // whether the file can be read is only known later, and loadFailed is emitted if it can't.
+    bool loadFile(string fileName, Model::ImportOptions options = Model::ImportOptions());
 
     // Reset the position of the model in the view
     void resetView();
@@ -34,11 +42,54 @@ public:
     void setViewMode(ViewMode mode);
     void setTexturingEnabled(bool enabled);
     void setLightingEnabled(bool enabled);
+    // Skips back facing triangles, and whole clusters whose triangles all face away.
+    // Only correct for closed meshes, so it is off by default.
+    void setBackfaceCullingEnabled(bool enabled);
+    // Section planes in the model's coordinates, at most Renderer::MaxClipPlanes (see Renderer::setClipPlanes).
+    // F6 adds one through the center of the model facing the camera, page up and down move the
+    // newest one along its normal and F8 removes them all.
+    void setClipPlanes(const vector<glm::vec4>& planes);
+    const vector<glm::vec4>& getClipPlanes() const;
+    // Fills the cut surfaces of closed meshes (F7)
+    void setClipCapsEnabled(bool enabled);
+    bool isClipCapsEnabled() const;
     ViewMode getViewMode();
+    // The loaded model, or null until a file has finished loading
+    const Model* getModel() const;
+    // Memory held by this view: the model and the renderer's copy of its meshes on the cpu and gpu
+    MemoryTracker::Usage getMemoryUsage() const;
+    // Number of OpenGL calls issued while drawing the last frame, and how many redundant
+    // state changes were skipped
+    unsigned int getGLCallsPerFrame() const;
+    unsigned int getGLCallsSkippedPerFrame() const;
+    // Shows CPU/GPU frame timings and per-frame counters on top of the view (F3).
+    // Frames are only recorded while the overlay is shown.
+    void setProfilerOverlayEnabled(bool enabled);
+    // Writes the recorded frames as a Chrome trace-event file (F4)
+    bool writeFrameTrace(const QString& fileName);
+    // How pickAt finds what is under the cursor (F5 switches)
+    void setPickingMode(PickingMode mode);
+    PickingMode getPickingMode() const;
+    // Queues a pick of whatever is under the point (x, y) of the widget; the answer arrives with picked()
+    void pickAt(int x, int y);
+    // The answer to the latest pick; found is false if nothing was under the cursor
+    const ModelPicker::Hit& getPickedHit() const;
+
+signals:
+    // A pick has been answered, with a one line description of the hit
+    void picked(const QString& description);
+    // The file passed to loadFile could not be read; nothing of it is drawn
+    void loadFailed(const QString& fileName);
 
 public slots:
     void onMessageLogged(QOpenGLDebugMessage message);
 
+private slots:
+    // Uploads whatever the loader has produced since the last call
+    void updateLoading();
+    // Takes the picker's latest answer
+    void updatePick();
+
 protected:
     // Set up OpenGL (create program, gen buffers, etc)
     void initializeGL() override;
@@ -55,42 +106,28 @@ protected:
     // Event handlers
     void mousePressEvent(QMouseEvent* event) override;
     void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
     void wheelEvent(QWheelEvent* event) override;
     void keyPressEvent(QKeyEvent* event) override;
     void keyReleaseEvent(QKeyEvent* event) override;
 
 private:
-    // OpenGL IDs
-    GLuint _programId;
-    GLuint _vertexArray;
-    GLuint _vertexBuffer;
-    vector<GLuint> _texIds;
+    Renderer _renderer;
 
+    // Owns the context the model's textures were created on, so it is destroyed after the model
+    unique_ptr<ModelLoader> _loader;
     unique_ptr<Model> _mainModel;
-    vector<Model::Mesh> _meshes;
+    // Reads the model from its own thread, so it is declared after the model to be stopped before it is destroyed
+    unique_ptr<ModelPicker> _picker;
+    PickingMode _pickingMode;
+    ModelPicker::Hit _pickedHit;
     string _file;
-    ViewMode _viewMode;
     QOpenGLDebugLogger* _logger;
 
-    // Uniform handles
-    GLuint _uniformMVPHandle;
-    GLuint _uniformTexSamplerHandle;
-    GLuint _uniformModelHandle;
-    GLuint _uniformTexEnabledHandle;
-    GLuint _uniformLightingHandle;
-    GLuint _uniformLightPosHandle;
-    GLuint _uniformLightingEnabledHandle;
-    GLuint _uniformViewPosHandle;
-
-    // Lighting
-    glm::vec3 _lightColor;
-    glm::vec3 _lightPos;
-
     // MVP matrices
     glm::mat4 _projection;
     glm::mat4 _view;
     glm::mat4 _model;
-    glm::mat4 _mvp;
 
     glm::vec3 _camPosition; // Camera position in world space
     glm::vec3 _camDirection; // Direction the camera is looking
@@ -105,21 +142,30 @@ private:
     bool _pendingMVPChange; 
     // False until a model has been loaded using ModelViewer::loadFile(string)
     bool _modelLoaded; 
-    bool _lightingEnabled;
-    bool _texturingEnabled;
+    // While loading: whether the bounds have arrived, and the model matrix that frames them
+    bool _previewShown;
+    MeshBounds::Box _previewBounds;
+    glm::mat4 _previewMatrix;
+    size_t _meshesShown;
+    QElapsedTimer _loadTimer;
+    // Time from loadFile to the first frame showing anything of the model, or -1
+    double _firstPixelMs;
 
     QPoint _lastPos; // Last mouse position
+    QPoint _pressPos; // Where the left button went down; releasing it there picks instead of rotating
     // Holds all keys currently being pressed
     vector<int> _keysPressed; 
 
     // Handles all camera movements each frame
     void processCameraMovements(); 
-    // Recalculates MVP matrix (projection * view * model)
+    // Adds a section plane through the center of the model, cutting away the half nearer to the camera
+    void addClipPlane();
+    // Takes the renderer's latest id pick, which arrives with a frame
+    void updateIdPick();
+    // Announces _pickedHit with picked(), followed by how long the pick took
+    void reportPick(const QString& timing);
+    // Recalculates the model matrix and passes projection, view and model to the renderer
     void recalculateMVP();
-    // Compile shader
-    void loadShader(string shaderSource, GLenum shaderType, GLuint &programId);
-    // Called to load the model vertices into memory
-    void loadVertices();
     // Returns true if _keysPressed contains the key passed in 
     bool isKeyPressed(int key);
     // Translate the model
@@ -0,0 +1,1367 @@
+#include "NativeImporter.h"
+#include "FloatParser.h"
+#include "PointCloud.h"
+#include "Utils.h"
+
+#include "QByteArray"
+#include "QElapsedTimer"
+#include "QFile"
+#include "QFileInfo"
+#include "QList"
+#include "QtEndian"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+// Text is split into at most this many chunks per hardware thread, each at least MinChunkBytes long
+const size_t ChunksPerThread = 4;
+const size_t MinChunkBytes = 1 << 20;
+// Binary records are decoded in batches of this many
+const size_t RecordsPerTask = 1 << 16;
+// Size of the text read per batch of points by readPoints, per point
+const size_t XyzBytesPerPoint = 32;
+
+// Marks a face corner without a uv or normal index
+const unsigned int NoIndex = ~0u;
+
+double elapsedMs(const QElapsedTimer& timer) {
+    return timer.nsecsElapsed() / 1e6;
+}
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool isDigit(char c) {
+    return unsigned(c - '0') < 10;
+}
+
+const char* skipSpaces(const char* p, const char* end) {
+    while(p < end && isSpace(*p))
+        ++p;
+    return p;
+}
+
+const char* nextLine(const char* p, const char* end) {
+    const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+// Returns the position after count lines starting at p, or null if there are fewer lines
+const char* skipLines(const char* p, const char* end, size_t count) {
+    for(size_t i = 0; i < count; ++i) {
+        if(p >= end)
+            return nullptr;
+        p = nextLine(p, end);
+    }
+    return p;
+}
+
+// Splits [begin, end) into chunks that each start at the beginning of a line. Chunk i is
+// [bounds[i], bounds[i + 1]); chunks can be empty.
+vector<const char*> splitLines(const char* begin, const char* end) {
+    size_t maxChunks = std::max(1u, std::thread::hardware_concurrency()) * ChunksPerThread;
+    size_t numChunks = std::max<size_t>(1, std::min<size_t>(maxChunks, (end - begin) / MinChunkBytes));
+
+    vector<const char*> bounds;
+    bounds.push_back(begin);
+    for(size_t i = 1; i < numChunks; ++i) {
+        const char* p = std::max(begin + (end - begin) * i / numChunks, bounds.back());
+        // The chunk starts after the newline ending the line p is in
+        bounds.push_back(p == begin ? begin : nextLine(p - 1, end));
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+size_t countLines(const char* p, const char* end) {
+    size_t count = 0;
+    while(p < end) {
+        p = nextLine(p, end);
+        ++count;
+    }
+    return count;
+}
+
+bool parseInt(const char*& p, const char* end, long long& value) {
+    const char* s = p;
+    bool negative = false;
+    if(s < end && (*s == '-' || *s == '+')) {
+        negative = *s == '-';
+        ++s;
+    }
+    if(s >= end || !isDigit(*s))
+        return false;
+
+    long long result = 0;
+    for(; s < end && isDigit(*s); ++s)
+        result = result * 10 + (*s - '0');
+    value = negative ? -result : result;
+    p = s;
+    return true;
+}
+
+// Keeps the first error reported by any of the parallel tasks
+class ErrorSink {
+
+public:
+    ErrorSink() :
+      _failed(false)
+    {}
+
+    void set(const string& error) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(!_failed)
+            _error = error;
+        _failed = true;
+    }
+
+    bool failed() const {
+        return _failed;
+    }
+
+    const string& error() const {
+        return _error;
+    }
+
+private:
+    std::mutex _mutex;
+    std::atomic<bool> _failed;
+    string _error;
+};
+
+// OBJ
+
+struct ObjCounts {
+    ObjCounts() :
+      positions(0),
+      uvs(0),
+      normals(0),
+      triangles(0)
+    {}
+
+    size_t positions;
+    size_t uvs;
+    size_t normals;
+    size_t triangles;
+};
+
+size_t countFaceCorners(const char* p, const char* end) {
+    size_t corners = 0;
+    bool inToken = false;
+    for(; p < end && *p != '\n' && *p != '#'; ++p) {
+        bool space = isSpace(*p);
+        if(!space && !inToken)
+            ++corners;
+        inToken = !space;
+    }
+    return corners;
+}
+
+ObjCounts countObj(const char* p, const char* end) {
+    ObjCounts counts;
+    while(p < end) {
+        p = skipSpaces(p, end);
+        if(end - p >= 2) {
+            if(p[0] == 'v' && isSpace(p[1]))
+                ++counts.positions;
+            else if(p[0] == 'v' && p[1] == 't')
+                ++counts.uvs;
+            else if(p[0] == 'v' && p[1] == 'n')
+                ++counts.normals;
+            else if(p[0] == 'f' && isSpace(p[1])) {
+                size_t corners = countFaceCorners(p + 1, end);
+                if(corners >= 3)
+                    counts.triangles += corners - 2;
+            }
+        }
+        p = nextLine(p, end);
+    }
+    return counts;
+}
+
+// Destination of the second OBJ pass. Every chunk writes from its own offsets, found by
+// summing the counts of the chunks before it.
+struct ObjOutput {
+    vector<glm::vec3> positions;
+    vector<glm::vec2> uvs;
+    vector<glm::vec3> normals;
+    vector<unsigned int> indices;      // Position index of each triangle corner
+    vector<unsigned int> uvIndices;    // Only filled if the file has uvs
+    vector<unsigned int> normalIndices; // Only filled if the file has normals
+};
+
+// Resolves a 1-based or negative (relative to the number read so far) OBJ index to a 0-based one
+bool resolveIndex(long long index, size_t readSoFar, size_t total, unsigned int& resolved) {
+    long long absolute = index > 0 ? index - 1 : static_cast<long long>(readSoFar) + index;
+    if(index == 0 || absolute < 0 || absolute >= static_cast<long long>(total))
+        return false;
+    resolved = unsigned(absolute);
+    return true;
+}
+
+bool parseObjChunk(const char* p, const char* end, const ObjCounts& first, const ObjCounts& totals, ObjOutput& output, string& error) {
+    size_t position = first.positions, uv = first.uvs, normal = first.normals, triangle = first.triangles;
+
+    while(p < end) {
+        p = skipSpaces(p, end);
+        const char* lineEnd = nextLine(p, end);
+
+        if(end - p >= 2 && p[0] == 'v' && isSpace(p[1])) {
+            p += 2;
+            glm::vec3& v = output.positions[position++];
+            for(int i = 0; i < 3; ++i) {
+                p = skipSpaces(p, lineEnd);
+                if(!FloatParser::parse(p, lineEnd, v[i])) {
+                    error = "Invalid vertex position";
+                    return false;
+                }
+            }
+        }
+        else if(end - p >= 2 && p[0] == 'v' && p[1] == 't') {
+            p += 2;
+            glm::vec2& t = output.uvs[uv++];
+            t = glm::vec2(0.0f);
+            // The second coordinate is optional
+            for(int i = 0; i < 2; ++i) {
+                p = skipSpaces(p, lineEnd);
+                if(!FloatParser::parse(p, lineEnd, t[i]) && i == 0) {
+                    error = "Invalid texture coordinate";
+                    return false;
+                }
+            }
+        }
+        else if(end - p >= 2 && p[0] == 'v' && p[1] == 'n') {
+            p += 2;
+            glm::vec3& n = output.normals[normal++];
+            for(int i = 0; i < 3; ++i) {
+                p = skipSpaces(p, lineEnd);
+                if(!FloatParser::parse(p, lineEnd, n[i])) {
+                    error = "Invalid vertex normal";
+                    return false;
+                }
+            }
+        }
+        else if(end - p >= 2 && p[0] == 'f' && isSpace(p[1])) {
+            p += 2;
+            // Polygons are triangulated as a fan around their first corner
+            unsigned int corner[3][3];
+            int numCorners = 0;
+
+            for(p = skipSpaces(p, lineEnd); p < lineEnd && *p != '\n' && *p != '#'; p = skipSpaces(p, lineEnd)) {
+                unsigned int v = 0, t = NoIndex, n = NoIndex;
+                long long index;
+                if(!parseInt(p, lineEnd, index) || !resolveIndex(index, position, totals.positions, v)) {
+                    error = "Invalid face index";
+                    return false;
+                }
+                if(p < lineEnd && *p == '/') {
+                    ++p;
+                    if(p < lineEnd && *p != '/') {
+                        if(!parseInt(p, lineEnd, index) || !resolveIndex(index, uv, totals.uvs, t)) {
+                            error = "Invalid face texture coordinate index";
+                            return false;
+                        }
+                    }
+                    if(p < lineEnd && *p == '/') {
+                        ++p;
+                        if(!parseInt(p, lineEnd, index) || !resolveIndex(index, normal, totals.normals, n)) {
+                            error = "Invalid face normal index";
+                            return false;
+                        }
+                    }
+                }
+
+                int slot = numCorners < 3 ? numCorners : 2;
+                if(numCorners >= 3) {
+                    // Next triangle of the fan: first corner, previous corner, this corner
+                    std::copy(corner[2], corner[2] + 3, corner[1]);
+                }
+                corner[slot][0] = v;
+                corner[slot][1] = t;
+                corner[slot][2] = n;
+                ++numCorners;
+
+                if(numCorners >= 3) {
+                    for(int k = 0; k < 3; ++k) {
+                        size_t i = triangle * 3 + k;
+                        output.indices[i] = corner[k][0];
+                        if(!output.uvIndices.empty())
+                            output.uvIndices[i] = corner[k][1];
+                        if(!output.normalIndices.empty())
+                            output.normalIndices[i] = corner[k][2];
+                    }
+                    ++triangle;
+                }
+            }
+        }
+        // Everything else (groups, materials, lines, comments) is ignored
+
+        p = lineEnd;
+    }
+    return true;
+}
+
+struct CornerKey {
+    unsigned int v, t, n;
+
+    bool operator==(const CornerKey& other) const {
+        return v == other.v && t == other.t && n == other.n;
+    }
+};
+
+struct CornerHash {
+    size_t operator()(const CornerKey& key) const {
+        return (size_t(key.v) * 73856093u) ^ (size_t(key.t) * 19349663u) ^ (size_t(key.n) * 83492791u);
+    }
+};
+
+// PLY
+
+enum PlyType { PlyInvalid, PlyInt8, PlyUInt8, PlyInt16, PlyUInt16, PlyInt32, PlyUInt32, PlyFloat32, PlyFloat64 };
+
+PlyType parsePlyType(const string& name) {
+    if(name == "char" || name == "int8")
+        return PlyInt8;
+    if(name == "uchar" || name == "uint8")
+        return PlyUInt8;
+    if(name == "short" || name == "int16")
+        return PlyInt16;
+    if(name == "ushort" || name == "uint16")
+        return PlyUInt16;
+    if(name == "int" || name == "int32")
+        return PlyInt32;
+    if(name == "uint" || name == "uint32")
+        return PlyUInt32;
+    if(name == "float" || name == "float32")
+        return PlyFloat32;
+    if(name == "double" || name == "float64")
+        return PlyFloat64;
+    return PlyInvalid;
+}
+
+size_t plyTypeSize(PlyType type) {
+    switch(type) {
+    case PlyInt8:
+    case PlyUInt8:
+        return 1;
+    case PlyInt16:
+    case PlyUInt16:
+        return 2;
+    case PlyInt32:
+    case PlyUInt32:
+    case PlyFloat32:
+        return 4;
+    case PlyFloat64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+double readPlyValue(const unsigned char* p, PlyType type, bool bigEndian) {
+    switch(type) {
+    case PlyInt8:
+        return double(qint8(*p));
+    case PlyUInt8:
+        return double(*p);
+    case PlyInt16:
+        return double(bigEndian ? qFromBigEndian<qint16>(p) : qFromLittleEndian<qint16>(p));
+    case PlyUInt16:
+        return double(bigEndian ? qFromBigEndian<quint16>(p) : qFromLittleEndian<quint16>(p));
+    case PlyInt32:
+        return double(bigEndian ? qFromBigEndian<qint32>(p) : qFromLittleEndian<qint32>(p));
+    case PlyUInt32:
+        return double(bigEndian ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p));
+    case PlyFloat32: {
+        quint32 bits = bigEndian ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    case PlyFloat64: {
+        quint64 bits = bigEndian ? qFromBigEndian<quint64>(p) : qFromLittleEndian<quint64>(p);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    default:
+        return 0.0;
+    }
+}
+
+// Reads a list length or vertex index. Integer types are read exactly; float ones must hold a
+// whole number small enough to convert. Returns false otherwise.
+bool readPlyInteger(const unsigned char* p, PlyType type, bool bigEndian, long long& value) {
+    const double real = readPlyValue(p, type, bigEndian);
+    if(!(std::fabs(real) <= 9007199254740992.0) || real != std::floor(real))
+        return false;
+    value = static_cast<long long>(real);
+    return true;
+}
+
+struct PlyProperty {
+    string name;
+    PlyType type;
+    bool isList;
+    PlyType countType; // Type of the length prefix of a list
+};
+
+struct PlyElement {
+    string name;
+    size_t count;
+    vector<PlyProperty> properties;
+
+    // Size of one record, or 0 if it contains lists and so has no fixed size
+    size_t recordSize() const {
+        size_t size = 0;
+        for(const PlyProperty& property : properties) {
+            if(property.isList)
+                return 0;
+            size += plyTypeSize(property.type);
+        }
+        return size;
+    }
+
+    int find(const char* const* names) const {
+        for(; *names; ++names) {
+            for(size_t i = 0; i < properties.size(); ++i) {
+                if(properties[i].name == *names)
+                    return int(i);
+            }
+        }
+        return -1;
+    }
+};
+
+bool isCornerList(const PlyProperty& property) {
+    return property.isList && (property.name == "vertex_indices" || property.name == "vertex_index");
+}
+
+enum PlyFormat { PlyAscii, PlyBinaryLittleEndian, PlyBinaryBigEndian };
+
+// Packs a colour whose components are in [0, 255] as RGBA8, red in the lowest byte
+uint32_t packColor(double red, double green, double blue) {
+    auto component = [](double value) { return uint32_t(std::min(std::max(value, 0.0), 255.0) + 0.5); };
+    return component(red) | (component(green) << 8) | (component(blue) << 16) | 0xFF000000u;
+}
+
+// Indices of the vertex properties that are read, -1 if missing
+struct PlyVertexLayout {
+    int position[3];
+    int normal[3];
+    int uv[2];
+    int color[3];
+    double colorScale; // Brings the stored colour components to [0, 255]
+
+    explicit PlyVertexLayout(const PlyElement& vertex) {
+        static const char* const x[] = { "x", nullptr };
+        static const char* const y[] = { "y", nullptr };
+        static const char* const z[] = { "z", nullptr };
+        static const char* const nx[] = { "nx", nullptr };
+        static const char* const ny[] = { "ny", nullptr };
+        static const char* const nz[] = { "nz", nullptr };
+        static const char* const u[] = { "u", "s", "texture_u", "texture_s", nullptr };
+        static const char* const v[] = { "v", "t", "texture_v", "texture_t", nullptr };
+        static const char* const red[] = { "red", "diffuse_red", "r", nullptr };
+        static const char* const green[] = { "green", "diffuse_green", "g", nullptr };
+        static const char* const blue[] = { "blue", "diffuse_blue", "b", nullptr };
+
+        position[0] = vertex.find(x);
+        position[1] = vertex.find(y);
+        position[2] = vertex.find(z);
+        normal[0] = vertex.find(nx);
+        normal[1] = vertex.find(ny);
+        normal[2] = vertex.find(nz);
+        uv[0] = vertex.find(u);
+        uv[1] = vertex.find(v);
+        color[0] = vertex.find(red);
+        color[1] = vertex.find(green);
+        color[2] = vertex.find(blue);
+
+        // Colours are bytes in most files, but may be stored in 16 bits or as floats in [0, 1]
+        colorScale = 1.0;
+        if(color[0] >= 0) {
+            PlyType type = vertex.properties[color[0]].type;
+            if(type == PlyInt16 || type == PlyUInt16)
+                colorScale = 1.0 / 257.0;
+            else if(type == PlyFloat32 || type == PlyFloat64)
+                colorScale = 255.0;
+        }
+    }
+
+    bool hasPositions() const {
+        return position[0] >= 0 && position[1] >= 0 && position[2] >= 0;
+    }
+
+    bool hasNormals() const {
+        return normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0;
+    }
+
+    bool hasUvs() const {
+        return uv[0] >= 0 && uv[1] >= 0;
+    }
+
+    bool hasColors() const {
+        return color[0] >= 0 && color[1] >= 0 && color[2] >= 0;
+    }
+};
+
+void storePlyVertex(const double* values, const PlyVertexLayout& layout, size_t i, Model::Mesh& mesh) {
+    mesh.vertices[i] = glm::vec3(values[layout.position[0]], values[layout.position[1]], values[layout.position[2]]);
+    if(!mesh.normals.empty())
+        mesh.normals[i] = glm::vec3(values[layout.normal[0]], values[layout.normal[1]], values[layout.normal[2]]);
+    if(!mesh.uvs.empty())
+        mesh.uvs[i] = glm::vec2(values[layout.uv[0]], values[layout.uv[1]]);
+    if(!mesh.colors.empty()) {
+        mesh.colors[i] = packColor(values[layout.color[0]] * layout.colorScale, values[layout.color[1]] * layout.colorScale,
+                                   values[layout.color[2]] * layout.colorScale);
+    }
+}
+
+// Fan-triangulates a polygon, appending its triangles to indices.
+// Returns false if a corner is out of range.
+bool addPolygon(const unsigned int* corners, size_t numCorners, size_t numVertices, unsigned int* indices) {
+    for(size_t i = 0; i < numCorners; ++i) {
+        if(corners[i] >= numVertices)
+            return false;
+    }
+    for(size_t i = 2; i < numCorners; ++i) {
+        *indices++ = corners[0];
+        *indices++ = corners[i - 1];
+        *indices++ = corners[i];
+    }
+    return true;
+}
+
+
+// XYZ
+
+bool isSeparator(char c) {
+    return isSpace(c) || c == ',';
+}
+
+const char* skipSeparators(const char* p, const char* end) {
+    while(p < end && isSeparator(*p))
+        ++p;
+    return p;
+}
+
+// Whether a line holds a point: it starts with a number and has at least three fields. The count
+// some PTS files start with is a single field, so it isn't taken for a point.
+bool isPointLine(const char* p, const char* end) {
+    p = skipSeparators(p, end);
+    if(p >= end || !(isDigit(*p) || *p == '-' || *p == '+' || *p == '.'))
+        return false;
+    int fields = 0;
+    while(p < end && *p != '\n' && fields < 3) {
+        ++fields;
+        while(p < end && !isSeparator(*p) && *p != '\n')
+            ++p;
+        p = skipSeparators(p, end);
+    }
+    return fields >= 3;
+}
+
+// Parses up to maxValues numbers from the line at p; returns how many were read
+int parsePointLine(const char* p, const char* end, float* values, int maxValues) {
+    int count = 0;
+    p = skipSeparators(p, end);
+    while(count < maxValues && p < end && *p != '\n' && FloatParser::parse(p, end, values[count])) {
+        ++count;
+        p = skipSeparators(p, end);
+    }
+    return count;
+}
+
+// Where the colour starts in a line of count values, or -1 for a line without one
+int xyzColorField(int count) {
+    if(count >= 7)
+        return 4; // x y z intensity r g b
+    if(count == 6)
+        return 3; // x y z r g b
+    return -1;
+}
+
+// LAS
+
+// Offset of the red, green and blue words in the records of each point data format, 0 if they have none
+const size_t LasColorOffsets[] = { 0, 0, 20, 28, 0, 28, 0, 30, 30, 0, 30 };
+
+// What is needed from the public header block to decode the point records
+struct LasHeader {
+    size_t pointOffset;
+    size_t recordLength;
+    quint64 numPoints;
+    double scale[3];
+    size_t colorOffset; // 0 if the records have no colour
+};
+
+bool parseLasHeader(const char* data, size_t size, LasHeader& header, string& error) {
+    // Everything is little endian
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    if(size < 227 || memcmp(data, "LASF", 4) != 0) {
+        error = "Not a LAS file";
+        return false;
+    }
+    const int versionMinor = bytes[25];
+    const size_t headerSize = qFromLittleEndian<quint16>(bytes + 94);
+    const int format = bytes[104];
+    header.pointOffset = qFromLittleEndian<quint32>(bytes + 96);
+    header.recordLength = qFromLittleEndian<quint16>(bytes + 105);
+    header.numPoints = qFromLittleEndian<quint32>(bytes + 107);
+    if(header.numPoints == 0 && versionMinor >= 4 && headerSize >= 375 && size >= 255)
+        header.numPoints = qFromLittleEndian<quint64>(bytes + 247);
+
+    for(int axis = 0; axis < 3; ++axis) {
+        quint64 bits = qFromLittleEndian<quint64>(bytes + 131 + axis * 8);
+        memcpy(&header.scale[axis], &bits, sizeof(double));
+    }
+
+    // LAZ sets the top bits of the format
+    if(format & 0xC0) {
+        error = "Compressed LAS (LAZ) is not supported";
+        return false;
+    }
+    if(format > 10 || header.recordLength < 20) {
+        error = "Unknown LAS point format";
+        return false;
+    }
+    if(header.pointOffset > size || (size - header.pointOffset) / header.recordLength < header.numPoints) {
+        error = "LAS file is truncated";
+        return false;
+    }
+    header.colorOffset = LasColorOffsets[format];
+    if(header.recordLength < header.colorOffset + 6)
+        header.colorOffset = 0;
+    return true;
+}
+
+// Decodes count records into the vertices and colours of mesh, in parallel
+void decodeLasPoints(const unsigned char* records, size_t count, const LasHeader& header, Model::Mesh& mesh) {
+    // Coordinates are integers to be scaled and offset. The offset is left out: it is usually
+    // large (geographic coordinates), and the points keep more precision in floats without it.
+    mesh.vertices.resize(count);
+    mesh.colors.resize(header.colorOffset > 0 ? count : 0);
+    size_t numTasks = (count + RecordsPerTask - 1) / RecordsPerTask;
+    Utils::parallelFor(numTasks, [&](size_t task) {
+        size_t last = std::min(count, (task + 1) * RecordsPerTask);
+        for(size_t i = task * RecordsPerTask; i < last; ++i) {
+            const unsigned char* record = records + i * header.recordLength;
+            mesh.vertices[i] = glm::vec3(
+                float(qFromLittleEndian<qint32>(record) * header.scale[0]),
+                float(qFromLittleEndian<qint32>(record + 4) * header.scale[1]),
+                float(qFromLittleEndian<qint32>(record + 8) * header.scale[2])
+            );
+            if(header.colorOffset > 0) {
+                // Colours are 16 bits per component
+                const unsigned char* color = record + header.colorOffset;
+                mesh.colors[i] = packColor(qFromLittleEndian<quint16>(color) / 257.0,
+                                           qFromLittleEndian<quint16>(color + 2) / 257.0,
+                                           qFromLittleEndian<quint16>(color + 4) / 257.0);
+            }
+        }
+    });
+}
+}
+
+NativeImporter::NativeImporter() {}
+
+NativeImporter::~NativeImporter() {}
+
+bool NativeImporter::canImport(const string& fileName, size_t minObjBytes) {
+    QFileInfo info(QString::fromStdString(fileName));
+    QString suffix = info.suffix().toLower();
+
+    if(suffix == "ply" || suffix == "xyz" || suffix == "pts" || suffix == "las")
+        return true;
+    if(suffix == "obj")
+        return size_t(info.size()) >= minObjBytes;
+    if(suffix == "stl") {
+        // Only binary STL, which is recognized by its size matching the triangle count in the header
+        QFile file(info.filePath());
+        if(!file.open(QIODevice::ReadOnly))
+            return false;
+        QByteArray header = file.read(84);
+        if(header.size() < 84)
+            return false;
+        quint32 numTriangles = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(header.constData() + 80));
+        return quint64(file.size()) == 84 + 50 * quint64(numTriangles);
+    }
+    return false;
+}
+
+bool NativeImporter::import(const string& fileName, vector<Model::Mesh>& meshes, ImportStatistics& statistics, string& error) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // The file is never copied; the parsers read the page cache through the mapping
+    QFile file(QString::fromStdString(fileName));
+    if(!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString().toStdString();
+        return false;
+    }
+    size_t size = size_t(file.size());
+    const char* data = size > 0 ? reinterpret_cast<const char*>(file.map(0, file.size())) : nullptr;
+    if(!data) {
+        error = size > 0 ? "Could not map the file" : "File is empty";
+        return false;
+    }
+    statistics.addStage("File map", elapsedMs(timer), size, 1);
+
+    Model::Mesh mesh;
+    mesh.name = QFileInfo(file).completeBaseName().toStdString();
+
+    QString suffix = QFileInfo(file).suffix().toLower();
+    bool loaded = false;
+    if(suffix == "obj")
+        loaded = importObj(data, size, mesh, statistics, error);
+    else if(suffix == "ply")
+        loaded = importPly(data, size, mesh, statistics, error);
+    else if(suffix == "stl")
+        loaded = importStl(data, size, mesh, statistics, error);
+    else if(suffix == "xyz" || suffix == "pts")
+        loaded = importXyz(data, size, mesh, statistics, error);
+    else if(suffix == "las")
+        loaded = importLas(data, size, mesh, statistics, error);
+    else
+        error = "Unsupported file format";
+
+    file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(data)));
+    if(loaded && mesh.vertices.empty()) {
+        error = "No vertices found";
+        loaded = false;
+    }
+    if(!loaded)
+        return false;
+
+    meshes.push_back(std::move(mesh));
+    return true;
+}
+
+bool NativeImporter::readPoints(const string& fileName, size_t batchPoints, const PointBatch& consume, string& error) {
+    // Batches aren't timed individually
+    ImportStatistics statistics;
+    QString suffix = QFileInfo(QString::fromStdString(fileName)).suffix().toLower();
+    if(suffix != "xyz" && suffix != "pts" && suffix != "las") {
+        vector<Model::Mesh> meshes;
+        if(!import(fileName, meshes, statistics, error))
+            return false;
+        for(Model::Mesh& mesh : meshes)
+            consume(mesh.vertices, mesh.colors);
+        return true;
+    }
+
+    QFile file(QString::fromStdString(fileName));
+    if(!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString().toStdString();
+        return false;
+    }
+    size_t size = size_t(file.size());
+    const char* data = size > 0 ? reinterpret_cast<const char*>(file.map(0, file.size())) : nullptr;
+    if(!data) {
+        error = size > 0 ? "Could not map the file" : "File is empty";
+        return false;
+    }
+
+    // Only the batch being decoded is held in memory; the rest of the file stays in the page cache
+    bool ok = true;
+    batchPoints = std::max<size_t>(batchPoints, 1);
+    if(suffix == "las") {
+        LasHeader header;
+        ok = parseLasHeader(data, size, header, error);
+        const unsigned char* records = reinterpret_cast<const unsigned char*>(data) + header.pointOffset;
+        for(quint64 first = 0; ok && first < header.numPoints; first += batchPoints) {
+            Model::Mesh batch;
+            size_t count = size_t(std::min<quint64>(batchPoints, header.numPoints - first));
+            decodeLasPoints(records + first * header.recordLength, count, header, batch);
+            consume(batch.vertices, batch.colors);
+        }
+    }
+    else {
+        // Batches of text end on line boundaries
+        const char* end = data + size;
+        const size_t batchBytes = batchPoints * XyzBytesPerPoint;
+        for(const char* p = data; ok && p < end;) {
+            const char* batchEnd = size_t(end - p) > batchBytes ? nextLine(p + batchBytes - 1, end) : end;
+            Model::Mesh batch;
+            ok = importXyz(p, batchEnd - p, batch, statistics, error);
+            if(ok && !batch.vertices.empty())
+                consume(batch.vertices, batch.colors);
+            p = batchEnd;
+        }
+    }
+
+    file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(data)));
+    return ok;
+}
+
+bool NativeImporter::importObj(const char* data, size_t size, Model::Mesh& mesh, ImportStatistics& statistics, string& error) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // First pass: count what every chunk holds, so the second can write into place
+    vector<const char*> bounds = splitLines(data, data + size);
+    size_t numChunks = bounds.size() - 1;
+    vector<ObjCounts> counts(numChunks + 1);
+    Utils::parallelFor(numChunks, [&](size_t i) {
+        counts[i + 1] = countObj(bounds[i], bounds[i + 1]);
+    });
+
+    // Turn the counts into the offset each chunk starts writing at
+    for(size_t i = 1; i <= numChunks; ++i) {
+        counts[i].positions += counts[i - 1].positions;
+        counts[i].uvs += counts[i - 1].uvs;
+        counts[i].normals += counts[i - 1].normals;
+        counts[i].triangles += counts[i - 1].triangles;
+    }
+    const ObjCounts& totals = counts[numChunks];
+    statistics.addStage("OBJ count", elapsedMs(timer), size, numChunks);
+
+    if(totals.positions == 0 || totals.triangles == 0) {
+        error = "No triangles found";
+        return false;
+    }
+    if(totals.positions > NoIndex || totals.triangles * 3 > NoIndex) {
+        error = "Too many vertices for 32 bit indices";
+        return false;
+    }
+
+    // Second pass: parse straight into the final arrays
+    timer.restart();
+    ObjOutput output;
+    output.positions.resize(totals.positions);
+    output.uvs.resize(totals.uvs);
+    output.normals.resize(totals.normals);
+    output.indices.resize(totals.triangles * 3);
+    if(totals.uvs > 0)
+        output.uvIndices.resize(totals.triangles * 3);
+    if(totals.normals > 0)
+        output.normalIndices.resize(totals.triangles * 3);
+
+    ErrorSink errors;
+    Utils::parallelFor(numChunks, [&](size_t i) {
+        string chunkError;
+        if(!errors.failed() && !parseObjChunk(bounds[i], bounds[i + 1], counts[i], totals, output, chunkError))
+            errors.set(chunkError);
+    });
+    if(errors.failed()) {
+        error = errors.error();
+        return false;
+    }
+    size_t parsedBytes = output.positions.size() * sizeof(glm::vec3) + output.uvs.size() * sizeof(glm::vec2)
+                       + output.normals.size() * sizeof(glm::vec3) + output.indices.size() * sizeof(unsigned int);
+    statistics.addStage("OBJ parse", elapsedMs(timer), parsedBytes, totals.positions);
+
+    // Scans usually index positions, uvs and normals alike, so the arrays can be used as they are.
+    // Otherwise every distinct combination of indices becomes a vertex of its own.
+    timer.restart();
+    bool sameIndices = (output.uvIndices.empty() || output.uvIndices == output.indices)
+                    && (output.normalIndices.empty() || output.normalIndices == output.indices);
+
+    if(sameIndices) {
+        mesh.vertices.swap(output.positions);
+        mesh.indices.swap(output.indices);
+        if(!output.uvs.empty()) {
+            output.uvs.resize(mesh.vertices.size());
+            mesh.uvs.swap(output.uvs);
+        }
+        if(!output.normals.empty()) {
+            output.normals.resize(mesh.vertices.size());
+            mesh.normals.swap(output.normals);
+        }
+    }
+    else {
+        std::unordered_map<CornerKey, unsigned int, CornerHash> vertexIds;
+        vertexIds.reserve(output.positions.size());
+        mesh.indices.resize(output.indices.size());
+
+        for(size_t i = 0; i < output.indices.size(); ++i) {
+            CornerKey key;
+            key.v = output.indices[i];
+            key.t = output.uvIndices.empty() ? NoIndex : output.uvIndices[i];
+            key.n = output.normalIndices.empty() ? NoIndex : output.normalIndices[i];
+
+            auto inserted = vertexIds.insert(std::make_pair(key, unsigned(mesh.vertices.size())));
+            if(inserted.second) {
+                mesh.vertices.push_back(output.positions[key.v]);
+                if(!output.uvs.empty())
+                    mesh.uvs.push_back(key.t != NoIndex ? output.uvs[key.t] : glm::vec2(0.0f));
+                if(!output.normals.empty())
+                    mesh.normals.push_back(key.n != NoIndex ? output.normals[key.n] : glm::vec3(0.0f));
+            }
+            mesh.indices[i] = inserted.first->second;
+        }
+    }
+    statistics.addStage("OBJ vertex merge", elapsedMs(timer), 0, mesh.vertices.size());
+    return true;
+}
+
+bool NativeImporter::importPly(const char* data, size_t size, Model::Mesh& mesh, ImportStatistics& statistics, string& error) {
+    QElapsedTimer timer;
+    timer.start();
+    const char* end = data + size;
+
+    // Header
+    if(size < 4 || strncmp(data, "ply", 3) != 0) {
+        error = "Not a PLY file";
+        return false;
+    }
+    PlyFormat format = PlyAscii;
+    vector<PlyElement> elements;
+    const char* p = nextLine(data, end);
+    bool headerEnded = false;
+
+    while(p < end && !headerEnded) {
+        const char* lineEnd = nextLine(p, end);
+        QList<QByteArray> words = QByteArray(p, int(lineEnd - p)).simplified().split(' ');
+        p = lineEnd;
+        if(words.isEmpty() || words[0].isEmpty())
+            continue;
+
+        const QByteArray& keyword = words[0];
+        if(keyword == "format" && words.size() >= 2) {
+            if(words[1] == "ascii")
+                format = PlyAscii;
+            else if(words[1] == "binary_little_endian")
+                format = PlyBinaryLittleEndian;
+            else if(words[1] == "binary_big_endian")
+                format = PlyBinaryBigEndian;
+            else {
+                error = "Unknown PLY format";
+                return false;
+            }
+        }
+        else if(keyword == "element" && words.size() >= 3) {
+            PlyElement element;
+            element.name = words[1].toStdString();
+            element.count = size_t(words[2].toULongLong());
+            elements.push_back(element);
+        }
+        else if(keyword == "property" && words.size() >= 3 && !elements.empty()) {
+            PlyProperty property;
+            property.isList = words[1] == "list";
+            if(property.isList && words.size() >= 5) {
+                property.countType = parsePlyType(words[2].toStdString());
+                property.type = parsePlyType(words[3].toStdString());
+                property.name = words[4].toStdString();
+            }
+            else {
+                property.countType = PlyInvalid;
+                property.type = parsePlyType(words[1].toStdString());
+                property.name = words[2].toStdString();
+            }
+            if(property.type == PlyInvalid || (property.isList && property.countType == PlyInvalid)) {
+                error = "Unknown PLY property type";
+                return false;
+            }
+            elements.back().properties.push_back(property);
+        }
+        else if(keyword == "end_header") {
+            headerEnded = true;
+        }
+    }
+    if(!headerEnded) {
+        error = "PLY header is not terminated";
+        return false;
+    }
+
+    const PlyElement* vertexElement = nullptr;
+    const PlyElement* faceElement = nullptr;
+    for(const PlyElement& element : elements) {
+        if(element.name == "vertex")
+            vertexElement = &element;
+        else if(element.name == "face")
+            faceElement = &element;
+    }
+    if(!vertexElement || vertexElement->count == 0 || vertexElement->count > NoIndex) {
+        error = "PLY file has no vertices";
+        return false;
+    }
+    PlyVertexLayout layout(*vertexElement);
+    if(!layout.hasPositions()) {
+        error = "PLY vertices have no position";
+        return false;
+    }
+    statistics.addStage("PLY header", elapsedMs(timer), p - data, elements.size());
+
+    const size_t numVertices = vertexElement->count;
+    mesh.vertices.resize(numVertices);
+    if(layout.hasNormals())
+        mesh.normals.resize(numVertices);
+    if(layout.hasUvs())
+        mesh.uvs.resize(numVertices);
+    // Only scans without faces are drawn with their colours, but whether there are faces is only known later
+    if(layout.hasColors())
+        mesh.colors.resize(numVertices);
+
+    const bool bigEndian = format == PlyBinaryBigEndian;
+    ErrorSink errors;
+
+    // Elements are stored one after the other, in the order of the header
+    for(const PlyElement& element : elements) {
+        timer.restart();
+        const char* elementStart = p;
+        const bool isVertex = &element == vertexElement;
+        const bool isFace = &element == faceElement;
+
+        if(format == PlyAscii) {
+            const char* elementEnd = skipLines(p, end, element.count);
+            if(!elementEnd) {
+                error = "PLY file is truncated";
+                return false;
+            }
+
+            // The counting pass below expects the corner list to come first on every face line
+            if(isFace && (element.properties.empty() || !isCornerList(element.properties[0]))) {
+                error = "PLY faces must start with their vertex indices";
+                return false;
+            }
+
+            if(isVertex || isFace) {
+                // Same two passes as OBJ: count the lines and triangles of each chunk, then parse into place
+                vector<const char*> bounds = splitLines(p, elementEnd);
+                size_t numChunks = bounds.size() - 1;
+                vector<size_t> firstLine(numChunks + 1, 0), firstTriangle(numChunks + 1, 0);
+                Utils::parallelFor(numChunks, [&](size_t i) {
+                    firstLine[i + 1] = countLines(bounds[i], bounds[i + 1]);
+                    if(isFace) {
+                        // Every face line starts with its number of corners
+                        size_t triangles = 0;
+                        for(const char* line = bounds[i]; line < bounds[i + 1]; line = nextLine(line, bounds[i + 1])) {
+                            const char* q = skipSpaces(line, bounds[i + 1]);
+                            long long corners;
+                            if(parseInt(q, bounds[i + 1], corners) && corners >= 3)
+                                triangles += size_t(corners - 2);
+                        }
+                        firstTriangle[i + 1] = triangles;
+                    }
+                });
+                for(size_t i = 1; i <= numChunks; ++i) {
+                    firstLine[i] += firstLine[i - 1];
+                    firstTriangle[i] += firstTriangle[i - 1];
+                }
+                if(isFace)
+                    mesh.indices.resize(firstTriangle[numChunks] * 3);
+
+                Utils::parallelFor(numChunks, [&](size_t i) {
+                    vector<double> values(element.properties.size(), 0.0);
+                    vector<unsigned int> corners;
+                    size_t line = firstLine[i];
+                    size_t triangle = firstTriangle[i];
+
+                    for(const char* q = bounds[i]; q < bounds[i + 1] && !errors.failed(); ++line) {
+                        const char* lineEnd = nextLine(q, bounds[i + 1]);
+                        corners.clear();
+
+                        for(size_t j = 0; j < element.properties.size(); ++j) {
+                            const PlyProperty& property = element.properties[j];
+                            q = skipSpaces(q, lineEnd);
+                            if(!property.isList) {
+                                float value;
+                                if(!FloatParser::parse(q, lineEnd, value)) {
+                                    errors.set("Invalid PLY value");
+                                    return;
+                                }
+                                values[j] = value;
+                                continue;
+                            }
+
+                            // Only the corner list of faces is kept; other lists are skipped
+                            long long length;
+                            if(!parseInt(q, lineEnd, length) || length < 0) {
+                                errors.set("Invalid PLY list");
+                                return;
+                            }
+                            bool keep = isFace && j == 0;
+                            for(long long k = 0; k < length; ++k) {
+                                long long index;
+                                float ignored;
+                                q = skipSpaces(q, lineEnd);
+                                if(keep ? !parseInt(q, lineEnd, index) : !FloatParser::parse(q, lineEnd, ignored)) {
+                                    errors.set("Invalid PLY list");
+                                    return;
+                                }
+                                if(keep)
+                                    corners.push_back(index >= 0 && index < static_cast<long long>(NoIndex) ? unsigned(index) : NoIndex);
+                            }
+                        }
+
+                        if(isVertex) {
+                            storePlyVertex(values.data(), layout, line, mesh);
+                        }
+                        else if(corners.size() >= 3) {
+                            // The counting pass only read the length at the start of the line
+                            if(triangle + corners.size() - 2 > firstTriangle[i + 1]) {
+                                errors.set("Invalid PLY face");
+                                return;
+                            }
+                            if(!addPolygon(corners.data(), corners.size(), numVertices, &mesh.indices[triangle * 3])) {
+                                errors.set("PLY face index out of range");
+                                return;
+                            }
+                            triangle += corners.size() - 2;
+                        }
+                        q = lineEnd;
+                    }
+                });
+            }
+            p = elementEnd;
+        }
+        else if(isVertex) {
+            // Vertex records have a fixed size, so batches can be decoded independently
+            size_t recordSize = element.recordSize();
+            if(recordSize == 0) {
+                error = "PLY vertices with list properties are not supported";
+                return false;
+            }
+            if(size_t(end - p) / recordSize < element.count) {
+                error = "PLY file is truncated";
+                return false;
+            }
+
+            vector<size_t> offsets;
+            size_t offset = 0;
+            for(const PlyProperty& property : element.properties) {
+                offsets.push_back(offset);
+                offset += plyTypeSize(property.type);
+            }
+
+            const unsigned char* records = reinterpret_cast<const unsigned char*>(p);
+            size_t numTasks = (element.count + RecordsPerTask - 1) / RecordsPerTask;
+            Utils::parallelFor(numTasks, [&](size_t task) {
+                vector<double> values(element.properties.size(), 0.0);
+                size_t last = std::min(element.count, (task + 1) * RecordsPerTask);
+                for(size_t i = task * RecordsPerTask; i < last; ++i) {
+                    const unsigned char* record = records + i * recordSize;
+                    for(size_t j = 0; j < element.properties.size(); ++j)
+                        values[j] = readPlyValue(record + offsets[j], element.properties[j].type, bigEndian);
+                    storePlyVertex(values.data(), layout, i, mesh);
+                }
+            });
+            p += element.count * recordSize;
+        }
+        else {
+            // Records with lists have to be walked in order to find where each starts
+            size_t recordSize = element.recordSize();
+            if(recordSize > 0 && !isFace) {
+                if(size_t(end - p) / recordSize < element.count) {
+                    error = "PLY file is truncated";
+                    return false;
+                }
+                p += element.count * recordSize;
+                continue;
+            }
+
+            const unsigned char* q = reinterpret_cast<const unsigned char*>(p);
+            const unsigned char* last = reinterpret_cast<const unsigned char*>(end);
+            vector<unsigned int> corners;
+            if(isFace)
+                mesh.indices.reserve(element.count * 3);
+
+            for(size_t i = 0; i < element.count; ++i) {
+                corners.clear();
+                for(const PlyProperty& property : element.properties) {
+                    if(!property.isList) {
+                        q += plyTypeSize(property.type);
+                        continue;
+                    }
+                    if(q + plyTypeSize(property.countType) > last) {
+                        error = "PLY file is truncated";
+                        return false;
+                    }
+                    long long count;
+                    if(!readPlyInteger(q, property.countType, bigEndian, count) || count < 0) {
+                        error = "Invalid PLY list";
+                        return false;
+                    }
+                    size_t length = size_t(count);
+                    q += plyTypeSize(property.countType);
+                    size_t itemSize = plyTypeSize(property.type);
+                    if(size_t(last - q) / itemSize < length) {
+                        error = "PLY file is truncated";
+                        return false;
+                    }
+
+                    bool keep = isFace && corners.empty() && isCornerList(property);
+                    if(keep) {
+                        // Invalid indices are kept as NoIndex, which addPolygon rejects like the ASCII reader's
+                        for(size_t k = 0; k < length; ++k) {
+                            long long index;
+                            bool valid = readPlyInteger(q + k * itemSize, property.type, bigEndian, index)
+                                      && index >= 0 && index < static_cast<long long>(NoIndex);
+                            corners.push_back(valid ? unsigned(index) : NoIndex);
+                        }
+                    }
+                    q += length * itemSize;
+                }
+
+                if(corners.size() >= 3) {
+                    size_t first = mesh.indices.size();
+                    mesh.indices.resize(first + (corners.size() - 2) * 3);
+                    if(!addPolygon(corners.data(), corners.size(), numVertices, &mesh.indices[first])) {
+                        error = "PLY face index out of range";
+                        return false;
+                    }
+                }
+            }
+            if(q > last) {
+                error = "PLY file is truncated";
+                return false;
+            }
+            p = reinterpret_cast<const char*>(q);
+        }
+
+        if(errors.failed()) {
+            error = errors.error();
+            return false;
+        }
+        if(isVertex)
+            statistics.addStage("PLY vertices", elapsedMs(timer), p - elementStart, numVertices);
+        else if(isFace)
+            statistics.addStage("PLY faces", elapsedMs(timer), p - elementStart, mesh.indices.size() / 3);
+    }
+
+    // Without faces the vertices are a point cloud
+    if(!mesh.indices.empty())
+        vector<uint32_t>().swap(mesh.colors);
+    return true;
+}
+
+bool NativeImporter::importStl(const char* data, size_t size, Model::Mesh& mesh, ImportStatistics& statistics, string& error) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // 80 byte header, triangle count, then 50 bytes per triangle: normal, three corners, attribute
+    if(size < 84) {
+        error = "STL file is truncated";
+        return false;
+    }
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t numTriangles = qFromLittleEndian<quint32>(bytes + 80);
+    if(size != 84 + 50 * numTriangles) {
+        error = "Not a binary STL file";
+        return false;
+    }
+    if(numTriangles == 0 || numTriangles * 3 > NoIndex) {
+        error = "Unsupported number of triangles";
+        return false;
+    }
+
+    // Corners aren't shared between triangles. The stored facet normals are left out: many exporters
+    // write zeros, and facet normals would light curved scans flat. The normals stage welds the
+    // corners by position and smooths them instead.
+    mesh.vertices.resize(numTriangles * 3);
+    mesh.indices.resize(numTriangles * 3);
+
+    size_t numTasks = (numTriangles + RecordsPerTask - 1) / RecordsPerTask;
+    Utils::parallelFor(numTasks, [&](size_t task) {
+        size_t last = std::min(numTriangles, (task + 1) * RecordsPerTask);
+        for(size_t i = task * RecordsPerTask; i < last; ++i) {
+            // Skip the facet normal
+            const unsigned char* record = bytes + 84 + i * 50 + 12;
+            for(int j = 0; j < 9; ++j) {
+                quint32 bits = qFromLittleEndian<quint32>(record + j * 4);
+                memcpy(&mesh.vertices[i * 3 + j / 3][j % 3], &bits, sizeof(float));
+            }
+            for(int k = 0; k < 3; ++k)
+                mesh.indices[i * 3 + k] = unsigned(i * 3 + k);
+        }
+    });
+    statistics.addStage("STL parse", elapsedMs(timer), size, numTriangles);
+    return true;
+}
+
+bool NativeImporter::importXyz(const char* data, size_t size, Model::Mesh& mesh, ImportStatistics& statistics, string& error) {
+    QElapsedTimer timer;
+    timer.start();
+    const char* end = data + size;
+
+    // First pass: count the points of every chunk
+    vector<const char*> bounds = splitLines(data, end);
+    size_t numChunks = bounds.size() - 1;
+    vector<size_t> firstPoint(numChunks + 1, 0);
+    Utils::parallelFor(numChunks, [&](size_t i) {
+        size_t count = 0;
+        for(const char* line = bounds[i]; line < bounds[i + 1]; line = nextLine(line, bounds[i + 1])) {
+            if(isPointLine(line, bounds[i + 1]))
+                ++count;
+        }
+        firstPoint[i + 1] = count;
+    });
+    for(size_t i = 1; i <= numChunks; ++i)
+        firstPoint[i] += firstPoint[i - 1];
+    const size_t numPoints = firstPoint[numChunks];
+    statistics.addStage("XYZ count", elapsedMs(timer), size, numChunks);
+
+    if(numPoints > NoIndex) {
+        error = "Too many points";
+        return false;
+    }
+    if(numPoints == 0)
+        return true;
+
+    // The first point decides whether the file has colours
+    const char* first = data;
+    while(!isPointLine(first, end))
+        first = nextLine(first, end);
+    float values[7];
+    const int colorField = xyzColorField(parsePointLine(first, end, values, 7));
+
+    // Second pass: parse straight into place
+    timer.restart();
+    mesh.vertices.resize(numPoints);
+    mesh.colors.resize(colorField >= 0 ? numPoints : 0);
+    ErrorSink errors;
+    Utils::parallelFor(numChunks, [&](size_t i) {
+        float values[7];
+        size_t point = firstPoint[i];
+        for(const char* line = bounds[i]; line < bounds[i + 1] && !errors.failed(); line = nextLine(line, bounds[i + 1])) {
+            if(!isPointLine(line, bounds[i + 1]))
+                continue;
+            int count = parsePointLine(line, bounds[i + 1], values, 7);
+            if(count < 3) {
+                errors.set("Invalid point");
+                return;
+            }
+            mesh.vertices[point] = glm::vec3(values[0], values[1], values[2]);
+            if(colorField >= 0) {
+                mesh.colors[point] = xyzColorField(count) == colorField
+                                   ? packColor(values[colorField], values[colorField + 1], values[colorField + 2])
+                                   : uint32_t(PointCloud::DefaultColor);
+            }
+            ++point;
+        }
+    });
+    if(errors.failed()) {
+        error = errors.error();
+        return false;
+    }
+    statistics.addStage("XYZ parse", elapsedMs(timer), size, numPoints);
+    return true;
+}
+
+bool NativeImporter::importLas(const char* data, size_t size, Model::Mesh& mesh, ImportStatistics& statistics, string& error) {
+    QElapsedTimer timer;
+    timer.start();
+
+    LasHeader header;
+    if(!parseLasHeader(data, size, header, error))
+        return false;
+    if(header.numPoints > NoIndex) {
+        error = "Too many points";
+        return false;
+    }
+
+    const size_t count = size_t(header.numPoints);
+    decodeLasPoints(reinterpret_cast<const unsigned char*>(data) + header.pointOffset, count, header, mesh);
+    statistics.addStage("LAS points", elapsedMs(timer), count * header.recordLength, count);
+    return true;
+}
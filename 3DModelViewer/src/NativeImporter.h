@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Model.h"
+
+#include <functional>
+#include <vector>
+#include <string>
+
+using std::vector;
+using std::string;
+
+// Reads the simple high-volume formats (OBJ, ASCII and binary PLY, binary STL, and the XYZ, PTS
+// and LAS point formats) straight from a memory mapped file into Model meshes, without building
+// an Assimp scene first. Point files, and PLY files without faces, give a mesh without indices
+// whose vertices the model turns into a PointCloud. Text is parsed in parallel chunks that start
+// on line boundaries: a first pass counts the elements of each chunk, a second one writes them
+// directly into the final vertex and index arrays. Peak memory stays close to the size of the
+// output, and loading is bound by how fast the file can be read.
+// Only geometry is read; materials and textures are left to Assimp.
+class NativeImporter {
+
+public:
+    // Whether fileName is in a format this importer reads. OBJ files smaller than minObjBytes are
+    // left to Assimp, which also loads their materials.
+    static bool canImport(const string& fileName, size_t minObjBytes);
+
+    // Appends the meshes of fileName to meshes. Only the geometry (vertices, normals, uvs,
+    // indices, and the colours of point clouds) and name of each mesh are set. Returns false and
+    // sets error if the file can't be read, in which case meshes is left unchanged.
+    static bool import(const string& fileName, vector<Model::Mesh>& meshes, ImportStatistics& statistics, string& error);
+
+    // Receives a batch of points; either array may be taken. colors is empty if the file has none.
+    typedef std::function<void(vector<glm::vec3>& positions, vector<uint32_t>& colors)> PointBatch;
+    // Reads the vertices of fileName in batches of at most batchPoints, for files too large to hold
+    // at once. XYZ, PTS and LAS are decoded a batch at a time from the mapping; other formats are
+    // imported whole and passed as one batch per mesh. Returns false and sets error on failure.
+    static bool readPoints(const string& fileName, size_t batchPoints, const PointBatch& consume, string& error);
+
+private:
+    NativeImporter();
+    ~NativeImporter();
+
+    static bool importObj(const char* data, size_t size, Model::Mesh& mesh, ImportStatistics& statistics, string& error);
+    static bool importPly(const char* data, size_t size, Model::Mesh& mesh, ImportStatistics& statistics, string& error);
+    static bool importStl(const char* data, size_t size, Model::Mesh& mesh, ImportStatistics& statistics, string& error);
+    // One point per line: x y z, optionally followed by r g b, or by intensity r g b (PTS)
+    static bool importXyz(const char* data, size_t size, Model::Mesh& mesh, ImportStatistics& statistics, string& error);
+    // Uncompressed LAS 1.0 to 1.4 with any point data format
+    static bool importLas(const char* data, size_t size, Model::Mesh& mesh, ImportStatistics& statistics, string& error);
+};
@@ -0,0 +1,292 @@
+#include "NormalGenerator.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NORMALGENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Every pass is split into chunks of this many faces, vertices or positions
+const size_t ChunkSize = 1 << 16;
+
+size_t numChunks(size_t count) {
+    return (count + ChunkSize - 1) / ChunkSize;
+}
+
+// A vertex, ordered by the bits of its position so equal positions end up next to each other
+struct PositionKey {
+    uint32_t x;
+    uint32_t y;
+    uint32_t z;
+    uint32_t vertex;
+
+    bool operator<(const PositionKey& other) const {
+        if(x != other.x)
+            return x < other.x;
+        if(y != other.y)
+            return y < other.y;
+        if(z != other.z)
+            return z < other.z;
+        return vertex < other.vertex;
+    }
+};
+
+uint32_t positionBits(float value) {
+    // -0 and +0 are the same position
+    value += 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// The cross product of each face's edges, whose length is twice its area, and its unit normal.
+// Both are stored with w = 0 so they can be loaded and summed as one register.
+void faceNormals(const vector<glm::vec3>& vertices, const vector<unsigned int>& indices,
+                 vector<glm::vec4>& weighted, vector<glm::vec4>& unit) {
+    const size_t numFaces = indices.size() / 3;
+    weighted.resize(numFaces);
+    unit.resize(numFaces);
+
+    Utils::parallelFor(numChunks(numFaces), [&](size_t chunk) {
+        size_t face = chunk * ChunkSize;
+        const size_t end = std::min(numFaces, face + ChunkSize);
+        const unsigned int* index = indices.data();
+        const glm::vec3* p = vertices.data();
+
+#ifdef NORMALGENERATOR_SSE2
+        // Four faces at a time, gathered into one register per axis of each corner
+        for(; face + 4 <= end; face += 4) {
+            __m128 corners[3][3];
+            for(int c = 0; c < 3; ++c) {
+                const glm::vec3& a = p[index[3 * face + c]];
+                const glm::vec3& b = p[index[3 * face + 3 + c]];
+                const glm::vec3& d = p[index[3 * face + 6 + c]];
+                const glm::vec3& e = p[index[3 * face + 9 + c]];
+                corners[c][0] = _mm_setr_ps(a.x, b.x, d.x, e.x);
+                corners[c][1] = _mm_setr_ps(a.y, b.y, d.y, e.y);
+                corners[c][2] = _mm_setr_ps(a.z, b.z, d.z, e.z);
+            }
+            __m128 e1[3], e2[3];
+            for(int axis = 0; axis < 3; ++axis) {
+                e1[axis] = _mm_sub_ps(corners[1][axis], corners[0][axis]);
+                e2[axis] = _mm_sub_ps(corners[2][axis], corners[0][axis]);
+            }
+            __m128 nx = _mm_sub_ps(_mm_mul_ps(e1[1], e2[2]), _mm_mul_ps(e1[2], e2[1]));
+            __m128 ny = _mm_sub_ps(_mm_mul_ps(e1[2], e2[0]), _mm_mul_ps(e1[0], e2[2]));
+            __m128 nz = _mm_sub_ps(_mm_mul_ps(e1[0], e2[1]), _mm_mul_ps(e1[1], e2[0]));
+
+            // Degenerate faces get a zero unit normal
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+            __m128 inverse = _mm_and_ps(_mm_cmpgt_ps(length, _mm_setzero_ps()), _mm_div_ps(_mm_set1_ps(1.0f), length));
+            __m128 ux = _mm_mul_ps(nx, inverse), uy = _mm_mul_ps(ny, inverse), uz = _mm_mul_ps(nz, inverse);
+
+            // Back to one register per face
+            __m128 nw = _mm_setzero_ps(), uw = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+            _MM_TRANSPOSE4_PS(ux, uy, uz, uw);
+            _mm_storeu_ps(&weighted[face].x, nx);
+            _mm_storeu_ps(&weighted[face + 1].x, ny);
+            _mm_storeu_ps(&weighted[face + 2].x, nz);
+            _mm_storeu_ps(&weighted[face + 3].x, nw);
+            _mm_storeu_ps(&unit[face].x, ux);
+            _mm_storeu_ps(&unit[face + 1].x, uy);
+            _mm_storeu_ps(&unit[face + 2].x, uz);
+            _mm_storeu_ps(&unit[face + 3].x, uw);
+        }
+#endif
+
+        for(; face < end; ++face) {
+            const glm::vec3& a = p[index[3 * face]];
+            glm::vec3 normal = glm::cross(p[index[3 * face + 1]] - a, p[index[3 * face + 2]] - a);
+            float length = glm::length(normal);
+            weighted[face] = glm::vec4(normal, 0.0f);
+            unit[face] = glm::vec4(length > 0.0f ? normal / length : glm::vec3(0.0f), 0.0f);
+        }
+    });
+}
+
+// Sum of the weighted normals of the faces with a corner in corners[begin, end) whose unit normal
+// is within the crease of normal, plus face's own. The faces are always visited in the order of
+// corners, so corners that include the same faces get bit-identical sums.
+glm::vec3 accumulate(const vector<glm::vec4>& weighted, const vector<glm::vec4>& unit, const uint32_t* corners,
+                     size_t begin, size_t end, size_t face, const glm::vec4& normal, float cosCrease) {
+#ifdef NORMALGENERATOR_SSE2
+    __m128 n = _mm_loadu_ps(&normal.x);
+    __m128 threshold = _mm_set1_ps(cosCrease);
+    __m128 sum = _mm_setzero_ps();
+    for(size_t i = begin; i < end; ++i) {
+        size_t other = corners[i] / 3;
+        __m128 w = _mm_loadu_ps(&weighted[other].x);
+        if(other == face) {
+            sum = _mm_add_ps(sum, w);
+            continue;
+        }
+        // The dot product ends up in every lane, since w is 0
+        __m128 d = _mm_mul_ps(n, _mm_loadu_ps(&unit[other].x));
+        d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+        d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_ps(sum, _mm_and_ps(_mm_cmpge_ps(d, threshold), w));
+    }
+    float result[4];
+    _mm_storeu_ps(result, sum);
+    return glm::vec3(result[0], result[1], result[2]);
+#else
+    glm::vec3 sum(0.0f);
+    for(size_t i = begin; i < end; ++i) {
+        size_t other = corners[i] / 3;
+        if(other == face || glm::dot(normal, unit[other]) >= cosCrease)
+            sum += glm::vec3(weighted[other]);
+    }
+    return sum;
+#endif
+}
+
+}
+
+NormalGenerator::NormalGenerator() {}
+
+NormalGenerator::~NormalGenerator() {}
+
+size_t NormalGenerator::generate(vector<glm::vec3>& vertices, vector<glm::vec2>& uvs, vector<unsigned int>& indices,
+                                 float creaseAngle, vector<glm::vec3>& normals) {
+    const size_t numVertices = vertices.size();
+    const size_t numCorners = indices.size() / 3 * 3;
+    normals.assign(numVertices, glm::vec3(0.0f, 0.0f, 1.0f));
+    if(numCorners == 0)
+        return 0;
+
+    vector<glm::vec4> weighted, unit;
+    faceNormals(vertices, indices, weighted, unit);
+
+    // Number the distinct positions
+    vector<PositionKey> keys(numVertices);
+    Utils::parallelFor(numChunks(numVertices), [&](size_t chunk) {
+        for(size_t i = chunk * ChunkSize; i < std::min(numVertices, (chunk + 1) * ChunkSize); ++i) {
+            PositionKey key = { positionBits(vertices[i].x), positionBits(vertices[i].y), positionBits(vertices[i].z), uint32_t(i) };
+            keys[i] = key;
+        }
+    });
+    Utils::parallelSort(keys, ChunkSize);
+
+    vector<uint32_t> positionOf(numVertices);
+    uint32_t numPositions = 0;
+    for(size_t i = 0; i < numVertices; ++i) {
+        if(i > 0 && (keys[i].x != keys[i - 1].x || keys[i].y != keys[i - 1].y || keys[i].z != keys[i - 1].z))
+            ++numPositions;
+        positionOf[keys[i].vertex] = numPositions;
+    }
+    ++numPositions;
+    vector<PositionKey>().swap(keys);
+
+    // The corners at each position, in corner order. Counting sort: two streaming passes.
+    vector<uint32_t> offsets(numPositions + 1, 0);
+    for(size_t c = 0; c < numCorners; ++c)
+        ++offsets[positionOf[indices[c]] + 1];
+    for(size_t i = 0; i < numPositions; ++i)
+        offsets[i + 1] += offsets[i];
+    vector<uint32_t> corners(numCorners);
+    {
+        vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for(size_t c = 0; c < numCorners; ++c)
+            corners[cursor[positionOf[indices[c]]]++] = uint32_t(c);
+    }
+
+    // Flat normals only take the corner's own face
+    float cosCrease = creaseAngle <= 0.0f ? 2.0f : std::cos(glm::radians(std::min(creaseAngle, 180.0f)));
+
+    vector<glm::vec3> cornerNormals(numCorners);
+    Utils::parallelFor(numChunks(numCorners), [&](size_t chunk) {
+        for(size_t c = chunk * ChunkSize; c < std::min(numCorners, (chunk + 1) * ChunkSize); ++c) {
+            size_t face = c / 3;
+            uint32_t position = positionOf[indices[c]];
+            glm::vec3 sum = accumulate(weighted, unit, corners.data(), offsets[position], offsets[position + 1], face, unit[face], cosCrease);
+            // A degenerate face takes whatever its neighbours agree on
+            if(glm::dot(sum, sum) == 0.0f)
+                sum = accumulate(weighted, unit, corners.data(), offsets[position], offsets[position + 1], face, glm::vec4(0.0f), -2.0f);
+            float length = glm::length(sum);
+            cornerNormals[c] = length > 0.0f ? sum / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+    });
+    vector<glm::vec4>().swap(weighted);
+    vector<glm::vec4>().swap(unit);
+
+    // Within each position, corners of the same vertex with the same normal share it. The first
+    // normal of a vertex keeps the vertex; every other one gets a copy of it. Run twice: once to
+    // count the copies of each chunk, then to write them.
+    auto split = [&](size_t chunk, size_t nextVertex, bool write, vector<uint32_t>& original, vector<uint32_t>& resolved) {
+        size_t added = 0;
+        for(size_t position = chunk * ChunkSize; position < std::min<size_t>(numPositions, (chunk + 1) * ChunkSize); ++position) {
+            size_t begin = offsets[position], count = offsets[position + 1] - begin;
+            original.resize(count);
+            resolved.resize(count);
+            for(size_t i = 0; i < count; ++i)
+                original[i] = indices[corners[begin + i]];
+
+            for(size_t i = 0; i < count; ++i) {
+                const glm::vec3& normal = cornerNormals[corners[begin + i]];
+                bool seenVertex = false;
+                size_t match = i;
+                for(size_t j = 0; j < i && match == i; ++j) {
+                    if(original[j] != original[i])
+                        continue;
+                    seenVertex = true;
+                    if(cornerNormals[corners[begin + j]] == normal)
+                        match = j;
+                }
+
+                if(match < i) {
+                    resolved[i] = resolved[match];
+                }
+                else if(!seenVertex) {
+                    resolved[i] = original[i];
+                    if(write)
+                        normals[original[i]] = normal;
+                }
+                else {
+                    resolved[i] = uint32_t(nextVertex + added);
+                    if(write) {
+                        vertices[resolved[i]] = vertices[original[i]];
+                        if(!uvs.empty())
+                            uvs[resolved[i]] = uvs[original[i]];
+                        normals[resolved[i]] = normal;
+                    }
+                    ++added;
+                }
+                if(write)
+                    indices[corners[begin + i]] = resolved[i];
+            }
+        }
+        return added;
+    };
+
+    const size_t positionChunks = numChunks(numPositions);
+    vector<size_t> chunkAdded(positionChunks);
+    Utils::parallelFor(positionChunks, [&](size_t chunk) {
+        vector<uint32_t> original, resolved;
+        chunkAdded[chunk] = split(chunk, 0, false, original, resolved);
+    });
+
+    vector<size_t> chunkFirst(positionChunks);
+    size_t added = 0;
+    for(size_t chunk = 0; chunk < positionChunks; ++chunk) {
+        chunkFirst[chunk] = numVertices + added;
+        added += chunkAdded[chunk];
+    }
+    vertices.resize(numVertices + added);
+    normals.resize(numVertices + added);
+    if(!uvs.empty())
+        uvs.resize(numVertices + added);
+
+    Utils::parallelFor(positionChunks, [&](size_t chunk) {
+        vector<uint32_t> original, resolved;
+        split(chunk, chunkFirst[chunk], true, original, resolved);
+    });
+    return added;
+}
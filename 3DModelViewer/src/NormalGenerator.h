@@ -0,0 +1,27 @@
+#pragma once
+
+#include "glm.hpp"
+#include <vector>
+
+using std::vector;
+
+// Vertex normals for meshes read without any. Each corner gets the area weighted average of the
+// normals of the faces around its position that are within the crease angle of its own face, and
+// vertices whose corners end up with different normals are split. Corners are matched by position
+// rather than by index, so meshes whose triangles share no vertices (STL) are smoothed as well.
+// The passes run in parallel over chunks of the mesh, and face normals are computed and summed
+// with SSE where available.
+class NormalGenerator {
+
+public:
+    // Fills normals for the triangles in indices. creaseAngle is in degrees: 0 gives every face
+    // its own flat normal, 180 smooths across every edge. Split vertices are appended to vertices
+    // and, if it isn't empty, uvs, and indices are rewritten to use them. Returns the number of
+    // vertices added.
+    static size_t generate(vector<glm::vec3>& vertices, vector<glm::vec2>& uvs, vector<unsigned int>& indices,
+                           float creaseAngle, vector<glm::vec3>& normals);
+
+private:
+    NormalGenerator();
+    ~NormalGenerator();
+};
@@ -0,0 +1,223 @@
+#include "OffscreenRenderer.h"
+
+#include "QThread"
+#include "QDebug"
+
+#include "gtc/matrix_transform.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// Camera setup shared by every view; the model is scaled to fit inside the field of view
+const float CameraDistance = 3.0f;
+const float FieldOfViewDegrees = 45.0f;
+const int Samples = 4;
+
+}
+
+OffscreenRenderer::OffscreenRenderer() {
+    _surface.setFormat(QSurfaceFormat::defaultFormat());
+    _surface.create();
+
+    _context.setFormat(QSurfaceFormat::defaultFormat());
+    if(!_context.create())
+        qWarning() << "Could not create an OpenGL context for offscreen rendering";
+}
+
+OffscreenRenderer::~OffscreenRenderer() {
+    releaseResources();
+}
+
+bool OffscreenRenderer::isValid() const {
+    return _surface.isValid() && _context.isValid();
+}
+
+void OffscreenRenderer::moveToThread(QThread* thread) {
+    _context.moveToThread(thread);
+}
+
+void OffscreenRenderer::releaseResources() {
+    if(!_renderer && !_framebuffer)
+        return;
+    if(!_context.makeCurrent(&_surface))
+        return;
+
+    _renderer.reset();
+    _framebuffer.reset();
+    _context.doneCurrent();
+}
+
+bool OffscreenRenderer::makeCurrent(QSize size) {
+    if(!isValid() || !_context.makeCurrent(&_surface))
+        return false;
+
+    if(!_renderer) {
+        _renderer.reset(new Renderer());
+        _renderer->initialize();
+    }
+
+    // The framebuffer is kept between models and only recreated when the size changes
+    if(!_framebuffer || _framebuffer->size() != size) {
+        QOpenGLFramebufferObjectFormat format;
+        format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+        format.setSamples(Samples);
+        _framebuffer.reset(new QOpenGLFramebufferObject(size, format));
+    }
+
+    _framebuffer->bind();
+    _renderer->setViewport(size.width(), size.height());
+    return true;
+}
+
+void OffscreenRenderer::doneCurrent() {
+    if(_framebuffer)
+        _framebuffer->release();
+    _context.doneCurrent();
+}
+
+Renderer* OffscreenRenderer::renderer() {
+    return _renderer.get();
+}
+
+QOpenGLFramebufferObject* OffscreenRenderer::framebuffer() {
+    return _framebuffer.get();
+}
+
+bool OffscreenRenderer::render(const string& fileName, QSize size, const vector<View>& views, vector<QImage>& images,
+                               Model::ImportOptions options) {
+    images.clear();
+
+    if(!makeCurrent(size))
+        return false;
+
+    bool success = false;
+    {
+        // The model owns its textures, so it has to be destroyed while the context is still current
+        unique_ptr<Model> model = loadModel(fileName, options);
+
+        if(model) {
+            _renderer->setMeshes(model->getMeshes());
+            _renderer->setPointCloud(model->getPointCloud());
+
+            for(View view : views) {
+                setCamera(*model, viewMatrix(view, CameraDistance), size);
+                _renderer->render();
+
+                images.push_back(_framebuffer->toImage());
+            }
+
+            _renderer->releaseMeshes();
+            success = true;
+        }
+    }
+
+    doneCurrent();
+    return success;
+}
+
+unique_ptr<Model> OffscreenRenderer::loadModel(const string& fileName, Model::ImportOptions options, Model::LoadCallbacks callbacks) {
+    unique_ptr<Model> model;
+    try {
+        model.reset(new Model(fileName, options, callbacks));
+    }
+    catch(std::runtime_error& error) {
+        qWarning() << fileName.c_str() << ":" << error.what();
+        return nullptr;
+    }
+
+    if(!model->initialized())
+        return nullptr;
+
+    // fitToScreen takes the angle between the view direction and the edge of the view
+    model->fitToScreen(CameraDistance, FieldOfViewDegrees / 2.0);
+    return model;
+}
+
+void OffscreenRenderer::setCamera(Model& model, const glm::mat4& view, QSize size) {
+    setCamera(view, model.getModelMatrix(), size);
+}
+
+void OffscreenRenderer::setCamera(const MeshBounds::Sphere& bounds, const glm::mat4& view, QSize size) {
+    setCamera(view, Model::fitMatrix(bounds, CameraDistance, FieldOfViewDegrees / 2.0), size);
+}
+
+void OffscreenRenderer::setCamera(const glm::mat4& view, const glm::mat4& model, QSize size) {
+    glm::mat4 projection = glm::perspective(
+        glm::radians(FieldOfViewDegrees),
+        float(size.width()) / float(size.height()),
+        0.1f,
+        10000.0f
+    );
+
+    // Light the model from the camera so every view is evenly lit
+    glm::vec3 eye = glm::vec3(glm::inverse(view) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    _renderer->setLight(eye, glm::vec3(1.0f, 1.0f, 1.0f));
+    _renderer->setMatrices(projection, view, model);
+}
+
+glm::mat4 OffscreenRenderer::orbitMatrix(float angle, float elevation) {
+    glm::vec3 direction(
+        std::cos(elevation) * std::sin(angle),
+        std::sin(elevation),
+        std::cos(elevation) * std::cos(angle)
+    );
+    return glm::lookAt(direction * CameraDistance, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+glm::mat4 OffscreenRenderer::viewMatrix(View view, float distance) {
+    glm::vec3 direction(0.0f, 0.0f, 1.0f);
+    glm::vec3 up(0.0f, 1.0f, 0.0f);
+
+    switch(view) {
+    case Iso:
+        direction = glm::normalize(glm::vec3(1.0f, 1.0f, 1.0f));
+        break;
+    case Front:
+        break;
+    case Back:
+        direction = glm::vec3(0.0f, 0.0f, -1.0f);
+        break;
+    case Left:
+        direction = glm::vec3(-1.0f, 0.0f, 0.0f);
+        break;
+    case Right:
+        direction = glm::vec3(1.0f, 0.0f, 0.0f);
+        break;
+    case Top:
+        direction = glm::vec3(0.0f, 1.0f, 0.0f);
+        up = glm::vec3(0.0f, 0.0f, -1.0f);
+        break;
+    case Bottom:
+        direction = glm::vec3(0.0f, -1.0f, 0.0f);
+        up = glm::vec3(0.0f, 0.0f, 1.0f);
+        break;
+    }
+
+    return glm::lookAt(direction * distance, glm::vec3(0.0f), up);
+}
+
+string OffscreenRenderer::viewName(View view) {
+    switch(view) {
+    case Iso:    return "iso";
+    case Front:  return "front";
+    case Back:   return "back";
+    case Left:   return "left";
+    case Right:  return "right";
+    case Top:    return "top";
+    case Bottom: return "bottom";
+    }
+    return "";
+}
+
+bool OffscreenRenderer::parseView(const string& name, View& view) {
+    const View views[] = { Iso, Front, Back, Left, Right, Top, Bottom };
+    for(View v : views) {
+        if(viewName(v) == name) {
+            view = v;
+            return true;
+        }
+    }
+    return false;
+}
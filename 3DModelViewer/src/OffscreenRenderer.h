@@ -0,0 +1,85 @@
+#pragma once
+
+#include "QOffscreenSurface"
+#include "QOpenGLContext"
+#include "QOpenGLFramebufferObject"
+#include "QImage"
+#include "QSize"
+
+#include "Renderer.h"
+
+#include <memory>
+#include <vector>
+#include <string>
+
+using std::vector;
+using std::string;
+using std::unique_ptr;
+
+class QThread;
+
+// Renders models into an image without a window, using its own GL context on an
+// offscreen surface and a framebuffer object.
+class OffscreenRenderer {
+
+public:
+    // Directions the model can be viewed from
+    enum View {
+        Iso,
+        Front,
+        Back,
+        Left,
+        Right,
+        Top,
+        Bottom
+    };
+
+    // Must be constructed on the GUI thread, since that is the only thread offscreen surfaces can be created on
+    OffscreenRenderer();
+    ~OffscreenRenderer();
+
+    bool isValid() const;
+
+    // Hands the context over to thread; render() may only be called from that thread afterwards
+    void moveToThread(QThread* thread);
+
+    // Loads fileName and renders one image of size per view, in the order given.
+    // Returns false if the model could not be loaded.
+    bool render(const string& fileName, QSize size, const vector<View>& views, vector<QImage>& images,
+                Model::ImportOptions options = Model::ImportOptions());
+    // Destroys the GL objects; call from the rendering thread once it is done
+    void releaseResources();
+
+    // Lower level access for callers that drive the renderer themselves (e.g. benchmarks).
+    // makeCurrent binds a framebuffer of size as the render target; renderer() and framebuffer()
+    // are only valid after it succeeded.
+    bool makeCurrent(QSize size);
+    void doneCurrent();
+    Renderer* renderer();
+    QOpenGLFramebufferObject* framebuffer();
+    // Loads fileName and scales it to fit the view; returns nullptr if it could not be loaded.
+    // The context must be current, and must stay current until the model is destroyed.
+    unique_ptr<Model> loadModel(const string& fileName, Model::ImportOptions options = Model::ImportOptions(),
+                                Model::LoadCallbacks callbacks = Model::LoadCallbacks());
+    // Points the renderer's camera at model from view, lit from the camera
+    void setCamera(Model& model, const glm::mat4& view, QSize size);
+    // Same for a model that is still loading, framed by its bounding sphere as it will be once loaded
+    void setCamera(const MeshBounds::Sphere& bounds, const glm::mat4& view, QSize size);
+    // View matrix of a camera circling the model; angles in radians
+    static glm::mat4 orbitMatrix(float angle, float elevation);
+
+    // Names used for views on the command line and in output file names
+    static string viewName(View view);
+    static bool parseView(const string& name, View& view);
+
+private:
+    QOffscreenSurface _surface;
+    QOpenGLContext _context;
+    unique_ptr<QOpenGLFramebufferObject> _framebuffer;
+    // Created on first use, once the context is current on the rendering thread
+    unique_ptr<Renderer> _renderer;
+
+    void setCamera(const glm::mat4& view, const glm::mat4& model, QSize size);
+    // Returns the view matrix looking at the origin from direction view, at distance
+    static glm::mat4 viewMatrix(View view, float distance);
+};
@@ -0,0 +1,305 @@
+#include "PointCloud.h"
+#include "Frustum.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <queue>
+
+namespace {
+
+// Bits of each coordinate in the Morton codes, which is also the deepest level of the octree
+const uint32_t MortonBits = 21;
+const uint32_t MortonCells = 1u << MortonBits;
+// Positions are coded and points are copied in chunks of this many
+const size_t ChunkSize = 1 << 16;
+// Subtrees are built by separate tasks down to this depth, and by the task of their root below it
+const uint32_t ParallelDepth = 2;
+
+struct SortKey {
+    uint64_t code;
+    uint32_t point;
+
+    bool operator<(const SortKey& other) const {
+        return code != other.code ? code < other.code : point < other.point;
+    }
+};
+
+// Moves the lowest 21 bits of value to every third bit
+uint64_t spreadBits(uint32_t value) {
+    uint64_t x = value & 0x1FFFFF;
+    x = (x | x << 32) & 0x1F00000000FFFFull;
+    x = (x | x << 16) & 0x1F0000FF0000FFull;
+    x = (x | x << 8) & 0x100F00F00F00F00Full;
+    x = (x | x << 4) & 0x10C30C30C30C30C3ull;
+    x = (x | x << 2) & 0x1249249249249249ull;
+    return x;
+}
+
+size_t numChunks(size_t count) {
+    return (count + ChunkSize - 1) / ChunkSize;
+}
+
+class Builder {
+
+public:
+    explicit Builder(vector<SortKey>& keys) :
+      _keys(keys)
+    {}
+
+    // Appends the node of the keys in [begin, end), whose codes share the top 3 * depth bits,
+    // followed by its descendants in depth first order
+    void build(size_t begin, size_t end, const glm::vec3& center, float halfSize, uint32_t depth, vector<PointCloud::Node>& nodes) {
+        PointCloud::Node node;
+        node.center = center;
+        node.halfSize = halfSize;
+        node.firstPoint = begin;
+        node.depth = depth;
+        std::fill(node.children, node.children + 8, -1);
+
+        const size_t count = end - begin;
+        const bool leaf = count <= PointCloud::MaxNodePoints || depth == MortonBits;
+        node.numPoints = leaf ? uint32_t(count) : uint32_t(PointCloud::MaxNodePoints);
+        node.spacing = 2.0f * halfSize / std::sqrt(float(node.numPoints));
+
+        size_t index = nodes.size();
+        nodes.push_back(node);
+        if(leaf)
+            return;
+
+        takeSample(begin, end, node.numPoints);
+
+        // The rest is still sorted, so each child's keys follow the previous child's
+        const int shift = 3 * int(MortonBits - 1 - depth);
+        size_t childBegin = begin + node.numPoints;
+        size_t childRanges[9];
+        for(int octant = 0; octant < 8; ++octant) {
+            childRanges[octant] = childBegin;
+            childBegin = std::partition_point(_keys.begin() + childBegin, _keys.begin() + end, [&](const SortKey& key) {
+                return int((key.code >> shift) & 7) <= octant;
+            }) - _keys.begin();
+        }
+        childRanges[8] = end;
+
+        auto childCenter = [&](int octant) {
+            return center + 0.5f * halfSize * glm::vec3((octant & 4) ? 1.0f : -1.0f, (octant & 2) ? 1.0f : -1.0f, (octant & 1) ? 1.0f : -1.0f);
+        };
+
+        if(depth >= ParallelDepth) {
+            for(int octant = 0; octant < 8; ++octant) {
+                if(childRanges[octant] == childRanges[octant + 1])
+                    continue;
+                nodes[index].children[octant] = int32_t(nodes.size());
+                build(childRanges[octant], childRanges[octant + 1], childCenter(octant), 0.5f * halfSize, depth + 1, nodes);
+            }
+            return;
+        }
+
+        // Near the root the subtrees are built in parallel, then appended with their indices moved
+        vector<vector<PointCloud::Node>> subtrees(8);
+        Utils::parallelFor(8, [&](size_t octant) {
+            if(childRanges[octant] != childRanges[octant + 1])
+                build(childRanges[octant], childRanges[octant + 1], childCenter(int(octant)), 0.5f * halfSize, depth + 1, subtrees[octant]);
+        });
+        for(int octant = 0; octant < 8; ++octant) {
+            if(subtrees[octant].empty())
+                continue;
+            int32_t offset = int32_t(nodes.size());
+            nodes[index].children[octant] = offset;
+            for(PointCloud::Node& child : subtrees[octant]) {
+                for(int32_t& grandChild : child.children) {
+                    if(grandChild >= 0)
+                        grandChild += offset;
+                }
+                nodes.push_back(child);
+            }
+        }
+    }
+
+private:
+    vector<SortKey>& _keys;
+
+    // Moves an evenly spaced sample of size keys of [begin, end) to its front, keeping the order of both parts.
+    // Every key is at or after the place it moves to, so the sample can be compacted in place.
+    void takeSample(size_t begin, size_t end, size_t size) {
+        const size_t count = end - begin;
+        vector<SortKey> rest;
+        rest.reserve(count - size);
+        size_t taken = 0;
+        for(size_t i = 0; i < count; ++i) {
+            // The i-th key is the next sample if it is the one nearest the middle of its stride
+            if(taken < size && i == (2 * taken + 1) * count / (2 * size))
+                _keys[begin + taken++] = _keys[begin + i];
+            else
+                rest.push_back(_keys[begin + i]);
+        }
+        std::copy(rest.begin(), rest.end(), _keys.begin() + begin + size);
+    }
+};
+
+}
+
+PointCloud::View::View() :
+  pixelsPerUnit(1.0f),
+  pointBudget(0),
+  minSpacingPixels(1.0f)
+{}
+
+PointCloud::PointCloud() {}
+
+void PointCloud::build(vector<glm::vec3>& positions, vector<uint32_t>& colors) {
+    computeBounds(positions);
+
+    // The octree spans the cube around the bounds
+    glm::vec3 extent = _bounds.max - _bounds.min;
+    float size = std::max(extent.x, std::max(extent.y, extent.z));
+    if(size <= 0.0f)
+        size = 1.0f;
+    buildInCube(positions, colors, _bounds.min, size);
+}
+
+void PointCloud::build(vector<glm::vec3>& positions, vector<uint32_t>& colors, const glm::vec3& origin, float size) {
+    computeBounds(positions);
+    buildInCube(positions, colors, origin, size);
+}
+
+void PointCloud::computeBounds(const vector<glm::vec3>& positions) {
+    vector<const vector<glm::vec3>*> arrays(1, &positions);
+    vector<MeshBounds::Box> boxes;
+    vector<MeshBounds::Sphere> spheres;
+    MeshBounds::compute(arrays, boxes, spheres);
+    _bounds = boxes[0];
+}
+
+void PointCloud::buildInCube(vector<glm::vec3>& positions, vector<uint32_t>& colors, const glm::vec3& origin, float size) {
+    _nodes.clear();
+    _points.clear();
+    const size_t count = positions.size();
+    if(count == 0)
+        return;
+
+    const float scale = MortonCells / size;
+
+    vector<SortKey> keys(count);
+    Utils::parallelFor(numChunks(count), [&](size_t chunk) {
+        size_t last = std::min(count, (chunk + 1) * ChunkSize);
+        for(size_t i = chunk * ChunkSize; i < last; ++i) {
+            glm::vec3 cell = (positions[i] - origin) * scale;
+            uint32_t x = std::min(uint32_t(std::max(cell.x, 0.0f)), MortonCells - 1);
+            uint32_t y = std::min(uint32_t(std::max(cell.y, 0.0f)), MortonCells - 1);
+            uint32_t z = std::min(uint32_t(std::max(cell.z, 0.0f)), MortonCells - 1);
+            keys[i].code = (spreadBits(x) << 2) | (spreadBits(y) << 1) | spreadBits(z);
+            keys[i].point = uint32_t(i);
+        }
+    });
+    Utils::parallelSort(keys, ChunkSize);
+
+    Builder builder(keys);
+    builder.build(0, count, origin + glm::vec3(0.5f * size), 0.5f * size, 0, _nodes);
+
+    // The keys are now in the order of the nodes' points
+    _points.resize(count);
+    const bool hasColors = colors.size() == count;
+    Utils::parallelFor(numChunks(count), [&](size_t chunk) {
+        size_t last = std::min(count, (chunk + 1) * ChunkSize);
+        for(size_t i = chunk * ChunkSize; i < last; ++i) {
+            _points[i].position = positions[keys[i].point];
+            _points[i].color = hasColors ? colors[keys[i].point] : uint32_t(DefaultColor);
+        }
+    });
+    vector<SortKey>().swap(keys);
+    vector<glm::vec3>().swap(positions);
+    vector<uint32_t>().swap(colors);
+
+    // Bounds of each node's own points, then of whole subtrees from the leaves up; children always follow their parent
+    Utils::parallelFor(_nodes.size(), [&](size_t i) {
+        Node& node = _nodes[i];
+        node.bounds = MeshBounds::Box();
+        for(uint64_t p = node.firstPoint; p < node.firstPoint + node.numPoints; ++p) {
+            node.bounds.min = glm::min(node.bounds.min, _points[p].position);
+            node.bounds.max = glm::max(node.bounds.max, _points[p].position);
+        }
+    });
+    for(size_t i = _nodes.size(); i-- > 0;) {
+        for(int32_t child : _nodes[i].children) {
+            if(child >= 0)
+                _nodes[i].bounds.extend(_nodes[child].bounds);
+        }
+    }
+}
+
+const vector<PointCloud::Node>& PointCloud::nodes() const {
+    return _nodes;
+}
+
+const vector<PointCloud::Point>& PointCloud::points() const {
+    return _points;
+}
+
+size_t PointCloud::numPoints() const {
+    return _points.size();
+}
+
+const MeshBounds::Box& PointCloud::bounds() const {
+    return _bounds;
+}
+
+size_t PointCloud::memoryBytes() const {
+    return _points.capacity() * sizeof(Point) + _nodes.capacity() * sizeof(Node);
+}
+
+void PointCloud::select(const vector<Node>& nodes, const View& view, vector<uint32_t>& selected) {
+    if(nodes.empty())
+        return;
+
+    struct Candidate {
+        float priority;
+        float distance;
+        uint32_t node;
+
+        bool operator<(const Candidate& other) const {
+            return priority < other.priority;
+        }
+    };
+
+    // Nodes are ranked by the size of their bounding sphere on screen
+    Frustum frustum(view.mvp);
+    std::priority_queue<Candidate> queue;
+    auto consider = [&](uint32_t index) {
+        const MeshBounds::Box& bounds = nodes[index].bounds;
+        if(bounds.isEmpty())
+            return;
+        glm::vec3 center = bounds.center();
+        float radius = 0.5f * glm::distance(bounds.min, bounds.max);
+        if(!frustum.intersectsSphere(center, radius))
+            return;
+        float distance = glm::distance(center, view.cameraPosition) - radius;
+        Candidate candidate;
+        candidate.priority = distance > 0.0f ? radius / distance : FLT_MAX;
+        candidate.distance = distance;
+        candidate.node = index;
+        queue.push(candidate);
+    };
+
+    consider(0);
+    size_t points = 0;
+    while(!queue.empty()) {
+        Candidate candidate = queue.top();
+        queue.pop();
+        const Node& node = nodes[candidate.node];
+        if(points + node.numPoints > view.pointBudget)
+            break;
+        selected.push_back(candidate.node);
+        points += node.numPoints;
+
+        // Children only add detail where the node's own points are still visibly apart
+        float distance = std::max(candidate.distance, 1e-6f);
+        if(node.spacing * view.pixelsPerUnit / distance < view.minSpacingPixels)
+            continue;
+        for(int32_t child : node.children) {
+            if(child >= 0)
+                consider(uint32_t(child));
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "glm.hpp"
+#include "MeshBounds.h"
+
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+// Points of a scan without faces, kept in an octree so only what is visible at a useful density is
+// drawn. The points are sorted along a Morton curve, which puts points that are close in space
+// next to each other. Every node keeps an evenly spaced sample of at most MaxNodePoints of the
+// points in its cube for itself and leaves the rest to its children, so the points of a node and
+// its ancestors together are a coarser version of the node's region. The points of each node are
+// contiguous, stored in depth first order.
+class PointCloud {
+
+public:
+    // Points a node keeps for itself; nodes with fewer points in their cube have no children
+    static const uint32_t MaxNodePoints = 1 << 14;
+    // Colour of points read without one
+    static const uint32_t DefaultColor = 0xFFB4B4B4;
+
+    struct Point {
+        glm::vec3 position;
+        uint32_t color; // RGBA, 8 bits each, red in the lowest byte
+    };
+
+    struct Node {
+        // The node's cube
+        glm::vec3 center;
+        float halfSize;
+        // Bounds of the points of the node and all its descendants
+        MeshBounds::Box bounds;
+        // Average distance between the node's own points
+        float spacing;
+        uint64_t firstPoint;
+        uint32_t numPoints;
+        int32_t children[8]; // Indices into nodes(), or -1
+        uint32_t depth;
+    };
+
+    // What select() needs to know about the view, all in the cloud's own coordinates
+    struct View {
+        View();
+
+        glm::mat4 mvp;
+        glm::vec3 cameraPosition;
+        // Size in pixels of one unit at a distance of one unit from the camera
+        float pixelsPerUnit;
+        // Most points to select
+        size_t pointBudget;
+        // Nodes whose points are already closer together than this on screen aren't refined
+        float minSpacingPixels;
+    };
+
+    PointCloud();
+
+    // Builds the octree of positions. colors holds one colour per position, or is empty for
+    // DefaultColor. Both are released. The stages run in parallel.
+    void build(vector<glm::vec3>& positions, vector<uint32_t>& colors);
+    // Same, but the root node is the cube of edge size at origin, which should hold the positions;
+    // those outside are put in the nearest leaf. Used to build the subtrees of larger octrees.
+    void build(vector<glm::vec3>& positions, vector<uint32_t>& colors, const glm::vec3& origin, float size);
+
+    const vector<Node>& nodes() const;
+    const vector<Point>& points() const;
+    size_t numPoints() const;
+    const MeshBounds::Box& bounds() const;
+    size_t memoryBytes() const;
+
+    // Appends to selected the nodes of nodes to draw for view, from the most to the least
+    // important: nodes that cover more of the screen first, each followed by its children only if
+    // it is visible, its points aren't dense enough yet, and the budget allows. Works on any node
+    // array laid out like nodes(), so it also drives clouds that aren't held in memory.
+    static void select(const vector<Node>& nodes, const View& view, vector<uint32_t>& selected);
+
+private:
+    vector<Node> _nodes;
+    vector<Point> _points;
+    MeshBounds::Box _bounds;
+
+    void computeBounds(const vector<glm::vec3>& positions);
+    void buildInCube(vector<glm::vec3>& positions, vector<uint32_t>& colors, const glm::vec3& origin, float size);
+};
@@ -0,0 +1,629 @@
+#include "PointCloudFile.h"
+#include "NativeImporter.h"
+
+#include "QDebug"
+#include "QElapsedTimer"
+#include "QFileInfo"
+#include "QSaveFile"
+#include "QTemporaryFile"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const char Magic[8] = { 'M', 'V', 'P', 'O', 'I', 'N', 'T', 'S' };
+// Increase whenever the layout below changes
+const quint32 Version = 1;
+// Files are written in native byte order; one written on a machine of the other order is rejected
+const quint32 ByteOrderMark = 0x01020304;
+
+// Memory a point takes while its bucket is built: the point, the arrays build() makes, and its sort key
+const size_t BuildBytesPerPoint = 64;
+// Most points read from the input at once
+const size_t MaxBatchPoints = 1 << 22;
+// Deepest level the buckets can be at. Points are counted per cell of this level to choose it.
+const int HistogramDepth = 5;
+// Memory of the write buffers of all buckets while the points are scattered
+const size_t ScatterBytes = 64 << 20;
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    quint64 numNodes;
+    quint64 numPoints;
+    quint64 pointsOffset;
+    quint64 nodesOffset;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+// PointCloud::Node with explicit padding, so no uninitialized bytes are written
+struct NodeRecord {
+    float center[3];
+    float halfSize;
+    float boundsMin[3];
+    float boundsMax[3];
+    float spacing;
+    quint32 numPoints;
+    quint64 firstPoint;
+    qint32 children[8];
+    quint32 depth;
+    quint32 padding;
+};
+
+double elapsedMs(const QElapsedTimer& timer) {
+    return timer.nsecsElapsed() / 1e6;
+}
+
+bool writeAll(QIODevice& device, const void* data, size_t bytes) {
+    return device.write(static_cast<const char*>(data), qint64(bytes)) == qint64(bytes);
+}
+
+bool readAll(QIODevice& device, void* data, size_t bytes) {
+    return device.read(static_cast<char*>(data), qint64(bytes)) == qint64(bytes);
+}
+
+FileHeader fileHeader(size_t numNodes, size_t numPoints, const MeshBounds::Box& bounds) {
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.byteOrder = ByteOrderMark;
+    header.numNodes = numNodes;
+    header.numPoints = numPoints;
+    header.pointsOffset = sizeof(FileHeader);
+    header.nodesOffset = header.pointsOffset + numPoints * sizeof(PointCloud::Point);
+    for(int axis = 0; axis < 3; ++axis) {
+        header.boundsMin[axis] = bounds.min[axis];
+        header.boundsMax[axis] = bounds.max[axis];
+    }
+    return header;
+}
+
+NodeRecord toRecord(const PointCloud::Node& node) {
+    NodeRecord record;
+    memset(&record, 0, sizeof(record));
+    for(int axis = 0; axis < 3; ++axis) {
+        record.center[axis] = node.center[axis];
+        record.boundsMin[axis] = node.bounds.min[axis];
+        record.boundsMax[axis] = node.bounds.max[axis];
+    }
+    record.halfSize = node.halfSize;
+    record.spacing = node.spacing;
+    record.numPoints = node.numPoints;
+    record.firstPoint = node.firstPoint;
+    std::copy(node.children, node.children + 8, record.children);
+    record.depth = node.depth;
+    return record;
+}
+
+PointCloud::Node fromRecord(const NodeRecord& record) {
+    PointCloud::Node node;
+    node.center = glm::vec3(record.center[0], record.center[1], record.center[2]);
+    node.halfSize = record.halfSize;
+    node.bounds.min = glm::vec3(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]);
+    node.bounds.max = glm::vec3(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]);
+    node.spacing = record.spacing;
+    node.numPoints = record.numPoints;
+    node.firstPoint = record.firstPoint;
+    std::copy(record.children, record.children + 8, node.children);
+    node.depth = record.depth;
+    return node;
+}
+
+bool writeNodes(QIODevice& device, const vector<PointCloud::Node>& nodes) {
+    vector<NodeRecord> records;
+    records.reserve(nodes.size());
+    for(const PointCloud::Node& node : nodes)
+        records.push_back(toRecord(node));
+    return writeAll(device, records.data(), records.size() * sizeof(NodeRecord));
+}
+
+// Index in Morton order of the cell holding position among the cells of the given depth of the
+// cube at origin with edge size. The x bit is the highest of each octant, as in PointCloud.
+uint32_t cellIndex(const glm::vec3& position, const glm::vec3& origin, float size, int depth) {
+    const float cells = float(1 << depth);
+    glm::vec3 cell = glm::clamp((position - origin) * (cells / size), glm::vec3(0.0f), glm::vec3(cells - 1.0f));
+    uint32_t x = uint32_t(cell.x), y = uint32_t(cell.y), z = uint32_t(cell.z);
+    uint32_t index = 0;
+    for(int bit = depth - 1; bit >= 0; --bit)
+        index = (index << 3) | (((x >> bit) & 1) << 2) | (((y >> bit) & 1) << 1) | ((z >> bit) & 1);
+    return index;
+}
+
+// Lowest corner of the cell with the given index and depth
+glm::vec3 cellOrigin(uint32_t index, const glm::vec3& origin, float size, int depth) {
+    uint32_t x = 0, y = 0, z = 0;
+    for(int bit = depth - 1; bit >= 0; --bit) {
+        uint32_t octant = (index >> (3 * bit)) & 7;
+        x = (x << 1) | (octant >> 2);
+        y = (y << 1) | ((octant >> 1) & 1);
+        z = (z << 1) | (octant & 1);
+    }
+    return origin + glm::vec3(float(x), float(y), float(z)) * (size / float(1 << depth));
+}
+
+// Appends a batch read from the input, keeping colors either empty or as long as positions
+void appendBatch(vector<glm::vec3>& positions, vector<uint32_t>& colors, const vector<glm::vec3>& batchPositions, const vector<uint32_t>& batchColors) {
+    if(!batchColors.empty() || !colors.empty()) {
+        colors.resize(positions.size(), uint32_t(PointCloud::DefaultColor));
+        if(batchColors.size() == batchPositions.size())
+            colors.insert(colors.end(), batchColors.begin(), batchColors.end());
+        else
+            colors.resize(colors.size() + batchPositions.size(), uint32_t(PointCloud::DefaultColor));
+    }
+    positions.insert(positions.end(), batchPositions.begin(), batchPositions.end());
+}
+
+// A point given up by its bucket to the levels above the buckets
+struct TopPoint {
+    uint32_t bucket;
+    PointCloud::Point point;
+};
+
+// Builds the levels above the buckets from the points the buckets gave up, which are sorted by
+// bucket, so the points of any cell above the buckets are contiguous. Each node keeps an even
+// sample of its cell's points and passes the rest down, like PointCloud's nodes; the nodes just
+// above the buckets keep whatever is left and have the buckets' subtrees as children.
+class TopBuilder {
+
+public:
+    TopBuilder(vector<TopPoint>& points, const glm::vec3& origin, float size, int bucketDepth,
+               const vector<quint64>& bucketPrefix, const vector<int32_t>& bucketRoots, const vector<PointCloud::Node>& bucketNodes) :
+      _points(points),
+      _origin(origin),
+      _size(size),
+      _bucketDepth(bucketDepth),
+      _bucketPrefix(bucketPrefix),
+      _bucketRoots(bucketRoots),
+      _bucketNodes(bucketNodes)
+    {}
+
+    // Appends the node of cell index at depth, whose points are [begin, end), and its descendants above the buckets
+    int32_t build(int depth, uint32_t index, size_t begin, size_t end, vector<PointCloud::Node>& nodes) {
+        const float cellSize = _size / float(1 << depth);
+        PointCloud::Node node;
+        node.center = cellOrigin(index, _origin, _size, depth) + glm::vec3(0.5f * cellSize);
+        node.halfSize = 0.5f * cellSize;
+        node.depth = uint32_t(depth);
+        std::fill(node.children, node.children + 8, -1);
+
+        const bool lastLevel = depth == _bucketDepth - 1;
+        const size_t count = end - begin;
+        node.numPoints = uint32_t(lastLevel ? count : std::min(count, size_t(PointCloud::MaxNodePoints)));
+        node.spacing = 2.0f * node.halfSize / std::sqrt(float(std::max<uint32_t>(node.numPoints, 1)));
+        node.firstPoint = begin;
+        if(!lastLevel)
+            takeSample(begin, end, node.numPoints);
+        node.bounds = MeshBounds::Box();
+        for(size_t i = begin; i < begin + node.numPoints; ++i) {
+            node.bounds.min = glm::min(node.bounds.min, _points[i].point.position);
+            node.bounds.max = glm::max(node.bounds.max, _points[i].point.position);
+        }
+
+        const int32_t self = int32_t(nodes.size());
+        nodes.push_back(node);
+
+        if(lastLevel) {
+            // Indices into the bucket nodes, moved behind these nodes once they are all built
+            for(uint32_t octant = 0; octant < 8; ++octant) {
+                int32_t root = _bucketRoots[index * 8 + octant];
+                nodes[self].children[octant] = root;
+                if(root >= 0)
+                    nodes[self].bounds.extend(_bucketNodes[root].bounds);
+            }
+            return self;
+        }
+
+        const int shift = 3 * (_bucketDepth - depth - 1);
+        size_t childBegin = begin + node.numPoints;
+        for(uint32_t octant = 0; octant < 8; ++octant) {
+            const uint32_t child = index * 8 + octant;
+            size_t childEnd = std::partition_point(_points.begin() + childBegin, _points.begin() + end, [&](const TopPoint& point) {
+                return (point.bucket >> shift) <= child;
+            }) - _points.begin();
+            if(hasPoints(depth + 1, child)) {
+                int32_t built = build(depth + 1, child, childBegin, childEnd, nodes);
+                nodes[self].children[octant] = built;
+                nodes[self].bounds.extend(nodes[built].bounds);
+            }
+            childBegin = childEnd;
+        }
+        return self;
+    }
+
+private:
+    vector<TopPoint>& _points;
+    glm::vec3 _origin;
+    float _size;
+    int _bucketDepth;
+    const vector<quint64>& _bucketPrefix; // Points in the buckets before each bucket
+    const vector<int32_t>& _bucketRoots;
+    const vector<PointCloud::Node>& _bucketNodes;
+
+    // Whether any bucket below cell index at depth has points
+    bool hasPoints(int depth, uint32_t index) const {
+        const int shift = 3 * (_bucketDepth - depth);
+        return _bucketPrefix[size_t(index + 1) << shift] > _bucketPrefix[size_t(index) << shift];
+    }
+
+    // Moves an evenly spaced sample of size points of [begin, end) to its front, keeping the order of both parts
+    void takeSample(size_t begin, size_t end, size_t size) {
+        const size_t count = end - begin;
+        if(size == count)
+            return;
+        vector<TopPoint> rest;
+        rest.reserve(count - size);
+        size_t taken = 0;
+        for(size_t i = 0; i < count; ++i) {
+            if(taken < size && i == (2 * taken + 1) * count / (2 * size))
+                _points[begin + taken++] = _points[begin + i];
+            else
+                rest.push_back(_points[begin + i]);
+        }
+        std::copy(rest.begin(), rest.end(), _points.begin() + begin + size);
+    }
+};
+
+}
+
+const char* const PointCloudFile::Suffix = "mvpc";
+
+PointCloudFile::PointCloudFile() :
+  _numPoints(0),
+  _pointsOffset(0)
+{}
+
+bool PointCloudFile::isPointCloudFile(const string& fileName) {
+    return QFileInfo(QString::fromStdString(fileName)).suffix().toLower() == Suffix;
+}
+
+bool PointCloudFile::write(const string& fileName, const PointCloud& cloud, string& error) {
+    // Written to a temporary file that replaces the output once complete
+    QSaveFile file(QString::fromStdString(fileName));
+    if(!file.open(QIODevice::WriteOnly)) {
+        error = file.errorString().toStdString();
+        return false;
+    }
+
+    FileHeader header = fileHeader(cloud.nodes().size(), cloud.numPoints(), cloud.bounds());
+    bool ok = writeAll(file, &header, sizeof(header))
+           && writeAll(file, cloud.points().data(), cloud.numPoints() * sizeof(PointCloud::Point))
+           && writeNodes(file, cloud.nodes());
+    if(!ok || !file.commit()) {
+        error = "Could not write " + fileName;
+        return false;
+    }
+    return true;
+}
+
+bool PointCloudFile::build(const string& inputFile, const string& outputFile, size_t memoryBytes, ImportStatistics& statistics, string& error) {
+    QElapsedTimer timer;
+    timer.start();
+    statistics.setFileName(inputFile);
+
+    const size_t maxPoints = std::max(memoryBytes / BuildBytesPerPoint, size_t(PointCloud::MaxNodePoints));
+    const size_t batchPoints = std::min(maxPoints, MaxBatchPoints);
+
+    // First pass: bounds and number of points
+    MeshBounds::Box bounds;
+    quint64 numPoints = 0;
+    bool read = NativeImporter::readPoints(inputFile, batchPoints, [&](vector<glm::vec3>& positions, vector<uint32_t>&) {
+        vector<const vector<glm::vec3>*> arrays(1, &positions);
+        vector<MeshBounds::Box> boxes;
+        vector<MeshBounds::Sphere> spheres;
+        MeshBounds::compute(arrays, boxes, spheres);
+        bounds.extend(boxes[0]);
+        numPoints += positions.size();
+    }, error);
+    if(!read)
+        return false;
+    if(numPoints == 0) {
+        error = "No points found";
+        return false;
+    }
+    statistics.addStage("Bounds pass", elapsedMs(timer), 0, size_t(numPoints));
+
+    // Clouds that fit in memory are built there in one go
+    if(numPoints <= maxPoints) {
+        timer.restart();
+        vector<glm::vec3> positions;
+        vector<uint32_t> colors;
+        positions.reserve(size_t(numPoints));
+        read = NativeImporter::readPoints(inputFile, batchPoints, [&](vector<glm::vec3>& batchPositions, vector<uint32_t>& batchColors) {
+            appendBatch(positions, colors, batchPositions, batchColors);
+        }, error);
+        if(!read)
+            return false;
+        statistics.addStage("Read points", elapsedMs(timer), positions.size() * sizeof(glm::vec3), positions.size());
+
+        timer.restart();
+        PointCloud cloud;
+        cloud.build(positions, colors);
+        statistics.addStage("Point octree", elapsedMs(timer), cloud.memoryBytes(), cloud.nodes().size());
+
+        timer.restart();
+        if(!write(outputFile, cloud, error))
+            return false;
+        statistics.addStage("Write", elapsedMs(timer), cloud.numPoints() * sizeof(PointCloud::Point), cloud.nodes().size());
+        return true;
+    }
+
+    // The octree spans the cube around the bounds
+    glm::vec3 extent = bounds.max - bounds.min;
+    float size = std::max(extent.x, std::max(extent.y, extent.z));
+    if(size <= 0.0f)
+        size = 1.0f;
+    const glm::vec3 origin = bounds.min;
+
+    // Second pass: points per cell of the deepest level the buckets can be at
+    timer.restart();
+    vector<quint64> histogram(size_t(1) << (3 * HistogramDepth), 0);
+    read = NativeImporter::readPoints(inputFile, batchPoints, [&](vector<glm::vec3>& positions, vector<uint32_t>&) {
+        for(const glm::vec3& position : positions)
+            ++histogram[cellIndex(position, origin, size, HistogramDepth)];
+    }, error);
+    if(!read)
+        return false;
+
+    // The buckets are the cells of the shallowest level whose densest cell fits in memory
+    int bucketDepth = 1;
+    vector<quint64> bucketCounts;
+    for(;; ++bucketDepth) {
+        const int shift = 3 * (HistogramDepth - bucketDepth);
+        bucketCounts.assign(size_t(1) << (3 * bucketDepth), 0);
+        for(size_t cell = 0; cell < histogram.size(); ++cell)
+            bucketCounts[cell >> shift] += histogram[cell];
+        if(*std::max_element(bucketCounts.begin(), bucketCounts.end()) <= maxPoints || bucketDepth == HistogramDepth)
+            break;
+    }
+    const size_t numBuckets = bucketCounts.size();
+    vector<quint64> bucketPrefix(numBuckets + 1, 0);
+    for(size_t b = 0; b < numBuckets; ++b)
+        bucketPrefix[b + 1] = bucketPrefix[b] + bucketCounts[b];
+    quint64 densest = *std::max_element(bucketCounts.begin(), bucketCounts.end());
+    if(densest > maxPoints)
+        qWarning() << "The densest cell of" << inputFile.c_str() << "holds" << densest << "points, more than the build memory allows";
+    statistics.addStage("Histogram pass", elapsedMs(timer), 0, numBuckets);
+
+    // Third pass: scatter the points into a scratch file, bucket after bucket
+    timer.restart();
+    QTemporaryFile scratch(QFileInfo(QString::fromStdString(outputFile)).absolutePath() + "/XXXXXX.scratch");
+    if(!scratch.open() || !scratch.resize(qint64(numPoints * sizeof(PointCloud::Point)))) {
+        error = "Could not create the scratch file: " + scratch.errorString().toStdString();
+        return false;
+    }
+    const size_t bufferPoints = std::max<size_t>(64, std::min<size_t>(1 << 16, ScatterBytes / (numBuckets * sizeof(PointCloud::Point))));
+    vector<quint64> cursors(bucketPrefix.begin(), bucketPrefix.end() - 1);
+    vector<vector<PointCloud::Point>> buffers(numBuckets);
+    bool scattered = true;
+    auto flush = [&](size_t bucket) {
+        vector<PointCloud::Point>& buffer = buffers[bucket];
+        if(buffer.empty())
+            return;
+        scattered = scattered && scratch.seek(qint64(cursors[bucket] * sizeof(PointCloud::Point)))
+                 && writeAll(scratch, buffer.data(), buffer.size() * sizeof(PointCloud::Point));
+        cursors[bucket] += buffer.size();
+        buffer.clear();
+    };
+    read = NativeImporter::readPoints(inputFile, batchPoints, [&](vector<glm::vec3>& positions, vector<uint32_t>& colors) {
+        const bool hasColors = colors.size() == positions.size();
+        for(size_t i = 0; i < positions.size(); ++i) {
+            PointCloud::Point point;
+            point.position = positions[i];
+            point.color = hasColors ? colors[i] : uint32_t(PointCloud::DefaultColor);
+            size_t bucket = cellIndex(point.position, origin, size, bucketDepth);
+            buffers[bucket].push_back(point);
+            if(buffers[bucket].size() >= bufferPoints)
+                flush(bucket);
+        }
+    }, error);
+    for(size_t b = 0; b < numBuckets; ++b)
+        flush(b);
+    vector<vector<PointCloud::Point>>().swap(buffers);
+    if(!read)
+        return false;
+    if(!scattered) {
+        error = "Could not write the scratch file: " + scratch.errorString().toStdString();
+        return false;
+    }
+    statistics.addStage("Scatter", elapsedMs(timer), size_t(numPoints * sizeof(PointCloud::Point)), size_t(numPoints));
+
+    QSaveFile file(QString::fromStdString(outputFile));
+    if(!file.open(QIODevice::WriteOnly)) {
+        error = file.errorString().toStdString();
+        return false;
+    }
+    FileHeader header = fileHeader(0, size_t(numPoints), bounds);
+    bool written = writeAll(file, &header, sizeof(header));
+
+    // The levels above the buckets get a share of every bucket's points, enough for a full node
+    // per cell up there, as far as memory allows
+    size_t numTopCells = 0;
+    for(int depth = 0; depth < bucketDepth; ++depth) {
+        const int shift = 3 * (bucketDepth - depth);
+        for(size_t cell = 0; cell < (size_t(1) << (3 * depth)); ++cell) {
+            if(bucketPrefix[(cell + 1) << shift] > bucketPrefix[cell << shift])
+                ++numTopCells;
+        }
+    }
+    const double topFraction = std::min(1.0, double(std::min(maxPoints, numTopCells * PointCloud::MaxNodePoints)) / double(numPoints));
+
+    // Fourth pass: each bucket on its own, into a subtree of the cube of its cell
+    timer.restart();
+    vector<PointCloud::Node> bucketNodes;
+    vector<int32_t> bucketRoots(numBuckets, -1);
+    vector<TopPoint> topPoints;
+    quint64 pointsWritten = 0;
+    const float bucketSize = size / float(1 << bucketDepth);
+    for(size_t b = 0; b < numBuckets && written; ++b) {
+        const size_t count = size_t(bucketCounts[b]);
+        if(count == 0)
+            continue;
+        vector<PointCloud::Point> points(count);
+        if(!scratch.seek(qint64(bucketPrefix[b] * sizeof(PointCloud::Point))) || !readAll(scratch, points.data(), count * sizeof(PointCloud::Point))) {
+            error = "Could not read the scratch file: " + scratch.errorString().toStdString();
+            return false;
+        }
+
+        // An evenly spaced sample goes to the levels above
+        const size_t sampleSize = std::min(count, size_t(std::ceil(count * topFraction)));
+        vector<glm::vec3> positions;
+        vector<uint32_t> colors;
+        positions.reserve(count - sampleSize);
+        colors.reserve(count - sampleSize);
+        size_t taken = 0;
+        for(size_t i = 0; i < count; ++i) {
+            if(taken < sampleSize && i == (2 * taken + 1) * count / (2 * sampleSize)) {
+                TopPoint top;
+                top.bucket = uint32_t(b);
+                top.point = points[i];
+                topPoints.push_back(top);
+                ++taken;
+            }
+            else {
+                positions.push_back(points[i].position);
+                colors.push_back(points[i].color);
+            }
+        }
+        vector<PointCloud::Point>().swap(points);
+        if(positions.empty())
+            continue;
+
+        PointCloud subtree;
+        subtree.build(positions, colors, cellOrigin(uint32_t(b), origin, size, bucketDepth), bucketSize);
+        written = writeAll(file, subtree.points().data(), subtree.numPoints() * sizeof(PointCloud::Point));
+
+        const int32_t offset = int32_t(bucketNodes.size());
+        bucketRoots[b] = offset;
+        for(PointCloud::Node node : subtree.nodes()) {
+            node.firstPoint += pointsWritten;
+            node.depth += uint32_t(bucketDepth);
+            for(int32_t& child : node.children) {
+                if(child >= 0)
+                    child += offset;
+            }
+            bucketNodes.push_back(node);
+        }
+        pointsWritten += subtree.numPoints();
+    }
+    statistics.addStage("Bucket octrees", elapsedMs(timer), size_t(pointsWritten * sizeof(PointCloud::Point)), bucketNodes.size());
+
+    // The levels above the buckets come first in the node table, so the root is node 0
+    timer.restart();
+    vector<PointCloud::Node> nodes;
+    TopBuilder topBuilder(topPoints, origin, size, bucketDepth, bucketPrefix, bucketRoots, bucketNodes);
+    topBuilder.build(0, 0, 0, topPoints.size(), nodes);
+    const int32_t numTopNodes = int32_t(nodes.size());
+    for(PointCloud::Node& node : nodes) {
+        node.firstPoint += pointsWritten;
+        if(node.depth == uint32_t(bucketDepth - 1)) {
+            for(int32_t& child : node.children) {
+                if(child >= 0)
+                    child += numTopNodes;
+            }
+        }
+    }
+    for(PointCloud::Node node : bucketNodes) {
+        for(int32_t& child : node.children) {
+            if(child >= 0)
+                child += numTopNodes;
+        }
+        nodes.push_back(node);
+    }
+
+    vector<PointCloud::Point> points;
+    points.reserve(topPoints.size());
+    for(const TopPoint& top : topPoints)
+        points.push_back(top.point);
+    written = written && writeAll(file, points.data(), points.size() * sizeof(PointCloud::Point)) && writeNodes(file, nodes);
+    statistics.addStage("Top levels", elapsedMs(timer), points.size() * sizeof(PointCloud::Point), size_t(numTopNodes));
+
+    // The header goes in last, once the number of nodes is known
+    header.numNodes = nodes.size();
+    written = written && file.seek(0) && writeAll(file, &header, sizeof(header));
+    if(!written || !file.commit()) {
+        error = "Could not write " + outputFile;
+        return false;
+    }
+    return true;
+}
+
+bool PointCloudFile::open(const string& fileName, string& error) {
+    _fileName = fileName;
+    _nodes.clear();
+
+    QFile file(QString::fromStdString(fileName));
+    if(!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString().toStdString();
+        return false;
+    }
+
+    FileHeader header;
+    if(!readAll(file, &header, sizeof(header)) || memcmp(header.magic, Magic, sizeof(Magic)) != 0) {
+        error = "Not a point cloud file";
+        return false;
+    }
+    if(header.version != Version || header.byteOrder != ByteOrderMark) {
+        error = "Point cloud file was written by another version or on another machine; build it again";
+        return false;
+    }
+
+    const quint64 fileSize = quint64(file.size());
+    if(header.numNodes == 0 || header.nodesOffset > fileSize || (fileSize - header.nodesOffset) / sizeof(NodeRecord) < header.numNodes
+       || header.pointsOffset + header.numPoints * sizeof(PointCloud::Point) > header.nodesOffset) {
+        error = "Point cloud file is truncated";
+        return false;
+    }
+
+    vector<NodeRecord> records(size_t(header.numNodes));
+    if(!file.seek(qint64(header.nodesOffset)) || !readAll(file, records.data(), records.size() * sizeof(NodeRecord))) {
+        error = "Could not read the nodes of the point cloud";
+        return false;
+    }
+    _nodes.reserve(records.size());
+    for(const NodeRecord& record : records) {
+        PointCloud::Node node = fromRecord(record);
+        bool valid = node.firstPoint + node.numPoints <= header.numPoints;
+        for(int32_t child : node.children)
+            valid = valid && child < int32_t(records.size());
+        if(!valid) {
+            error = "Point cloud file is corrupt";
+            _nodes.clear();
+            return false;
+        }
+        _nodes.push_back(node);
+    }
+
+    _numPoints = header.numPoints;
+    _pointsOffset = header.pointsOffset;
+    _bounds.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    _bounds.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    return true;
+}
+
+const string& PointCloudFile::fileName() const {
+    return _fileName;
+}
+
+const vector<PointCloud::Node>& PointCloudFile::nodes() const {
+    return _nodes;
+}
+
+const MeshBounds::Box& PointCloudFile::bounds() const {
+    return _bounds;
+}
+
+uint64_t PointCloudFile::numPoints() const {
+    return _numPoints;
+}
+
+bool PointCloudFile::readNode(QFile& file, uint32_t node, vector<PointCloud::Point>& points) const {
+    const PointCloud::Node& cloudNode = _nodes[node];
+    points.resize(cloudNode.numPoints);
+    return file.seek(qint64(_pointsOffset + cloudNode.firstPoint * sizeof(PointCloud::Point)))
+        && readAll(file, points.data(), points.size() * sizeof(PointCloud::Point));
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "QFile"
+
+#include "PointCloud.h"
+#include "ImportStatistics.h"
+
+#include <cstdint>
+#include <vector>
+#include <string>
+
+using std::vector;
+using std::string;
+
+// A PointCloud preprocessed into a file, for scans too large to hold in memory: a header, the
+// points of every node in a chunk of their own, and the node table. Opening one reads only the
+// node table; PointCloudStream then reads the chunks of the nodes a view needs.
+//
+// build() makes the file from a point file of any size in a bounded amount of memory. The cube
+// around the points is split into buckets, cells of a fixed depth chosen so the densest one fits
+// in memory; the points are scattered into a scratch file bucket by bucket, and each bucket is
+// built into a subtree on its own. Every bucket gives an even sample of its points to the levels
+// above the buckets, which are built last from those samples. Files are written in native byte order.
+class PointCloudFile {
+
+public:
+    // Suffix of preprocessed point clouds
+    static const char* const Suffix;
+    // Memory the build uses by default for the points it holds at once
+    static const size_t DefaultBuildMemory = size_t(2) << 30;
+
+    PointCloudFile();
+
+    static bool isPointCloudFile(const string& fileName);
+    // Builds the octree of the points of inputFile (any format NativeImporter::readPoints reads)
+    // into outputFile, holding the points of at most about memoryBytes at once. The stages are
+    // recorded in statistics. Returns false and sets error on failure.
+    static bool build(const string& inputFile, const string& outputFile, size_t memoryBytes, ImportStatistics& statistics, string& error);
+    // Writes a cloud built in memory
+    static bool write(const string& fileName, const PointCloud& cloud, string& error);
+
+    // Reads the header and node table of fileName
+    bool open(const string& fileName, string& error);
+    const string& fileName() const;
+    const vector<PointCloud::Node>& nodes() const;
+    const MeshBounds::Box& bounds() const;
+    uint64_t numPoints() const;
+
+    // Reads the points of node through file, a handle to fileName opened by the caller. Threads
+    // may read at once, each with its own handle.
+    bool readNode(QFile& file, uint32_t node, vector<PointCloud::Point>& points) const;
+
+private:
+    string _fileName;
+    vector<PointCloud::Node> _nodes;
+    MeshBounds::Box _bounds;
+    uint64_t _numPoints;
+    uint64_t _pointsOffset;
+};
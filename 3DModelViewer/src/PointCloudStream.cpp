@@ -0,0 +1,138 @@
+#include "PointCloudStream.h"
+
+#include "QDebug"
+
+#include <algorithm>
+
+PointCloudStream::PointCloudStream() :
+  _maxBytes(DefaultMemoryBytes),
+  _bytes(0),
+  _request(0),
+  _stopping(false)
+{}
+
+PointCloudStream::~PointCloudStream() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for(std::thread& loader : _loaders)
+        loader.join();
+}
+
+bool PointCloudStream::open(const string& fileName, size_t memoryBytes, string& error) {
+    if(!_file.open(fileName, error))
+        return false;
+
+    _maxBytes = memoryBytes;
+    for(int i = 0; i < NumLoaders; ++i)
+        _loaders.push_back(std::thread(&PointCloudStream::load, this));
+    return true;
+}
+
+const vector<PointCloud::Node>& PointCloudStream::nodes() const {
+    return _file.nodes();
+}
+
+const MeshBounds::Box& PointCloudStream::bounds() const {
+    return _file.bounds();
+}
+
+uint64_t PointCloudStream::numPoints() const {
+    return _file.numPoints();
+}
+
+void PointCloudStream::request(const vector<uint32_t>& nodes) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_request;
+        _queue.clear();
+        for(uint32_t node : nodes) {
+            auto it = _cache.find(node);
+            if(it != _cache.end())
+                it->second.lastRequest = _request;
+            else if(_loading.count(node) == 0)
+                _queue.push_back(node);
+        }
+    }
+    _wake.notify_all();
+}
+
+PointCloudStream::NodePoints PointCloudStream::points(uint32_t node) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _cache.find(node);
+    return it != _cache.end() ? it->second.points : NodePoints();
+}
+
+MemoryTracker::Usage PointCloudStream::getMemoryUsage() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _memory.usage();
+}
+
+void PointCloudStream::load() {
+    // Each loader reads through a handle of its own
+    QFile file(QString::fromStdString(_file.fileName()));
+    if(!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open" << _file.fileName().c_str() << "for streaming:" << file.errorString();
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    for(;;) {
+        _wake.wait(lock, [this] { return _stopping || !_queue.empty(); });
+        if(_stopping)
+            return;
+        uint32_t node = _queue.front();
+        _queue.pop_front();
+        _loading.insert(node);
+
+        lock.unlock();
+        std::shared_ptr<vector<PointCloud::Point>> points = std::make_shared<vector<PointCloud::Point>>();
+        bool read = _file.readNode(file, node, *points);
+        lock.lock();
+
+        _loading.erase(node);
+        if(!read) {
+            qWarning() << "Could not read node" << node << "of" << _file.fileName().c_str();
+            continue;
+        }
+        size_t bytes = points->size() * sizeof(PointCloud::Point);
+        if(!makeRoom(bytes)) {
+            // The cache is full of the latest request; what is left of it waits for the next one
+            _queue.clear();
+            continue;
+        }
+        Entry entry;
+        entry.points = points;
+        entry.lastRequest = _request;
+        _cache[node] = entry;
+        _bytes += bytes;
+        _memory.set(MemoryTracker::VertexArrays, _bytes);
+    }
+}
+
+bool PointCloudStream::makeRoom(size_t bytes) {
+    if(_bytes + bytes <= _maxBytes)
+        return true;
+
+    vector<std::pair<uint64_t, uint32_t>> candidates;
+    size_t droppable = 0;
+    for(const auto& entry : _cache) {
+        if(entry.second.lastRequest != _request) {
+            candidates.push_back(std::make_pair(entry.second.lastRequest, entry.first));
+            droppable += entry.second.points->size() * sizeof(PointCloud::Point);
+        }
+    }
+    if(_bytes - droppable + bytes > _maxBytes)
+        return false;
+
+    std::sort(candidates.begin(), candidates.end());
+    for(size_t i = 0; i < candidates.size() && _bytes + bytes > _maxBytes; ++i) {
+        auto it = _cache.find(candidates[i].second);
+        _bytes -= it->second.points->size() * sizeof(PointCloud::Point);
+        _cache.erase(it);
+    }
+    _memory.set(MemoryTracker::VertexArrays, _bytes);
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "MemoryTracker.h"
+#include "PointCloudFile.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <string>
+
+using std::vector;
+using std::string;
+
+// The nodes of a PointCloudFile, read in on demand. The renderer requests the nodes its view
+// needs every frame, most important first; loader threads read them from disk into a cache of
+// fixed size, dropping the nodes requested longest ago to make room. Nodes of the latest request
+// are never dropped; once the cache is full of them the rest of the request waits for the next.
+// Every method is called from the GUI thread.
+class PointCloudStream {
+
+public:
+    // Memory of the cached points by default
+    static const size_t DefaultMemoryBytes = size_t(1) << 30;
+    static const int NumLoaders = 2;
+
+    // Points are shared, so a node dropped from the cache stays valid for whoever is still using it
+    typedef std::shared_ptr<const vector<PointCloud::Point>> NodePoints;
+
+    PointCloudStream();
+    // Stops the loaders after the node each is reading
+    ~PointCloudStream();
+
+    // Reads the node table of fileName and starts the loaders
+    bool open(const string& fileName, size_t memoryBytes, string& error);
+    const vector<PointCloud::Node>& nodes() const;
+    const MeshBounds::Box& bounds() const;
+    uint64_t numPoints() const;
+
+    // Replaces the previous request with nodes, in order of priority. Those already cached are
+    // kept; the others are queued for the loaders.
+    void request(const vector<uint32_t>& nodes);
+    // The points of node, or null while it isn't cached
+    NodePoints points(uint32_t node);
+
+    MemoryTracker::Usage getMemoryUsage();
+
+private:
+    struct Entry {
+        NodePoints points;
+        uint64_t lastRequest; // Latest request that asked for the node
+    };
+
+    PointCloudFile _file;
+    size_t _maxBytes;
+    vector<std::thread> _loaders;
+
+    // Guards everything below, shared with the loaders
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::deque<uint32_t> _queue;
+    std::unordered_set<uint32_t> _loading;
+    std::unordered_map<uint32_t, Entry> _cache;
+    size_t _bytes;
+    uint64_t _request;
+    bool _stopping;
+    MemoryTracker::Account _memory;
+
+    void load();
+    // Drops the least recently requested nodes, other than those of the latest request, until
+    // bytes more fit. Returns false if they can't. Called with the mutex held.
+    bool makeRoom(size_t bytes);
+};
@@ -0,0 +1,187 @@
+#include "PointRenderer.h"
+
+#include "gtc/type_ptr.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+PointRenderer::PointRenderer() :
+  _gl(nullptr),
+  _state(nullptr),
+  _program(0),
+  _mvpLocation(-1),
+  _modelLocation(-1),
+  _pointScaleLocation(-1),
+  _cloud(nullptr),
+  _stream(nullptr),
+  _pointBudget(DefaultPointBudget),
+  _gpuBytes(0),
+  _frame(0),
+  _pointsLastFrame(0)
+{}
+
+void PointRenderer::initialize(QOpenGLFunctions_3_3_Core* gl, GLStateCache* state, GLuint program) {
+    _gl = gl;
+    _state = state;
+    _program = program;
+    _mvpLocation = _gl->glGetUniformLocation(_program, "mvp");
+    _modelLocation = _gl->glGetUniformLocation(_program, "model");
+    _pointScaleLocation = _gl->glGetUniformLocation(_program, "pointScale");
+}
+
+void PointRenderer::release() {
+    if(!_gl)
+        return;
+
+    for(auto& entry : _gpuNodes)
+        deleteNode(entry.second);
+    _gpuNodes.clear();
+    _gpuBytes = 0;
+}
+
+void PointRenderer::setPointCloud(const PointCloud* cloud) {
+    release();
+    _cloud = cloud;
+    _stream = nullptr;
+    _pointsLastFrame = 0;
+}
+
+void PointRenderer::setPointStream(PointCloudStream* stream) {
+    release();
+    _cloud = nullptr;
+    _stream = stream;
+    _pointsLastFrame = 0;
+}
+
+bool PointRenderer::hasPointCloud() const {
+    return (_cloud && _cloud->numPoints() > 0) || (_stream && _stream->numPoints() > 0);
+}
+
+void PointRenderer::setPointBudget(size_t points) {
+    _pointBudget = points;
+}
+
+size_t PointRenderer::pointsLastFrame() const {
+    return _pointsLastFrame;
+}
+
+size_t PointRenderer::gpuBytes() const {
+    return _gpuBytes;
+}
+
+bool PointRenderer::draw(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model, int width, int height) {
+    _pointsLastFrame = 0;
+    if(!_gl || !hasPointCloud())
+        return false;
+    ++_frame;
+
+    // Selection works in the cloud's own coordinates
+    PointCloud::View cloudView;
+    cloudView.mvp = projection * view * model;
+    cloudView.cameraPosition = glm::vec3(glm::inverse(view * model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    cloudView.pixelsPerUnit = 0.5f * height * projection[1][1];
+    cloudView.pointBudget = std::min(_pointBudget, PointsPerPixel * size_t(width) * size_t(height));
+    _selected.clear();
+    PointCloud::select(nodes(), cloudView, _selected);
+
+    if(_stream) {
+        _missing.clear();
+        for(uint32_t index : _selected) {
+            if(_gpuNodes.count(index) == 0)
+                _missing.push_back(index);
+        }
+        _stream->request(_missing);
+    }
+
+    _state->useProgram(_program);
+    _state->setEnabled(GL_PROGRAM_POINT_SIZE, true);
+    _state->uniformMatrix4(_mvpLocation, glm::value_ptr(cloudView.mvp));
+    _state->uniformMatrix4(_modelLocation, glm::value_ptr(model));
+
+    // The shader divides by the distance to the camera, which is in world units
+    const float modelScale = glm::length(glm::vec3(model[0]));
+    const vector<PointCloud::Node>& cloudNodes = nodes();
+    size_t uploaded = 0;
+    bool changed = false;
+    for(uint32_t index : _selected) {
+        const PointCloud::Node& node = cloudNodes[index];
+        auto it = _gpuNodes.find(index);
+        if(it == _gpuNodes.end()) {
+            // Nodes come coarse first, so the ones left for later frames are covered by their ancestors
+            size_t bytes = node.numPoints * sizeof(PointCloud::Point);
+            if(uploaded > 0 && uploaded + bytes > MaxUploadBytesPerFrame)
+                continue;
+            PointCloudStream::NodePoints streamed;
+            if(_stream) {
+                streamed = _stream->points(index);
+                if(!streamed)
+                    continue;
+            }
+            it = _gpuNodes.insert(std::make_pair(index, GpuNode())).first;
+            upload(node, streamed ? streamed->data() : &_cloud->points()[node.firstPoint], it->second);
+            uploaded += bytes;
+            changed = true;
+        }
+        it->second.lastFrame = _frame;
+
+        _state->uniform1f(_pointScaleLocation, node.spacing * modelScale * cloudView.pixelsPerUnit);
+        _state->bindVertexArray(it->second.vertexArray);
+        _state->drawArrays(GL_POINTS, 0, GLsizei(node.numPoints));
+        _pointsLastFrame += node.numPoints;
+    }
+
+    _state->bindVertexArray(0);
+    _state->setEnabled(GL_PROGRAM_POINT_SIZE, false);
+    return evict() || changed;
+}
+
+const vector<PointCloud::Node>& PointRenderer::nodes() const {
+    return _stream ? _stream->nodes() : _cloud->nodes();
+}
+
+void PointRenderer::upload(const PointCloud::Node& cloudNode, const PointCloud::Point* points, GpuNode& node) {
+    node.bytes = cloudNode.numPoints * sizeof(PointCloud::Point);
+
+    _gl->glGenVertexArrays(1, &node.vertexArray);
+    _state->bindVertexArray(node.vertexArray);
+    _gl->glGenBuffers(1, &node.buffer);
+    _state->bindBuffer(GL_ARRAY_BUFFER, node.buffer);
+    _state->bufferData(GL_ARRAY_BUFFER, node.bytes, points, GL_STATIC_DRAW);
+
+    // Position and colour interleaved, the colour as normalized bytes
+    const GLsizei stride = sizeof(PointCloud::Point);
+    _state->vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(PointCloud::Point, position));
+    _state->vertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(PointCloud::Point, color));
+
+    _state->bindBuffer(GL_ARRAY_BUFFER, 0);
+    _gpuBytes += node.bytes;
+}
+
+void PointRenderer::deleteNode(GpuNode& node) {
+    _state->deleteBuffers(1, &node.buffer);
+    _state->deleteVertexArrays(1, &node.vertexArray);
+    _gpuBytes -= node.bytes;
+    node.buffer = node.vertexArray = 0;
+    node.bytes = 0;
+}
+
+bool PointRenderer::evict() {
+    if(_gpuBytes <= MaxGpuBytes)
+        return false;
+
+    vector<std::pair<uint64_t, uint32_t>> candidates;
+    for(const auto& entry : _gpuNodes) {
+        if(entry.second.lastFrame != _frame)
+            candidates.push_back(std::make_pair(entry.second.lastFrame, entry.first));
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    bool evicted = false;
+    for(size_t i = 0; i < candidates.size() && _gpuBytes > MaxGpuBytes; ++i) {
+        auto it = _gpuNodes.find(candidates[i].second);
+        deleteNode(it->second);
+        _gpuNodes.erase(it);
+        evicted = true;
+    }
+    return evicted;
+}
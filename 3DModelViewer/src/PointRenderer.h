@@ -0,0 +1,88 @@
+#pragma once
+
+#include "QOpenGLFunctions_3_3_Core"
+
+#include "GLStateCache.h"
+#include "PointCloud.h"
+#include "PointCloudStream.h"
+
+#include "glm.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+using std::vector;
+
+// Draws a PointCloud as GL_POINTS. Every frame the nodes worth drawing are chosen with
+// PointCloud::select under a point budget that follows the size of the viewport, so a scan of
+// hundreds of millions of points costs about as much as one that fills the screen once. Each
+// node's points get their own buffer when it is first selected; a few nodes are uploaded per
+// frame, coarse ones first, and the buffers of nodes that haven't been drawn for the longest
+// are deleted when the cache outgrows its limit. Points are sized from the spacing of their
+// node, so the coarse levels cover the surface until the finer ones arrive. A PointCloudStream is
+// drawn the same way, asking the stream every frame for the selected nodes it has no buffer for
+// and uploading each once the stream's loaders have read it.
+// Owned by the renderer; every method but setPointBudget expects its context to be current.
+class PointRenderer {
+
+public:
+    // Most points drawn per frame, and per pixel of the viewport
+    static const size_t DefaultPointBudget = 5000000;
+    static const size_t PointsPerPixel = 3;
+    // Limits of the node buffers: bytes uploaded per frame, and bytes kept on the gpu
+    static const size_t MaxUploadBytesPerFrame = 32 << 20;
+    static const size_t MaxGpuBytes = size_t(512) << 20;
+
+    PointRenderer();
+
+    // Takes the program built from the point shaders, and the renderer's state cache, which every
+    // GL call that changes state goes through; release() deletes the node buffers
+    void initialize(QOpenGLFunctions_3_3_Core* gl, GLStateCache* state, GLuint program);
+    void release();
+
+    // The cloud to draw, or null; the cloud must outlive its use here. Deletes the buffers of the previous one.
+    void setPointCloud(const PointCloud* cloud);
+    // The streamed cloud to draw instead, or null; replaces the cloud the same way
+    void setPointStream(PointCloudStream* stream);
+    bool hasPointCloud() const;
+    void setPointBudget(size_t points);
+
+    // Selects, uploads and draws the nodes for the view. Returns true if buffers were created
+    // or deleted, so the caller can update its memory usage.
+    bool draw(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model, int width, int height);
+
+    size_t pointsLastFrame() const;
+    size_t gpuBytes() const;
+
+private:
+    struct GpuNode {
+        GLuint vertexArray;
+        GLuint buffer;
+        size_t bytes;
+        uint64_t lastFrame; // Last frame the node was drawn in
+    };
+
+    QOpenGLFunctions_3_3_Core* _gl;
+    GLStateCache* _state;
+    GLuint _program;
+    GLint _mvpLocation;
+    GLint _modelLocation; // Places the points relative to the clip planes
+    GLint _pointScaleLocation;
+
+    const PointCloud* _cloud;
+    PointCloudStream* _stream;
+    size_t _pointBudget;
+    std::unordered_map<uint32_t, GpuNode> _gpuNodes;
+    vector<uint32_t> _selected;
+    vector<uint32_t> _missing; // Selected nodes without a buffer, requested from the stream
+    size_t _gpuBytes;
+    uint64_t _frame;
+    size_t _pointsLastFrame;
+
+    const vector<PointCloud::Node>& nodes() const;
+    void upload(const PointCloud::Node& cloudNode, const PointCloud::Point* points, GpuNode& node);
+    void deleteNode(GpuNode& node);
+    // Deletes the least recently drawn buffers, other than those of this frame, until the cache fits
+    bool evict();
+};
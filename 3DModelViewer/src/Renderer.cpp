@@ -0,0 +1,1043 @@
+#include "Renderer.h"
+#include "Frustum.h"
+
+#include "gtc/type_ptr.hpp"
+
+#include "QDebug"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+// Everything drawing a mesh needs once it is on the gpu: its buffers, levels, clusters, bounds and
+// textures, but not its vertex and index arrays, which stay with the model
+Model::Mesh drawRecord(const Model::Mesh& mesh) {
+    Model::Mesh record;
+    record.name = mesh.name;
+    record.lods = mesh.lods;
+    record.vertexBuffer = mesh.vertexBuffer;
+    record.uvBuffer = mesh.uvBuffer;
+    record.normalBuffer = mesh.normalBuffer;
+    record.tangentBuffer = mesh.tangentBuffer;
+    record.indexBuffer = mesh.indexBuffer;
+    record.vertexArray = 0;
+    record.positionDecode = mesh.positionDecode;
+    record.compressionError = mesh.compressionError;
+    record.compactBuffer = mesh.compactBuffer;
+    record.clusters = mesh.clusters;
+    record.matIndex = mesh.matIndex;
+    record.numFaces = mesh.numFaces;
+    record.numVertices = mesh.numVertices;
+    record.acmrBefore = mesh.acmrBefore;
+    record.acmrAfter = mesh.acmrAfter;
+    record.bounds = mesh.bounds;
+    record.boundingSphere = mesh.boundingSphere;
+    record.diffuseTexture = mesh.diffuseTexture;
+    record.specularTexture = mesh.specularTexture;
+    record.normalTexture = mesh.normalTexture;
+    record.uploaded = mesh.uploaded;
+    return record;
+}
+
+}
+
+Renderer::Renderer() :
+  _programId(0),
+  _idProgramId(0),
+  _pointProgramId(0),
+  _viewMode(ModelView),
+  _uniformTexSamplerHandle(0),
+  _idMvpLocation(-1),
+  _idMeshLocation(-1),
+  _idModelLocation(-1),
+  _lightColor(glm::vec3(1.0, 1.0, 1.0)),
+  _lightPos(glm::vec3(0.0, 5.0, 0.0)),
+  _projection(glm::mat4(1.0)),
+  _view(glm::mat4(1.0)),
+  _model(glm::mat4(1.0)),
+  _mvp(glm::mat4(1.0)),
+  _width(1),
+  _height(1),
+  _lodPixelError(1.0),
+  _initialized(false),
+  _lightingEnabled(true),
+  _texturingEnabled(true),
+  _backfaceCullingEnabled(false),
+  _clipCapsEnabled(false),
+  _frameUniformBuffer(0),
+  _frameUniformsValid(false),
+  _drawUniformBuffer(0),
+  _drawUniformStride(0),
+  _drawUniformCapacity(0),
+  _previewVertexArray(0),
+  _previewVertexBuffer(0),
+  _previewIndexBuffer(0),
+  _previewPoints(0),
+  _capVertexArray(0),
+  _capVertexBuffer(0),
+  _gpuBufferBytes(0)
+{}
+
+Renderer::~Renderer() {
+    if(!_initialized)
+        return;
+
+    releaseMeshes();
+    releasePreview();
+    _profiler.release();
+    _gpuPicker.release();
+    _pointRenderer.release();
+    glDeleteBuffers(1, &_frameUniformBuffer);
+    glDeleteBuffers(1, &_drawUniformBuffer);
+    glDeleteBuffers(1, &_capVertexBuffer);
+    glDeleteVertexArrays(1, &_capVertexArray);
+    glDeleteProgram(_programId);
+    glDeleteProgram(_idProgramId);
+    glDeleteProgram(_pointProgramId);
+}
+
+void Renderer::initialize() {
+    if(!initializeOpenGLFunctions())
+        throw std::runtime_error("Error: Cannot initialize OpenGL functions");
+
+    _state.setFunctions(this);
+
+    _profiler.initialize(this);
+    _gpuPicker.initialize(this);
+
+    _state.setEnabled(GL_DEPTH_TEST, true);
+    glClearColor(1.0, 1.0, 1.0, 1.0);
+
+    // Load and compile our shaders
+    _programId = glCreateProgram();
+    loadShader("shaders/vertex.shader", GL_VERTEX_SHADER, _programId);
+    loadShader("shaders/fragment.shader", GL_FRAGMENT_SHADER, _programId);
+    _state.useProgram(_programId);
+
+    // All meshes sample their diffuse texture from unit 0, and their normal map, if any, from unit 1
+    _uniformTexSamplerHandle = glGetUniformLocation(_programId, "texSampler");
+    _state.uniform1i(_uniformTexSamplerHandle, 0);
+    _uniformNormalSamplerHandle = glGetUniformLocation(_programId, "normalSampler");
+    _state.uniform1i(_uniformNormalSamplerHandle, 1);
+    _state.activeTexture(GL_TEXTURE0);
+
+    // Connect the uniform blocks to their binding points
+    glUniformBlockBinding(_programId, glGetUniformBlockIndex(_programId, "FrameData"), FrameUniformBinding);
+    glUniformBlockBinding(_programId, glGetUniformBlockIndex(_programId, "DrawData"), DrawUniformBinding);
+
+    // Per-frame data lives in a single block that is rewritten only when it changes
+    glGenBuffers(1, &_frameUniformBuffer);
+    _state.bindBuffer(GL_UNIFORM_BUFFER, _frameUniformBuffer);
+    _state.bufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FrameUniformBinding, _frameUniformBuffer);
+
+    // The id pass only needs positions, and sets its uniforms directly. It reads the clip planes
+    // from the frame block, like the point program.
+    _idProgramId = glCreateProgram();
+    loadShader("shaders/id_vertex.shader", GL_VERTEX_SHADER, _idProgramId);
+    loadShader("shaders/id_fragment.shader", GL_FRAGMENT_SHADER, _idProgramId);
+    _idMvpLocation = glGetUniformLocation(_idProgramId, "mvp");
+    _idMeshLocation = glGetUniformLocation(_idProgramId, "meshId");
+    _idModelLocation = glGetUniformLocation(_idProgramId, "model");
+    glUniformBlockBinding(_idProgramId, glGetUniformBlockIndex(_idProgramId, "FrameData"), FrameUniformBinding);
+
+    // Point clouds have their own program, with interleaved positions and colours and sized points
+    _pointProgramId = glCreateProgram();
+    loadShader("shaders/point_vertex.shader", GL_VERTEX_SHADER, _pointProgramId);
+    loadShader("shaders/point_fragment.shader", GL_FRAGMENT_SHADER, _pointProgramId);
+    glUniformBlockBinding(_pointProgramId, glGetUniformBlockIndex(_pointProgramId, "FrameData"), FrameUniformBinding);
+    _pointRenderer.initialize(this, &_state, _pointProgramId);
+
+    // The square every cap is drawn from, placed on its plane by the cap's model matrix
+    const glm::vec3 capCorners[] = {
+        glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f),
+        glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(-1.0f, 1.0f, 0.0f)
+    };
+    glGenVertexArrays(1, &_capVertexArray);
+    _state.bindVertexArray(_capVertexArray);
+    glGenBuffers(1, &_capVertexBuffer);
+    _state.bindBuffer(GL_ARRAY_BUFFER, _capVertexBuffer);
+    _state.bufferData(GL_ARRAY_BUFFER, sizeof(capCorners), capCorners, GL_STATIC_DRAW);
+    _state.vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    _state.bindVertexArray(0);
+    _state.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Per-draw data is packed into one buffer, refilled every frame.
+    // Each draw's block must start at a multiple of the uniform buffer offset alignment.
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    _drawUniformStride = (sizeof(DrawUniforms) + alignment - 1) / alignment * alignment;
+    glGenBuffers(1, &_drawUniformBuffer);
+    _drawUniformCapacity = 0;
+
+    _state.bindBuffer(GL_UNIFORM_BUFFER, 0);
+    _state.useProgram(0);
+
+    _initialized = true;
+    _state.viewport(0, 0, _width, _height);
+    updateMemoryUsage();
+}
+
+bool Renderer::initialized() const {
+    return _initialized;
+}
+
+void Renderer::releaseMeshes() {
+    for(Model::Mesh& mesh : _meshes) {
+        // Buffers filled by the model from its cache belong to the model
+        if(!mesh.uploaded) {
+            GLuint buffers[] = { mesh.vertexBuffer, mesh.uvBuffer, mesh.normalBuffer, mesh.tangentBuffer, mesh.indexBuffer, mesh.compactBuffer };
+            _state.deleteBuffers(6, buffers);
+        }
+        _state.deleteVertexArrays(1, &mesh.vertexArray);
+    }
+    // The model going with the meshes may delete its textures and buffers, and the next one creates
+    // its own, on this context or another, so nothing bound before can be trusted
+    _state.invalidate();
+    _meshes.clear();
+    _meshIndices.clear();
+    _sceneBounds = MeshBounds::Box();
+    _pointRenderer.setPointCloud(nullptr);
+    _gpuBufferBytes = 0;
+    if(_previewVertexArray)
+        _gpuBufferBytes = (8 + _previewPoints) * sizeof(glm::vec3) + 24 * sizeof(unsigned int);
+    updateMemoryUsage();
+}
+
+void Renderer::setViewport(int width, int height) {
+    _width = std::max(width, 1);
+    _height = std::max(height, 1);
+
+    if(_initialized)
+        _state.viewport(0, 0, _width, _height);
+}
+
+void Renderer::setMatrices(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model) {
+    _projection = projection;
+    _view = view;
+    _model = model;
+    _mvp = _projection * _view * _model;
+}
+
+void Renderer::setLight(const glm::vec3& position, const glm::vec3& color) {
+    // Picked up by the frame uniform block on the next frame
+    _lightPos = position;
+    _lightColor = color;
+}
+
+void Renderer::setViewMode(ViewMode mode) {
+    _viewMode = mode;
+}
+
+Renderer::ViewMode Renderer::getViewMode() const {
+    return _viewMode;
+}
+
+void Renderer::setLightingEnabled(bool enabled) {
+    _lightingEnabled = enabled;
+}
+
+void Renderer::setTexturingEnabled(bool enabled) {
+    _texturingEnabled = enabled;
+}
+
+void Renderer::setBackfaceCullingEnabled(bool enabled) {
+    _backfaceCullingEnabled = enabled;
+}
+
+void Renderer::setLodPixelError(double pixels) {
+    _lodPixelError = pixels;
+}
+
+void Renderer::setClipPlanes(const vector<glm::vec4>& planes) {
+    // Normalized so the culling tests compare distances with bounding sphere radii
+    _clipPlanes.clear();
+    for(const glm::vec4& plane : planes) {
+        const float length = glm::length(glm::vec3(plane));
+        if(length > 0.0f && _clipPlanes.size() < size_t(MaxClipPlanes))
+            _clipPlanes.push_back(plane / length);
+    }
+}
+
+const vector<glm::vec4>& Renderer::getClipPlanes() const {
+    return _clipPlanes;
+}
+
+void Renderer::setClipCapsEnabled(bool enabled) {
+    _clipCapsEnabled = enabled;
+}
+
+bool Renderer::isClipCapsEnabled() const {
+    return _clipCapsEnabled;
+}
+
+unsigned int Renderer::getGLCallsPerFrame() const {
+    return _state.callsLastFrame();
+}
+
+unsigned int Renderer::getGLCallsSkippedPerFrame() const {
+    return _state.callsSkippedLastFrame();
+}
+
+size_t Renderer::getGpuBufferBytes() const {
+    return _gpuBufferBytes;
+}
+
+const MemoryTracker::Usage& Renderer::getMemoryUsage() const {
+    return _memory.usage();
+}
+
+void Renderer::invalidateState() {
+    _state.invalidate();
+}
+
+FrameProfiler& Renderer::profiler() {
+    return _profiler;
+}
+
+void Renderer::render() {
+    // State changed by others between frames is reported through invalidateState
+    _state.beginFrame();
+    _gpuPicker.poll();
+
+    enableClipPlanes(true);
+    renderScene();
+    if(_gpuPicker.isPassDue())
+        renderIdPass();
+    // Whatever paints on top of the frame doesn't write clip distances
+    enableClipPlanes(false);
+}
+
+void Renderer::requestIdPick(int x, int y) {
+    _gpuPicker.request(x, y);
+}
+
+bool Renderer::takeIdPick(GpuPicker::Result& result) {
+    if(!_gpuPicker.takeResult(result))
+        return false;
+
+    // The meshes may have been replaced while the result was on its way
+    if(result.found && result.mesh >= _meshIndices.size())
+        result.found = false;
+    if(result.found)
+        result.mesh = uint32_t(_meshIndices[result.mesh]);
+    return true;
+}
+
+void Renderer::pickRay(int x, int y, glm::vec3& origin, glm::vec3& direction) const {
+    glm::vec2 ndc(
+        (x + 0.5f) / float(_width) * 2.0f - 1.0f,
+        1.0f - (y + 0.5f) / float(_height) * 2.0f
+    );
+    glm::mat4 inverseViewProjection = glm::inverse(_projection * _view);
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+    origin = glm::vec3(nearPoint) / nearPoint.w;
+    direction = glm::vec3(farPoint) / farPoint.w - origin;
+}
+
+void Renderer::renderScene() {
+    FrameProfiler::GpuScope gpuScope(_profiler, "Scene");
+
+    _state.viewport(0, 0, _width, _height);
+    _state.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Overlays painted on top of the frame may have changed these
+    _state.setEnabled(GL_DEPTH_TEST, true);
+    _state.activeTexture(GL_TEXTURE0);
+
+    // Points are drawn from the vertices, and wireframes from the unique edges of each level, so
+    // each is drawn once rather than once for every triangle using it
+    const bool drawPoints = _viewMode == ViewMode::PointCloud;
+    const bool wireFrame = _viewMode == ViewMode::WireFrame;
+
+    _state.setEnabled(GL_CULL_FACE, _backfaceCullingEnabled);
+    _state.useProgram(_programId);
+
+    {
+        FrameProfiler::CpuScope scope(_profiler, "Culling");
+        buildDrawList();
+    }
+    {
+        FrameProfiler::CpuScope scope(_profiler, "Draw list build");
+        updateFrameUniforms();
+        uploadDrawUniforms();
+    }
+
+    FrameProfiler::CpuScope scope(_profiler, "Submission");
+    unsigned int numTriangles = 0;
+    unsigned int numLines = 0;
+    unsigned int numPoints = 0;
+
+    for(size_t i = 0; i < _drawList.size(); ++i) {
+        const DrawCommand& draw = _drawList[i];
+        if(draw.capPlane >= 0)
+            continue;
+
+        bindDrawUniforms(i);
+        if(!draw.mesh) {
+            drawPreview();
+            continue;
+        }
+
+        const Model::Mesh& mesh = *draw.mesh;
+        if(mesh.tangentBuffer && mesh.normalTexture.texId) {
+            _state.activeTexture(GL_TEXTURE1);
+            _state.bindTexture(GL_TEXTURE_2D, mesh.normalTexture.texId);
+            _state.activeTexture(GL_TEXTURE0);
+        }
+        _state.bindTexture(GL_TEXTURE_2D, mesh.diffuseTexture.texId);
+        _state.bindVertexArray(mesh.vertexArray);
+
+        // Meshes imported without their edges fall back to outlining every triangle
+        const Model::Lod& lod = mesh.lods[draw.lodIndex];
+        _state.polygonMode(wireFrame && !draw.edges ? GL_LINE : GL_FILL);
+
+        if(drawPoints) {
+            _state.drawArrays(GL_POINTS, 0, mesh.numVertices);
+            numPoints += mesh.numVertices;
+        }
+        else if(draw.numRanges > 0) {
+            _state.multiDrawElements(draw.edges ? GL_LINES : GL_TRIANGLES, &_drawCounts[draw.firstRange], GL_UNSIGNED_INT,
+                                     &_drawOffsets[draw.firstRange], GLsizei(draw.numRanges));
+            for(size_t r = draw.firstRange; r < draw.firstRange + draw.numRanges; ++r) {
+                if(draw.edges)
+                    numLines += _drawCounts[r] / 2;
+                else
+                    numTriangles += _drawCounts[r] / 3;
+            }
+        }
+        else if(draw.edges) {
+            _state.drawElements(GL_LINES, lod.edgeCount, GL_UNSIGNED_INT, (void*)(lod.edgeOffset * sizeof(unsigned int)));
+            numLines += lod.edgeCount / 2;
+        }
+        else {
+            _state.drawElements(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT, (void*)(lod.indexOffset * sizeof(unsigned int)));
+            numTriangles += lod.indexCount / 3;
+        }
+    }
+
+    if(!_drawList.empty() && _drawList.back().capPlane >= 0)
+        drawCaps();
+
+    // Clean up; painting on top of the frame expects filled polygons
+    _state.bindVertexArray(0);
+    _state.polygonMode(GL_FILL);
+
+    // The point cloud selects and uploads its nodes itself
+    if(_pointRenderer.hasPointCloud()) {
+        if(_pointRenderer.draw(_projection, _view, _model, _width, _height))
+            updateMemoryUsage();
+        numPoints += unsigned(_pointRenderer.pointsLastFrame());
+    }
+
+    _profiler.count(FrameProfiler::DrawCalls, _state.drawCalls());
+    _profiler.count(FrameProfiler::Triangles, numTriangles);
+    _profiler.count(FrameProfiler::Lines, numLines);
+    _profiler.count(FrameProfiler::Points, numPoints);
+    _profiler.count(FrameProfiler::TextureBinds, _state.textureBinds());
+    _profiler.count(FrameProfiler::BufferBytes, double(_state.bufferBytes()));
+}
+
+void Renderer::renderIdPass() {
+    FrameProfiler::GpuScope gpuScope(_profiler, "Id pass");
+    FrameProfiler::CpuScope scope(_profiler, "Id pass");
+
+    // Only the region around the cursor is drawn, so most meshes are culled by its frustum
+    glm::mat4 region = _gpuPicker.beginPass(_width, _height, _projection * _view);
+    glm::mat4 mvp = region * _mvp;
+    Frustum frustum(mvp);
+
+    _state.viewport(0, 0, GpuPicker::RegionSize, GpuPicker::RegionSize);
+    _state.setEnabled(GL_BLEND, false);
+    _state.setEnabled(GL_DEPTH_TEST, true);
+    _state.setEnabled(GL_CULL_FACE, _backfaceCullingEnabled);
+    _state.polygonMode(GL_FILL);
+    _state.useProgram(_idProgramId);
+
+    for(size_t i = 0; i < _meshes.size(); ++i) {
+        const Model::Mesh& mesh = _meshes[i];
+        if(!mesh.bounds.isEmpty() && (!frustum.intersectsSphere(mesh.boundingSphere.center, mesh.boundingSphere.radius) ||
+                                      isClipped(mesh.boundingSphere.center, mesh.boundingSphere.radius)))
+            continue;
+
+        glm::mat4 meshMvp = mesh.compactBuffer ? mvp * mesh.positionDecode : mvp;
+        glm::mat4 meshModel = mesh.compactBuffer ? _model * mesh.positionDecode : _model;
+        _state.uniformMatrix4(_idMvpLocation, glm::value_ptr(meshMvp));
+        _state.uniformMatrix4(_idModelLocation, glm::value_ptr(meshModel));
+        _state.uniform1ui(_idMeshLocation, GLuint(i + 1));
+
+        // The full resolution level in one draw, so the primitive id is the triangle's index in it
+        const Model::Lod& lod = mesh.lods[0];
+        _state.bindVertexArray(mesh.vertexArray);
+        _state.drawElements(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT, (void*)(lod.indexOffset * sizeof(unsigned int)));
+    }
+
+    _state.bindVertexArray(0);
+    _state.viewport(0, 0, _width, _height);
+    _gpuPicker.endPass();
+}
+
+void Renderer::updateFrameUniforms() {
+    FrameUniforms frame;
+    frame.view = _view;
+    frame.projection = _projection;
+    frame.viewPos = glm::inverse(_view) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    frame.lightPos = glm::vec4(_lightPos, 1.0f);
+    frame.lightColor = glm::vec4(_lightColor, 1.0f);
+    frame.flags = glm::vec4(_lightingEnabled ? 1.0f : 0.0f, _texturingEnabled ? 1.0f : 0.0f, float(_clipPlanes.size()), 0.0f);
+
+    // Planes are transformed by the inverse transpose of the matrix transforming the points
+    const glm::mat4 planeToWorld = glm::transpose(glm::inverse(_model));
+    for(int i = 0; i < MaxClipPlanes; ++i)
+        frame.clipPlanes[i] = i < int(_clipPlanes.size()) ? planeToWorld * _clipPlanes[i] : glm::vec4(0.0f);
+
+    // Nothing to upload if the camera, light, toggles and planes are the same as last frame
+    if(_frameUniformsValid && memcmp(&frame, &_frameUniforms, sizeof(FrameUniforms)) == 0)
+        return;
+
+    _state.bindBuffer(GL_UNIFORM_BUFFER, _frameUniformBuffer);
+    _state.bufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+    _frameUniforms = frame;
+    _frameUniformsValid = true;
+}
+
+void Renderer::buildDrawList() {
+    _drawList.clear();
+    _drawCounts.clear();
+    _drawOffsets.clear();
+
+    // Culling happens in object space, where the mesh and cluster bounds are stored
+    Frustum frustum(_mvp);
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(_view * _model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+    for(const Model::Mesh& mesh : _meshes) {
+        if(!mesh.bounds.isEmpty() && (!frustum.intersectsSphere(mesh.boundingSphere.center, mesh.boundingSphere.radius) ||
+                                      isClipped(mesh.boundingSphere.center, mesh.boundingSphere.radius)))
+            continue;
+
+        DrawCommand draw;
+        draw.mesh = &mesh;
+        draw.capPlane = -1;
+        // Draw the coarsest level of detail that still looks like the full mesh
+        draw.lodIndex = selectLod(mesh);
+        draw.edges = _viewMode == ViewMode::WireFrame && mesh.lods[draw.lodIndex].edgeCount > 0;
+        draw.firstRange = _drawCounts.size();
+        draw.numRanges = 0;
+
+        if(draw.lodIndex == 0 && !mesh.clusters.empty()) {
+            cullClusters(mesh, frustum, cameraPosition, draw.edges);
+            draw.numRanges = _drawCounts.size() - draw.firstRange;
+            if(draw.numRanges == 0)
+                continue; // every cluster was culled
+        }
+
+        _drawList.push_back(draw);
+    }
+
+    if(_previewVertexArray) {
+        DrawCommand preview;
+        preview.mesh = nullptr;
+        preview.capPlane = -1;
+        preview.lodIndex = 0;
+        preview.edges = false;
+        preview.firstRange = _drawCounts.size();
+        preview.numRanges = 0;
+        _drawList.push_back(preview);
+    }
+
+    // One cap per plane, after everything they cover. Wireframes and points have nothing to fill.
+    const bool meshesDrawn = !_drawList.empty() && _drawList.front().mesh;
+    if(_clipCapsEnabled && _viewMode == ViewMode::ModelView && meshesDrawn && !_sceneBounds.isEmpty()) {
+        for(size_t i = 0; i < _clipPlanes.size(); ++i) {
+            DrawCommand cap;
+            cap.mesh = nullptr;
+            cap.capPlane = int(i);
+            cap.lodIndex = 0;
+            cap.edges = false;
+            cap.firstRange = _drawCounts.size();
+            cap.numRanges = 0;
+            _drawList.push_back(cap);
+        }
+    }
+}
+
+void Renderer::uploadDrawUniforms() {
+    if(_drawList.empty())
+        return;
+
+    _state.bindBuffer(GL_UNIFORM_BUFFER, _drawUniformBuffer);
+
+    // The buffer is orphaned every frame, so the driver hands out fresh storage instead of waiting
+    // for the gpu to finish the draws of earlier frames that still read the old one
+    const bool grown = _drawList.size() > _drawUniformCapacity;
+    if(grown)
+        _drawUniformCapacity = _drawList.size() * 2;
+    _state.bufferData(GL_UNIFORM_BUFFER, _drawUniformCapacity * _drawUniformStride, nullptr, GL_STREAM_DRAW);
+    if(grown)
+        updateMemoryUsage();
+
+    _drawUniformData.assign(_drawList.size() * _drawUniformStride, 0);
+    for(size_t i = 0; i < _drawList.size(); ++i) {
+        const Model::Mesh* mesh = _drawList[i].mesh;
+
+        DrawUniforms draw;
+        draw.model = _model;
+        draw.mvp = _mvp;
+        draw.flags = glm::vec4(0.0f);
+        if(_drawList[i].capPlane >= 0) {
+            const glm::mat4 cap = capMatrix(_clipPlanes[_drawList[i].capPlane]);
+            draw.model = _model * cap;
+            draw.mvp = _mvp * cap;
+            draw.flags.y = 1.0f;
+        }
+        else if(!mesh) {
+            draw.flags.y = 1.0f;
+        }
+        else if(mesh->compactBuffer) {
+            // Quantized positions are decoded by folding the mesh's decode matrix into the transforms
+            draw.model = _model * mesh->positionDecode;
+            draw.mvp = _mvp * mesh->positionDecode;
+            draw.flags.x = 1.0f;
+        }
+        // A normal map that failed to load leaves the mesh with its vertex normals
+        if(mesh && mesh->tangentBuffer && mesh->normalTexture.texId)
+            draw.flags.z = 1.0f;
+        memcpy(&_drawUniformData[i * _drawUniformStride], &draw, sizeof(DrawUniforms));
+    }
+
+    // One upload for every draw of the frame
+    _state.bufferSubData(GL_UNIFORM_BUFFER, 0, _drawUniformData.size(), _drawUniformData.data());
+}
+
+void Renderer::setMeshes(const vector<Model::Mesh>& meshes) {
+    releaseMeshes();
+    for(size_t i = 0; i < meshes.size(); ++i)
+        uploadMesh(meshes[i], i);
+    updateMemoryUsage();
+}
+
+void Renderer::addMesh(const Model::Mesh& mesh, size_t index) {
+    uploadMesh(mesh, index);
+    updateMemoryUsage();
+}
+
+void Renderer::uploadMesh(const Model::Mesh& source, size_t index) {
+    _meshes.push_back(drawRecord(source));
+    _meshIndices.push_back(index);
+    Model::Mesh& mesh = _meshes.back();
+    if(!mesh.bounds.isEmpty())
+        _sceneBounds.extend(mesh.bounds);
+
+    // Meshes read from a cache arrive with their buffers already filled by the model
+    if(!mesh.uploaded)
+        createBuffers(source, mesh);
+
+    // Each mesh records its attribute layout and index buffer in its own vertex array object,
+    // so drawing it only needs a single bind. Vertex arrays aren't shared between contexts, so
+    // this is done here even for buffers created on another one.
+    glGenVertexArrays(1, &mesh.vertexArray);
+    _state.bindVertexArray(mesh.vertexArray);
+
+    if(mesh.compactBuffer) {
+        // All three attributes are interleaved in a single buffer
+        const GLsizei stride = sizeof(VertexCompressor::CompactVertex);
+        _state.bindBuffer(GL_ARRAY_BUFFER, mesh.compactBuffer);
+        _state.vertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(VertexCompressor::CompactVertex, position));
+        _state.vertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(VertexCompressor::CompactVertex, uv));
+        _state.vertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(VertexCompressor::CompactVertex, normal));
+    }
+    else {
+        _state.bindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+        _state.vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        // Attributes without a buffer are left disabled, so the shader reads their constant value
+        if(mesh.uvBuffer) {
+            _state.bindBuffer(GL_ARRAY_BUFFER, mesh.uvBuffer);
+            _state.vertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        }
+        if(mesh.normalBuffer) {
+            _state.bindBuffer(GL_ARRAY_BUFFER, mesh.normalBuffer);
+            _state.vertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        }
+    }
+    // Packed tangents come from their own buffer whichever way the other attributes are stored
+    if(mesh.tangentBuffer) {
+        _state.bindBuffer(GL_ARRAY_BUFFER, mesh.tangentBuffer);
+        _state.vertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 0, 0);
+    }
+    _state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+
+    _state.bindVertexArray(0);
+    _state.bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Renderer::createBuffers(const Model::Mesh& mesh, Model::Mesh& record) {
+    if(!mesh.compactVertices.empty()) {
+        // Send the packed, interleaved vertex data to gpu instead of the float arrays
+        glGenBuffers(1, &record.compactBuffer);
+        _state.bindBuffer(GL_ARRAY_BUFFER, record.compactBuffer);
+        _state.bufferData(
+            GL_ARRAY_BUFFER,
+            mesh.compactVertices.size() * sizeof(VertexCompressor::CompactVertex),
+            mesh.compactVertices.data(),
+            GL_STATIC_DRAW
+        );
+        record.vertexBuffer = record.uvBuffer = record.normalBuffer = 0;
+    }
+    else {
+        // Send vertex data to gpu
+        glGenBuffers(1, &record.vertexBuffer);
+        _state.bindBuffer(GL_ARRAY_BUFFER, record.vertexBuffer);
+        _state.bufferData(
+            GL_ARRAY_BUFFER,
+            mesh.vertices.size() * sizeof(glm::vec3),
+            mesh.vertices.data(),
+            GL_STATIC_DRAW
+        );
+
+        // Send uv data to gpu, if the mesh has any
+        if(!mesh.uvs.empty()) {
+            glGenBuffers(1, &record.uvBuffer);
+            _state.bindBuffer(GL_ARRAY_BUFFER, record.uvBuffer);
+            _state.bufferData(
+                GL_ARRAY_BUFFER,
+                mesh.uvs.size() * sizeof(glm::vec2),
+                mesh.uvs.data(),
+                GL_STATIC_DRAW
+            );
+        }
+
+        // Send vertex normal data to gpu, if the mesh has any
+        if(!mesh.normals.empty()) {
+            glGenBuffers(1, &record.normalBuffer);
+            _state.bindBuffer(GL_ARRAY_BUFFER, record.normalBuffer);
+            _state.bufferData(
+                GL_ARRAY_BUFFER,
+                mesh.normals.size() * sizeof(glm::vec3),
+                mesh.normals.data(),
+                GL_STATIC_DRAW
+            );
+        }
+    }
+
+    // Send the packed tangents of normal mapped meshes to the gpu
+    if(!mesh.tangents.empty()) {
+        glGenBuffers(1, &record.tangentBuffer);
+        _state.bindBuffer(GL_ARRAY_BUFFER, record.tangentBuffer);
+        _state.bufferData(
+            GL_ARRAY_BUFFER,
+            mesh.tangents.size() * sizeof(uint32_t),
+            mesh.tangents.data(),
+            GL_STATIC_DRAW
+        );
+    }
+
+    // Send the indices of every level of detail to the gpu. The copy target leaves the element
+    // binding of whatever vertex array is bound alone.
+    glGenBuffers(1, &record.indexBuffer);
+    _state.bindBuffer(GL_COPY_WRITE_BUFFER, record.indexBuffer);
+    _state.bufferData(
+        GL_COPY_WRITE_BUFFER,
+        mesh.indices.size() * sizeof(unsigned int),
+        mesh.indices.data(),
+        GL_STATIC_DRAW
+    );
+    _state.bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if(!mesh.compactVertices.empty()) {
+        _gpuBufferBytes += mesh.compactVertices.size() * sizeof(VertexCompressor::CompactVertex);
+    }
+    else {
+        _gpuBufferBytes += mesh.vertices.size() * sizeof(glm::vec3)
+                         + mesh.uvs.size() * sizeof(glm::vec2)
+                         + mesh.normals.size() * sizeof(glm::vec3);
+    }
+    _gpuBufferBytes += mesh.tangents.size() * sizeof(uint32_t) + mesh.indices.size() * sizeof(unsigned int);
+    _state.bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Renderer::setPreview(const glm::vec3& min, const glm::vec3& max, const vector<glm::vec3>& points) {
+    releasePreview();
+
+    vector<glm::vec3> vertices;
+    vertices.reserve(8 + points.size());
+    for(int i = 0; i < 8; ++i)
+        vertices.push_back(glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z));
+    vertices.insert(vertices.end(), points.begin(), points.end());
+
+    // Corners i and j share an edge when their indices differ in one bit
+    const unsigned int edges[] = {
+        0, 1, 2, 3, 4, 5, 6, 7,
+        0, 2, 1, 3, 4, 6, 5, 7,
+        0, 4, 1, 5, 2, 6, 3, 7
+    };
+
+    glGenVertexArrays(1, &_previewVertexArray);
+    _state.bindVertexArray(_previewVertexArray);
+
+    glGenBuffers(1, &_previewVertexBuffer);
+    _state.bindBuffer(GL_ARRAY_BUFFER, _previewVertexBuffer);
+    _state.bufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+    _state.vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+    glGenBuffers(1, &_previewIndexBuffer);
+    _state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, _previewIndexBuffer);
+    _state.bufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(edges), edges, GL_STATIC_DRAW);
+
+    _state.bindVertexArray(0);
+    _state.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    _previewPoints = GLsizei(points.size());
+    _gpuBufferBytes += vertices.size() * sizeof(glm::vec3) + sizeof(edges);
+    updateMemoryUsage();
+}
+
+void Renderer::releasePreview() {
+    if(!_previewVertexArray)
+        return;
+
+    GLuint buffers[] = { _previewVertexBuffer, _previewIndexBuffer };
+    _state.deleteBuffers(2, buffers);
+    _state.deleteVertexArrays(1, &_previewVertexArray);
+    _gpuBufferBytes -= (8 + _previewPoints) * sizeof(glm::vec3) + 24 * sizeof(unsigned int);
+    _previewVertexArray = _previewVertexBuffer = _previewIndexBuffer = 0;
+    _previewPoints = 0;
+    updateMemoryUsage();
+}
+
+void Renderer::setPointCloud(const ::PointCloud* cloud) {
+    _pointRenderer.setPointCloud(cloud);
+    updateMemoryUsage();
+}
+
+void Renderer::setPointStream(PointCloudStream* stream) {
+    _pointRenderer.setPointStream(stream);
+    updateMemoryUsage();
+}
+
+void Renderer::setPointBudget(size_t points) {
+    _pointRenderer.setPointBudget(points);
+}
+
+void Renderer::drawPreview() {
+    _state.bindTexture(GL_TEXTURE_2D, 0);
+    _state.bindVertexArray(_previewVertexArray);
+    _state.drawElements(GL_LINES, 24, GL_UNSIGNED_INT, 0);
+    if(_previewPoints > 0)
+        _state.drawArrays(GL_POINTS, 8, _previewPoints);
+}
+
+void Renderer::bindDrawUniforms(size_t index) {
+    _state.bindBufferRange(GL_UNIFORM_BUFFER, DrawUniformBinding, _drawUniformBuffer,
+                           index * _drawUniformStride,
+                           sizeof(DrawUniforms));
+}
+
+void Renderer::drawCaps() {
+    size_t firstCap = _drawList.size();
+    while(firstCap > 0 && _drawList[firstCap - 1].capPlane >= 0)
+        --firstCap;
+
+    _state.setEnabled(GL_STENCIL_TEST, true);
+    _state.setEnabled(GL_CULL_FACE, false);
+    _state.polygonMode(GL_FILL);
+
+    for(size_t c = firstCap; c < _drawList.size(); ++c) {
+        // Every face left by the planes along the ray through a pixel flips its stencil value, so
+        // it ends up odd where the ray meets the plane inside a closed mesh. Faces count whichever
+        // way they face and whatever is in front of them.
+        _state.clear(GL_STENCIL_BUFFER_BIT);
+        _state.colorMask(false);
+        _state.depthMask(false);
+        _state.stencilFunc(GL_ALWAYS, 0, 1);
+        _state.stencilOp(GL_KEEP, GL_KEEP, GL_INVERT);
+        _state.setEnabled(GL_DEPTH_TEST, false);
+
+        for(size_t i = 0; i < firstCap; ++i) {
+            const DrawCommand& draw = _drawList[i];
+            if(!draw.mesh)
+                continue;
+
+            bindDrawUniforms(i);
+            _state.bindVertexArray(draw.mesh->vertexArray);
+            const Model::Lod& lod = draw.mesh->lods[draw.lodIndex];
+            if(draw.numRanges > 0) {
+                _state.multiDrawElements(GL_TRIANGLES, &_drawCounts[draw.firstRange], GL_UNSIGNED_INT,
+                                         &_drawOffsets[draw.firstRange], GLsizei(draw.numRanges));
+            }
+            else {
+                _state.drawElements(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT, (void*)(lod.indexOffset * sizeof(unsigned int)));
+            }
+        }
+
+        // The cap is depth tested against the meshes in front of it, and cut by the other planes only
+        const GLenum ownPlane = GLenum(GL_CLIP_DISTANCE0 + _drawList[c].capPlane);
+        _state.colorMask(true);
+        _state.depthMask(true);
+        _state.stencilFunc(GL_NOTEQUAL, 0, 1);
+        _state.stencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        _state.setEnabled(GL_DEPTH_TEST, true);
+        _state.setEnabled(ownPlane, false);
+
+        bindDrawUniforms(c);
+        _state.bindTexture(GL_TEXTURE_2D, 0);
+        _state.bindVertexArray(_capVertexArray);
+        _state.drawArrays(GL_TRIANGLE_FAN, 0, 4);
+        _state.setEnabled(ownPlane, true);
+    }
+
+    _state.setEnabled(GL_STENCIL_TEST, false);
+    _state.setEnabled(GL_CULL_FACE, _backfaceCullingEnabled);
+}
+
+void Renderer::enableClipPlanes(bool enabled) {
+    // Planes are only changed between frames, so the ones enabled here are the ones disabled after it
+    for(size_t i = 0; i < _clipPlanes.size(); ++i)
+        _state.setEnabled(GLenum(GL_CLIP_DISTANCE0 + i), enabled);
+}
+
+bool Renderer::isClipped(const glm::vec3& center, float radius) const {
+    for(const glm::vec4& plane : _clipPlanes) {
+        if(glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return true;
+    }
+    return false;
+}
+
+glm::mat4 Renderer::capMatrix(const glm::vec4& plane) const {
+    const glm::vec3 normal(plane);
+    const glm::vec3 center = _sceneBounds.center();
+    const float radius = 0.5f * glm::length(_sceneBounds.max - _sceneBounds.min);
+
+    // Any two directions perpendicular to the normal span the plane
+    const glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    const glm::vec3 u = glm::normalize(glm::cross(normal, axis));
+    const glm::vec3 v = glm::cross(normal, u);
+
+    glm::mat4 cap;
+    cap[0] = glm::vec4(u * radius, 0.0f);
+    cap[1] = glm::vec4(v * radius, 0.0f);
+    cap[2] = glm::vec4(normal, 0.0f);
+    // The center of the bounds, projected onto the plane
+    cap[3] = glm::vec4(center - (glm::dot(normal, center) + plane.w) * normal, 1.0f);
+    return cap;
+}
+
+void Renderer::updateMemoryUsage() {
+    MemoryTracker::Usage meshes = Model::meshMemory(_meshes);
+    _memory.set(MemoryTracker::VertexArrays, meshes.bytes[MemoryTracker::VertexArrays]);
+    _memory.set(MemoryTracker::IndexArrays, meshes.bytes[MemoryTracker::IndexArrays]);
+
+    size_t uniformBytes = _initialized ? sizeof(FrameUniforms) + _drawUniformCapacity * _drawUniformStride : 0;
+    _memory.set(MemoryTracker::GLBuffers, _gpuBufferBytes + uniformBytes + _gpuPicker.gpuBytes() + _pointRenderer.gpuBytes());
+}
+
+void Renderer::cullClusters(const Model::Mesh& mesh, const Frustum& frustum, const glm::vec3& cameraPosition, bool edges) {
+    // Ranges of earlier meshes stay in the lists; only ranges of this mesh may be merged
+    const size_t firstRange = _drawCounts.size();
+
+    for(const MeshClusterizer::Cluster& cluster : mesh.clusters) {
+        if(!frustum.intersectsSphere(cluster.center, cluster.radius) || isClipped(cluster.center, cluster.radius))
+            continue;
+        if(_backfaceCullingEnabled && MeshClusterizer::isBackfacing(cluster, cameraPosition))
+            continue;
+
+        // Clusters are contiguous in the index buffer, and so are their edges, so neighbouring
+        // survivors share one range. Edges on the border of two clusters are listed by both.
+        const int count = edges ? cluster.edgeCount : cluster.indexCount;
+        if(count == 0)
+            continue;
+        size_t offset = (edges ? cluster.edgeOffset : cluster.indexOffset) * sizeof(unsigned int);
+        if(_drawCounts.size() > firstRange && size_t(_drawOffsets.back()) + _drawCounts.back() * sizeof(unsigned int) == offset) {
+            _drawCounts.back() += count;
+        }
+        else {
+            _drawCounts.push_back(count);
+            _drawOffsets.push_back((const void*)offset);
+        }
+    }
+}
+
+int Renderer::selectLod(const Model::Mesh& mesh) {
+    if(mesh.lods.size() < 2 || mesh.bounds.isEmpty())
+        return 0;
+
+    // Bounding sphere of the mesh in view space
+    float scale = glm::length(glm::vec3(_model[0]));
+    float radius = mesh.boundingSphere.radius * scale;
+    glm::vec4 viewCenter = _view * _model * glm::vec4(mesh.boundingSphere.center, 1.0f);
+
+    // Distance to the closest point of the mesh; anything the camera is inside gets full detail
+    float distance = -viewCenter.z - radius;
+    if(distance <= 0.0f)
+        return 0;
+
+    // How many pixels one unit of length covers at that distance
+    float pixelsPerUnit = 0.5f * _height * _projection[1][1] / distance;
+
+    for(int i = int(mesh.lods.size()) - 1; i > 0; --i) {
+        if(mesh.lods[i].error * scale * pixelsPerUnit <= _lodPixelError)
+            return i;
+    }
+    return 0;
+}
+
+void Renderer::loadShader(string shaderSource, GLenum shaderType, GLuint &programId) {
+    GLuint shaderId = glCreateShader(shaderType);
+
+    GLint result = GL_FALSE; // compilation result
+    int infoLogLength;       // length of info log
+
+    std::ifstream shaderFile(shaderSource);
+    std::string shaderStr;
+    const char* shader;
+
+    if(!shaderFile.is_open()) {
+        std::string error = "Error: could not read file ";
+        throw std::runtime_error(error.append(shaderSource).c_str());
+    }
+
+    // Read shader
+    std::string buffer;
+    while(std::getline(shaderFile, buffer)) {
+        shaderStr += buffer + "\n";
+    }
+
+    shader = shaderStr.c_str();
+
+    // Compile shader
+    qDebug() << "Compiling shader";
+    glShaderSource(shaderId, // Shader handle
+                   1,        // Number of files
+                   &shader,  // Shader source code
+                   NULL);    // NULL terminated string
+    glCompileShader(shaderId);
+
+    // Check shader
+    glGetShaderiv(shaderId, GL_COMPILE_STATUS, &result);
+    glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &infoLogLength);
+    std::vector<char> errorMessage(infoLogLength);
+    glGetShaderInfoLog(shaderId, infoLogLength, NULL, &errorMessage[0]);
+    qDebug() << errorMessage.data();
+
+    // Link the program
+    qDebug() << "Linking program";
+    glAttachShader(programId, shaderId);
+    glLinkProgram(programId);
+
+    // Check the program
+    glGetProgramiv(programId, GL_LINK_STATUS, &result);
+    glGetProgramiv(programId, GL_INFO_LOG_LENGTH, &infoLogLength);
+    std::vector<char> programErrorMessage(std::max(infoLogLength, int(1)));
+    glGetProgramInfoLog(programId, infoLogLength, NULL, &programErrorMessage[0]);
+    qDebug() << programErrorMessage.data();
+
+    glDeleteShader(shaderId);
+
+    shaderFile.close();
+}
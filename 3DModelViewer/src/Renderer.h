@@ -0,0 +1,248 @@
+#pragma once
+
+#include "QOpenGLFunctions_3_3_Core"
+
+#include "Model.h"
+#include "GLStateCache.h"
+#include "FrameProfiler.h"
+#include "GpuPicker.h"
+#include "PointRenderer.h"
+#include "MemoryTracker.h"
+
+#include "glm.hpp"
+
+using std::vector;
+using std::string;
+
+class Frustum;
+
+// Draws the meshes of a model into whatever framebuffer is bound on the current context.
+// It holds no window or widget state, so the same path is used by the interactive viewer and
+// by headless rendering. Every method that touches GL expects the renderer's context to be current.
+class Renderer : protected QOpenGLFunctions_3_3_Core {
+
+public:
+    enum ViewMode {
+        PointCloud = GL_POINT,      // View the vertices of the meshes as points
+        WireFrame = GL_LINES,       // View the unique edges of the meshes as lines
+        ModelView = GL_TRIANGLES    // Normal viewing mode
+    };
+
+    // Number of section planes the shaders evaluate
+    static const int MaxClipPlanes = 6;
+
+    Renderer();
+    // Releases the GL objects; the context must still be current
+    ~Renderer();
+
+    // Compile the shaders and create the uniform buffers
+    void initialize();
+    bool initialized() const;
+
+    // Uploads the meshes to the gpu, replacing the ones uploaded before
+    void setMeshes(const vector<Model::Mesh>& meshes);
+    // Uploads one more mesh, keeping the ones uploaded before; index is its position in the model
+    void addMesh(const Model::Mesh& mesh, size_t index);
+    void releaseMeshes();
+    // Shows a model that is still loading: the outline of its bounds and a sample of its
+    // vertices as points, drawn in a plain colour next to the meshes added so far
+    void setPreview(const glm::vec3& min, const glm::vec3& max, const vector<glm::vec3>& points);
+    void releasePreview();
+    // The point cloud of the model, drawn after the meshes; null for none. The cloud must stay alive
+    // until it is replaced. Drawn in every view mode, since it has no faces.
+    void setPointCloud(const ::PointCloud* cloud);
+    // A cloud streamed from disk, drawn instead of the point cloud; its nodes appear as they are read
+    void setPointStream(PointCloudStream* stream);
+    // Most points of the cloud drawn per frame; fewer are drawn for small viewports
+    void setPointBudget(size_t points);
+
+    void setViewport(int width, int height);
+    void setMatrices(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model);
+    void setLight(const glm::vec3& position, const glm::vec3& color);
+    void setViewMode(ViewMode mode);
+    ViewMode getViewMode() const;
+    void setLightingEnabled(bool enabled);
+    void setTexturingEnabled(bool enabled);
+    // Skips back facing triangles, and whole clusters whose triangles all face away.
+    // Only correct for closed meshes, so it is off by default.
+    void setBackfaceCullingEnabled(bool enabled);
+    // Largest screen-space error (in pixels) allowed when choosing a level of detail
+    void setLodPixelError(double pixels);
+    // Object space section planes (a, b, c, d); whatever has a*x + b*y + c*z + d < 0 is cut away.
+    // At most MaxClipPlanes are used. Meshes and clusters entirely on the cut side are culled, and
+    // changing the planes only changes the frame uniforms, so they can be moved every frame.
+    void setClipPlanes(const vector<glm::vec4>& planes);
+    const vector<glm::vec4>& getClipPlanes() const;
+    // Fills the cut surface of every plane with a plain colour, found by counting the faces behind
+    // it in the stencil buffer. Only correct for closed meshes, so it is off by default.
+    void setClipCapsEnabled(bool enabled);
+    bool isClipCapsEnabled() const;
+
+    // Clear the framebuffer and draw the meshes, followed by the id pass if a pick is waiting for one
+    void render();
+    // Tells the renderer that other code changed GL state on its context, e.g. by painting over
+    // the frame with a QPainter. The state it shadows is otherwise kept from one frame to the next.
+    void invalidateState();
+
+    // Queues a pick of pixel (x, y) of the viewport, counted from the top left, from the ids of the
+    // triangles drawn there. It is drawn by one of the next frames and answered a few frames later.
+    void requestIdPick(int x, int y);
+    // The answer to the latest id pick, if it has arrived since the last call. Its mesh is the
+    // index of the mesh in the model.
+    bool takeIdPick(GpuPicker::Result& result);
+    // The world space ray from the near to the far plane through the center of pixel (x, y)
+    void pickRay(int x, int y, glm::vec3& origin, glm::vec3& direction) const;
+
+    // Number of OpenGL calls issued while drawing the last frame, and how many redundant
+    // state changes were skipped
+    unsigned int getGLCallsPerFrame() const;
+    unsigned int getGLCallsSkippedPerFrame() const;
+    // Size of the vertex and index buffers of the current meshes
+    size_t getGpuBufferBytes() const;
+    // The renderer's draw records of the meshes, and every buffer it allocated on the gpu
+    const MemoryTracker::Usage& getMemoryUsage() const;
+    // Records the stages of render() while enabled; frames are delimited by the caller
+    FrameProfiler& profiler();
+
+private:
+    // Uniform block binding points, matching the blocks declared in the shaders
+    static const GLuint FrameUniformBinding = 0;
+    static const GLuint DrawUniformBinding = 1;
+
+    // std140 layout of the FrameData block, set once per frame
+    struct FrameUniforms {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec4 viewPos;
+        glm::vec4 lightPos;
+        glm::vec4 lightColor;
+        glm::vec4 flags; // x: lighting enabled, y: texturing enabled, z: number of clip planes
+        glm::vec4 clipPlanes[MaxClipPlanes]; // World space
+    };
+
+    // std140 layout of the DrawData block, one per draw
+    struct DrawUniforms {
+        glm::mat4 model;
+        glm::mat4 mvp;
+        glm::vec4 flags; // x: compact normals, y: plain colour without lighting or texture, z: normal mapped
+    };
+
+    // One draw of the current frame
+    struct DrawCommand {
+        const Model::Mesh* mesh; // Null for the loading preview and the caps
+        int capPlane; // The clip plane whose cap this draws, or -1
+        int lodIndex;
+        bool edges; // Draws the level's edges as lines for the wireframe view
+        // Cluster ranges in _drawCounts/_drawOffsets; numRanges is 0 when the whole lod is drawn
+        size_t firstRange;
+        size_t numRanges;
+    };
+
+    // OpenGL IDs
+    GLuint _programId;
+    GLuint _idProgramId;
+    GLuint _pointProgramId;
+    GLStateCache _state;
+    FrameProfiler _profiler;
+    GpuPicker _gpuPicker;
+    PointRenderer _pointRenderer;
+
+    // What drawing needs of each mesh, without its vertex and index arrays, which stay with the model
+    vector<Model::Mesh> _meshes;
+    vector<size_t> _meshIndices; // Index of each of _meshes in the model
+    ViewMode _viewMode;
+
+    // Uniform handles
+    GLuint _uniformTexSamplerHandle;
+    GLuint _uniformNormalSamplerHandle;
+    GLint _idMvpLocation;
+    GLint _idMeshLocation;
+    GLint _idModelLocation;
+
+    // Lighting
+    glm::vec3 _lightColor;
+    glm::vec3 _lightPos;
+
+    // MVP matrices
+    glm::mat4 _projection;
+    glm::mat4 _view;
+    glm::mat4 _model;
+    glm::mat4 _mvp;
+
+    int _width;
+    int _height;
+    double _lodPixelError;
+
+    bool _initialized;
+    bool _lightingEnabled;
+    bool _texturingEnabled;
+    bool _backfaceCullingEnabled;
+    bool _clipCapsEnabled;
+
+    // Normalized, in object space
+    vector<glm::vec4> _clipPlanes;
+    // Bounds of every mesh uploaded, which the caps are sized to cover
+    MeshBounds::Box _sceneBounds;
+
+    // Uniform buffers
+    GLuint _frameUniformBuffer;
+    FrameUniforms _frameUniforms; // Last uploaded frame data
+    bool _frameUniformsValid;
+    GLuint _drawUniformBuffer;
+    size_t _drawUniformStride; // sizeof(DrawUniforms) rounded up to the offset alignment
+    size_t _drawUniformCapacity; // Draws the buffer can hold
+    vector<unsigned char> _drawUniformData;
+
+    // Draws of the current frame, and the index ranges of their visible clusters for glMultiDrawElements
+    vector<DrawCommand> _drawList;
+    vector<GLsizei> _drawCounts;
+    vector<const void*> _drawOffsets;
+
+    // Loading preview: the 8 corners of the bounds followed by the sampled points
+    GLuint _previewVertexArray;
+    GLuint _previewVertexBuffer;
+    GLuint _previewIndexBuffer; // Edges of the bounds as lines
+    GLsizei _previewPoints;
+
+    // A square of side 2 around the origin in the xy plane, placed on a clip plane to draw its cap
+    GLuint _capVertexArray;
+    GLuint _capVertexBuffer;
+
+    size_t _gpuBufferBytes;
+    MemoryTracker::Account _memory;
+
+    // Registers the mesh copies and buffer sizes with the memory tracker
+    void updateMemoryUsage();
+    // Adds a draw record of mesh to _meshes with its vertex array, and its buffers unless the model filled them
+    void uploadMesh(const Model::Mesh& mesh, size_t index);
+    // Fills the buffers of record from the arrays of mesh
+    void createBuffers(const Model::Mesh& mesh, Model::Mesh& record);
+    void drawPreview();
+    // Binds the DrawData of the index-th draw of _drawList
+    void bindDrawUniforms(size_t index);
+    // Fills the cut surfaces of the meshes in _drawList with the cap draws at its end
+    void drawCaps();
+    // Enables a clip distance for each clip plane, or disables all of them
+    void enableClipPlanes(bool enabled);
+    // Whether a sphere in object space lies entirely on the cut side of a clip plane
+    bool isClipped(const glm::vec3& center, float radius) const;
+    // Maps the cap square onto the clip plane, centered on and covering _sceneBounds
+    glm::mat4 capMatrix(const glm::vec4& plane) const;
+    // Draws the meshes and the loading preview into the bound framebuffer
+    void renderScene();
+    // Draws the mesh and triangle ids of the region around the requested pick
+    void renderIdPass();
+    // Compile shader
+    void loadShader(string shaderSource, GLenum shaderType, GLuint &programId);
+    // Uploads the frame uniform block if anything in it changed since the last frame
+    void updateFrameUniforms();
+    // Culls meshes and clusters and fills _drawList with what is left
+    void buildDrawList();
+    // Orphans the per-draw buffer and writes the DrawData of every draw in _drawList into it
+    void uploadDrawUniforms();
+    // Appends to _drawCounts/_drawOffsets the clusters of mesh that survive frustum, clip plane and
+    // backface culling, as ranges of their triangles or, with edges, of their edges
+    void cullClusters(const Model::Mesh& mesh, const Frustum& frustum, const glm::vec3& cameraPosition, bool edges);
+    // Returns the index of the coarsest level of detail whose error is below _lodPixelError
+    int selectLod(const Model::Mesh& mesh);
+};
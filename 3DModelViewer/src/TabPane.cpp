@@ -7,7 +7,8 @@ TabPane::TabPane(QWidget* parent) :
   QTabWidget(parent),
   _wireFrameEnabled(false),
   _lightingEnabled(true),
-  _texturingEnabled(true)
+  _texturingEnabled(true),
+  _backfaceCullingEnabled(false)
 {
     setTabsClosable(true);
     connect(this, SIGNAL(tabCloseRequested(int)), this, SLOT(closeTab(int)));
@@ -18,30 +19,41 @@ TabPane::TabPane(QWidget* parent) :
 
 TabPane::~TabPane() {}
 
-int TabPane::addTab(string fileName) {
+int TabPane::addTab(string fileName, Model::ImportOptions options) {
 
     if(currentIndex() != -1 || _viewers.empty()) {
         addViewer();
     }
 
-    if(fileName.length() == 0 || !_viewers[_viewers.size() - 1]->loadFile(fileName)) {
+    if(fileName.length() == 0 || !_viewers[_viewers.size() - 1]->loadFile(fileName, options)) {
         return -1; // File could not be loaded
     }
 
     string label = Utils::getFileNameFromPath(fileName);
     int ret = QTabWidget::addTab(_viewers[_viewers.size() - 1].get(), label.c_str());
+    setTabToolTip(ret, QString("%1 (%2)").arg(fileName.c_str()).arg(Model::profileName(options.profile).c_str()));
     setCurrentIndex(count() - 1); // set the view to the new tab
 
-    // Set lighting/texturing/view mode
+    // Set lighting/texturing/culling/view mode
     enableWireFrameView(_wireFrameEnabled);
     enableLighting(_lightingEnabled);
     enableTexturing(_texturingEnabled);
+    enableBackfaceCulling(_backfaceCullingEnabled);
 
     return ret;
 }
 
+ModelViewer* TabPane::currentViewer() const {
+    if(currentIndex() == -1 || currentIndex() >= int(_viewers.size()))
+        return nullptr;
+    return _viewers[currentIndex()].get();
+}
+
 void TabPane::addViewer() {
     shared_ptr<ModelViewer> viewer = shared_ptr<ModelViewer>(new ModelViewer(this));
+    connect(viewer.get(), SIGNAL(picked(QString)), this, SIGNAL(picked(QString)));
+    // Queued, so the tab can be closed once the viewer has returned from emitting it
+    connect(viewer.get(), SIGNAL(loadFailed(QString)), this, SLOT(viewerLoadFailed(QString)), Qt::QueuedConnection);
     _viewers.push_back(viewer);
 }
 
@@ -57,6 +69,12 @@ void TabPane::enableWireFrameView(bool enabled) {
         _viewers[currentIndex()]->setViewMode(ModelViewer::ViewMode::ModelView);
 }
 
+void TabPane::viewerLoadFailed(const QString& fileName) {
+    int index = indexOf(static_cast<QWidget*>(sender()));
+    if(index != -1)
+        emit loadFailed(index, fileName);
+}
+
 void TabPane::closeTab(int index) {
     if(index >= 0 && _viewers.size() > index) {
         _viewers.erase(_viewers.begin() + index);
@@ -75,3 +93,9 @@ void TabPane::enableTexturing(bool enabled) {
     if(!_viewers.empty() && currentIndex() < _viewers.size())
         _viewers[currentIndex()]->setTexturingEnabled(enabled);
 }
+
+void TabPane::enableBackfaceCulling(bool enabled) {
+    _backfaceCullingEnabled = enabled;
+    if(!_viewers.empty() && currentIndex() < _viewers.size())
+        _viewers[currentIndex()]->setBackfaceCullingEnabled(enabled);
+}
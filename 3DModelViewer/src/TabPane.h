@@ -1,6 +1,7 @@
 #pragma once
 
 #include "qtabwidget.h"
+#include "Model.h"
 #include <memory>
 #include <vector>
 
@@ -19,14 +20,29 @@ public:
     ~TabPane();
 
     // Create a new tab with the specified file
-    // Returns index of the tab
-    int addTab(string fileName);
+    // Returns index of the tab, or -1 if the file does not exist. Files that turn out
+    // to be unreadable are reported later with loadFailed.
+    int addTab(string fileName, Model::ImportOptions options = Model::ImportOptions());
+    // The viewer of the selected tab, or null if no tab is open
+    ModelViewer* currentViewer() const;
+
+signals:
+    // Forwarded from the viewers
+    void picked(const QString& description);
+    // The file of the tab at index could not be loaded; the tab is left open and empty
+    void loadFailed(int index, const QString& fileName);
 
 public slots:
     void closeTab(int index);
     void enableLighting(bool enabled);
     void enableWireFrameView(bool enabled);
     void enableTexturing(bool enabled);
+    // Only correct for closed meshes, so it is off until checked
+    void enableBackfaceCulling(bool enabled);
+
+private slots:
+    // Finds the tab of the viewer that failed and emits loadFailed
+    void viewerLoadFailed(const QString& fileName);
 
 private:
     // Holds all of our views
@@ -35,6 +51,7 @@ private:
     bool _wireFrameEnabled;
     bool _lightingEnabled;
     bool _texturingEnabled;
+    bool _backfaceCullingEnabled;
 
     void addViewer();
 };
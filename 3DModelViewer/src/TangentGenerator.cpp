@@ -0,0 +1,127 @@
+#include "TangentGenerator.h"
+#include "VertexCompressor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Which uv windings the faces around a vertex have
+const uint8_t PreservingFaces = 1;
+const uint8_t MirroredFaces = 2;
+const unsigned int NoVertex = ~0u;
+
+// A unit tangent in the plane of normal, for vertices whose faces give no usable direction
+glm::vec3 anyTangent(const glm::vec3& normal) {
+    glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    return glm::normalize(axis - normal * glm::dot(normal, axis));
+}
+
+float cornerAngle(const glm::vec3& corner, const glm::vec3& next, const glm::vec3& previous) {
+    glm::vec3 a = next - corner, b = previous - corner;
+    float lengths = glm::length(a) * glm::length(b);
+    if(lengths <= 0.0f)
+        return 0.0f;
+    return std::acos(glm::clamp(glm::dot(a, b) / lengths, -1.0f, 1.0f));
+}
+
+}
+
+TangentGenerator::TangentGenerator() {}
+
+TangentGenerator::~TangentGenerator() {}
+
+size_t TangentGenerator::generate(vector<glm::vec3>& vertices, vector<glm::vec3>& normals, vector<glm::vec2>& uvs,
+                                  vector<unsigned int>& indices, vector<uint32_t>& tangents) {
+    tangents.clear();
+    const size_t numVertices = vertices.size();
+    const size_t numFaces = indices.size() / 3;
+    if(normals.size() != numVertices || uvs.size() != numVertices)
+        return 0;
+
+    // Direction of increasing u on each face. The uv area is doubled and signed: positive when the
+    // uvs wind the same way as the positions, negative when the map is mirrored, zero when degenerate.
+    vector<glm::vec3> faceTangents(numFaces);
+    vector<float> uvAreas(numFaces);
+    for(size_t f = 0; f < numFaces; ++f) {
+        const unsigned int* face = &indices[f * 3];
+        glm::vec3 d1 = vertices[face[1]] - vertices[face[0]], d2 = vertices[face[2]] - vertices[face[0]];
+        glm::vec2 t1 = uvs[face[1]] - uvs[face[0]], t2 = uvs[face[2]] - uvs[face[0]];
+        float area = t1.x * t2.y - t1.y * t2.x;
+        glm::vec3 tangent = t2.y * d1 - t1.y * d2;
+        uvAreas[f] = area;
+        faceTangents[f] = area > 0.0f ? tangent : area < 0.0f ? -tangent : glm::vec3(0.0f);
+    }
+
+    // Vertices used by faces of both windings get a copy for the mirrored ones. Faces with
+    // degenerate uvs take no side and stay on the original vertex.
+    vector<uint8_t> windings(numVertices, 0);
+    for(size_t f = 0; f < numFaces; ++f) {
+        if(uvAreas[f] == 0.0f)
+            continue;
+        for(int k = 0; k < 3; ++k)
+            windings[indices[f * 3 + k]] |= uvAreas[f] > 0.0f ? PreservingFaces : MirroredFaces;
+    }
+    vector<unsigned int> mirrored(numVertices, NoVertex);
+    size_t added = 0;
+    for(size_t v = 0; v < numVertices; ++v) {
+        if(windings[v] == (PreservingFaces | MirroredFaces))
+            mirrored[v] = unsigned(numVertices + added++);
+    }
+    if(added > 0) {
+        vertices.resize(numVertices + added);
+        normals.resize(numVertices + added);
+        uvs.resize(numVertices + added);
+        for(size_t v = 0; v < numVertices; ++v) {
+            if(mirrored[v] == NoVertex)
+                continue;
+            vertices[mirrored[v]] = vertices[v];
+            normals[mirrored[v]] = normals[v];
+            uvs[mirrored[v]] = uvs[v];
+        }
+        for(size_t f = 0; f < numFaces; ++f) {
+            if(uvAreas[f] >= 0.0f)
+                continue;
+            for(int k = 0; k < 3; ++k) {
+                unsigned int& index = indices[f * 3 + k];
+                if(mirrored[index] != NoVertex)
+                    index = mirrored[index];
+            }
+        }
+    }
+
+    // Every corner adds its face's tangent, projected into the plane of the vertex normal and
+    // weighted by the angle of the corner
+    const size_t total = vertices.size();
+    vector<glm::vec3> sums(total, glm::vec3(0.0f));
+    for(size_t f = 0; f < numFaces; ++f) {
+        if(uvAreas[f] == 0.0f)
+            continue;
+        const unsigned int* face = &indices[f * 3];
+        for(int k = 0; k < 3; ++k) {
+            unsigned int v = face[k];
+            glm::vec3 projected = faceTangents[f] - normals[v] * glm::dot(normals[v], faceTangents[f]);
+            float length = glm::length(projected);
+            if(length <= 0.0f)
+                continue;
+            float angle = cornerAngle(vertices[v], vertices[face[(k + 1) % 3]], vertices[face[(k + 2) % 3]]);
+            sums[v] += projected * (angle / length);
+        }
+    }
+
+    tangents.resize(total);
+    for(size_t v = 0; v < total; ++v) {
+        glm::vec3 normal = normals[v];
+        float normalLength = glm::length(normal);
+        normal = normalLength > 0.0f ? normal / normalLength : glm::vec3(0.0f, 0.0f, 1.0f);
+
+        glm::vec3 tangent = sums[v] - normal * glm::dot(normal, sums[v]);
+        float length = glm::length(tangent);
+        tangent = length > 1e-12f ? tangent / length : anyTangent(normal);
+
+        // Copies hold the mirrored corners; other vertices are mirrored only if all their faces are
+        bool mirror = v >= numVertices || windings[v] == MirroredFaces;
+        tangents[v] = VertexCompressor::packTangent(glm::vec4(tangent, mirror ? -1.0f : 1.0f));
+    }
+    return added;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "glm.hpp"
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+// Per-vertex tangent frames for normal mapping, following the conventions of MikkTSpace so
+// maps baked by other tools come out the same: each face's tangent is the direction of
+// increasing u, projected into the plane of each corner's vertex normal and weighted by the
+// corner angle, and the bitangent is rebuilt in the shader as cross(normal, tangent) * w.
+// Corners of a vertex whose faces disagree on the uv winding (mirrored uvs) can't share a
+// tangent; those vertices are split.
+class TangentGenerator {
+
+public:
+    // Fills tangents, packed with VertexCompressor::packTangent, for the triangles in indices.
+    // Vertices that have to be split are appended to vertices, normals and uvs and indices is
+    // rewritten to use them. Returns the number of vertices added.
+    static size_t generate(vector<glm::vec3>& vertices, vector<glm::vec3>& normals, vector<glm::vec2>& uvs,
+                           vector<unsigned int>& indices, vector<uint32_t>& tangents);
+
+private:
+    TangentGenerator();
+    ~TangentGenerator();
+};
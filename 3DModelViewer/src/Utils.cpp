@@ -1,5 +1,17 @@
 #include "Utils.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
 Utils::Utils() {}
 
 Utils::~Utils() {}
@@ -11,3 +23,45 @@ string Utils::getFileNameFromPath(string path) {
 string Utils::getPathFromFileName(string fileName) {
     return fileName.substr(0, fileName.find_last_of("/\\") + 1);
 }
+
+void Utils::parallelFor(size_t count, std::function<void(size_t)> task, size_t maxThreads) {
+    size_t numThreads = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+    if(maxThreads > 0)
+        numThreads = std::min(numThreads, maxThreads);
+
+    if(numThreads <= 1) {
+        for(size_t i = 0; i < count; ++i)
+            task(i);
+        return;
+    }
+
+    // Each worker grabs the next unclaimed index until none are left
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for(size_t t = 0; t < numThreads; ++t) {
+        workers.push_back(std::thread([&]() {
+            for(size_t i = next++; i < count; i = next++)
+                task(i);
+        }));
+    }
+    for(std::thread& worker : workers)
+        worker.join();
+}
+
+size_t Utils::getPeakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss); // bytes on macOS
+#else
+    return size_t(usage.ru_maxrss) * 1024; // kilobytes on Linux
+#endif
+#endif
+}
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <string>
+#include <functional>
+#include <vector>
 
 using std::string;
 
@@ -10,8 +13,34 @@ public:
     static string getFileNameFromPath(string path);
     static string getPathFromFileName(string fileName);
 
+    // Calls task(i) for every i in [0, count) spread across the available hardware threads, or at
+    // most maxThreads of them if it isn't 0; 1 runs every call on the calling thread, which callers
+    // that are already one task of a parallelFor use to avoid starting threads of their own.
+    // Returns once every call has finished.
+    static void parallelFor(size_t count, std::function<void(size_t)> task, size_t maxThreads = 0);
+
+    // Sorts values by operator<: chunks of chunkSize are sorted in parallel, then neighbouring
+    // runs are merged in parallel rounds. maxThreads is passed on to parallelFor.
+    template<typename T>
+    static void parallelSort(std::vector<T>& values, size_t chunkSize = 1 << 16, size_t maxThreads = 0) {
+        const size_t size = values.size();
+        parallelFor((size + chunkSize - 1) / chunkSize, [&](size_t chunk) {
+            std::sort(values.begin() + chunk * chunkSize, values.begin() + std::min(size, (chunk + 1) * chunkSize));
+        }, maxThreads);
+        for(size_t width = chunkSize; width < size; width *= 2) {
+            parallelFor((size + 2 * width - 1) / (2 * width), [&](size_t pair) {
+                size_t begin = pair * 2 * width;
+                size_t middle = std::min(size, begin + width);
+                size_t end = std::min(size, begin + 2 * width);
+                std::inplace_merge(values.begin() + begin, values.begin() + middle, values.begin() + end);
+            }, maxThreads);
+        }
+    }
+
+    // Largest amount of physical memory the process has used so far, in bytes
+    static size_t getPeakResidentBytes();
+
 private:
     Utils();
     ~Utils();
 };
-
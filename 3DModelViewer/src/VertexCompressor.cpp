@@ -0,0 +1,164 @@
+#include "VertexCompressor.h"
+
+#include "gtc/matrix_transform.hpp"
+#include "gtc/packing.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+float signNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+int16_t packSnorm16(float value) {
+    return int16_t(std::floor(glm::clamp(value, -1.0f, 1.0f) * 32767.0f + 0.5f));
+}
+
+float unpackSnorm16(int16_t value) {
+    return std::max(float(value) / 32767.0f, -1.0f);
+}
+
+uint32_t packSnorm10(float value) {
+    return uint32_t(int(std::floor(glm::clamp(value, -1.0f, 1.0f) * 511.0f + 0.5f))) & 0x3FF;
+}
+
+// The signed normalized value in numBits bits of packed, starting at firstBit
+float unpackSnorm(uint32_t packed, int firstBit, int numBits) {
+    int32_t value = int32_t(packed << (32 - firstBit - numBits)) >> (32 - numBits);
+    return std::max(float(value) / float((1 << (numBits - 1)) - 1), -1.0f);
+}
+
+}
+
+VertexCompressor::Error::Error() :
+  maxPosition(0.0f),
+  meanPosition(0.0f),
+  maxPositionRelative(0.0f),
+  maxNormalDegrees(0.0f),
+  maxUv(0.0f)
+{}
+
+VertexCompressor::VertexCompressor() {}
+
+VertexCompressor::~VertexCompressor() {}
+
+vector<VertexCompressor::CompactVertex> VertexCompressor::compress(const vector<glm::vec3>& positions,
+                                                                   const vector<glm::vec3>& normals,
+                                                                   const vector<glm::vec2>& uvs,
+                                                                   glm::mat4& positionDecode,
+                                                                   Error* error) {
+    vector<CompactVertex> result(positions.size());
+
+    // Exact bounds of the positions; the quantization grid spans exactly this box
+    glm::vec3 minPos(0.0f), maxPos(0.0f);
+    if(!positions.empty()) {
+        minPos = maxPos = positions[0];
+        for(const glm::vec3& p : positions) {
+            minPos = glm::min(minPos, p);
+            maxPos = glm::max(maxPos, p);
+        }
+    }
+    glm::vec3 extent = maxPos - minPos;
+    for(int axis = 0; axis < 3; ++axis) {
+        if(extent[axis] <= 0.0f)
+            extent[axis] = 1.0f; // flat along this axis, any scale decodes correctly
+    }
+
+    positionDecode = glm::scale(glm::translate(glm::mat4(1.0f), minPos), extent);
+
+    const bool hasNormals = normals.size() == positions.size();
+    const bool hasUvs = uvs.size() == positions.size();
+
+    for(size_t i = 0; i < positions.size(); ++i) {
+        CompactVertex& v = result[i];
+
+        glm::vec3 normalized = (positions[i] - minPos) / extent;
+        for(int axis = 0; axis < 3; ++axis)
+            v.position[axis] = uint16_t(std::floor(glm::clamp(normalized[axis], 0.0f, 1.0f) * 65535.0f + 0.5f));
+        v.position[3] = 0;
+
+        glm::vec2 oct = hasNormals ? octEncode(normals[i]) : glm::vec2(0.0f);
+        v.normal[0] = packSnorm16(oct.x);
+        v.normal[1] = packSnorm16(oct.y);
+
+        glm::uint halves = glm::packHalf2x16(hasUvs ? uvs[i] : glm::vec2(0.0f));
+        v.uv[0] = uint16_t(halves & 0xffff);
+        v.uv[1] = uint16_t(halves >> 16);
+    }
+
+    if(error) {
+        *error = Error();
+        double positionSum = 0.0;
+
+        for(size_t i = 0; i < positions.size(); ++i) {
+            const CompactVertex& v = result[i];
+
+            glm::vec3 decoded = minPos + extent * glm::vec3(v.position[0], v.position[1], v.position[2]) / 65535.0f;
+            float positionError = glm::distance(decoded, positions[i]);
+            error->maxPosition = std::max(error->maxPosition, positionError);
+            positionSum += positionError;
+
+            if(hasNormals && glm::length(normals[i]) > 0.0f) {
+                glm::vec3 normal = octDecode(glm::vec2(unpackSnorm16(v.normal[0]), unpackSnorm16(v.normal[1])));
+                float cosine = glm::clamp(glm::dot(normal, glm::normalize(normals[i])), -1.0f, 1.0f);
+                error->maxNormalDegrees = std::max(error->maxNormalDegrees, glm::degrees(std::acos(cosine)));
+            }
+
+            if(hasUvs) {
+                glm::vec2 uv = glm::unpackHalf2x16(glm::uint(v.uv[0]) | (glm::uint(v.uv[1]) << 16));
+                glm::vec2 difference = glm::abs(uv - uvs[i]);
+                error->maxUv = std::max(error->maxUv, std::max(difference.x, difference.y));
+            }
+        }
+
+        if(!positions.empty())
+            error->meanPosition = float(positionSum / positions.size());
+        float diagonal = glm::length(maxPos - minPos);
+        if(diagonal > 0.0f)
+            error->maxPositionRelative = error->maxPosition / diagonal;
+    }
+
+    return result;
+}
+
+glm::vec2 VertexCompressor::octEncode(glm::vec3 normal) {
+    float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if(length <= 0.0f)
+        return glm::vec2(0.0f);
+
+    // Project onto the octahedron, then fold the lower hemisphere over the upper one
+    glm::vec3 n = normal / length;
+    if(n.z >= 0.0f)
+        return glm::vec2(n.x, n.y);
+    return glm::vec2(
+        (1.0f - std::abs(n.y)) * signNotZero(n.x),
+        (1.0f - std::abs(n.x)) * signNotZero(n.y)
+    );
+}
+
+uint32_t VertexCompressor::packTangent(glm::vec4 tangent) {
+    // Two bits hold -1 as 3 and +1 as 1
+    uint32_t sign = tangent.w < 0.0f ? 3u : 1u;
+    return packSnorm10(tangent.x) | (packSnorm10(tangent.y) << 10) | (packSnorm10(tangent.z) << 20) | (sign << 30);
+}
+
+glm::vec4 VertexCompressor::unpackTangent(uint32_t packed) {
+    return glm::vec4(
+        unpackSnorm(packed, 0, 10),
+        unpackSnorm(packed, 10, 10),
+        unpackSnorm(packed, 20, 10),
+        unpackSnorm(packed, 30, 2)
+    );
+}
+
+glm::vec3 VertexCompressor::octDecode(glm::vec2 encoded) {
+    glm::vec3 n(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+    if(n.z < 0.0f) {
+        float x = n.x;
+        n.x = (1.0f - std::abs(n.y)) * signNotZero(x);
+        n.y = (1.0f - std::abs(x)) * signNotZero(n.y);
+    }
+    return glm::normalize(n);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "glm.hpp"
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+// Packs float vertex attributes (32 bytes per vertex) into a 16 byte interleaved format:
+//  - positions as 16-bit unsigned normalized values relative to the mesh bounding box,
+//    turned back into object space by a per-mesh decode matrix
+//  - normals octahedral-encoded into two 16-bit signed normalized values
+//  - texture coordinates as half floats
+class VertexCompressor {
+
+public:
+    struct CompactVertex {
+        uint16_t position[4]; // x, y, z and padding
+        int16_t normal[2];
+        uint16_t uv[2];
+    };
+
+    // Worst case differences between the original and decoded attributes
+    struct Error {
+        Error();
+
+        float maxPosition;       // Object-space distance
+        float meanPosition;
+        float maxPositionRelative; // maxPosition divided by the bounding box diagonal
+        float maxNormalDegrees;
+        float maxUv;
+    };
+
+    // Returns the packed vertices. positionDecode receives the matrix that maps the
+    // normalized [0, 1] positions back to object space; if error is non-null it is
+    // filled by decoding every vertex again and comparing against the input.
+    static vector<CompactVertex> compress(const vector<glm::vec3>& positions,
+                                          const vector<glm::vec3>& normals,
+                                          const vector<glm::vec2>& uvs,
+                                          glm::mat4& positionDecode,
+                                          Error* error = nullptr);
+
+    static glm::vec2 octEncode(glm::vec3 normal);
+    static glm::vec3 octDecode(glm::vec2 encoded);
+
+    // Tangents are packed into the signed normalized 10:10:10:2 layout of GL_INT_2_10_10_10_REV:
+    // x, y and z of the unit tangent in the low 30 bits, and the bitangent sign (w) in the top two
+    static uint32_t packTangent(glm::vec4 tangent);
+    static glm::vec4 unpackTangent(uint32_t packed);
+
+private:
+    VertexCompressor();
+    ~VertexCompressor();
+};
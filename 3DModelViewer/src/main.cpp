@@ -1,13 +1,189 @@
 #include "mainwindow.h"
+#include "BatchRenderer.h"
+#include "Benchmark.h"
+#include "MeshAnalyzer.h"
+#include "OffscreenRenderer.h"
+#include "PointCloudFile.h"
 #include <QtWidgets/QApplication>
+#include "QCommandLineParser"
+#include "QDebug"
+#include "QDir"
+#include "QFile"
+#include "QFileInfo"
+#include "QTextStream"
+#include "QJsonDocument"
+
+#include <algorithm>
+
+// Parses --size into size, leaving it unchanged if the option is not set. Returns false on invalid input.
+static bool parseSize(const QCommandLineParser& parser, QSize& size) {
+    if(!parser.isSet("size"))
+        return true;
+
+    QStringList values = parser.value("size").split('x');
+    bool widthOk = false, heightOk = false;
+    if(values.size() == 2)
+        size = QSize(values[0].toInt(&widthOk), values[1].toInt(&heightOk));
+    if(!widthOk || !heightOk || size.isEmpty()) {
+        qWarning() << "Invalid size" << parser.value("size") << "- expected WIDTHxHEIGHT";
+        return false;
+    }
+    return true;
+}
+
+// Replaces options with those of the --profile import profile, if it is set. Returns false on invalid input.
+static bool parseProfile(const QCommandLineParser& parser, Model::ImportOptions& options) {
+    if(!parser.isSet("profile"))
+        return true;
+
+    Model::ImportProfile profile;
+    if(!Model::parseProfile(parser.value("profile").trimmed().toLower().toStdString(), profile)) {
+        qWarning() << "Unknown import profile" << parser.value("profile") << "- expected fast-preview, standard or high-quality";
+        return false;
+    }
+    options = Model::ImportOptions::fromProfile(profile);
+    return true;
+}
+
+// Parses the headless rendering options into options. Returns false on invalid input.
+static bool parseRenderOptions(const QCommandLineParser& parser, BatchRenderer::Options& options) {
+    if(!parseSize(parser, options.size))
+        return false;
+
+    if(parser.isSet("views")) {
+        options.views.clear();
+        for(const QString& name : parser.value("views").split(',', QString::SkipEmptyParts)) {
+            OffscreenRenderer::View view;
+            if(!OffscreenRenderer::parseView(name.trimmed().toLower().toStdString(), view)) {
+                qWarning() << "Unknown view" << name;
+                return false;
+            }
+            options.views.push_back(view);
+        }
+    }
+
+    // The individual import options are applied on top of the profile
+    if(!parseProfile(parser, options.importOptions))
+        return false;
+    if(parser.isSet("import-options") && !Benchmark::parseImportOptions(parser.value("import-options"), options.importOptions)) {
+        qWarning() << "Invalid import options" << parser.value("import-options");
+        return false;
+    }
+    if(parser.isSet("out"))
+        options.outputDirectory = parser.value("out");
+    if(parser.isSet("threads"))
+        options.numThreads = parser.value("threads").toInt();
+
+    return !options.views.empty();
+}
+
+// Parses the benchmark options into options. Returns false on invalid input.
+static bool parseBenchmarkOptions(const QCommandLineParser& parser, Benchmark::Options& options) {
+    if(!parseSize(parser, options.size))
+        return false;
+
+    if(parser.isSet("frames"))
+        options.frames = std::max(1, parser.value("frames").toInt());
+    if(parser.isSet("picks"))
+        options.picks = std::max(0, parser.value("picks").toInt());
+
+    // The individual import options are applied on top of the profile
+    if(!parseProfile(parser, options.importOptions))
+        return false;
+    if(parser.isSet("import-options") && !Benchmark::parseImportOptions(parser.value("import-options"), options.importOptions)) {
+        qWarning() << "Invalid import options" << parser.value("import-options");
+        return false;
+    }
+    return true;
+}
+
+// Writes a benchmark report to the --json file, or to standard output. Returns false on failure.
+static bool writeReport(const QCommandLineParser& parser, const QJsonObject& report) {
+    QByteArray text = QJsonDocument(report).toJson();
+    if(!parser.isSet("json")) {
+        QTextStream(stdout) << text;
+        return true;
+    }
+
+    QFile file(parser.value("json"));
+    if(!file.open(QIODevice::WriteOnly) || file.write(text) != text.size()) {
+        qWarning() << "Could not write" << parser.value("json");
+        return false;
+    }
+    return true;
+}
+
+// Loads the --analyze model with the --profile and --import-options stages and writes the report of
+// its meshes to the --json file, or to standard output. Returns false on failure.
+static bool analyzeModel(const QCommandLineParser& parser) {
+    Model::ImportOptions options;
+    if(!parseProfile(parser, options))
+        return false;
+    if(parser.isSet("import-options") && !Benchmark::parseImportOptions(parser.value("import-options"), options)) {
+        qWarning() << "Invalid import options" << parser.value("import-options");
+        return false;
+    }
+
+    OffscreenRenderer renderer;
+    if(!renderer.makeCurrent(QSize(1, 1))) {
+        qWarning() << "Could not create an OpenGL context";
+        return false;
+    }
+
+    QJsonObject report;
+    {
+        // The model has to be destroyed while the context is current
+        const string fileName = parser.value("analyze").toStdString();
+        std::unique_ptr<Model> model = renderer.loadModel(fileName, options);
+        if(!model) {
+            qWarning() << "Could not load" << parser.value("analyze");
+            return false;
+        }
+        report = MeshAnalyzer::toJson(MeshAnalyzer::analyze(*model));
+        report["file"] = parser.value("analyze");
+        report["profile"] = QString::fromStdString(Model::profileName(options.profile));
+    }
+    renderer.releaseResources();
+    return writeReport(parser, report);
+}
+
+// Builds the octree file of the --point-octree cloud in the --out directory, or next to the cloud.
+// Returns false on failure.
+static bool buildPointOctree(const QCommandLineParser& parser) {
+    QFileInfo input(parser.value("point-octree"));
+    QDir directory = parser.isSet("out") ? QDir(parser.value("out")) : input.absoluteDir();
+    QString output = directory.filePath(input.completeBaseName() + "." + PointCloudFile::Suffix);
+
+    size_t memoryBytes = PointCloudFile::DefaultBuildMemory;
+    if(parser.isSet("memory")) {
+        bool ok = false;
+        int megabytes = parser.value("memory").toInt(&ok);
+        if(!ok || megabytes <= 0) {
+            qWarning() << "Invalid memory" << parser.value("memory") << "- expected a number of megabytes";
+            return false;
+        }
+        memoryBytes = size_t(megabytes) << 20;
+    }
+
+    ImportStatistics statistics;
+    string error;
+    if(!PointCloudFile::build(input.filePath().toStdString(), output.toStdString(), memoryBytes, statistics, error)) {
+        qWarning() << "Could not build the octree of" << input.filePath() << ":" << error.c_str();
+        return false;
+    }
+    QTextStream(stdout) << statistics.toText() << "Wrote " << output << "\n";
+    return true;
+}
 
 int main(int argc, char *argv[]) {
-    QApplication app(argc, argv);
-    app.setAttribute(Qt::AA_ShareOpenGLContexts);
+    // Models are loaded on contexts shared with the viewers' (see ModelLoader). Qt only creates the
+    // global share context if this is set before the application, and with the default format.
+    QApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
 
     // Required for OSX
     QSurfaceFormat format;
     format.setDepthBufferSize(24);
+    format.setStencilBufferSize(8); // Section caps
     format.setMajorVersion(3);
     format.setMinorVersion(3);
     format.setSamples(4);
@@ -15,6 +191,62 @@ int main(int argc, char *argv[]) {
     format.setOption(QSurfaceFormat::DebugContext);
     QSurfaceFormat::setDefaultFormat(format);
 
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "3D model viewer. With --render, models are rendered to images without opening a window; "
+        "add -platform offscreen on machines without a display."
+    );
+    parser.addHelpOption();
+    parser.addOptions({
+        { "render", "Render a model, or every model found below a directory, to images.", "file or directory" },
+        { "size", "Size of the rendered images (default 512x512).", "WIDTHxHEIGHT" },
+        { "views", "Comma separated views to render: iso, front, back, left, right, top, bottom (default iso).", "views" },
+        { "out", "Directory the images are written to (default current directory).", "directory" },
+        { "threads", "Number of render workers, each with its own OpenGL context (default one per core).", "count" },
+        { "benchmark", "Measure import stages and frame times of a model, or of every model below a directory.", "file or directory" },
+        { "frames", "Number of measured frames in the benchmark orbit (default 360).", "count" },
+        { "picks", "Number of pixels the benchmark picks with rays and with the id buffer, to compare their latency (default 0).", "count" },
+        { "profile", "Import profile: fast-preview, standard (default) or high-quality.", "profile" },
+        { "import-options", "Import stages to use, e.g. lods=1,optimize=1,compress=0,clusters=1,native=1,cache=1,edges=1,edgeangle=30.", "options" },
+        { "parse-benchmark", "Compare the speed of number parsers on the text models (OBJ, ASCII PLY and STL) of a file or directory.", "file or directory" },
+        { "analyze", "Report the triangles, unique vertices, degenerate and duplicate triangles, non-manifold and boundary edges, "
+                     "area and volume of every mesh of a model as JSON.", "file" },
+        { "json", "File the benchmark or analysis report is written to (default standard output).", "file" },
+        { "point-octree", "Preprocess a point cloud (PLY, XYZ, PTS or LAS) of any size into an octree file (.mvpc), which is streamed from disk when opened. "
+                          "Written to the --out directory, or next to the cloud.", "file" },
+        { "memory", "Memory the point octree build holds points in, in MB (default 2048).", "MB" }
+    });
+    parser.process(app);
+
+    if(parser.isSet("render")) {
+        BatchRenderer::Options options;
+        if(!parseRenderOptions(parser, options))
+            return 1;
+
+        BatchRenderer renderer(options);
+        return renderer.run(parser.value("render")) == 0 ? 0 : 2;
+    }
+
+    if(parser.isSet("benchmark")) {
+        Benchmark::Options options;
+        if(!parseBenchmarkOptions(parser, options))
+            return 1;
+
+        Benchmark benchmark(options);
+        return writeReport(parser, benchmark.run(parser.value("benchmark"))) ? 0 : 1;
+    }
+
+    if(parser.isSet("point-octree"))
+        return buildPointOctree(parser) ? 0 : 1;
+
+    if(parser.isSet("analyze"))
+        return analyzeModel(parser) ? 0 : 1;
+
+    if(parser.isSet("parse-benchmark"))
+        return writeReport(parser, Benchmark::benchmarkNumberParsing(parser.value("parse-benchmark"))) ? 0 : 1;
+
     MainWindow window;
     window.show();
 
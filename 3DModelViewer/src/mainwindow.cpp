@@ -2,10 +2,18 @@
 #include "TabPane.h"
 #include "ModelViewer.h"
 #include "QMenu"
+#include "QActionGroup"
 #include "QFileDialog"
 #include "QErrorMessage"
+#include "QLabel"
+#include "QTimer"
+#include "ModelStatisticsDialog.h"
+#include "MeshReportDialog.h"
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
+MainWindow::MainWindow(QWidget *parent) :
+  QMainWindow(parent),
+  _importProfile(Model::Standard)
+{
     _ui.setupUi(this);
 
     connect(_ui.actionNew, SIGNAL(triggered()), this, SLOT(addNew()));
@@ -13,6 +21,48 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     connect(_ui.actionView_wireframe, SIGNAL(triggered(bool)), _ui.tabPane, SLOT(enableWireFrameView(bool)));
     connect(_ui.actionLighting, SIGNAL(triggered(bool)), _ui.tabPane, SLOT(enableLighting(bool)));
     connect(_ui.actionToggleTexturing, SIGNAL(triggered(bool)), _ui.tabPane, SLOT(enableTexturing(bool)));
+    // Clicking a model shows what was picked
+    connect(_ui.tabPane, SIGNAL(picked(QString)), _ui.statusBar, SLOT(showMessage(QString)));
+    // Files are read in the background, so most that can't be loaded are only found out later
+    connect(_ui.tabPane, SIGNAL(loadFailed(int, QString)), this, SLOT(loadFailed(int, QString)));
+
+    // Files are imported with the profile checked when they are opened
+    QMenu* profileMenu = new QMenu(tr("Import profile"), this);
+    QActionGroup* profileGroup = new QActionGroup(this);
+    const std::pair<Model::ImportProfile, QString> profiles[] = {
+        { Model::FastPreview, tr("Fast preview") },
+        { Model::Standard, tr("Standard") },
+        { Model::HighQuality, tr("High quality") }
+    };
+    for(const auto& profile : profiles) {
+        QAction* action = profileMenu->addAction(profile.second);
+        action->setCheckable(true);
+        action->setChecked(profile.first == _importProfile);
+        action->setData(int(profile.first));
+        profileGroup->addAction(action);
+    }
+    connect(profileGroup, SIGNAL(triggered(QAction*)), this, SLOT(setImportProfile(QAction*)));
+    _ui.menuFile->insertMenu(_ui.actionExit, profileMenu);
+    _ui.menuFile->insertSeparator(_ui.actionExit);
+
+    QMenu* viewMenu = _ui.menuBar->addMenu(tr("View"));
+    QAction* cullingAction = viewMenu->addAction(tr("Cull back faces"));
+    cullingAction->setCheckable(true);
+    cullingAction->setStatusTip(tr("Skip triangles facing away from the camera; only correct for closed meshes"));
+    connect(cullingAction, SIGNAL(triggered(bool)), _ui.tabPane, SLOT(enableBackfaceCulling(bool)));
+    viewMenu->addSeparator();
+    QAction* statisticsAction = viewMenu->addAction(tr("Model statistics..."));
+    connect(statisticsAction, SIGNAL(triggered()), this, SLOT(showModelStatistics()));
+    QAction* meshReportAction = viewMenu->addAction(tr("Mesh report..."));
+    connect(meshReportAction, SIGNAL(triggered()), this, SLOT(showMeshReport()));
+
+    // Memory use of the current tab and of all tabs, refreshed once a second
+    _memoryLabel = new QLabel(this);
+    _ui.statusBar->addPermanentWidget(_memoryLabel);
+    QTimer* memoryTimer = new QTimer(this);
+    connect(memoryTimer, SIGNAL(timeout()), this, SLOT(updateMemoryStatus()));
+    memoryTimer->start(1000);
+    updateMemoryStatus();
 }
 
 MainWindow::~MainWindow() {}
@@ -29,18 +79,17 @@ void MainWindow::addNew() {
         tr("Open file"),       // Caption
         QDir::homePath(),      // Directory
         tr("All Files (*.*);;" // File filter
-           "Wavefront (*.obj)")
+           "Wavefront (*.obj);;"
+           "Point clouds (*.ply *.xyz *.pts *.las);;"
+           "Point octrees (*.mvpc)")
     ).toStdString();
 
     if(_file.length() == 0)
         return; // no file picked
 
     // Load the file into the viewer
-    if(_ui.tabPane->addTab(_file) == -1) {
-        // If we can't load the file, create an error popup
-        QErrorMessage errorBox;
-        errorBox.showMessage("Error: Invalid file tpye");
-        errorBox.exec();
+    if(_ui.tabPane->addTab(_file, Model::ImportOptions::fromProfile(_importProfile)) == -1) {
+        showLoadError();
         return;
     }
 
@@ -54,6 +103,50 @@ void MainWindow::addNew() {
     //setCentralWidget(_tabPane);
 }
 
+void MainWindow::loadFailed(int index, const QString& fileName) {
+    _ui.tabPane->closeTab(index);
+    if(QString::fromStdString(_file) == fileName)
+        setWindowTitle("3D Model Viewer");
+    showLoadError();
+}
+
+void MainWindow::showLoadError() {
+    // If we can't load the file, create an error popup
+    QErrorMessage errorBox;
+    errorBox.showMessage("Error: Invalid file tpye");
+    errorBox.exec();
+}
+
+void MainWindow::setImportProfile(QAction* action) {
+    _importProfile = Model::ImportProfile(action->data().toInt());
+}
+
 void MainWindow::exitApp() {
     close();
+}
+
+void MainWindow::showModelStatistics() {
+    ModelViewer* viewer = _ui.tabPane->currentViewer();
+    if(!viewer || !viewer->getModel())
+        return; // nothing loaded
+
+    ModelStatisticsDialog dialog(viewer->getModel()->getImportStatistics(), viewer->getMemoryUsage(), this);
+    dialog.exec();
+}
+
+void MainWindow::showMeshReport() {
+    ModelViewer* viewer = _ui.tabPane->currentViewer();
+    if(!viewer || !viewer->getModel())
+        return; // nothing loaded
+
+    MeshReportDialog dialog(*viewer->getModel(), this);
+    dialog.exec();
+}
+
+void MainWindow::updateMemoryStatus() {
+    QString text = tr("All tabs: %1").arg(MemoryTracker::toText(MemoryTracker::globalUsage()));
+    ModelViewer* viewer = _ui.tabPane->currentViewer();
+    if(viewer)
+        text = tr("This tab: %1    %2").arg(MemoryTracker::toText(viewer->getMemoryUsage())).arg(text);
+    _memoryLabel->setText(text);
 }
\ No newline at end of file
@@ -10,6 +10,7 @@ using std::shared_ptr;
 using std::string;
 
 class TabPane;
+class QLabel;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -22,10 +23,22 @@ private:
     Ui::MainWindowClass _ui;
     TabPane* _tabPane;
     string _file;
+    QLabel* _memoryLabel;
+    // Profile used for the next file opened
+    Model::ImportProfile _importProfile;
+
+    // Shows the error popup for a file that could not be loaded
+    void showLoadError();
 
 private slots:
     void addNew();
+    // Closes the tab of a file that could not be loaded and reports it
+    void loadFailed(int index, const QString& fileName);
+    void setImportProfile(QAction* action);
     void exitApp();
+    void showModelStatistics();
+    void showMeshReport();
+    void updateMemoryStatus();
 
 };
 